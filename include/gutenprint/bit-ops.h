@@ -41,6 +41,20 @@ extern "C" {
 extern void	stp_fold(const unsigned char *line, int single_length,
 			 unsigned char *outbuf);
 
+/**
+ * Like stp_fold, but only interleave bytes first through last of each
+ * bit string.  Only bytes 2 * first through 2 * last + 1 of the output
+ * are written.
+ *
+ * @param line the input bit string
+ * @param single_length the length (in bytes) of the input
+ * @param first the first byte of each bit string to interleave
+ * @param last the last byte of each bit string to interleave
+ * @param outbuf the output.
+ */
+extern void	stp_fold_extent(const unsigned char *line, int single_length,
+				int first, int last, unsigned char *outbuf);
+
 /**
  * Interleave a buffer consisting of three bit strings of length single_length
  * into one string of packed three-bit ints.
@@ -131,6 +145,40 @@ extern void	stp_split_4(int height, int bits, const unsigned char *in,
 extern void	stp_unpack(int height, int bits, int n, const unsigned char *in,
 			   unsigned char **outs);
 
+/**
+ * Like stp_unpack, but only unpack the part of the input containing
+ * bytes first through last.  The part is widened to whole output bytes,
+ * which are written exactly as stp_unpack would write them; the rest of
+ * the outputs is left alone.
+ *
+ * @param height the number of integers in the input divided by 8
+ * @param bits the bit depth (1 or 2)
+ * @param n the number of outputs into which the input should be distributed
+ * @param in the input bit string
+ * @param outs the array of output bit strings
+ * @param first the first byte of the input to unpack
+ * @param last the last byte of the input to unpack
+ * @param out_first the first byte written to each output
+ * @param out_last the last byte written to each output
+ * @returns 1 if anything was written, 0 otherwise
+ */
+extern int	stp_unpack_extent(int height, int bits, int n,
+				  const unsigned char *in, unsigned char **outs,
+				  int first, int last,
+				  int *out_first, int *out_last);
+
+/**
+ * Find the first and last nonzero bytes of a line.
+ *
+ * @param line the line
+ * @param length the length (in bytes) of the line
+ * @param first the first nonzero byte, or length if there are none
+ * @param last the last nonzero byte, or 0 if there are none
+ * @returns 1 if the line has any nonzero bytes, 0 otherwise
+ */
+extern int	stp_find_extent(const unsigned char *line, int length,
+				int *first, int *last);
+
 /**
  * Deprecated -- use stp_unpack
  */
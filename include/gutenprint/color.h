@@ -77,6 +77,16 @@ extern stp_parameter_list_t stp_color_list_parameters(const stp_vars_t *v);
 extern void stp_color_describe_parameter(const stp_vars_t *v, const char *name,
 					 stp_parameter_t *description);
 
+/*
+ * Render an 8 bit RGB soft preview of the image with the color settings
+ * in v (which must include InputImageType), without printing it.  out
+ * must hold width * height * 3 bytes.  Curves whose settings have not
+ * changed since the previous call are not recomputed.  Return value is
+ * 1 on success, 0 on failure.
+ */
+extern int stp_color_preview(const stp_vars_t *v, stp_image_t *image,
+			     unsigned char *out);
+
 extern int
 stp_color_register(const stp_color_t *color);
 
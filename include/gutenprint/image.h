@@ -47,6 +47,9 @@ extern "C" {
 /*! The maximum number of channels. */
 #define STP_CHANNEL_LIMIT	(64)
 
+/*! The image can deliver its rows in any order (see stp_image_t::flags). */
+#define STP_IMAGE_RANDOM_ACCESS	(1 << 0)
+
 
 /** Image status. */
 typedef enum
@@ -95,14 +98,16 @@ typedef struct stp_image
    * something goes wrong, or the application wishes to stop producing
    * any further output (e. g. because the user cancelled the print
    * job), it should return STP_IMAGE_STATUS_ABORT.  This will cause
-   * the driver to flush any remaining data to the output.  It will
-   * always request rows in monotonically ascending order, but it may
-   * skip rows (if, for example, the resolution of the input is higher
-   * than the resolution of the output).
+   * the driver to flush any remaining data to the output.  Unless the
+   * image sets STP_IMAGE_RANDOM_ACCESS in flags, it will always
+   * request rows in monotonically ascending order, but it may skip
+   * rows (if, for example, the resolution of the input is higher than
+   * the resolution of the output).
    * @param image the image in use.
    * @param data a pointer to width() bytes of pixel data.
    * @param byte_limit (image width * number of channels).
-   * @param row (unused).
+   * @param row the row requested.  Images that do not set
+   * STP_IMAGE_RANDOM_ACCESS may ignore this.
    */
   stp_image_status_t (*get_row)(struct stp_image *image, unsigned char *data,
                                 size_t byte_limit, int row);
@@ -121,6 +126,44 @@ typedef struct stp_image
    * need to be associated with the image object.
    */
   void *rep;
+  /**
+   * STP_IMAGE_* flags describing optional capabilities of the image.
+   * STP_IMAGE_RANDOM_ACCESS means that get_row() honors its row
+   * argument for any row in any order, which lets drivers that print
+   * the image upside down (e. g. the back sides of duplex pages) read
+   * it directly rather than buffering the whole page.  Images that
+   * predate this member leave it zero.
+   */
+  unsigned flags;
+  /**
+   * Optional.  This callback transfers count consecutive rows, starting
+   * at row, into data, each row occupying byte_limit bytes, as if
+   * get_row() had been called for each of them in turn.  Unlike
+   * get_row(), it must honor its row argument.  The color layer uses
+   * it, when provided, to fetch the image a tile of rows at a time.
+   * @param image the image in use.
+   * @param data a pointer to count * byte_limit bytes of pixel data.
+   * @param byte_limit (image width * number of channels).
+   * @param row the first row requested.
+   * @param count the number of rows requested.
+   */
+  stp_image_status_t (*get_rows)(struct stp_image *image, unsigned char *data,
+				 size_t byte_limit, int row, int count);
+  /**
+   * Optional.  This callback returns a pointer to the image's own copy
+   * of row, in the format get_row() would deliver it, so that the
+   * pixels need not be copied at all.  It sets *count to the number of
+   * consecutive rows, byte_limit bytes apart, that may be read from
+   * the pointer.  The data need only remain valid until the next call
+   * on the image.  It may return NULL, in which case get_rows() or
+   * get_row() is used.
+   * @param image the image in use.
+   * @param byte_limit (image width * number of channels).
+   * @param row the first row requested.
+   * @param count returns the number of rows available.
+   */
+  const unsigned char *(*map_rows)(struct stp_image *image, size_t byte_limit,
+				   int row, int *count);
 } stp_image_t;
 
 extern void stp_image_init(stp_image_t *image);
@@ -130,6 +173,13 @@ extern int stp_image_height(stp_image_t *image); /* In pixels */
 extern stp_image_status_t stp_image_get_row(stp_image_t *image,
 					    unsigned char *data,
 					    size_t limit, int row);
+extern stp_image_status_t stp_image_get_rows(stp_image_t *image,
+					     unsigned char *data,
+					     size_t limit, int row,
+					     int count);
+extern const unsigned char *stp_image_map_rows(stp_image_t *image,
+					       size_t limit, int row,
+					       int *count);
 extern const char *stp_image_get_appname(stp_image_t *image);
 extern void stp_image_conclude(stp_image_t *image);
 
@@ -243,6 +243,30 @@ extern void stp_vars_copy(stp_vars_t *dest, const stp_vars_t *source);
  */
 extern stp_vars_t *stp_vars_create_copy(const stp_vars_t *source);
 
+/**
+ * Compute a fingerprint of the settings in a vars object.
+ * Two vars objects with the same driver, color conversion, dimensions
+ * and parameter settings (regardless of the order in which they were
+ * set) have the same fingerprint.  Output, error, and debug functions,
+ * component data, and the PageNumber parameter are not considered, so
+ * successive pages of a job with unchanged settings compare equal.
+ * The value is only meaningful within a single process.
+ * @param v the vars to use.
+ * @returns the fingerprint.
+ */
+extern unsigned long stp_vars_get_fingerprint(const stp_vars_t *v);
+
+/**
+ * Compare the settings in two vars objects.
+ * The same things are compared as are considered by
+ * stp_vars_get_fingerprint(); vars objects whose settings compare equal
+ * have the same fingerprint, but not the other way around.
+ * @param a the first vars.
+ * @param b the second vars.
+ * @returns 1 if the settings are the same, 0 if not.
+ */
+extern int stp_vars_settings_equal(const stp_vars_t *a, const stp_vars_t *b);
+
 /**
  * Destroy a vars object.
  * It is an error to destroy the vars more than once.
@@ -103,6 +103,14 @@ typedef struct {		/* Width of data actually printed */
   int *end_pos;
 } stp_linebounds_t;
 
+typedef struct {		/* Memory used by the pass buffers */
+  size_t limit;			/* Budget in bytes, 0 if unlimited */
+  size_t current;		/* Bytes held in memory now */
+  size_t peak;			/* Most bytes held in memory at once */
+  size_t spilled;		/* Bytes written to the spill file */
+  size_t unbounded;		/* Bytes fixed size buffers would need */
+} stp_weave_memory_t;
+
 typedef enum {
   STP_WEAVE_ZIGZAG,
   STP_WEAVE_ASCENDING,
@@ -122,6 +130,15 @@ typedef void stp_fillfunc(stp_vars_t *v, int row, int subpass,
 typedef void stp_flushfunc(stp_vars_t *v, int passno, int vertical_subpass);
 typedef int stp_compute_linewidth_func(stp_vars_t *v, int n);
 
+/*
+ * Pass buffers beyond a memory limit are moved to a temporary file where
+ * the platform supports it.  The limit, in megabytes (0 for none), is
+ * the integer parameter WeaveBufferLimit if the application has set it,
+ * or else the environment variable STP_WEAVE_BUFFER_LIMIT, and 512 if
+ * neither is set.  No driver lists WeaveBufferLimit among its
+ * parameters; it is only there for applications that set it with
+ * stp_set_int_parameter().
+ */
 extern void stp_initialize_weave(stp_vars_t *v, int jets, int separation,
 				 int oversample, int horizontal,
 				 int vertical, int ncolors, int bitwidth,
@@ -137,6 +154,15 @@ extern void stp_initialize_weave(stp_vars_t *v, int jets, int separation,
 extern stp_packfunc stp_pack_tiff;
 extern stp_packfunc stp_pack_uncompressed;
 
+/*
+ * Produce the same output as stp_pack_tiff, given that bytes first
+ * through last contain all the nonzero bytes of the line, while only
+ * compressing those.
+ */
+extern int stp_pack_tiff_extent(const unsigned char *line, int length,
+				int first, int last, unsigned char *comp_buf,
+				unsigned char **comp_ptr);
+
 extern stp_fillfunc stp_fill_tiff;
 extern stp_fillfunc stp_fill_uncompressed;
 
@@ -160,9 +186,15 @@ stp_get_linecount_by_pass(const stp_vars_t *v, int pass);
 extern const stp_linebufs_t *
 stp_get_linebases_by_pass(const stp_vars_t *v, int pass);
 
+extern const stp_linebounds_t *
+stp_get_linebounds_by_pass(const stp_vars_t *v, int pass);
+
 extern stp_pass_t *
 stp_get_pass_by_pass(const stp_vars_t *v, int pass);
 
+extern int
+stp_get_weave_memory(const stp_vars_t *v, stp_weave_memory_t *usage);
+
 extern void
 stp_weave_parameters_by_row(const stp_vars_t *v, int row,
 			    int vertical_subpass, stp_weave_t *w);
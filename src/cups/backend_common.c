@@ -28,6 +28,11 @@
 
 #include "backend_common.h"
 
+#include <poll.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+
 #define BACKEND_VERSION "0.86G"
 #ifndef URI_PREFIX
 #error "Must Define URI_PREFIX"
@@ -53,6 +58,7 @@ int test_mode = 0;
 
 static int max_xfer_size = URB_XFER_SIZE;
 static int xfer_timeout = XFER_TIMEOUT;
+static int readahead_size = 0;
 
 /* Support Functions */
 static int backend_claim_interface(struct libusb_device_handle *dev, int iface,
@@ -841,7 +847,7 @@ void print_help(char *argv0, struct dyesub_backend *backend)
 	if (!backend) {
 		int i;
 		DEBUG("Environment variables:\n");
-		DEBUG(" DYESUB_DEBUG EXTRA_PID EXTRA_VID EXTRA_TYPE BACKEND SERIAL\n");
+		DEBUG(" DYESUB_DEBUG EXTRA_PID EXTRA_VID EXTRA_TYPE BACKEND SERIAL DYESUB_READAHEAD\n");
 		DEBUG("CUPS Usage:\n");
 		DEBUG("\tDEVICE_URI=someuri %s job user title num-copies options [ filename ]\n", URI_PREFIX);
 		DEBUG("\n");
@@ -927,6 +933,168 @@ int parse_cmdstream(struct dyesub_backend *backend, void *backend_ctx, int fd)
 	return CUPS_BACKEND_OK;
 };
 
+/* Read-ahead of the spool data.
+
+   Backends read a page, then block in main_loop() until the printer
+   has taken it.  Meanwhile nothing drains the input, so the filter
+   generating the next page stalls as soon as the pipe fills.  With
+   DYESUB_READAHEAD=<bytes> set, a helper process keeps reading the
+   input into a buffer of at most that size and feeds it to
+   read_parse() through a pipe, so the next page is produced while the
+   current one prints.  The backends see an ordinary file descriptor,
+   so none of them need to change.  The helper is started before libusb
+   is initialized, so it inherits no USB state; as the input must be
+   known by then, this is only done in CUPS mode. */
+
+static void readahead_loop(int in_fd, int out_fd, uint8_t *buf, size_t size)
+{
+	size_t head = 0, count = 0;
+	int eof = 0;
+
+	while (!terminate && (!eof || count)) {
+		struct pollfd fds[2];
+		int nfds = 0, in_idx = -1, out_idx = -1;
+		ssize_t num;
+
+		if (!eof && count < size) {
+			fds[nfds].fd = in_fd;
+			fds[nfds].events = POLLIN;
+			in_idx = nfds++;
+		}
+		if (count) {
+			fds[nfds].fd = out_fd;
+			fds[nfds].events = POLLOUT;
+			out_idx = nfds++;
+		}
+		if (poll(fds, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (in_idx >= 0 && fds[in_idx].revents) {
+			size_t tail = (head + count) % size;
+			struct iovec iov[2];
+			int iovcnt = 1;
+			iov[0].iov_base = buf + tail;
+			iov[0].iov_len = size - count;
+			if (size - count > size - tail) {
+				iov[0].iov_len = size - tail;
+				iov[1].iov_base = buf;
+				iov[1].iov_len = head;
+				iovcnt = 2;
+			}
+			num = readv(in_fd, iov, iovcnt);
+			if (num > 0)
+				count += num;
+			else if (num == 0 || errno != EINTR)
+				eof = 1;
+		}
+		if (out_idx >= 0 && fds[out_idx].revents) {
+			/* Hand both ring segments over in one write so a wrap
+			   never splits a record the backend reads in one go */
+			struct iovec iov[2];
+			int iovcnt = 1;
+			iov[0].iov_base = buf + head;
+			iov[0].iov_len = count;
+			if (count > size - head) {
+				iov[0].iov_len = size - head;
+				iov[1].iov_base = buf;
+				iov[1].iov_len = count - iov[0].iov_len;
+				iovcnt = 2;
+			}
+			num = writev(out_fd, iov, iovcnt);
+			if (num > 0) {
+				head = (head + num) % size;
+				count -= num;
+			} else if (num < 0 && errno != EINTR && errno != EAGAIN) {
+				break;  /* Backend has gone away */
+			}
+		}
+	}
+}
+
+/* Replace *data_fd with the read end of a pipe fed by a read-ahead
+   process; returns its pid, or -1 if read-ahead could not be set up
+   (in which case *data_fd is untouched). */
+static pid_t start_readahead(int *data_fd, size_t size)
+{
+	int fds[2];
+	pid_t pid;
+	uint8_t *buf;
+
+	/* Allocate before forking; the child may not safely malloc() */
+	buf = malloc(size);
+	if (!buf) {
+		WARNING("Unable to allocate %lu byte read-ahead buffer\n",
+			(unsigned long) size);
+		return -1;
+	}
+	if (pipe(fds) < 0) {
+		free(buf);
+		return -1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		free(buf);
+		return -1;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+		readahead_loop(*data_fd, fds[1], buf, size);
+		close(fds[1]);
+		_exit(0);
+	}
+
+	free(buf);
+	close(fds[1]);
+	close(*data_fd);
+	*data_fd = fds[0];
+	DEBUG("Reading ahead up to %lu bytes of input\n", (unsigned long) size);
+	return pid;
+}
+
+static void stop_readahead(pid_t pid, int data_fd)
+{
+	if (pid <= 0)
+		return;
+	close(data_fd);  /* Unblocks a writer stuck on a full pipe */
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+/* Open the input (unless it is stdin) and make sure it is blocking */
+static int open_input(const char *fname, int *data_fd)
+{
+	int i;
+
+	if (strcmp("-", fname)) {
+		*data_fd = open(fname, O_RDONLY);
+		if (*data_fd < 0) {
+			perror("ERROR:Can't open input file");
+			return CUPS_BACKEND_FAILED;
+		}
+	}
+
+	i = fcntl(*data_fd, F_GETFL, 0);
+	if (i < 0) {
+		perror("ERROR:Can't open input");
+		return CUPS_BACKEND_FAILED;
+	}
+	i &= ~O_NONBLOCK;
+	i = fcntl(*data_fd, F_SETFL, i);
+	if (i < 0) {
+		perror("ERROR:Can't open input");
+		return CUPS_BACKEND_FAILED;
+	}
+
+	return CUPS_BACKEND_OK;
+}
+
 int main (int argc, char **argv)
 {
 	struct libusb_context *ctx = NULL;
@@ -940,8 +1108,7 @@ int main (int argc, char **argv)
 	uint8_t iface, altset;
 
 	int data_fd = fileno(stdin);
-
-	int i;
+	pid_t readahead_pid = -1;
 
 	int ret = CUPS_BACKEND_OK;
 
@@ -979,6 +1146,8 @@ int main (int argc, char **argv)
 		max_xfer_size = atoi(getenv("MAX_XFER_SIZE"));
 	if (getenv("XFER_TIMEOUT"))
 		xfer_timeout = atoi(getenv("XFER_TIMEOUT"));
+	if (getenv("DYESUB_READAHEAD"))
+		readahead_size = atoi(getenv("DYESUB_READAHEAD"));
 	if (getenv("TEST_MODE"))
 		test_mode = atoi(getenv("TEST_MODE"));
 
@@ -1059,6 +1228,18 @@ int main (int argc, char **argv)
 		jobid = rand();
 	}
 
+	/* In CUPS mode the input is known now, so open it and start any
+	   read-ahead before libusb is initialized */
+	if (uri) {
+		ret = open_input(fname, &data_fd);
+		if (ret)
+			return ret;
+		if (readahead_size > 0)
+			readahead_pid = start_readahead(&data_fd, readahead_size);
+	} else if (readahead_size > 0) {
+		DEBUG("DYESUB_READAHEAD is only used in CUPS mode\n");
+	}
+
 #ifndef LIBUSB_PRE_1_0_10
 	if (dyesub_debug) {
 		const struct libusb_version *ver;
@@ -1193,28 +1374,10 @@ bypass:
 	}
 
 	/* Open file if not STDIN */
-	if (strcmp("-", fname)) {
-		data_fd = open(fname, O_RDONLY);
-		if (data_fd < 0) {
-			perror("ERROR:Can't open input file");
-			ret = CUPS_BACKEND_FAILED;
+	if (!uri) {
+		ret = open_input(fname, &data_fd);
+		if (ret)
 			goto done;
-		}
-	}
-
-	/* Ensure we're using BLOCKING I/O */
-	i = fcntl(data_fd, F_GETFL, 0);
-	if (i < 0) {
-		perror("ERROR:Can't open input");
-		ret = CUPS_BACKEND_FAILED;
-		goto done;
-	}
-	i &= ~O_NONBLOCK;
-	i = fcntl(data_fd, F_SETFL, i);
-	if (i < 0) {
-		perror("ERROR:Can't open input");
-		ret = CUPS_BACKEND_FAILED;
-		goto done;
 	}
 
 	/* Ignore SIGPIPE */
@@ -1271,7 +1434,12 @@ newpage:
 	goto newpage;
 
 done_multiple:
-	close(data_fd);
+	if (readahead_pid > 0) {
+		stop_readahead(readahead_pid, data_fd);
+		readahead_pid = -1;
+	} else {
+		close(data_fd);
+	}
 
 	/* Done printing, log the total number of pages */
 	if (!uri)
@@ -1286,6 +1454,7 @@ done_close:
 	if (test_mode < TEST_MODE_NOATTACH)
 		libusb_close(dev);
 done:
+	stop_readahead(readahead_pid, data_fd);
 
 	if (backend && backend_ctx) {
 		backend->teardown(backend_ctx);
@@ -175,6 +175,7 @@ struct mitsu70x_ctx {
 	int raw_format;
 	int reverse;
 	int sharpen; /* ie mhdr.sharpen - 1 */
+	int use_fallback; /* MITSU70X_FALLBACK set */
 
 	uint8_t rew[2]; /* 1 for rewind ok (default!) */
 
@@ -704,12 +705,21 @@ static int mitsu70x_attach(void *vctx, struct libusb_device_handle *dev, int typ
 
 	ctx->last_l = ctx->last_u = 65535;
 
+	/* The internal fallback is experimental and poor enough that it
+	   must be asked for */
+	if (getenv("MITSU70X_FALLBACK"))
+		ctx->use_fallback = atoi(getenv("MITSU70X_FALLBACK"));
+
 	/* Attempt to open the library */
 #if defined(WITH_DYNAMIC)
 	DEBUG("Attempting to load image processing library\n");
 	ctx->dl_handle = DL_OPEN(LIB_NAME_RE);
-	if (!ctx->dl_handle)
-		WARNING("Image processing library not found, using internal fallback code\n");
+	if (!ctx->dl_handle) {
+		if (ctx->use_fallback)
+			WARNING("Image processing library not found, using experimental internal fallback code\n");
+		else
+			WARNING("Image processing library not found, set MITSU70X_FALLBACK=1 to use experimental internal fallback code\n");
+	}
 	if (ctx->dl_handle) {
 		ctx->GetAPIVersion = DL_SYM(ctx->dl_handle, "lib70x_getapiversion");
 		if (!ctx->GetAPIVersion) {
@@ -762,7 +772,10 @@ static int mitsu70x_attach(void *vctx, struct libusb_device_handle *dev, int typ
 		break;
 	}
 #else
-	WARNING("Dynamic library support not enabled, using internal fallback code\n");
+	if (ctx->use_fallback)
+		WARNING("Dynamic library support not enabled, using experimental internal fallback code\n");
+	else
+		WARNING("Dynamic library support not enabled, set MITSU70X_FALLBACK=1 to use experimental internal fallback code\n");
 #endif
 
 	struct mitsu70x_printerstatus_resp resp;
@@ -834,6 +847,67 @@ static void mitsu70x_teardown(void *vctx) {
 	free(ctx);
 }
 
+/* EXPERIMENTAL internal fallback for when the image processing library
+   is missing.  Converts 8bpp BGR to the 16bpp planar YMC the printer
+   takes, the same as a "raw" spool, with an optional sharpening pass.
+   There is no CPC (head and color correction) processing, so quality is
+   poor.  It has not been checked against the library's output or on a
+   printer. */
+static void mitsu70x_fallback_convert(const uint8_t *src, uint8_t *dest,
+				      uint16_t rows, uint16_t cols,
+				      uint32_t planelen, int sharpen,
+				      int reverse)
+{
+	uint32_t stride = cols * 3;
+	uint16_t row, col;
+	int plane;
+
+	/* Each plane is padded out to a multiple of 512 bytes */
+	for (plane = 0 ; plane < 3 ; plane++)
+		memset(dest + plane * planelen + rows * cols * 2, 0,
+		       planelen - rows * cols * 2);
+	if (sharpen < 0)
+		sharpen = 0;
+
+	for (row = 0 ; row < rows ; row++) {
+		const uint8_t *in = src + row * stride;
+		const uint8_t *up = row ? in - stride : in;
+		const uint8_t *down = (row + 1 < rows) ? in + stride : in;
+		/* Rows go out in print order */
+		uint32_t out = ((reverse ? rows - 1 - row : row) * cols) * 2;
+
+		for (plane = 0 ; plane < 3 ; plane++) {
+			uint8_t *o = dest + plane * planelen + out;
+			const uint8_t *c = in + plane;
+
+			if (!sharpen) {
+				for (col = 0 ; col < cols ; col++, c += 3) {
+					/* Scale up to 16 bits, big-endian */
+					*o++ = 255 - *c;
+					*o++ = 255 - *c;
+				}
+				continue;
+			}
+
+			/* Unsharp mask against the four neighbours; the
+			   edge columns are their own outside neighbour */
+			for (col = 0 ; col < cols ; col++, c += 3) {
+				uint32_t i = c - in;
+				int32_t l = col ? c[-3] : c[0];
+				int32_t r = (col + 1 < cols) ? c[3] : c[0];
+				int32_t val = 255 - c[0];
+				val += sharpen * (l + r + up[i] + down[i] - 4 * c[0]) / 16;
+				if (val < 0)
+					val = 0;
+				else if (val > 255)
+					val = 255;
+				*o++ = val;
+				*o++ = val;
+			}
+		}
+	}
+}
+
 static int mitsu70x_read_parse(void *vctx, int data_fd) {
 	struct mitsu70x_ctx *ctx = vctx;
 	int i, remain;
@@ -1128,9 +1202,18 @@ repeat:
 				return CUPS_BACKEND_CANCEL;
 			}
 		} else {
-			// XXXFALLBACK write fallback code?
-			ERROR("!!! Image Processing Library not found, aborting!\n");
-			return CUPS_BACKEND_CANCEL;
+			if (!ctx->use_fallback) {
+				ERROR("!!! Image Processing Library not found, aborting!\n");
+				return CUPS_BACKEND_CANCEL;
+			}
+			WARNING("Utilizing EXPERIMENTAL fallback internal image processing code\n");
+			WARNING(" *** Output quality will be poor! *** \n");
+
+			/* Lay the planes out as a raw spool would, so they
+			   are sent the same way */
+			mitsu70x_fallback_convert(spoolbuf, ctx->databuf + ctx->datalen,
+						  ctx->rows, ctx->cols, planelen,
+						  ctx->sharpen, ctx->reverse);
 		}
 
 		/* Move up the pointer to after the image data */
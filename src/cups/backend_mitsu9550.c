@@ -41,6 +41,10 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 #define BACKEND mitsu9550_backend
 
 #include "backend_common.h"
@@ -186,6 +190,9 @@ struct mitsu9550_ctx {
 
 	/* CP98xx stuff */
 	struct mitsu98xx_tables *m98xxdata;
+	uint8_t *m98xxmatte;   /* Matte lamination pattern, loaded once */
+	size_t m98xxmatte_len;
+	int m98xxmatte_mapped;
 };
 
 /* Printer data structures */
@@ -273,26 +280,87 @@ struct mitsu9550_status2 {
 		} \
 	} while (0);
 
-static void mitsu98xx_dogamma(uint8_t *src, uint16_t *dest, uint8_t plane,
-			      uint16_t *table, uint32_t len)
+/* Split the packed BGR data into the three planes, running each one
+   through its gamma table and storing the result big-endian, as the
+   printer wants it.  The tables are in native byte order. */
+static void mitsu98xx_dogamma(const uint8_t *src, uint16_t *dest_by,
+			      uint16_t *dest_gm, uint16_t *dest_rc,
+			      const struct mitsu98xx_data *table, uint32_t len)
 {
-	src += plane;
-	while(len--) {
-		*dest++ = table[*src];
+	uint16_t by[256], gm[256], rc[256];
+	int i;
+
+	/* Pre-swap the tables so the loop is nothing but lookups */
+	for (i = 0 ; i < 256 ; i++) {
+		by[i] = cpu_to_be16(table->GNMby[i]);
+		gm[i] = cpu_to_be16(table->GNMgm[i]);
+		rc[i] = cpu_to_be16(table->GNMrc[i]);
+	}
+
+	while (len--) {
+		uint8_t b = src[0], g = src[1], r = src[2];
+		*dest_by++ = by[b];
+		*dest_gm++ = gm[g];
+		*dest_rc++ = rc[r];
 		src += 3;
 	}
-	/* TODO:  Eventually, when we do real processing of this data, we will need to
-	   have the gamma table in native endian format and generate BE data at the end. */
 }
 
-static int mitsu98xx_fillmatte(struct mitsu9550_ctx *ctx)
+/* Load the matte lamination pattern; it is kept for later jobs */
+static int mitsu98xx_load_matte(struct mitsu9550_ctx *ctx)
 {
-	int fd, i;
-	uint32_t j, remain;
+	struct stat st;
+	int fd;
+
+	if (ctx->m98xxmatte)
+		return 0;
 
-	DEBUG("Reading %d bytes of matte data from disk (%d/%d)\n", ctx->cols * ctx->rows, ctx->cols, LAMINATE_STRIDE);
+	DEBUG("Reading matte data from disk\n");
 	fd = open(MITSU_M98xx_LAMINATE_FILE, O_RDONLY);
-	if (fd < 0) {
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || st.st_size < LAMINATE_STRIDE * 2) {
+		close(fd);
+		return -1;
+	}
+	ctx->m98xxmatte_len = st.st_size;
+
+#ifdef HAVE_SYS_MMAN_H
+	ctx->m98xxmatte = mmap(NULL, ctx->m98xxmatte_len, PROT_READ,
+			       MAP_SHARED, fd, 0);
+	if (ctx->m98xxmatte != MAP_FAILED)
+		ctx->m98xxmatte_mapped = 1;
+	else
+		ctx->m98xxmatte = NULL;
+#endif
+
+	if (!ctx->m98xxmatte) {
+		size_t done = 0;
+		ssize_t i;
+
+		ctx->m98xxmatte = malloc(ctx->m98xxmatte_len);
+		if (ctx->m98xxmatte) {
+			while (done < ctx->m98xxmatte_len &&
+			       (i = read(fd, ctx->m98xxmatte + done,
+					 ctx->m98xxmatte_len - done)) > 0)
+				done += i;
+			if (done < ctx->m98xxmatte_len) {
+				free(ctx->m98xxmatte);
+				ctx->m98xxmatte = NULL;
+			}
+		}
+	}
+	close(fd);
+
+	return ctx->m98xxmatte ? 0 : -1;
+}
+
+static int mitsu98xx_fillmatte(struct mitsu9550_ctx *ctx)
+{
+	uint32_t j, offset;
+
+	DEBUG("Tiling %d bytes of matte data (%d/%d)\n", ctx->cols * ctx->rows, ctx->cols, LAMINATE_STRIDE);
+	if (mitsu98xx_load_matte(ctx)) {
 		WARNING("Unable to open matte lamination data file '%s'\n", MITSU_M98xx_LAMINATE_FILE);
 		ctx->hdr1.matte = 0;
 		goto done;
@@ -310,28 +378,25 @@ static int mitsu98xx_fillmatte(struct mitsu9550_ctx *ctx)
 	matte->rows = ctx->hdr1.rows;
 	ctx->datalen += sizeof(struct mitsu9550_plane);
 
-	/* Read in the matte data plane */
+	/* Each print row takes the next LAMINATE_STRIDE entries of the
+	   pattern, wrapping around at its end, but only uses the first
+	   'cols' of them. */
+	offset = 0;
 	for (j = 0 ; j < ctx->rows ; j++) {
-		remain = LAMINATE_STRIDE * 2;
+		uint32_t remain = ctx->cols * 2;
+		uint32_t pos = offset;
 
-		/* Read one row of lamination data at a time */
 		while (remain) {
-			i = read(fd, ctx->databuf + ctx->datalen, remain);
-			if (i < 0)
-				return CUPS_BACKEND_CANCEL;
-			if (i == 0) {
-				/* We hit EOF, restart from beginning */
-				lseek(fd, 0, SEEK_SET);
-				continue;
-			}
-			ctx->datalen += i;
-			remain -= i;
+			uint32_t chunk = ctx->m98xxmatte_len - pos;
+			if (chunk > remain)
+				chunk = remain;
+			memcpy(ctx->databuf + ctx->datalen, ctx->m98xxmatte + pos, chunk);
+			ctx->datalen += chunk;
+			remain -= chunk;
+			pos = 0;
 		}
-		/* Back off the buffer so we "wrap" on the print row. */
-		ctx->datalen -= ((LAMINATE_STRIDE - ctx->cols) * 2);
+		offset = (offset + LAMINATE_STRIDE * 2) % ctx->m98xxmatte_len;
 	}
-	/* We're done! */
-	close(fd);
 
 	/* Fill in the lamination plane footer */
 	ctx->databuf[ctx->datalen++] = 0x1b;
@@ -574,6 +639,13 @@ static void mitsu9550_teardown(void *vctx) {
 		free(ctx->databuf);
 	if (ctx->m98xxdata)
 		free(ctx->m98xxdata);
+#ifdef HAVE_SYS_MMAN_H
+	if (ctx->m98xxmatte_mapped)
+		munmap(ctx->m98xxmatte, ctx->m98xxmatte_len);
+	else
+#endif
+	if (ctx->m98xxmatte)
+		free(ctx->m98xxmatte);
 	free(ctx);
 }
 
@@ -689,6 +761,17 @@ hdr_done:
 			remain -= i;
 		}
 		close(fd);
+
+		/* The gamma tables are stored big-endian */
+		for (i = 0 ; i < 256 ; i++) {
+			struct mitsu98xx_data *data = &ctx->m98xxdata->superfine;
+			int j;
+			for (j = 0 ; j < 3 ; j++, data++) {
+				data->GNMby[i] = be16_to_cpu(data->GNMby[i]);
+				data->GNMgm[i] = be16_to_cpu(data->GNMgm[i]);
+				data->GNMrc[i] = be16_to_cpu(data->GNMrc[i]);
+			}
+		}
 	}
 
 	if (is_raw) {
@@ -838,7 +921,11 @@ hdr_done:
 		}
 
 		planelen = ctx->rows * ctx->cols * 2;
-		remain = (ctx->hdr1.matte ? 3 : 4) * (planelen + sizeof(struct mitsu9550_plane)) + sizeof(struct mitsu9550_cmd);
+		/* Three planes and the job footer, plus the matte plane
+		   and its footer */
+		remain = 3 * (planelen + sizeof(struct mitsu9550_plane)) + sizeof(struct mitsu9550_cmd);
+		if (ctx->hdr1.matte)
+			remain += planelen + sizeof(struct mitsu9550_plane) + sizeof(struct mitsu9550_cmd);
 		newbuf = malloc(remain);
 		if (!newbuf) {
 			ERROR("Memory allocation Failure!\n");
@@ -859,38 +946,19 @@ hdr_done:
 		}
 
 		DEBUG("Applying 8bpp->12bpp Gamma Correction\n");
-		/* For B/Y plane */
-		memcpy(newbuf + newlen, ctx->databuf, sizeof(struct mitsu9550_plane));
-		newbuf[newlen + 3] = 0x10;  /* ie 16bpp data */
-		newlen += sizeof(struct mitsu9550_plane);
-		mitsu98xx_dogamma(ctx->databuf + sizeof(struct mitsu9550_plane),
-				  (uint16_t*) (newbuf + newlen),
-				  0,
-				  table->GNMby,
-				  planelen / 2);
-		newlen += planelen;
-
-		/* For G/M plane */
-		memcpy(newbuf + newlen, ctx->databuf, sizeof(struct mitsu9550_plane));
-		newbuf[newlen + 3] = 0x10;  /* ie 16bpp data */
-		newlen += sizeof(struct mitsu9550_plane);
-		mitsu98xx_dogamma(ctx->databuf + sizeof(struct mitsu9550_plane),
-				  (uint16_t*) (newbuf + newlen),
-				  1,
-				  table->GNMgm,
-				  planelen / 2);
-		newlen += planelen;
-
-		/* For R/C plane */
-		memcpy(newbuf + newlen, ctx->databuf, sizeof(struct mitsu9550_plane));
-		newbuf[newlen + 3] = 0x10;  /* ie 16bpp data */
+		/* Plane headers for B/Y, G/M and R/C */
+		for (i = 0 ; i < 3 ; i++) {
+			uint8_t *hdr = newbuf + i * (sizeof(struct mitsu9550_plane) + planelen);
+			memcpy(hdr, ctx->databuf, sizeof(struct mitsu9550_plane));
+			hdr[3] = 0x10;  /* ie 16bpp data */
+		}
 		newlen += sizeof(struct mitsu9550_plane);
 		mitsu98xx_dogamma(ctx->databuf + sizeof(struct mitsu9550_plane),
 				  (uint16_t*) (newbuf + newlen),
-				  2,
-				  table->GNMrc,
-				  planelen / 2);
-		newlen += planelen;
+				  (uint16_t*) (newbuf + newlen + planelen + sizeof(struct mitsu9550_plane)),
+				  (uint16_t*) (newbuf + newlen + 2 * (planelen + sizeof(struct mitsu9550_plane))),
+				  table, planelen / 2);
+		newlen += 3 * planelen + 2 * sizeof(struct mitsu9550_plane);
 
 		/* And finally, the job footer. */
 		memcpy(newbuf + newlen, ctx->databuf + sizeof(struct mitsu9550_plane) + planelen * 3, sizeof(struct mitsu9550_cmd));
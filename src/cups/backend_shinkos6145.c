@@ -1972,92 +1972,102 @@ static void shinkos6145_teardown(void *vctx) {
 	free(ctx);
 }
 
-static void lib6145_calc_avg(struct shinkos6145_ctx *ctx, uint16_t rows, uint16_t cols)
+/* Convert one plane of 8-bit samples to 16-bit pulse values, padding
+   each row out to the full stripe, and return the sum of the samples */
+static uint64_t lib6145_convert_plane(const uint8_t *src, uint16_t *dest,
+				      const uint16_t *table,
+				      uint16_t rows, uint16_t cols,
+				      uint16_t pad_l, uint16_t pad_r)
 {
-	uint32_t plane, i, planelen;
-	planelen = rows * cols;
-
-	for (plane = 0 ; plane < 3 ; plane++) {
-		uint64_t sum = 0;
+	uint64_t sum = 0;
+	uint16_t row, col;
 
-		for (i = 0 ; i < planelen ; i++) {
-			sum += ctx->databuf[(planelen * plane) + i];
+	for (row = 0 ; row < rows ; row++) {
+		uint32_t rowsum = 0;
+
+		memset(dest, 0, pad_l * sizeof(uint16_t));
+		dest += pad_l;
+		for (col = 0 ; col + 4 <= cols ; col += 4) {
+			uint8_t s0 = src[0], s1 = src[1], s2 = src[2], s3 = src[3];
+			dest[0] = table[s0];
+			dest[1] = table[s1];
+			dest[2] = table[s2];
+			dest[3] = table[s3];
+			rowsum += s0 + s1 + s2 + s3;
+			src += 4;
+			dest += 4;
+		}
+		for ( ; col < cols ; col++) {
+			rowsum += *src;
+			*dest++ = table[*src++];
 		}
-		ctx->image_avg[plane] = (sum / planelen);
+		memset(dest, 0, pad_r * sizeof(uint16_t));
+		dest += pad_r;
+		sum += rowsum;
 	}
+
+	return sum;
 }
 
-static void lib6145_process_image(uint8_t *src, uint16_t *dest,
-				  struct shinkos6145_correctionparam *corrdata,
-				  uint8_t oc_mode)
+/* Convert planar YMC 8-bit data to the padded 16-bit stripes the printer
+   wants, computing the plane averages along the way */
+static void lib6145_process_image(const uint8_t *src, uint16_t *dest,
+				  const struct shinkos6145_correctionparam *corrdata,
+				  uint8_t oc_mode, uint8_t *image_avg)
 {
-	uint32_t in, out;
-
-	uint16_t pad_l, pad_r, row_lim;
-	uint16_t row, col;
+	uint16_t rows, cols, row_lim, pad_l, pad_r;
+	uint32_t planelen, stripelen;
+	int plane;
 
+	rows = le16_to_cpu(corrdata->height);
+	cols = le16_to_cpu(corrdata->width);
 	row_lim = le16_to_cpu(corrdata->headDots);
-	pad_l = (row_lim - le16_to_cpu(corrdata->width)) / 2;
-	pad_r = pad_l + le16_to_cpu(corrdata->width);
-	out = 0;
-	in = 0;
-
-	/* Convert YMC 8-bit to 16-bit, and pad appropriately to full stripe */
-	for (row = 0 ; row < le16_to_cpu(corrdata->height) ; row++) {
-		for (col = 0 ; col < row_lim; col++) {
-			uint16_t val;
-			if (col < pad_l) {
-				val = 0;
-			} else if (col < pad_r) {
-				val = corrdata->pulseTransTable_Y[src[in++]];
-			} else {
-				val = 0;
-			}
-			dest[out++] = val;
-		}
-	}
-	for (row = 0 ; row < le16_to_cpu(corrdata->height) ; row++) {
-		for (col = 0 ; col < row_lim; col++) {
-			uint16_t val;
-			if (col < pad_l) {
-				val = 0;
-			} else if (col < pad_r) {
-				val = corrdata->pulseTransTable_M[src[in++]];
-			} else {
-				val = 0;
-			}
-			dest[out++] = val;
-		}
-	}
-	for (row = 0 ; row < le16_to_cpu(corrdata->height) ; row++) {
-		for (col = 0 ; col < row_lim; col++) {
-			uint16_t val;
-			if (col < pad_l) {
-				val = 0;
-			} else if (col < pad_r) {
-				val = corrdata->pulseTransTable_C[src[in++]];
-			} else {
-				val = 0;
-			}
-			dest[out++] = val;
+	pad_l = (row_lim - cols) / 2;
+	pad_r = row_lim - cols - pad_l;
+	planelen = rows * cols;
+	stripelen = rows * row_lim;
+
+	/* Convert YMC 8-bit to 16-bit, and pad appropriately to full stripe.
+	   The tables are copied out of the packed structure so the compiler
+	   knows that storing to dest can't change them. */
+	for (plane = 0 ; plane < 3 ; plane++) {
+		uint16_t table[256];
+		uint64_t sum;
+
+		switch (plane) {
+		case 0:
+			memcpy(table, corrdata->pulseTransTable_Y, sizeof(table));
+			break;
+		case 1:
+			memcpy(table, corrdata->pulseTransTable_M, sizeof(table));
+			break;
+		default:
+			memcpy(table, corrdata->pulseTransTable_C, sizeof(table));
+			break;
 		}
+		sum = lib6145_convert_plane(src, dest, table,
+					    rows, cols, pad_l, pad_r);
+		image_avg[plane] = (sum / planelen);
+		src += planelen;
+		dest += stripelen;
 	}
 
-	/* Generate lamination plane, if desired */
+	/* Generate lamination plane, if desired; every row is the same */
 	if (oc_mode > PRINT_MODE_NO_OC) {
 		// XXX matters if we're using glossy/matte...
-		for (row = 0 ; row < le16_to_cpu(corrdata->height) ; row++) {
-			for (col = 0 ; col < row_lim; col++) {
-				uint16_t val;
-				if (col < pad_l) {
-					val = 0;
-				} else if (col < pad_r) {
-					val = corrdata->pulseTransTable_O[corrdata->printOpLevel];
-				} else {
-					val = 0;
-				}
-				dest[out++] = val;
-			}
+		uint16_t val = corrdata->pulseTransTable_O[corrdata->printOpLevel];
+		uint16_t *first = dest;
+		uint16_t row, col;
+
+		memset(dest, 0, pad_l * sizeof(uint16_t));
+		dest += pad_l;
+		for (col = 0 ; col < cols ; col++)
+			*dest++ = val;
+		memset(dest, 0, pad_r * sizeof(uint16_t));
+		dest += pad_r;
+		for (row = 1 ; row < rows ; row++) {
+			memcpy(dest, first, row_lim * sizeof(uint16_t));
+			dest += row_lim;
 		}
 	}
 }
@@ -2341,8 +2351,8 @@ top:
 			WARNING("Utilizing fallback internal image processing code\n");
 			WARNING(" *** Output quality will be poor! *** \n");
 
-			lib6145_calc_avg(ctx, le32_to_cpu(ctx->hdr.columns), le32_to_cpu(ctx->hdr.rows));
-			lib6145_process_image(ctx->databuf, databuf2, ctx->corrdata, oc_mode);
+			lib6145_process_image(ctx->databuf, databuf2, ctx->corrdata,
+					      oc_mode, ctx->image_avg);
 		}
 
 		free(ctx->databuf);
@@ -338,19 +338,21 @@ generate_model_ppds(const char *prefix, int verbose,
 		    const stp_printer_t *printer, const char *language,
 		    int which_ppds, int use_compression)
 {
+  int status = 0;
   if ((which_ppds & 1) &&
       generate_ppd(prefix, verbose, printer, language, PPD_SIMPLIFIED,
 		   use_compression))
-    return (1);
-  if ((which_ppds & 2) &&
-      generate_ppd(prefix, verbose, printer, language, PPD_STANDARD,
-		   use_compression))
-    return (1);
-  if ((which_ppds & 4) &&
-      generate_ppd(prefix, verbose, printer, language, PPD_NO_COLOR_OPTS,
-		   use_compression))
-    return (1);
-  return 0;
+    status = 1;
+  else if ((which_ppds & 2) &&
+	   generate_ppd(prefix, verbose, printer, language, PPD_STANDARD,
+			use_compression))
+    status = 1;
+  else if ((which_ppds & 4) &&
+	   generate_ppd(prefix, verbose, printer, language, PPD_NO_COLOR_OPTS,
+			use_compression))
+    status = 1;
+  free_description_cache();
+  return status;
 }
 
 /*
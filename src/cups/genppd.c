@@ -20,6 +20,8 @@
  *
  *   main()              - Process files on the command-line...
  *   cat_ppd()           - Copy the named PPD to stdout.
+ *   describe_parameter() - Describe a parameter, using cached descriptions.
+ *   free_description_cache() - Free all cached parameter descriptions.
  *   generate_ppd()      - Generate a PPD file.
  *   getlangs()          - Get a list of available translations.
  *   help()              - Show detailed help.
@@ -131,6 +133,8 @@ const char *parameter_level_names[] =
  * Local functions...
  */
 
+static void	describe_parameter(const stp_vars_t *v, const char *name,
+				   stp_parameter_t *desc);
 static int	gpputs(gpFile f, const char *s);
 static int	gpprintf(gpFile f, const char *format, ...)
        __attribute__((format(__printf__, 2, 3)));
@@ -138,11 +142,11 @@ static int	is_special_option(const char *name);
 static void	print_group_close(gpFile fp, stp_parameter_class_t p_class,
 				  stp_parameter_level_t p_level,
 				  const char *language,
-				  const stp_string_list_t *po);
+				  const stp_i18n_catalog_t *po);
 static void	print_group_open(gpFile fp, stp_parameter_class_t p_class,
 				 stp_parameter_level_t p_level,
 				 const char *language,
-				 const stp_string_list_t *po);
+				 const stp_i18n_catalog_t *po);
 
 
 /*
@@ -248,6 +252,128 @@ is_special_option(const char *name)	/* I - Option name */
   return 0;
 }
 
+/*
+ * write_ppd() asks for the same parameter descriptions over and over:
+ * once more for every language of a globalized PPD, and again for each
+ * PPD type of the same printer.  Descriptions depend only on the
+ * printer and the settings in the vars, so they are cached in a hash
+ * table keyed on the settings and the parameter name.  Each distinct
+ * set of settings is copied once and hashed by its vars fingerprint;
+ * since different settings may share a fingerprint, they are always
+ * compared in full.  The cache owns the descriptions; callers must not
+ * destroy them.  free_description_cache() must be called when each
+ * printer is done.
+ */
+
+#define DESCRIPTION_CACHE_BUCKETS (1024)
+
+typedef struct cached_settings
+{
+  struct cached_settings *next;		/* Next in hash bucket */
+  unsigned long	fingerprint;		/* stp_vars_get_fingerprint() */
+  stp_vars_t	*settings;		/* Copy of the settings */
+} cached_settings_t;
+
+typedef struct cached_description
+{
+  struct cached_description *next;	/* Next in hash bucket */
+  const cached_settings_t *settings;	/* Settings described */
+  char		*name;			/* Parameter name */
+  stp_parameter_t desc;			/* Description */
+} cached_description_t;
+
+static cached_settings_t *settings_cache[DESCRIPTION_CACHE_BUCKETS];
+static cached_description_t *description_cache[DESCRIPTION_CACHE_BUCKETS];
+
+static unsigned long
+description_hash(unsigned long fingerprint, const char *name)
+{
+  unsigned long hash = fingerprint;
+  while (*name)
+    hash = (hash * 31) + (unsigned char) *name++;
+  return hash % DESCRIPTION_CACHE_BUCKETS;
+}
+
+/*
+ * 'free_description_cache()' - Free all cached parameter descriptions.
+ */
+
+void
+free_description_cache(void)
+{
+  int i;
+  for (i = 0; i < DESCRIPTION_CACHE_BUCKETS; i++)
+    {
+      cached_description_t *desc = description_cache[i];
+      cached_settings_t *settings = settings_cache[i];
+      while (desc)
+	{
+	  cached_description_t *next = desc->next;
+	  stp_free(desc->name);
+	  stp_parameter_description_destroy(&(desc->desc));
+	  stp_free(desc);
+	  desc = next;
+	}
+      while (settings)
+	{
+	  cached_settings_t *next = settings->next;
+	  stp_vars_destroy(settings->settings);
+	  stp_free(settings);
+	  settings = next;
+	}
+      description_cache[i] = NULL;
+      settings_cache[i] = NULL;
+    }
+}
+
+/*
+ * 'describe_parameter()' - Describe a parameter, using cached descriptions.
+ */
+
+static void
+describe_parameter(const stp_vars_t *v, const char *name,
+		   stp_parameter_t *desc)
+{
+  unsigned long fingerprint = stp_vars_get_fingerprint(v);
+  cached_settings_t **sbucket =
+    &(settings_cache[fingerprint % DESCRIPTION_CACHE_BUCKETS]);
+  cached_description_t **dbucket =
+    &(description_cache[description_hash(fingerprint, name)]);
+  cached_settings_t *settings;
+  cached_description_t *entry;
+
+  for (settings = *sbucket; settings; settings = settings->next)
+    if (settings->fingerprint == fingerprint &&
+	stp_vars_settings_equal(settings->settings, v))
+      break;
+
+  if (settings)
+    {
+      for (entry = *dbucket; entry; entry = entry->next)
+	if (entry->settings == settings && strcmp(entry->name, name) == 0)
+	  {
+	    *desc = entry->desc;
+	    return;
+	  }
+    }
+  else
+    {
+      settings = stp_malloc(sizeof(cached_settings_t));
+      settings->fingerprint = fingerprint;
+      settings->settings = stp_vars_create_copy(v);
+      settings->next = *sbucket;
+      *sbucket = settings;
+    }
+
+  entry = stp_malloc(sizeof(cached_description_t));
+  entry->settings = settings;
+  entry->name = stp_strdup(name);
+  stp_describe_parameter(v, name, &(entry->desc));
+  entry->next = *dbucket;
+  *dbucket = entry;
+  *desc = entry->desc;
+}
+
 /*
  * strlen returns the number of characters.  PPD file limitations are
  * defined in bytes.  So we need something to count bytes, not merely
@@ -281,7 +407,7 @@ print_ppd_header(gpFile fp, ppd_type_t ppd_type, int model, const char *driver,
 		 const char *family, const char *long_name,
 		 const char *manufacturer, const char *device_id,
 		 const char *ppd_location,
-		 const char *language, const stp_string_list_t *po,
+		 const char *language, const stp_i18n_catalog_t *po,
 		 char **all_langs)
 {
   char short_long_name[(PPD_MAX_SHORT_NICKNAME) + 1];
@@ -372,7 +498,7 @@ print_ppd_header_3(gpFile fp, ppd_type_t ppd_type, int model,
 		   const char *family, const char *long_name,
 		   const char *manufacturer, const char *device_id,
 		   const char *ppd_location,
-		   const char *language, const stp_string_list_t *po,
+		   const char *language, const stp_i18n_catalog_t *po,
 		   char **all_langs)
 {
   int i;
@@ -414,7 +540,7 @@ print_ppd_header_2(gpFile fp, ppd_type_t ppd_type, int model, const char *driver
 		   const char *family, const char *long_name,
 		   const char *manufacturer, const char *device_id,
 		   const char *ppd_location,
-		   const char *language, const stp_string_list_t *po,
+		   const char *language, const stp_i18n_catalog_t *po,
 		   char **all_langs)
 {
   gpprintf(fp, "*StpDriverName:	\"%s\"\n", driver);
@@ -425,7 +551,7 @@ print_ppd_header_2(gpFile fp, ppd_type_t ppd_type, int model, const char *driver
 
 static void
 print_page_sizes(gpFile fp, stp_vars_t *v, int simplified,
-		 const stp_string_list_t *po)
+		 const stp_i18n_catalog_t *po)
 {
   int variable_sizes = 0;
   stp_parameter_t desc;
@@ -442,7 +568,7 @@ print_page_sizes(gpFile fp, stp_vars_t *v, int simplified,
   const stp_param_string_t *opt;
   int cur_opt = 0;
 
-  stp_describe_parameter(v, "PageSize", &desc);
+  describe_parameter(v, "PageSize", &desc);
   num_opts = stp_string_list_count(desc.bounds.str);
   the_papers = stp_malloc(sizeof(paper_t) * num_opts);
   for (i = 0; i < num_opts; i++)
@@ -594,14 +720,13 @@ print_page_sizes(gpFile fp, stp_vars_t *v, int simplified,
       stp_clear_string_parameter(v, "PageSize");
     }
 
-  stp_parameter_description_destroy(&desc);
   if (the_papers)
     stp_free(the_papers);
 }
 
 static void
 print_color_setup(gpFile fp, int simplified, int printer_is_color,
-		  const stp_string_list_t *po)
+		  const stp_i18n_catalog_t *po)
 {
   gpputs(fp, "*ColorKeyWords: \"ColorModel\"\n");
   gpprintf(fp, "*OpenUI *ColorModel/%s: PickOne\n", _("Color Model"));
@@ -694,7 +819,7 @@ print_group(
     stp_parameter_class_t p_class,	/* I - Option class */
     stp_parameter_level_t p_level,	/* I - Option level */
     const char		  *language,	/* I - Language */
-    const stp_string_list_t     *po)		/* I - Message catalog */
+    const stp_i18n_catalog_t     *po)		/* I - Message catalog */
 {
   char buf[64];
   const char *class = stp_i18n_lookup(po, parameter_class_names[p_class]);
@@ -710,7 +835,7 @@ print_group(
 
       for (langnum = 0; all_langs[langnum]; langnum ++)
 	{
-	  const stp_string_list_t *altpo;
+	  const stp_i18n_catalog_t *altpo;
 
 	  lang = all_langs[langnum];
 
@@ -740,7 +865,7 @@ print_group_close(
     stp_parameter_class_t p_class,	/* I - Option class */
     stp_parameter_level_t p_level,	/* I - Option level */
     const char		 *language,	/* I - language */
-    const stp_string_list_t    *po)		/* I - Message catalog */
+    const stp_i18n_catalog_t    *po)		/* I - Message catalog */
 {
   print_group(fp, "Close", p_class, p_level, NULL, NULL);
 }
@@ -756,13 +881,13 @@ print_group_open(
     stp_parameter_class_t p_class,	/* I - Option class */
     stp_parameter_level_t p_level,	/* I - Option level */
     const char		 *language,	/* I - language */
-    const stp_string_list_t    *po)		/* I - Message catalog */
+    const stp_i18n_catalog_t    *po)		/* I - Message catalog */
 {
   print_group(fp, "Open", p_class, p_level, language ? language : "C", po);
 }
 
 static void
-print_one_option(gpFile fp, stp_vars_t *v, const stp_string_list_t *po,
+print_one_option(gpFile fp, stp_vars_t *v, const stp_i18n_catalog_t *po,
 		 ppd_type_t ppd_type, const stp_parameter_t *lparam,
 		 const stp_parameter_t *desc)
 {
@@ -1015,7 +1140,7 @@ print_one_option(gpFile fp, stp_vars_t *v, const stp_string_list_t *po,
 }
 
 static void
-print_one_localization(gpFile fp, const stp_string_list_t *po,
+print_one_localization(gpFile fp, const stp_i18n_catalog_t *po,
 		       int simplified, const char *lang,
 		       const stp_parameter_t *lparam,
 		       const stp_parameter_t *desc)
@@ -1199,7 +1324,7 @@ write_ppd(
   char		*default_resolution = NULL;  /* Default resolution mapped name */
   stp_string_list_t *resolutions = stp_string_list_create();
   char		**all_langs = getlangs();/* All languages */
-  const stp_string_list_t	*po = stp_i18n_load(language);
+  const stp_i18n_catalog_t	*po = stp_i18n_load(language);
 					/* Message catalog */
 
   /*
@@ -1230,7 +1355,7 @@ write_ppd(
   stp_set_string_parameter(v, "JobMode", "Job");
 
   /* Assume that color printers are inkjets and should have pages reversed */
-  stp_describe_parameter(v, "PrintingMode", &desc);
+  describe_parameter(v, "PrintingMode", &desc);
   if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
     {
       if (stp_string_list_is_present(desc.bounds.str, "Color"))
@@ -1248,12 +1373,10 @@ write_ppd(
       else
 	gpputs(fp, "*DefaultColorSpace:	Gray\n");
     }
-  stp_parameter_description_destroy(&desc);
 
-  stp_describe_parameter(v, "NativeCopies", &desc);
+  describe_parameter(v, "NativeCopies", &desc);
   if (desc.p_type == STP_PARAMETER_TYPE_BOOLEAN)
     nativecopies = desc.deflt.boolean;
-  stp_parameter_description_destroy(&desc);
 
   if (nativecopies)
     gpputs(fp, "*cupsManualCopies: False\n");
@@ -1303,7 +1426,7 @@ write_ppd(
   * Media types...
   */
 
-  stp_describe_parameter(v, "MediaType", &desc);
+  describe_parameter(v, "MediaType", &desc);
 
   if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active &&
       stp_string_list_count(desc.bounds.str) > 0)
@@ -1333,13 +1456,12 @@ write_ppd(
 
     gpputs(fp, "*CloseUI: *MediaType\n\n");
   }
-  stp_parameter_description_destroy(&desc);
 
  /*
   * Input slots...
   */
 
-  stp_describe_parameter(v, "InputSlot", &desc);
+  describe_parameter(v, "InputSlot", &desc);
 
   if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active &&
       stp_string_list_count(desc.bounds.str) > 0)
@@ -1369,13 +1491,12 @@ write_ppd(
 
     gpputs(fp, "*CloseUI: *InputSlot\n\n");
   }
-  stp_parameter_description_destroy(&desc);
 
  /*
   * Quality settings
   */
 
-  stp_describe_parameter(v, "Quality", &desc);
+  describe_parameter(v, "Quality", &desc);
   if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active)
     {
       int is_color_opt =
@@ -1406,11 +1527,10 @@ write_ppd(
 	    {
 	      stp_parameter_t res_desc;
 	      stp_clear_string_parameter(v, "Quality");
-	      stp_describe_parameter(v, "Resolution", &res_desc);
+	      describe_parameter(v, "Resolution", &res_desc);
 	      stp_set_string_parameter(v, "Resolution", res_desc.deflt.str);
 	      stp_describe_resolution(v, &xdpi, &ydpi);
 	      stp_clear_string_parameter(v, "Resolution");
-	      stp_parameter_description_destroy(&res_desc);
 	    }
 	  gpprintf(fp, "*%sStpQuality %s/%s:\t\"<</HWResolution[%d %d]/cupsRowFeed %d>>setpagedevice\"\n",
 		   nocolor && strcmp(opt->name, desc.deflt.str) != 0 ? "?" : "",
@@ -1418,14 +1538,13 @@ write_ppd(
 	}
       gpputs(fp, "*CloseUI: *StpQuality\n\n");
     }
-  stp_parameter_description_destroy(&desc);
   stp_clear_string_parameter(v, "Quality");
 
  /*
   * Resolutions...
   */
 
-  stp_describe_parameter(v, "Resolution", &desc);
+  describe_parameter(v, "Resolution", &desc);
 
   if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active)
     {
@@ -1455,9 +1574,8 @@ write_ppd(
 	    {
 	      stp_parameter_t desc1;
 	      stp_clear_string_parameter(v, "Resolution");
-	      stp_describe_parameter(v, "Quality", &desc1);
+	      describe_parameter(v, "Quality", &desc1);
 	      stp_set_string_parameter(v, "Quality", desc1.deflt.str);
-	      stp_parameter_description_destroy(&desc1);
 	      stp_describe_resolution(v, &xdpi, &ydpi);
 	      stp_clear_string_parameter(v, "Quality");
 	      tmp_xdpi = xdpi;
@@ -1561,9 +1679,8 @@ write_ppd(
 	}
     }
 
-  stp_parameter_description_destroy(&desc);
 
-  stp_describe_parameter(v, "OutputOrder", &desc);
+  describe_parameter(v, "OutputOrder", &desc);
   if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
     {
       gpprintf(fp, "*OpenUI *OutputOrder/%s: PickOne\n", _("Output Order"));
@@ -1575,7 +1692,6 @@ write_ppd(
       gpprintf(fp, "*OutputOrder Reverse/%s: \"\"\n", _("Reverse"));
       gpputs(fp, "*CloseUI: *OutputOrder\n\n");
     }
-  stp_parameter_description_destroy(&desc);
 
  /*
   * Duplex
@@ -1583,7 +1699,7 @@ write_ppd(
   * else the PPD files will not be generated correctly
   */
 
-  stp_describe_parameter(v, "Duplex", &desc);
+  describe_parameter(v, "Duplex", &desc);
   if (desc.is_active && desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
     {
       num_opts = stp_string_list_count(desc.bounds.str);
@@ -1615,7 +1731,6 @@ write_ppd(
         gpputs(fp, "*CloseUI: *Duplex\n\n");
       }
     }
-  stp_parameter_description_destroy(&desc);
 
   gpprintf(fp, "*OpenUI *StpiShrinkOutput/%s: PickOne\n",
 	   _("Shrink Page If Necessary to Fit Borders"));
@@ -1649,7 +1764,7 @@ write_ppd(
 		   lparam->p_type != STP_PARAMETER_TYPE_INT &&
 		   lparam->p_type != STP_PARAMETER_TYPE_DOUBLE))
 		  continue;
-	      stp_describe_parameter(v, lparam->name, &desc);
+	      describe_parameter(v, lparam->name, &desc);
 	      if (desc.is_active)
 		{
 		  if (!printed_open_group)
@@ -1659,14 +1774,13 @@ write_ppd(
 		    }
 		  print_one_option(fp, v, po, ppd_type, lparam, &desc);
 		}
-	      stp_parameter_description_destroy(&desc);
 	    }
 	  if (printed_open_group)
 	    print_group_close(fp, j, k, language, po);
 	}
     }
   stp_parameter_list_destroy(param_list);
-  stp_describe_parameter(v, "ImageType", &desc);
+  describe_parameter(v, "ImageType", &desc);
   if (desc.is_active && desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
     {
       num_opts = stp_string_list_count(desc.bounds.str);
@@ -1682,7 +1796,6 @@ write_ppd(
 	  gpputs(fp, "\n");
 	}
     }
-  stp_parameter_description_destroy(&desc);
 
   if (!language)
     {
@@ -1691,7 +1804,7 @@ write_ppd(
        */
 
       const char *lang;
-      const stp_string_list_t *savepo = po;
+      const stp_i18n_catalog_t *savepo = po;
       int langnum;
 
       for (langnum = 0; all_langs[langnum]; langnum ++)
@@ -1713,7 +1826,7 @@ write_ppd(
 	  else
 	    stp_set_string_parameter(v, "PrintingMode", "BW");
 	  stp_set_string_parameter(v, "ChannelBitDepth", "8");
-	  stp_describe_parameter(v, "PageSize", &desc);
+	  describe_parameter(v, "PageSize", &desc);
 	  num_opts = stp_string_list_count(desc.bounds.str);
 
 	  gpprintf(fp, "*%s.Translation PageSize/%s: \"\"\n", lang, _("Media Size"));
@@ -1745,7 +1858,6 @@ write_ppd(
 	      gpprintf(fp, "*%s.PageRegion %s/%s: \"\"\n", lang, opt->name, stp_i18n_lookup(po, opt->text));
 	    }
 
-	  stp_parameter_description_destroy(&desc);
 
 	  /*
 	   * Do we support color?
@@ -1777,7 +1889,7 @@ write_ppd(
 	   * Media types...
 	   */
 
-	  stp_describe_parameter(v, "MediaType", &desc);
+	  describe_parameter(v, "MediaType", &desc);
 	  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active &&
 	      stp_string_list_count(desc.bounds.str) > 0)
 	    {
@@ -1790,13 +1902,12 @@ write_ppd(
 		  gpprintf(fp, "*%s.MediaType %s/%s: \"\"\n", lang, opt->name, stp_i18n_lookup(po, opt->text));
 		}
 	    }
-	  stp_parameter_description_destroy(&desc);
 
 	  /*
 	   * Input slots...
 	   */
 
-	  stp_describe_parameter(v, "InputSlot", &desc);
+	  describe_parameter(v, "InputSlot", &desc);
 
 	  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active &&
 	      stp_string_list_count(desc.bounds.str) > 0)
@@ -1810,13 +1921,12 @@ write_ppd(
 		  gpprintf(fp, "*%s.InputSlot %s/%s: \"\"\n", lang, opt->name, stp_i18n_lookup(po, opt->text));
 		}
 	    }
-	  stp_parameter_description_destroy(&desc);
 
 	  /*
 	   * Quality settings
 	   */
 
-	  stp_describe_parameter(v, "Quality", &desc);
+	  describe_parameter(v, "Quality", &desc);
 	  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.is_active)
 	    {
 	      gpprintf(fp, "*%s.Translation StpQuality/%s: \"\"\n", lang, stp_i18n_lookup(po, desc.text));
@@ -1827,13 +1937,12 @@ write_ppd(
 		  gpprintf(fp, "*%s.StpQuality %s/%s: \"\"\n", lang, opt->name, stp_i18n_lookup(po, opt->text));
 		}
 	    }
-	  stp_parameter_description_destroy(&desc);
 
 	  /*
 	   * Resolution
 	   */
 
-	  stp_describe_parameter(v, "Resolution", &desc);
+	  describe_parameter(v, "Resolution", &desc);
 
 	  if (!simplified || desc.p_level == STP_PARAMETER_LEVEL_BASIC)
 	    {
@@ -1851,20 +1960,18 @@ write_ppd(
 		}
 	    }
 
-	  stp_parameter_description_destroy(&desc);
 
 	  /*
 	   * OutputOrder
 	   */
 
-	  stp_describe_parameter(v, "OutputOrder", &desc);
+	  describe_parameter(v, "OutputOrder", &desc);
 	  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
 	    {
 	      gpprintf(fp, "*%s.Translation OutputOrder/%s: \"\"\n", lang, _("Output Order"));
 	      gpprintf(fp, "*%s.OutputOrder Normal/%s: \"\"\n", lang, _("Normal"));
 	      gpprintf(fp, "*%s.OutputOrder Reverse/%s: \"\"\n", lang, _("Reverse"));
 	    }
-	  stp_parameter_description_destroy(&desc);
 
 	  /*
 	   * Duplex
@@ -1872,7 +1979,7 @@ write_ppd(
 	   * else the PPD files will not be generated correctly
 	   */
 
-	  stp_describe_parameter(v, "Duplex", &desc);
+	  describe_parameter(v, "Duplex", &desc);
 	  if (desc.is_active && desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
 	    {
 	      num_opts = stp_string_list_count(desc.bounds.str);
@@ -1892,7 +1999,6 @@ write_ppd(
 		    }
 		}
 	    }
-	  stp_parameter_description_destroy(&desc);
 
 	  gpprintf(fp, "*%s.Translation StpiShrinkOutput/%s: \"\"\n", lang,
 		   _("Shrink Page If Necessary to Fit Borders"));
@@ -1919,16 +2025,15 @@ write_ppd(
 			   lparam->p_type != STP_PARAMETER_TYPE_INT &&
 			   lparam->p_type != STP_PARAMETER_TYPE_DOUBLE))
 			continue;
-		      stp_describe_parameter(v, lparam->name, &desc);
+		      describe_parameter(v, lparam->name, &desc);
 		      if (desc.is_active)
 			print_one_localization(fp, po, simplified, lang,
 					       lparam, &desc);
-		      stp_parameter_description_destroy(&desc);
 		    }
 		}
 	    }
 	  stp_parameter_list_destroy(param_list);
-	  stp_describe_parameter(v, "ImageType", &desc);
+	  describe_parameter(v, "ImageType", &desc);
 	  if (desc.is_active && desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
 	    {
 	      num_opts = stp_string_list_count(desc.bounds.str);
@@ -1943,7 +2048,6 @@ write_ppd(
 		    }
 		}
 	    }
-	  stp_parameter_description_destroy(&desc);
 	}
       po = savepo;
     }
@@ -85,6 +85,7 @@ extern int cups_ppd_ps_level;
 extern int localize_numbers;
 extern int use_base_version;
 
+extern void	free_description_cache(void);
 extern int	write_ppd(gpFile fp, const stp_printer_t *p,
 		          const char *language, const char *ppd_location,
 			  ppd_type_t ppd_type, const char *filename,
@@ -126,6 +126,7 @@ cat_ppd(const char *uri)	/* I - Driver URI */
   const char 		*infix = "";
   ppd_type_t 		ppd_type = PPD_STANDARD;
   gpfile		outFD;
+  int			ret;		/* Status from write_ppd() */
 
   if ((status = httpSeparateURI(HTTP_URI_CODING_ALL, uri,
                                 scheme, sizeof(scheme),
@@ -183,7 +184,9 @@ cat_ppd(const char *uri)	/* I - Driver URI */
 	   filename, gpext);
 
   outFD.f = stdout;
-  return (write_ppd(&outFD, p, lang, ppd_location, ppd_type, filename, 0));
+  ret = write_ppd(&outFD, p, lang, ppd_location, ppd_type, filename, 0);
+  free_description_cache();
+  return (ret);
 }
 
 /*
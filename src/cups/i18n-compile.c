@@ -0,0 +1,55 @@
+/*
+ *   Compile a gettext .po file into a Gutenprint message catalog.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Contents:
+ *
+ *   main() - Main entry for compiler.
+ */
+
+/*
+ * Include necessary files...
+ */
+
+#include "i18n.h"
+#include <config.h>
+#include <stdio.h>
+
+
+/*
+ * 'main()' - Main entry for compiler.
+ *
+ * Usage: i18n-compile file.po file.cat
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line arguments */
+     char *argv[])			/* I - Command-line arguments */
+{
+  if (argc != 3)
+  {
+    fputs("Usage: i18n-compile file.po file.cat\n", stderr);
+    return (1);
+  }
+
+  if (stp_i18n_compile(argv[1], argv[2]))
+  {
+    fprintf(stderr, "i18n-compile: Unable to compile %s into %s\n",
+            argv[1], argv[2]);
+    return (1);
+  }
+
+  return (0);
+}
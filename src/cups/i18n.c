@@ -18,10 +18,16 @@
  *
  * Contents:
  *
- *   stp_i18n_load()   - Load a message catalog for a locale.
- *   stp_i18n_lookup() - Lookup a string in the message catalog...
- *   stp_i18n_printf() - Send a formatted string to stderr.
- *   stpi_unquote()    - Unquote characters in strings.
+ *   stp_i18n_load()       - Load a message catalog for a locale.
+ *   stp_i18n_lookup()     - Lookup a string in the message catalog...
+ *   stp_i18n_printf()     - Send a formatted string to stderr.
+ *   stp_i18n_compile()    - Compile a .po file into a message catalog.
+ *   stpi_add_message()    - Add a message to a list of messages.
+ *   stpi_build_catalog()  - Build a catalog image from a list of messages.
+ *   stpi_hash()           - Hash a message ID.
+ *   stpi_load_catalog()   - Load a compiled message catalog.
+ *   stpi_read_po()        - Read the messages in a .po file.
+ *   stpi_unquote()        - Unquote characters in strings.
  */
 
 /*
@@ -39,6 +45,13 @@
 #include <errno.h>
 #include <iconv.h>
 #include <strings.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 
 /*
@@ -55,22 +68,80 @@
  */
 
 
+/*
+ * Compiled catalogs (gutenprint_ll.cat, made from the .po file at build
+ * time by i18n-compile) hold the translations, already converted to
+ * UTF-8, in a hash table that is used in place:
+ *
+ *   stpi_i18n_header_t
+ *   stpi_i18n_entry_t[hash_size]	Open addressed, linear probing
+ *   strings				NUL terminated, found by offset
+ *
+ * Numbers are in host byte order; a catalog from a host with the other
+ * byte order is ignored in favor of the .po file.  Messages read from a
+ * .po file are built into the same form in memory.
+ */
+
+#define STPI_I18N_MAGIC		"STPI18N1"
+#define STPI_I18N_BYTE_ORDER	0x01020304
+
+typedef struct
+{
+  char			magic[8];	/* STPI_I18N_MAGIC */
+  uint32_t		byte_order;	/* STPI_I18N_BYTE_ORDER */
+  uint32_t		count;		/* Number of messages */
+  uint32_t		hash_size;	/* Number of hash slots, power of 2 */
+  uint32_t		size;		/* Size of the whole catalog */
+} stpi_i18n_header_t;
+
+typedef struct
+{
+  uint32_t		hash;		/* Hash of the message ID */
+  uint32_t		id;		/* Offset of ID, 0 if slot is empty */
+  uint32_t		str;		/* Offset of translation */
+} stpi_i18n_entry_t;
+
+
 /*
  * Cache structure...
  */
 
-typedef struct stpi_i18n_s
+struct stpi_i18n_s
 {
   struct stpi_i18n_s	*next;		/* Next catalog */
   char			locale[6];	/* Locale */
-  stp_string_list_t	*po;		/* Message catalog */
-} stpi_i18n_t;
+  char			*data;		/* Catalog image */
+  size_t		size;		/* Size of image */
+  int			mapped;		/* Image is mmap()ed? */
+  const stpi_i18n_entry_t *table;	/* Hash table */
+  uint32_t		mask;		/* hash_size - 1 */
+};
+
+
+/*
+ * Messages read from a .po file...
+ */
+
+typedef struct
+{
+  int			count,		/* Number of messages */
+			alloc;		/* Allocated messages */
+  char			**ids,		/* Message IDs */
+			**strs;		/* Translations */
+} stpi_i18n_messages_t;
 
 
 /*
  * Local functions...
  */
 
+static void	stpi_add_message(stpi_i18n_messages_t *msgs, const char *id,
+		                 const char *str);
+static char	*stpi_build_catalog(const stpi_i18n_messages_t *msgs,
+		                    size_t *size);
+static uint32_t	stpi_hash(const char *s);
+static stp_i18n_catalog_t *stpi_load_catalog(const char *catname);
+static int	stpi_read_po(const char *poname, stpi_i18n_messages_t *msgs);
 static void	stpi_unquote(char *s);
 
 
@@ -78,36 +149,28 @@ static void	stpi_unquote(char *s);
  * Local globals...
  */
 
-static stpi_i18n_t	*stpi_pocache = NULL;
+static stp_i18n_catalog_t *stpi_pocache = NULL;
 
 
 /*
  * 'stp_i18n_load()' - Load a message catalog for a locale.
  */
 
-const stp_string_list_t *		/* O - Message catalog */
+const stp_i18n_catalog_t *		/* O - Message catalog */
 stp_i18n_load(const char *locale)	/* I - Locale name */
 {
-  stp_string_list_t	*po;		/* Message catalog */
+  stp_i18n_catalog_t	*pocache;	/* Current cache entry */
+  stpi_i18n_messages_t	msgs;		/* Messages from .po file */
   char			ll_CC[6],	/* Locale ID */
-			poname[1024];	/* .po filename */
-  stpi_i18n_t		*pocache;	/* Current cache entry */
-  FILE			*pofile;	/* .po file */
+			poname[1024],	/* .po filename */
+			catname[1024],	/* Compiled catalog filename */
+			*ptr;		/* Pointer into locale ID */
   const char		*stp_localedir;	/* STP_LOCALEDIR environment variable */
-  char			line[4096],	/* Line buffer */
-			*ptr,		/* Pointer into buffer */
-			id[4096],	/* Translation ID */
-			str[4096],	/* Translation string */
-			utf8str[4096];	/* UTF-8 translation string */
-  int			in_id,		/* Processing "id" string? */
-			in_str,		/* Processing "str" string? */
-			linenum;	/* Line number in .po file */
-  iconv_t		ic;		/* Transcoder to UTF-8 */
-  size_t		inbytes,	/* Number of input buffer bytes */
-			outbytes;	/* Number of output buffer bytes */
-  char			*inptr,		/* Pointer into input buffer */
-			*outptr;	/* Pointer into output buffer */
-  int			fuzzy = 0;	/* Fuzzy translation? */
+  struct stat		postat,		/* .po file information */
+			catstat;	/* Compiled catalog information */
+  int			have_po,	/* Have .po file? */
+			have_cat;	/* Have compiled catalog? */
+  int			i;		/* Looping var */
 
 
   if (!locale)
@@ -119,7 +182,7 @@ stp_i18n_load(const char *locale)	/* I - Locale name */
 
   for (pocache = stpi_pocache; pocache; pocache = pocache->next)
     if (!strcmp(locale, pocache->locale))
-      return (pocache->po);
+      return (pocache);
 
  /*
   * Find the message catalog for the given locale...
@@ -134,29 +197,441 @@ stp_i18n_load(const char *locale)	/* I - Locale name */
   if ((ptr = strchr(ll_CC, '.')) != NULL)
     *ptr = '\0';
 
-  snprintf(poname, sizeof(poname), "%s/%s/gutenprint_%s.po", stp_localedir,
-	   ll_CC, ll_CC);
-  if (access(poname, 0) && strlen(ll_CC) > 2)
+  for (;;)
   {
+    snprintf(poname, sizeof(poname), "%s/%s/gutenprint_%s.po", stp_localedir,
+	     ll_CC, ll_CC);
+    snprintf(catname, sizeof(catname), "%s/%s/gutenprint_%s.cat",
+	     stp_localedir, ll_CC, ll_CC);
+    have_po  = !stat(poname, &postat);
+    have_cat = !stat(catname, &catstat);
+
+    if (have_po || have_cat || strlen(ll_CC) <= 2)
+      break;
+
     ll_CC[2] = '\0';
+  }
 
-    snprintf(poname, sizeof(poname), "%s/%s/gutenprint_%s.po", stp_localedir,
-             ll_CC, ll_CC);
+ /*
+  * Use the compiled catalog unless the .po file is newer...
+  */
+
+  pocache = NULL;
+
+  if (have_cat && (!have_po || catstat.st_mtime >= postat.st_mtime))
+    pocache = stpi_load_catalog(catname);
+
+  if (!pocache && have_po)
+  {
+    memset(&msgs, 0, sizeof(msgs));
+
+    if (!stpi_read_po(poname, &msgs) &&
+	(pocache = calloc(1, sizeof(stp_i18n_catalog_t))) != NULL)
+    {
+      if ((pocache->data = stpi_build_catalog(&msgs, &pocache->size)) != NULL)
+      {
+	pocache->table =
+	  (const stpi_i18n_entry_t *)(pocache->data + sizeof(stpi_i18n_header_t));
+	pocache->mask =
+	  ((const stpi_i18n_header_t *)pocache->data)->hash_size - 1;
+      }
+      else
+      {
+        free(pocache);
+	pocache = NULL;
+      }
+    }
+
+    for (i = 0; i < msgs.count; i ++)
+    {
+      free(msgs.ids[i]);
+      free(msgs.strs[i]);
+    }
+    free(msgs.ids);
+    free(msgs.strs);
   }
 
-  if ((pofile = fopen(poname, "rb")) == NULL)
+  if (!pocache)
     return (NULL);
 
  /*
-  * Read the messages and add them to a string list...
+  * Add this to the cache...
   */
 
-  if ((po = stp_string_list_create()) == NULL)
+  strncpy(pocache->locale, locale, sizeof(pocache->locale) - 1);
+  pocache->next = stpi_pocache;
+  stpi_pocache  = pocache;
+
+  return (pocache);
+}
+
+
+/*
+ * 'stp_i18n_lookup()' - Lookup a string in the message catalog...
+ */
+
+const char *				/* O - Localized message */
+stp_i18n_lookup(
+    const stp_i18n_catalog_t *po,	/* I - Message catalog */
+    const char        *message)		/* I - Message */
+{
+  uint32_t		hash,		/* Hash of message */
+			slot;		/* Current hash slot */
+  const stpi_i18n_entry_t *entry;	/* Current entry */
+
+
+  if (!po || !message)
+    return (message);
+
+  hash = stpi_hash(message);
+
+  for (slot = hash & po->mask; (entry = po->table + slot)->id;
+       slot = (slot + 1) & po->mask)
+    if (entry->hash == hash && !strcmp(po->data + entry->id, message))
+      return (po->data + entry->str);
+
+  return (message);
+}
+
+
+/*
+ * 'stp_i18n_printf()' - Send a formatted string to stderr.
+ */
+
+void
+stp_i18n_printf(
+    const stp_i18n_catalog_t *po,	/* I - Message catalog */
+    const char        *message,		/* I - Printf-style message */
+    ...)				/* I - Additional arguments as needed */
+{
+  va_list	ap;			/* Argument pointer */
+
+
+  va_start(ap, message);
+  vfprintf(stderr, stp_i18n_lookup(po, message), ap);
+  va_end(ap);
+}
+
+
+/*
+ * 'stp_i18n_compile()' - Compile a .po file into a message catalog.
+ */
+
+int					/* O - 0 on success, -1 on error */
+stp_i18n_compile(const char *poname,	/* I - .po file */
+		 const char *catname)	/* I - Compiled catalog to write */
+{
+  stpi_i18n_messages_t	msgs;		/* Messages from .po file */
+  char			*data;		/* Catalog image */
+  size_t		size;		/* Size of image */
+  FILE			*catfile;	/* Compiled catalog */
+  int			status = -1;	/* Return status */
+  int			i;		/* Looping var */
+
+
+  memset(&msgs, 0, sizeof(msgs));
+
+  if (!stpi_read_po(poname, &msgs) &&
+      (data = stpi_build_catalog(&msgs, &size)) != NULL)
+  {
+    if ((catfile = fopen(catname, "wb")) != NULL)
+    {
+      if (fwrite(data, 1, size, catfile) == size)
+	status = 0;
+
+      if (fclose(catfile))
+	status = -1;
+
+      if (status)
+	unlink(catname);
+    }
+
+    free(data);
+  }
+
+  for (i = 0; i < msgs.count; i ++)
+  {
+    free(msgs.ids[i]);
+    free(msgs.strs[i]);
+  }
+  free(msgs.ids);
+  free(msgs.strs);
+
+  return (status);
+}
+
+
+/*
+ * 'stpi_add_message()' - Add a message to a list of messages.
+ */
+
+static void
+stpi_add_message(stpi_i18n_messages_t *msgs,	/* I - Messages */
+		 const char           *id,	/* I - Message ID */
+		 const char           *str)	/* I - Translation */
+{
+  if (msgs->count >= msgs->alloc)
+  {
+    int		alloc = msgs->alloc ? msgs->alloc * 2 : 1024;
+    char	**ids,			/* New message IDs */
+		**strs;			/* New translations */
+
+    if ((ids = realloc(msgs->ids, alloc * sizeof(char *))) == NULL)
+      return;
+    msgs->ids = ids;
+
+    if ((strs = realloc(msgs->strs, alloc * sizeof(char *))) == NULL)
+      return;
+    msgs->strs  = strs;
+    msgs->alloc = alloc;
+  }
+
+  if ((msgs->ids[msgs->count] = strdup(id)) == NULL)
+    return;
+
+  if ((msgs->strs[msgs->count] = strdup(str)) == NULL)
+  {
+    free(msgs->ids[msgs->count]);
+    return;
+  }
+
+  msgs->count ++;
+}
+
+
+/*
+ * 'stpi_build_catalog()' - Build a catalog image from a list of messages.
+ *
+ * If a message ID appears more than once, the first translation is used.
+ */
+
+static char *				/* O - Catalog image or NULL */
+stpi_build_catalog(
+    const stpi_i18n_messages_t *msgs,	/* I - Messages */
+    size_t                     *size)	/* O - Size of image */
+{
+  stpi_i18n_header_t	*header;	/* Catalog header */
+  stpi_i18n_entry_t	*table;		/* Hash table */
+  char			*data;		/* Catalog image */
+  size_t		bytes,		/* Size of image */
+			offset;		/* Offset of next string */
+  uint32_t		hash_size,	/* Number of hash slots */
+			hash,		/* Hash of current ID */
+			slot;		/* Current hash slot */
+  int			i;		/* Looping var */
+
+
+  for (hash_size = 16; hash_size < 2 * (uint32_t)msgs->count; hash_size *= 2);
+
+  bytes = sizeof(stpi_i18n_header_t) + hash_size * sizeof(stpi_i18n_entry_t);
+  for (i = 0; i < msgs->count; i ++)
+    bytes += strlen(msgs->ids[i]) + strlen(msgs->strs[i]) + 2;
+
+  if (bytes > UINT32_MAX || (data = calloc(1, bytes)) == NULL)
+    return (NULL);
+
+  header = (stpi_i18n_header_t *)data;
+  table  = (stpi_i18n_entry_t *)(data + sizeof(stpi_i18n_header_t));
+  offset = sizeof(stpi_i18n_header_t) + hash_size * sizeof(stpi_i18n_entry_t);
+
+  memcpy(header->magic, STPI_I18N_MAGIC, sizeof(header->magic));
+  header->byte_order = STPI_I18N_BYTE_ORDER;
+  header->hash_size  = hash_size;
+
+  for (i = 0; i < msgs->count; i ++)
+  {
+    size_t	idsize = strlen(msgs->ids[i]) + 1,
+		strsize = strlen(msgs->strs[i]) + 1;
+
+    hash = stpi_hash(msgs->ids[i]);
+
+    for (slot = hash & (hash_size - 1); table[slot].id;
+         slot = (slot + 1) & (hash_size - 1))
+      if (table[slot].hash == hash &&
+          !strcmp(data + table[slot].id, msgs->ids[i]))
+	break;
+
+    if (table[slot].id)
+      continue;
+
+    table[slot].hash = hash;
+    table[slot].id   = offset;
+    memcpy(data + offset, msgs->ids[i], idsize);
+    offset += idsize;
+    table[slot].str  = offset;
+    memcpy(data + offset, msgs->strs[i], strsize);
+    offset += strsize;
+
+    header->count ++;
+  }
+
+  header->size = offset;
+  *size        = offset;
+
+  return (data);
+}
+
+
+/*
+ * 'stpi_hash()' - Hash a message ID (32-bit FNV-1a).
+ */
+
+static uint32_t				/* O - Hash value */
+stpi_hash(const char *s)		/* I - String */
+{
+  uint32_t	hash = 2166136261u;	/* Hash value */
+
+
+  while (*s)
+  {
+    hash ^= (unsigned char)*s++;
+    hash *= 16777619u;
+  }
+
+  return (hash);
+}
+
+
+/*
+ * 'stpi_load_catalog()' - Load a compiled message catalog.
+ */
+
+static stp_i18n_catalog_t *		/* O - Catalog or NULL */
+stpi_load_catalog(const char *catname)	/* I - Compiled catalog */
+{
+  stp_i18n_catalog_t	*cat;		/* Catalog */
+  const stpi_i18n_header_t *header;	/* Catalog header */
+  const stpi_i18n_entry_t *table;	/* Hash table */
+  struct stat		catstat;	/* Catalog information */
+  char			*data = NULL;	/* Catalog image */
+  size_t		size;		/* Size of image */
+  int			mapped = 0;	/* Image is mmap()ed? */
+  int			fd;		/* Catalog file */
+  uint32_t		i,		/* Looping var */
+			empty;		/* Number of empty hash slots */
+
+
+  if ((fd = open(catname, O_RDONLY)) < 0)
+    return (NULL);
+
+  if (fstat(fd, &catstat) || catstat.st_size < (off_t)sizeof(stpi_i18n_header_t))
   {
-    fclose(pofile);
+    close(fd);
     return (NULL);
   }
 
+  size = catstat.st_size;
+
+#ifdef HAVE_SYS_MMAN_H
+  if ((data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED)
+    mapped = 1;
+  else
+    data = NULL;
+#endif /* HAVE_SYS_MMAN_H */
+
+  if (!data && (data = malloc(size)) != NULL)
+  {
+    size_t	bytes = 0;		/* Bytes read so far */
+    ssize_t	n;			/* Bytes read this time */
+
+    while (bytes < size && (n = read(fd, data + bytes, size - bytes)) > 0)
+      bytes += n;
+
+    if (bytes < size)
+    {
+      free(data);
+      data = NULL;
+    }
+  }
+
+  close(fd);
+
+  if (!data)
+    return (NULL);
+
+ /*
+  * Validate the header, hash table, and string offsets so that lookups
+  * need no further checks...
+  */
+
+  header = (const stpi_i18n_header_t *)data;
+  table  = (const stpi_i18n_entry_t *)(data + sizeof(stpi_i18n_header_t));
+
+  if (memcmp(header->magic, STPI_I18N_MAGIC, sizeof(header->magic)) ||
+      header->byte_order != STPI_I18N_BYTE_ORDER ||
+      header->size != size || data[size - 1] ||
+      !header->hash_size || (header->hash_size & (header->hash_size - 1)) ||
+      header->hash_size > (size - sizeof(stpi_i18n_header_t)) /
+                          sizeof(stpi_i18n_entry_t))
+    goto bad_catalog;
+
+  for (i = 0, empty = 0; i < header->hash_size; i ++)
+    if (!table[i].id)
+      empty ++;
+    else if (table[i].id >= size || table[i].str >= size)
+      goto bad_catalog;
+
+  if (!empty)				/* Lookups must terminate */
+    goto bad_catalog;
+
+  if ((cat = calloc(1, sizeof(stp_i18n_catalog_t))) == NULL)
+    goto bad_catalog;
+
+  cat->data   = data;
+  cat->size   = size;
+  cat->mapped = mapped;
+  cat->table  = table;
+  cat->mask   = header->hash_size - 1;
+
+  return (cat);
+
+  bad_catalog:
+
+  fprintf(stderr, "DEBUG: Ignoring invalid message catalog %s\n", catname);
+
+#ifdef HAVE_SYS_MMAN_H
+  if (mapped)
+    munmap(data, size);
+  else
+#endif /* HAVE_SYS_MMAN_H */
+  free(data);
+
+  return (NULL);
+}
+
+
+/*
+ * 'stpi_read_po()' - Read the messages in a .po file.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+stpi_read_po(const char           *poname,	/* I - .po file */
+	     stpi_i18n_messages_t *msgs)	/* I - Messages */
+{
+  FILE			*pofile;	/* .po file */
+  char			line[4096],	/* Line buffer */
+			*ptr,		/* Pointer into buffer */
+			id[4096],	/* Translation ID */
+			str[4096],	/* Translation string */
+			utf8str[4096];	/* UTF-8 translation string */
+  int			in_id,		/* Processing "id" string? */
+			in_str,		/* Processing "str" string? */
+			linenum;	/* Line number in .po file */
+  iconv_t		ic;		/* Transcoder to UTF-8 */
+  size_t		inbytes,	/* Number of input buffer bytes */
+			outbytes;	/* Number of output buffer bytes */
+  char			*inptr,		/* Pointer into input buffer */
+			*outptr;	/* Pointer into output buffer */
+  int			fuzzy = 0;	/* Fuzzy translation? */
+
+
+  if ((pofile = fopen(poname, "rb")) == NULL)
+    return (-1);
+
+ /*
+  * Read the messages and add them to the list...
+  */
+
   linenum = 0;
   id[0]   = '\0';
   str[0]  = '\0';
@@ -242,12 +717,12 @@ stp_i18n_load(const char *locale)	/* I - Locale name */
 	  */
 
           stpi_unquote(utf8str);
-          stp_string_list_add_string_unsafe(po, id, utf8str);
+          stpi_add_message(msgs, id, utf8str);
 	}
 	else
 	{
           stpi_unquote(str);
-          stp_string_list_add_string_unsafe(po, id, str);
+          stpi_add_message(msgs, id, str);
         }
       }
       else if (!id[0] && str[0] && !ic)
@@ -360,70 +835,20 @@ stp_i18n_load(const char *locale)	/* I - Locale name */
       */
 
       stpi_unquote(utf8str);
-      stp_string_list_add_string_unsafe(po, id, utf8str);
+      stpi_add_message(msgs, id, utf8str);
     }
     else
     {
       stpi_unquote(str);
-      stp_string_list_add_string_unsafe(po, id, str);
+      stpi_add_message(msgs, id, str);
     }
   }
 
   fclose(pofile);
 
- /*
-  * Add this to the cache...
-  */
-
-  if ((pocache = calloc(1, sizeof(stpi_i18n_t))) != NULL)
-  {
-    strncpy(pocache->locale, locale, sizeof(pocache->locale) - 1);
-    pocache->po   = po;
-    pocache->next = stpi_pocache;
-    stpi_pocache  = pocache;
-  }
-
   if (ic)
     iconv_close(ic);
-  return (po);
-}
-
-
-/*
- * 'stp_i18n_lookup()' - Lookup a string in the message catalog...
- */
-
-const char *				/* O - Localized message */
-stp_i18n_lookup(
-    const stp_string_list_t *po,		/* I - Message catalog */
-    const char        *message)		/* I - Message */
-{
-  stp_param_string_t	*param;		/* Matching message */
-
-
-  if (po && (param = stp_string_list_find(po, message)) != NULL && param->text)
-    return (param->text);
-  else
-    return (message);
-}
-
-
-/*
- * 'stp_i18n_printf()' - Send a formatted string to stderr.
- */
-
-void
-stp_i18n_printf(
-    const stp_string_list_t *po,		/* I - Message catalog */
-    const char        *message,		/* I - Printf-style message */
-    ...)				/* I - Additional arguments as needed */
-{
-  va_list	ap;			/* Argument pointer */
-
-
-  va_start(ap, message);
-  vfprintf(stderr, stp_i18n_lookup(po, message), ap);
-  va_end(ap);
+  return (0);
 }
 
 
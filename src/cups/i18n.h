@@ -28,12 +28,21 @@
 #define _(x) x
 
 
+/*
+ * Message catalog...
+ */
+
+typedef struct stpi_i18n_s stp_i18n_catalog_t;
+
+
 /*
  * Prototypes...
  */
 
-extern const stp_string_list_t	*stp_i18n_load(const char *locale);
-extern const char		*stp_i18n_lookup(const stp_string_list_t *po,
+extern const stp_i18n_catalog_t	*stp_i18n_load(const char *locale);
+extern const char		*stp_i18n_lookup(const stp_i18n_catalog_t *po,
 				                 const char *message);
-extern void			stp_i18n_printf(const stp_string_list_t *po,
+extern void			stp_i18n_printf(const stp_i18n_catalog_t *po,
 				                const char *message, ...);
+extern int			stp_i18n_compile(const char *poname,
+						 const char *catname);
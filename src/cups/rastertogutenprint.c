@@ -23,6 +23,7 @@
  *   cancel_job()              - Cancel the current job...
  *   Image_get_appname()       - Get the application we are running.
  *   Image_get_row()           - Get one row of the image.
+ *   Image_get_rows()          - Get several rows of the image.
  *   Image_height()            - Return the height of an image.
  *   Image_init()              - Initialize an image.
  *   Image_conclude()          - Close the progress display.
@@ -116,6 +117,10 @@ static const char *Image_get_appname(stp_image_t *image);
 static stp_image_status_t Image_get_row(stp_image_t *image,
 					unsigned char *data,
 					size_t byte_limit, int row);
+static stp_image_status_t Image_get_rows(stp_image_t *image,
+					 unsigned char *data,
+					 size_t byte_limit, int row,
+					 int count);
 static int	Image_height(stp_image_t *image);
 static int	Image_width(stp_image_t *image);
 static void	Image_conclude(stp_image_t *image);
@@ -130,6 +135,9 @@ static stp_image_t theImage =
   Image_get_row,
   Image_get_appname,
   Image_conclude,
+  NULL,
+  0,
+  Image_get_rows,
   NULL
 };
 
@@ -138,7 +146,7 @@ static double total_bytes_printed = 0;
 static int print_messages_as_errors = 0;
 static int suppress_messages = 0;
 static int suppress_verbose_messages = 0;
-static const stp_string_list_t *po = NULL;
+static const stp_i18n_catalog_t *po = NULL;
 #ifdef ENABLE_CUPS_LOAD_SAVE_OPTIONS
 static const char *save_file_name = NULL;
 static const char *load_file_name = NULL;
@@ -1550,6 +1558,22 @@ throwaway_data(int amount, cups_image_t *cups)
     cupsRasterReadPixels(cups->ras, trash, leftover);
 }
 
+static void
+report_progress(cups_image_t *cups)
+{
+  int new_percent = (int) (100.0 * cups->row / cups->header.cupsHeight);
+  if (new_percent > cups->last_percent)
+    {
+      if (! suppress_verbose_messages)
+	{
+	  stp_i18n_printf(po, _("INFO: Printing page %d, %d%%\n"),
+			  cups->page + 1, new_percent);
+	  fprintf(stderr, "ATTR: job-media-progress=%d\n", new_percent);
+	}
+      cups->last_percent = new_percent;
+    }
+}
+
 static stp_image_status_t
 Image_get_row(stp_image_t   *image,	/* I - Image */
 	      unsigned char *data,	/* O - Row */
@@ -1563,7 +1587,6 @@ Image_get_row(stp_image_t   *image,	/* I - Image */
   stp_image_status_t tmp_image_status = Image_status;
   unsigned char *orig = data;           /* Temporary pointer */
   static int warned = 0;                /* Error warning printed? */
-  int new_percent;
   int left_margin, right_margin;
 
   if ((cups = (cups_image_t *)(image->rep)) == NULL)
@@ -1654,17 +1677,7 @@ Image_get_row(stp_image_t   *image,	/* I - Image */
 	}
     }
 
-  new_percent = (int) (100.0 * cups->row / cups->header.cupsHeight);
-  if (new_percent > cups->last_percent)
-    {
-      if (! suppress_verbose_messages)
-	{
-	  stp_i18n_printf(po, _("INFO: Printing page %d, %d%%\n"),
-			  cups->page + 1, new_percent);
-	  fprintf(stderr, "ATTR: job-media-progress=%d\n", new_percent);
-	}
-      cups->last_percent = new_percent;
-    }
+  report_progress(cups);
 
   if (tmp_image_status != STP_IMAGE_STATUS_OK)
     {
@@ -1675,6 +1688,57 @@ Image_get_row(stp_image_t   *image,	/* I - Image */
 }
 
 
+/*
+ * 'Image_get_rows()' - Get several rows of the image.
+ *
+ * When the raster rows need no trimming or conversion they are read
+ * with a single call; otherwise this is the same as calling
+ * Image_get_row() for each row.
+ */
+
+static stp_image_status_t
+Image_get_rows(stp_image_t   *image,	/* I - Image */
+	       unsigned char *data,	/* O - Rows */
+	       size_t	     byte_limit, /* I - how many bytes in each row */
+	       int           row,	/* I - First row number */
+	       int           count)	/* I - Number of rows */
+{
+  cups_image_t	*cups;			/* CUPS image */
+  size_t	bytes_per_line;
+  int		i;
+
+  if ((cups = (cups_image_t *)(image->rep)) != NULL &&
+      cups->row == row &&
+      (unsigned) (row + count) <= cups->header.cupsHeight &&
+      cups->header.cupsBitsPerPixel != 1 &&
+      cups->left_trim == 0 && cups->right_trim == 0)
+    {
+      bytes_per_line =
+	((cups->adjusted_width * cups->header.cupsBitsPerPixel) +
+	 CHAR_BIT - 1) / CHAR_BIT;
+      if (bytes_per_line == cups->header.cupsBytesPerLine &&
+	  bytes_per_line == byte_limit)
+	{
+	  if (! suppress_messages && ! suppress_verbose_messages)
+	    fprintf(stderr, "DEBUG2: Gutenprint: Reading %d rows at %d\n",
+		    count, cups->row);
+	  cupsRasterReadPixels(cups->ras, data, bytes_per_line * count);
+	  cups->row += count;
+	  report_progress(cups);
+	  return Image_status;
+	}
+    }
+  for (i = 0; i < count; i++)
+    {
+      stp_image_status_t status =
+	Image_get_row(image, data + i * byte_limit, byte_limit, row + i);
+      if (status != STP_IMAGE_STATUS_OK)
+	return status;
+    }
+  return STP_IMAGE_STATUS_OK;
+}
+
+
 /*
  * 'Image_height()' - Return the height of an image.
  */
@@ -0,0 +1,86 @@
+/*
+ *   Stand-ins for backend_common.c, for tests of a single backend
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *          [http://www.gnu.org/licenses/gpl-2.0.html]
+ *
+ *   SPDX-License-Identifier: GPL-2.0+
+ *
+ */
+
+/* The backend tests include one backend's source file directly, to get at
+   its static conversion routines, and link with this in place of
+   backend_common.c and its main().  Nothing here talks to a printer. */
+
+#include "backend_common.h"
+
+int terminate = 0;
+int dyesub_debug = 0;
+int fast_return = 0;
+int extra_vid = -1;
+int extra_pid = -1;
+int extra_type = -1;
+int copies = 1;
+int test_mode = 0;
+
+int send_data(struct libusb_device_handle *dev, uint8_t endp,
+	      uint8_t *buf, int len)
+{
+	UNUSED(dev);
+	UNUSED(endp);
+	UNUSED(buf);
+	UNUSED(len);
+	return CUPS_BACKEND_FAILED;
+}
+
+int read_data(struct libusb_device_handle *dev, uint8_t endp,
+	      uint8_t *buf, int buflen, int *readlen)
+{
+	UNUSED(dev);
+	UNUSED(endp);
+	UNUSED(buf);
+	UNUSED(buflen);
+	UNUSED(readlen);
+	return CUPS_BACKEND_FAILED;
+}
+
+void dump_markers(struct marker *markers, int marker_count, int full)
+{
+	UNUSED(markers);
+	UNUSED(marker_count);
+	UNUSED(full);
+}
+
+void print_license_blurb(void)
+{
+}
+
+void print_help(char *argv0, struct dyesub_backend *backend)
+{
+	UNUSED(argv0);
+	UNUSED(backend);
+}
+
+uint16_t uint16_to_packed_bcd(uint16_t val)
+{
+	return val;
+}
+
+uint32_t packed_bcd_to_uint32(char *in, int len)
+{
+	UNUSED(in);
+	UNUSED(len);
+	return 0;
+}
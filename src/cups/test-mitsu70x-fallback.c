@@ -0,0 +1,122 @@
+/*
+ *   Mitsubishi CP-D70 family internal image conversion test
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *          [http://www.gnu.org/licenses/gpl-2.0.html]
+ *
+ *   SPDX-License-Identifier: GPL-2.0+
+ *
+ */
+
+/*
+ * Usage: test-mitsu70x-fallback
+ *
+ * Runs the experimental conversion the D70 backend uses with
+ * MITSU70X_FALLBACK set over a small BGR image, with and without row
+ * reversal and at several sharpening levels, and compares the planes
+ * with values worked out by hand from the conversion's own definition:
+ * Y, M and C are 255 minus B, G and R, plus sharpen/16 of the
+ * four-neighbour Laplacian of the input, clamped, sent as 16-bit
+ * big-endian samples with each plane padded with zeros to a multiple of
+ * 512 bytes.  This only guards that definition against regressions.  It
+ * says nothing about how close the result is to what the image
+ * processing library produces, which has not been checked.  The exit
+ * status is nonzero on a mismatch.
+ */
+
+#include "backend_mitsu70x.c"
+
+#define ROWS 3
+#define COLS 4
+
+/* BGR */
+static const uint8_t image[ROWS][COLS][3] = {
+	{ { 10, 200, 30 }, { 250, 0, 128 }, { 90, 90, 90 }, { 0, 255, 255 } },
+	{ { 128, 128, 128 }, { 255, 255, 255 }, { 0, 0, 0 }, { 40, 80, 160 } },
+	{ { 5, 15, 25 }, { 100, 150, 200 }, { 220, 110, 55 }, { 64, 32, 16 } },
+};
+
+static const struct {
+	int sharpen;
+	int reverse;
+	uint8_t ymc[3][ROWS][COLS];  /* In the order the rows are sent */
+} cases[] = {
+	{ 0, 0, {
+		{ { 245, 5, 165, 255 }, { 127, 0, 255, 215 }, { 250, 155, 35, 191 } },
+		{ { 55, 255, 165, 0 }, { 127, 0, 255, 175 }, { 240, 105, 145, 223 } },
+		{ { 225, 127, 165, 0 }, { 127, 0, 255, 95 }, { 230, 55, 200, 239 } },
+	} },
+	{ 0, 1, {
+		{ { 250, 155, 35, 191 }, { 127, 0, 255, 215 }, { 245, 5, 165, 255 } },
+		{ { 240, 105, 145, 223 }, { 127, 0, 255, 175 }, { 55, 255, 165, 0 } },
+		{ { 230, 55, 200, 239 }, { 127, 0, 255, 95 }, { 225, 127, 165, 0 } },
+	} },
+	{ 4, 0, {
+		{ { 255, 0, 160, 255 }, { 99, 0, 255, 201 }, { 255, 200, 0, 224 } },
+		{ { 0, 255, 162, 0 }, { 148, 0, 255, 186 }, { 255, 88, 108, 254 } },
+		{ { 255, 125, 193, 0 }, { 109, 0, 255, 43 }, { 255, 0, 212, 255 } },
+	} },
+	{ 16, 1, {
+		{ { 255, 255, 0, 255 }, { 13, 0, 255, 159 }, { 255, 0, 145, 255 } },
+		{ { 255, 35, 0, 255 }, { 213, 0, 255, 222 }, { 0, 255, 150, 0 } },
+		{ { 255, 0, 251, 255 }, { 53, 0, 255, 0 }, { 255, 118, 255, 0 } },
+	} },
+};
+
+int main(void)
+{
+	uint32_t planelen = ((ROWS * COLS * 2 + 511) / 512) * 512;
+	uint8_t dest[3 * 512];
+	unsigned int c;
+	int failures = 0;
+
+	for (c = 0 ; c < sizeof(cases) / sizeof(cases[0]) ; c++) {
+		uint32_t plane, i;
+		int bad = 0;
+
+		memset(dest, 0x5a, sizeof(dest));
+		mitsu70x_fallback_convert(&image[0][0][0], dest, ROWS, COLS,
+					  planelen, cases[c].sharpen,
+					  cases[c].reverse);
+
+		for (plane = 0 ; plane < 3 ; plane++) {
+			const uint8_t *expect = &cases[c].ymc[plane][0][0];
+			const uint8_t *got = dest + plane * planelen;
+
+			for (i = 0 ; i < ROWS * COLS ; i++) {
+				if (got[2 * i] != expect[i] || got[2 * i + 1] != expect[i]) {
+					printf("FAIL: sharpen %d reverse %d: plane %u sample %u is %02x%02x, expected %02x%02x\n",
+					       cases[c].sharpen, cases[c].reverse,
+					       plane, i, got[2 * i], got[2 * i + 1],
+					       expect[i], expect[i]);
+					bad = 1;
+				}
+			}
+			for (i = ROWS * COLS * 2 ; i < planelen ; i++) {
+				if (got[i]) {
+					printf("FAIL: sharpen %d reverse %d: plane %u padding not cleared\n",
+					       cases[c].sharpen, cases[c].reverse, plane);
+					bad = 1;
+					break;
+				}
+			}
+		}
+		failures += bad;
+	}
+
+	if (!failures)
+		printf("All D70 fallback conversions match\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+ *   Shinko/Sinfonia CHC-S6145 image conversion test
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *          [http://www.gnu.org/licenses/gpl-2.0.html]
+ *
+ *   SPDX-License-Identifier: GPL-2.0+
+ *
+ */
+
+/*
+ * Usage: test-s6145-convert
+ *
+ * Runs the conversion the S6145 backend uses when the image processing
+ * library is missing over every print size, with and without overcoat,
+ * using random correction tables, and compares the stripes and plane
+ * averages with a straightforward pixel at a time conversion.  The exit
+ * status is nonzero if they differ.
+ */
+
+#include "backend_shinkos6145.c"
+
+static const uint16_t *reference_table(const struct shinkos6145_correctionparam *corrdata,
+				       int plane, uint16_t *table)
+{
+	int i;
+	for (i = 0 ; i < 256 ; i++) {
+		switch (plane) {
+		case 0:
+			table[i] = corrdata->pulseTransTable_Y[i];
+			break;
+		case 1:
+			table[i] = corrdata->pulseTransTable_M[i];
+			break;
+		default:
+			table[i] = corrdata->pulseTransTable_C[i];
+			break;
+		}
+	}
+	return table;
+}
+
+/* One pixel at a time, as the backend used to do it */
+static void reference_process_image(const uint8_t *src, uint16_t *dest,
+				    const struct shinkos6145_correctionparam *corrdata,
+				    uint8_t oc_mode, uint8_t *image_avg)
+{
+	uint16_t rows = le16_to_cpu(corrdata->height);
+	uint16_t cols = le16_to_cpu(corrdata->width);
+	uint16_t row_lim = le16_to_cpu(corrdata->headDots);
+	uint16_t pad_l = (row_lim - cols) / 2;
+	uint16_t pad_r = pad_l + cols;
+	uint32_t planelen = rows * cols;
+	uint32_t in = 0, out = 0;
+	uint16_t row, col;
+	int plane;
+
+	for (plane = 0 ; plane < 3 ; plane++) {
+		uint16_t table[256];
+		uint64_t sum = 0;
+		uint32_t i;
+
+		for (i = 0 ; i < planelen ; i++)
+			sum += src[planelen * plane + i];
+		image_avg[plane] = sum / planelen;
+
+		reference_table(corrdata, plane, table);
+		for (row = 0 ; row < rows ; row++) {
+			for (col = 0 ; col < row_lim ; col++) {
+				if (col < pad_l || col >= pad_r)
+					dest[out++] = 0;
+				else
+					dest[out++] = table[src[in++]];
+			}
+		}
+	}
+
+	if (oc_mode > PRINT_MODE_NO_OC) {
+		for (row = 0 ; row < rows ; row++) {
+			for (col = 0 ; col < row_lim ; col++) {
+				if (col < pad_l || col >= pad_r)
+					dest[out++] = 0;
+				else
+					dest[out++] = corrdata->pulseTransTable_O[corrdata->printOpLevel];
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	/* Every S6145 print size, plus a couple of odd ones */
+	static const uint16_t sizes[][2] = {
+		{ 1844, 634 }, { 1844, 1240 }, { 1548, 1536 }, { 1548, 2140 },
+		{ 1844, 1832 }, { 1844, 2434 }, { 1844, 2492 }, { 1844, 2740 },
+		{ 1843, 3 }, { 5, 7 },
+	};
+	struct shinkos6145_correctionparam *corrdata;
+	unsigned int size, i;
+	int failures = 0;
+
+	corrdata = malloc(sizeof(*corrdata));
+	if (!corrdata)
+		return 1;
+	srand(6145);
+	for (i = 0 ; i < sizeof(*corrdata) ; i++)
+		((uint8_t *) corrdata)[i] = rand();
+	corrdata->headDots = cpu_to_le16(1920);
+	corrdata->printOpLevel = rand() % 256;
+
+	for (size = 0 ; size < sizeof(sizes) / sizeof(sizes[0]) ; size++) {
+		uint16_t cols = sizes[size][0], rows = sizes[size][1];
+		size_t planelen = (size_t) rows * cols;
+		size_t outlen = (size_t) 1920 * rows * 4 * sizeof(uint16_t);
+		uint8_t *src = malloc(planelen * 3);
+		uint16_t *expect = malloc(outlen);
+		uint16_t *got = malloc(outlen);
+		uint8_t oc_mode;
+
+		if (!src || !expect || !got)
+			return 1;
+		for (i = 0 ; i < planelen * 3 ; i++)
+			src[i] = rand();
+		corrdata->width = cpu_to_le16(cols);
+		corrdata->height = cpu_to_le16(rows);
+
+		for (oc_mode = PRINT_MODE_NO_OC ; oc_mode <= PRINT_MODE_NO_OC + 1 ; oc_mode++) {
+			uint8_t expect_avg[3], got_avg[3];
+
+			memset(expect, 0x5a, outlen);
+			memset(got, 0x5a, outlen);
+			reference_process_image(src, expect, corrdata, oc_mode, expect_avg);
+			lib6145_process_image(src, got, corrdata, oc_mode, got_avg);
+			if (memcmp(expect, got, outlen) ||
+			    memcmp(expect_avg, got_avg, sizeof(got_avg))) {
+				printf("FAIL: %ux%u, overcoat mode %u\n",
+				       cols, rows, oc_mode);
+				failures++;
+			}
+		}
+		free(src);
+		free(expect);
+		free(got);
+	}
+	free(corrdata);
+
+	if (!failures)
+		printf("All S6145 conversions match\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,348 @@
+/*
+ *   Test for the IEEE 1284.4 transport against a scripted printer.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: d4-test [-n queries]
+ *
+ * A child process plays the printer at the other end of a socketpair.
+ * It answers the D4 transactions the way an Epson does, grants a few
+ * packets of credit at a time, and checks that the host never sends a
+ * data packet it has no credit for.  The host opens the control channel,
+ * runs a series of status queries, and sends a block larger than one
+ * packet.  Finally the printer goes silent, and a command must time out
+ * rather than hang.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "d4lib.h"
+
+#define SOCKET_ID     0x40
+#define PACKET_SIZE   0x200
+#define CREDIT_GRANT  4
+#define BLOCK_SIZE    2000
+
+static const char status_reply[] = "@BDC ST2\r\nST:01;\r\n";
+
+typedef struct
+{
+  int credit_requests;		/* CreditRequest transactions */
+  int data_packets;		/* Data packets received */
+  int data_bytes;		/* Payload received */
+  int overruns;			/* Data packets sent without credit */
+} printer_stats_t;
+
+static double
+compute_interval(struct timeval *tv1, struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static int
+test_for_st(const unsigned char *buf)
+{
+  return !strncmp("@BDC ST", (const char *) buf, 7);
+}
+
+static int
+read_fully(int fd, unsigned char *buf, int len)
+{
+  int total = 0;
+  while (total < len)
+    {
+      int status = read(fd, buf + total, len - total);
+      if (status <= 0)
+	return -1;
+      total += status;
+    }
+  return total;
+}
+
+static void
+reply(int fd, const unsigned char *packet, int len)
+{
+  if (write(fd, packet, len) != len)
+    exit(2);
+}
+
+/*
+ * Send a transaction reply: header, the command with the reply bit set,
+ * a zero result, and the given parameters.
+ */
+static void
+transaction_reply(int fd, int command, const unsigned char *params, int len)
+{
+  unsigned char packet[64];
+  packet[0] = 0;
+  packet[1] = 0;
+  packet[2] = 0;
+  packet[3] = 8 + len;
+  packet[4] = 1;
+  packet[5] = 0;
+  packet[6] = command | 0x80;
+  packet[7] = 0;
+  memcpy(packet + 8, params, len);
+  reply(fd, packet, 8 + len);
+}
+
+static void
+run_printer(int fd, int result_fd)
+{
+  unsigned char packet[65536];
+  unsigned char params[64];
+  printer_stats_t stats;
+  int host_credit = 0;		/* Credit we have granted the host */
+  int reply_credit = 0;		/* Credit the host has granted us */
+
+  memset(&stats, 0, sizeof(stats));
+  while (read_fully(fd, packet, 6) == 6)
+    {
+      int len = (packet[2] << 8) + packet[3];
+      if (len < 6 || read_fully(fd, packet + 6, len - 6) < 0)
+	break;
+      if (packet[0] != 0 || packet[1] != 0)
+	{
+	  /* Data for the channel */
+	  stats.data_packets++;
+	  stats.data_bytes += len - 6;
+	  if (host_credit-- <= 0)
+	    stats.overruns++;
+	  if (packet[6] == 's' && packet[7] == 't' && reply_credit > 0)
+	    {
+	      int rlen = 6 + strlen(status_reply);
+	      packet[2] = rlen >> 8;
+	      packet[3] = rlen & 0xff;
+	      packet[4] = 0;
+	      packet[5] = 0;
+	      memcpy(packet + 6, status_reply, rlen - 6);
+	      reply(fd, packet, rlen);
+	      reply_credit--;
+	    }
+	  continue;
+	}
+      switch (packet[6])
+	{
+	case 0x00:		/* Init */
+	  params[0] = 0x10;
+	  transaction_reply(fd, 0x00, params, 1);
+	  break;
+	case 0x09:		/* GetSocketID */
+	  params[0] = SOCKET_ID;
+	  memcpy(params + 1, packet + 7, len - 7);
+	  transaction_reply(fd, 0x09, params, len - 6);
+	  break;
+	case 0x01:		/* OpenChannel */
+	  params[0] = packet[7];
+	  params[1] = packet[8];
+	  params[2] = PACKET_SIZE >> 8;
+	  params[3] = PACKET_SIZE & 0xff;
+	  params[4] = PACKET_SIZE >> 8;
+	  params[5] = PACKET_SIZE & 0xff;
+	  params[6] = 0;
+	  params[7] = 0;
+	  transaction_reply(fd, 0x01, params, 8);
+	  break;
+	case 0x02:		/* CloseChannel */
+	  params[0] = packet[7];
+	  params[1] = packet[8];
+	  transaction_reply(fd, 0x02, params, 2);
+	  break;
+	case 0x03:		/* Credit */
+	  reply_credit += (packet[9] << 8) + packet[10];
+	  params[0] = packet[7];
+	  params[1] = packet[8];
+	  transaction_reply(fd, 0x03, params, 2);
+	  break;
+	case 0x04:		/* CreditRequest */
+	  stats.credit_requests++;
+	  host_credit += CREDIT_GRANT;
+	  params[0] = packet[7];
+	  params[1] = packet[8];
+	  params[2] = 0;
+	  params[3] = CREDIT_GRANT;
+	  transaction_reply(fd, 0x04, params, 4);
+	  break;
+	case 0x08:		/* Exit: report, then stop answering */
+	  transaction_reply(fd, 0x08, params, 0);
+	  if (write(result_fd, &stats, sizeof(stats)) != sizeof(stats))
+	    exit(2);
+	  while (read(fd, packet, sizeof(packet)) > 0)
+	    ;
+	  exit(0);
+	default:
+	  exit(3);
+	}
+    }
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], result[2];
+  unsigned char buf[1024];
+  unsigned char block[BLOCK_SIZE];
+  int send_size = PACKET_SIZE;
+  int receive_size = PACKET_SIZE;
+  int queries = 10;
+  int failures = 0;
+  int socket_id;
+  int expected_requests;
+  printer_stats_t stats;
+  struct timeval tv1, tv2;
+  pid_t pid;
+  int i, c;
+
+  while ((c = getopt(argc, argv, "n:")) != -1)
+    {
+      switch (c)
+	{
+	case 'n':
+	  queries = atoi(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-n queries]\n", argv[0]);
+	  return 1;
+	}
+    }
+  if (queries <= 0)
+    queries = 10;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) || pipe(result))
+    {
+      perror("d4-test");
+      return 1;
+    }
+  pid = fork();
+  if (pid == 0)
+    {
+      close(fds[0]);
+      close(result[0]);
+      run_printer(fds[1], result[1]);
+    }
+  close(fds[1]);
+  close(result[1]);
+
+  setDebug(0);
+  d4RdTimeout = 200;
+  d4WrTimeout = 200;
+  d4FlushTimeout = 10;
+
+  (void) gettimeofday(&tv1, NULL);
+  if (!Init(fds[0]))
+    {
+      fprintf(stderr, "Init failed\n");
+      return 1;
+    }
+  socket_id = GetSocketID(fds[0], "EPSON-CTRL");
+  if (socket_id != SOCKET_ID)
+    {
+      fprintf(stderr, "GetSocketID returned %d\n", socket_id);
+      return 1;
+    }
+  if (OpenChannel(fds[0], socket_id, &send_size, &receive_size) != 1 ||
+      send_size != PACKET_SIZE)
+    {
+      fprintf(stderr, "OpenChannel failed\n");
+      return 1;
+    }
+
+  for (i = 0; i < queries; i++)
+    {
+      int status;
+      memset(buf, 0, sizeof(buf));
+      status = writeAndReadData(fds[0], socket_id,
+				(const unsigned char *) "st\1\0\1", 5, 1,
+				buf, sizeof(buf) - 1, &send_size,
+				&receive_size, &test_for_st);
+      if (status != strlen(status_reply) ||
+	  memcmp(buf, status_reply, status) != 0)
+	{
+	  fprintf(stderr, "Query %d: bad status reply (%d)\n", i, status);
+	  failures++;
+	}
+    }
+
+  for (i = 0; i < BLOCK_SIZE; i++)
+    block[i] = i & 0xff;
+  if (writeData(fds[0], socket_id, block, BLOCK_SIZE, 0) != BLOCK_SIZE)
+    {
+      fprintf(stderr, "Writing a block of %d bytes failed\n", BLOCK_SIZE);
+      failures++;
+    }
+  (void) gettimeofday(&tv2, NULL);
+
+  if (Exit(fds[0]) != 1)
+    {
+      fprintf(stderr, "Exit failed\n");
+      failures++;
+    }
+  if (read(result[0], &stats, sizeof(stats)) != sizeof(stats))
+    {
+      fprintf(stderr, "No report from the printer\n");
+      return 1;
+    }
+
+  /* One credit per query, and one per packet of the block */
+  i = queries + (BLOCK_SIZE + PACKET_SIZE - 7) / (PACKET_SIZE - 6);
+  expected_requests = (i + CREDIT_GRANT - 1) / CREDIT_GRANT;
+  if (stats.data_packets != i ||
+      stats.data_bytes != queries * 5 + BLOCK_SIZE)
+    {
+      fprintf(stderr, "Printer got %d packets, %d bytes\n",
+	      stats.data_packets, stats.data_bytes);
+      failures++;
+    }
+  if (stats.overruns)
+    {
+      fprintf(stderr, "%d packets sent without credit\n", stats.overruns);
+      failures++;
+    }
+  if (stats.credit_requests != expected_requests)
+    {
+      fprintf(stderr, "%d credit requests, expected %d\n",
+	      stats.credit_requests, expected_requests);
+      failures++;
+    }
+
+  /* The printer no longer answers, so this must time out */
+  if (CreditRequest(fds[0], socket_id) > 0)
+    {
+      fprintf(stderr, "Silent printer granted credit\n");
+      failures++;
+    }
+
+  close(fds[0]);
+  waitpid(pid, NULL, 0);
+  if (failures)
+    fprintf(stderr, "%d failures\n", failures);
+  else
+    printf("%d queries, %d packets, %d credit requests, %.3f sec\n",
+	   queries, stats.data_packets, stats.credit_requests,
+	   compute_interval(&tv1, &tv2));
+  return failures ? 1 : 0;
+}
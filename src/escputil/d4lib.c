@@ -35,11 +35,13 @@
  */
 
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <signal.h>
 #include <fcntl.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -47,6 +49,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#ifdef HAVE_POLL
+#include <sys/poll.h>
+#else
+#include <sys/select.h>
+#endif
 
 #include "d4lib.h"
 
@@ -56,21 +63,28 @@
 #define WRTIMEOUT     10000
 #define RDDATATIMEOUT 1000
 #define MICROTIMEOUT  1
+#define FLUSHTIMEOUT  500
 #endif
 
 int d4WrTimeout     = WRTIMEOUT;
 int d4RdTimeout     = RDTIMEOUT;
 int d4RdDataTimeout = RDDATATIMEOUT;
 int d4MicroTimeout  = 1;
+int d4FlushTimeout  = FLUSHTIMEOUT;
 int ppid        = 0;
 
 int debugD4     = 1;
 
-typedef void (*signalHandler_t)(int);
-static signalHandler_t sig;
 static int timeoutGot = 0;
 static int _readData(int fd, unsigned char *buf, int len);
 
+/* Credit granted to us by the printer and not yet used, and the   */
+/* packet size negotiated for sending, for each socket.  Credit    */
+/* is only requested when this runs out, so that packets can be    */
+/* sent back to back instead of one credit round trip per packet.  */
+static int hostCredit[256];
+static int hostPacketSize[256];
+
 static int d4Errno = 0;
 
 /* commands for the D4 protocol
@@ -169,20 +183,6 @@ static errorMessage_t errorMessage[] =
    { 0x00, NULL                                                      ,0 }
 };
 
-#define RESET_TIMER(ti,oti) { signal(SIGALRM, sig); \
-                              memset((void*)&ti,0,sizeof(ti)); \
-                              memset((void*)&oti,0,sizeof(oti)); \
-                              setitimer( ITIMER_REAL ,&ti, &oti); \
-                            }
-
-#define SET_TIMER(ti,oti,val) { memset((void*)&ti,0,sizeof(ti)); \
-                                memset((void*)&oti,0,sizeof(oti)); \
-                                ti.it_value.tv_sec  = val/1000; \
-                                ti.it_value.tv_usec = (val%1000)*1000; \
-                                setitimer( ITIMER_REAL ,&ti, &oti); \
-                                sig = signal(SIGALRM, sigAlarm); \
-                              }
-
 static int d4USleep(long usec)
 {
   struct timespec t;
@@ -191,6 +191,79 @@ static int d4USleep(long usec)
   return nanosleep(&t, NULL);
 }
 
+/*******************************************************************/
+/* Function d4Wait()                                               */
+/*        wait until the device is ready                           */
+/* Input:  int   fd      file handle                               */
+/*         int   output  wait for writing rather than reading      */
+/*         int   timeout in ms                                     */
+/*                                                                 */
+/* Return: 1 if ready, 0 on timeout (timeoutGot set), -1 on error  */
+/*                                                                 */
+/*******************************************************************/
+
+static int d4Wait(int fd, int output, int timeout)
+{
+#ifdef HAVE_POLL
+   struct pollfd ufds;
+   int status;
+   ufds.fd = fd;
+   ufds.events = output ? POLLOUT : POLLIN;
+   do
+   {
+      ufds.revents = 0;
+      status = poll(&ufds, 1, timeout);
+   }
+   while ( status < 0 && errno == EINTR );
+   if ( status == 0 )
+      timeoutGot = -1;
+   return status;
+#else
+   fd_set fds;
+   struct timeval tv;
+   int status;
+   do
+   {
+      FD_ZERO(&fds);
+      FD_SET(fd, &fds);
+      tv.tv_sec  = timeout / 1000;
+      tv.tv_usec = (timeout % 1000) * 1000;
+      status = select(fd + 1, output ? NULL : &fds, output ? &fds : NULL,
+                      NULL, timeout < 0 ? NULL : &tv);
+   }
+   while ( status < 0 && errno == EINTR );
+   if ( status == 0 )
+      timeoutGot = -1;
+   return status;
+#endif
+}
+
+/*******************************************************************/
+/* Function d4Read()                                               */
+/*        read whatever arrives within the timeout                 */
+/* Input:  int   fd      file handle                               */
+/*         char *buf     the data are to be put here               */
+/*         int   len     the maximum number of bytes to read       */
+/*         int   timeout in ms                                     */
+/*                                                                 */
+/* Return: number of bytes read, 0 if none or -1 on error          */
+/*                                                                 */
+/*******************************************************************/
+
+static int d4Read(int fd, void *buf, int len, int timeout)
+{
+   int rd = d4Wait(fd, 0, timeout);
+   if ( rd <= 0 )
+      return rd;
+   rd = read(fd, buf, len);
+   if ( rd < 0 && errno == EAGAIN )
+   {
+      errno = 0;
+      rd = 0;
+   }
+   return rd;
+}
+
 /*******************************************************************/
 /* Function printHexValues                                         */
 /*                                                                 */
@@ -290,20 +363,6 @@ int SafeWrite(int fd, const void *data, int len)
   return(status);
 }
 
-/*******************************************************************/
-/* Function sigAlarm(int code)                                     */
-/*                                                                 */
-/* do nothing, avoid printing of undesired messages and/or         */
-/* other not desirable actions                                     */
-/*                                                                 */
-/*******************************************************************/
-
-static void sigAlarm(int code)
-{
-   timeoutGot = -1;
-}
-
-
 /*******************************************************************/
 /* Function printError()                                           */
 /*    print an error message on stdout                             */
@@ -389,7 +448,6 @@ static int writeCmd(int fd, unsigned char *cmd, int len)
 {
    int w;
    int i = 0;
-   struct  itimerval ti, oti;
 
 # if PTIME
    struct timeval beg, end;
@@ -419,9 +477,12 @@ static int writeCmd(int fd, unsigned char *cmd, int len)
    errno = 0;
    while ( i < len )
    {
-      SET_TIMER(ti,oti,d4WrTimeout);
+      if ( d4Wait(fd, 1, d4WrTimeout) <= 0 )
+      {
+         i = -1;
+         break;
+      }
       w = SafeWrite(fd, cmd+i,len-i);
-      RESET_TIMER(ti,oti);
       if ( w < 0 )
       {
          if ( debugD4 )
@@ -466,13 +527,10 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
    int rd    = 0;
    int total = 0;
    struct timeval beg, end;
-   struct itimerval ti, oti;
    long dt;
    int count = 0;
    int first_read = 1;
    int excess = 0;
-   /* wait a little bit before reading an answer */
-   d4USleep(d4RdTimeout);
 
    /* for error handling in case of timeout */
    timeoutGot = 0;
@@ -487,8 +545,7 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
      printf("+++length: %i\n", len);
    while ( total < len )
    {
-      SET_TIMER(ti,oti, d4RdTimeout);
-      rd = read(fd, buf+total, len-total);
+      rd = d4Read(fd, buf+total, len-total, d4RdTimeout);
       if (debugD4)
 	{
 	  if (first_read)
@@ -504,13 +561,12 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
 	  else
 	    printf("%i ", rd);
 	}
-      RESET_TIMER(ti,oti);
       if ( rd <= 0 )
       {
          gettimeofday(&end, NULL);
          dt  = (end.tv_sec  - beg.tv_sec) * 1000;
          dt += (end.tv_usec - beg.tv_usec) / 1000;
-         if ( dt > d4RdTimeout * 2 )
+         if ( timeoutGot || dt > d4RdTimeout * 2 )
          {
             if ( debugD4 )
                printf("\n+++Timeout 1 at readAnswer() rcv %d bytes",total);
@@ -526,6 +582,8 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
              break;
          }
          errno = 0;
+         /* the device may report readiness without having data */
+         d4USleep(d4RdTimeout);
       } else {
          total += rd;
          if ( total > 3 )
@@ -550,7 +608,6 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
 	      }
          }
       }
-      d4USleep(d4RdTimeout);
    }
    if (debugD4)
      printf("\n");
@@ -561,7 +618,7 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
 	 {
 	   char wastebuf[256];
 	   int bytes = excess > 256 ? 256 : excess;
-	   int status = read(fd, wastebuf, bytes);
+	   int status = d4Read(fd, wastebuf, bytes, d4RdTimeout);
 	   if (status < 0)
 	     break;
 	   else if (status == 0 && retry_count > 2)
@@ -604,11 +661,9 @@ int readAnswer(int fd, unsigned char *buf, int len, int allowExtra)
 static void _flushData(int fd)
 {
    int rd    = 0;
-   struct itimerval ti, oti;
    char buf[1024];
    int len = 1023;
    int count = 200;
-   d4USleep(d4RdTimeout);
 
    /* for error handling in case of timeout */
    timeoutGot = 0;
@@ -619,17 +674,16 @@ static void _flushData(int fd)
 
    if (debugD4)
      printf("+++flush data: length: %i\n", len);
+   /* read until the device has been quiet for d4FlushTimeout ms */
    do
      {
-       d4USleep(d4RdTimeout);
-       SET_TIMER(ti,oti, d4RdTimeout);
-       rd = read(fd, buf, len);
+       rd = d4Read(fd, buf, len, d4FlushTimeout);
        if (debugD4)
 	 printf("+++flush: read: %i %s\n", rd,
 		 rd < 0 && errno != 0 ?strerror(errno) : "");
-       RESET_TIMER(ti,oti);
        count--;
-     } while ( count > 0 && (rd > 0 || (rd < 0 && errno == EAGAIN)));
+     } while ( count > 0 && rd > 0 );
+   timeoutGot = 0;
 }
 
 /*******************************************************************/
@@ -651,7 +705,6 @@ static int _readData(int fd, unsigned char *buf, int len)
    unsigned char  header[6];
    struct timeval beg, end;
    long dt;
-   struct itimerval ti, oti;
 
    /* set errno to 0 in order to get correct informations */
    /* in case of error                                    */
@@ -661,9 +714,7 @@ static int _readData(int fd, unsigned char *buf, int len)
    gettimeofday(&beg, NULL);
    while ( total < 6 )
    {
-      SET_TIMER(ti,oti, d4RdTimeout);
-      rd = read(fd, header+total, 6-total);
-      RESET_TIMER(ti,oti);
+      rd = d4Read(fd, header+total, 6-total, d4RdTimeout);
       if ( rd <= 0 )
       {
          gettimeofday(&end, NULL);
@@ -689,6 +740,8 @@ static int _readData(int fd, unsigned char *buf, int len)
 
    if ( total == 6 )
    {
+      /* the printer may piggyback credit for us on its data */
+      hostCredit[header[0]] += header[4];
       toGet = (header[2] << 8) + header[3] - 6;
       if (debugD4)
 	printf("+++toGet: %i\n", toGet);
@@ -696,9 +749,7 @@ static int _readData(int fd, unsigned char *buf, int len)
       gettimeofday(&beg, NULL);
       while ( total < toGet )
       {
-         SET_TIMER(ti,oti, d4RdTimeout);
-         rd = read(fd, buf+total, toGet-total);
-         RESET_TIMER(ti,oti);
+         rd = d4Read(fd, buf+total, toGet-total, d4RdTimeout);
          if ( rd <= 0 )
          {
             gettimeofday(&end, NULL);
@@ -997,6 +1048,8 @@ int OpenChannel(int fd, unsigned char sockId, int *sndSz, int *rcvSz)
          }
          *sndSz = (buf[10]<<8) + buf[11];
          *rcvSz = (buf[12]<<8) + buf[13];
+         hostCredit[sockId] = (buf[14]<<8) + buf[15];
+         hostPacketSize[sockId] = *sndSz;
          break;
       }
       else
@@ -1042,6 +1095,8 @@ int CloseChannel(int fd, unsigned char socketID)
    buf[sizeof(cmdHeader_t)+0] = socketID;
    buf[sizeof(cmdHeader_t)+1] = socketID;
    buf[sizeof(cmdHeader_t)+2] = 0;
+   hostCredit[socketID] = 0;
+   hostPacketSize[socketID] = 0;
    rd = sendReceiveCmd(fd, buf,10, buf, 10, 0);
    return rd == 10 ? 1 : rd;
 }
@@ -1139,7 +1194,8 @@ int Credit(int fd, unsigned char socketID, int credit)
 /* Return: credit                                                  */
 /*                                                                 */
 /* Remark: CreditRequest() will be called in a loop as long as     */
-/*         the returned credit is 0                                */
+/*         the returned credit is 0.  Credit left over from an     */
+/*         earlier request is returned without asking again.       */
 /*                                                                 */
 /*******************************************************************/
 #define MAX_CREDIT_REQUEST 2
@@ -1149,6 +1205,9 @@ int askForCredit(int fd, unsigned char socketID, int *sndSize, int *rcvSize)
    int count  = 0;
    int retries = 10;
 
+   if ( hostCredit[socketID] > 0 )
+      return hostCredit[socketID];
+
    while (credit == 0 && retries-- >= 0 )
    {
       while((credit=CreditRequest(fd,socketID)) == 0  && count < MAX_CREDIT_REQUEST && retries-- >= 0)
@@ -1176,13 +1235,14 @@ int askForCredit(int fd, unsigned char socketID, int *sndSize, int *rcvSize)
          return 0;
       count++;
    }
+   if ( credit > 0 )
+      hostCredit[socketID] += credit;
    return credit;
 }
 
 /*******************************************************************/
-/* Function writeData()                                            */
-/*        Convenience function                                     */
-/*        write the data to the device                             */
+/* Function writePacket()                                          */
+/*        write one data packet to the device                      */
 /* Input:  int   fd    file handle                                 */
 /*         unsigned char    socketID  the deetination socket       */
 /*         unsigned char   *buf       the datas to be send         */
@@ -1193,12 +1253,11 @@ int askForCredit(int fd, unsigned char socketID, int *sndSize, int *rcvSize)
 /*                                                                 */
 /*******************************************************************/
 
-int writeData(int fd, unsigned char socketID, const unsigned char *buf, int len, int eoj)
+static int writePacket(int fd, unsigned char socketID, const unsigned char *buf, int len, int eoj)
 {
    unsigned char  cmd[6];
    int wr = 0;
    int ret = 0;
-   struct  itimerval ti, oti;
    struct timeval beg;
    static unsigned char *buffer = NULL;
    static int bLen   = 0;
@@ -1229,9 +1288,9 @@ int writeData(int fd, unsigned char socketID, const unsigned char *buf, int len,
    memcpy(buffer + 6, buf, len - 6 );
    while( ret > -1 && wr != len )
    {
-      SET_TIMER(ti,oti,d4WrTimeout);
+      if ( d4Wait(fd, 1, d4WrTimeout) <= 0 )
+         break;
       ret = SafeWrite(fd, buffer+wr, len-wr );
-      RESET_TIMER(ti,oti);
       if ( ret == -1 )
       {
          perror("write: ");
@@ -1269,6 +1328,55 @@ int writeData(int fd, unsigned char socketID, const unsigned char *buf, int len,
 
 }
 
+/*******************************************************************/
+/* Function writeData()                                            */
+/*        Convenience function                                     */
+/*        write the data to the device                             */
+/* Input:  int   fd    file handle                                 */
+/*         unsigned char    socketID  the deetination socket       */
+/*         unsigned char   *buf       the datas to be send         */
+/*         int   len       how many datas are to we send           */
+/*         int   eoj       set out of band flag if eoj set         */
+/*                                                                 */
+/* Return: number of bytes written or -1;                          */
+/*                                                                 */
+/* Remark: data longer than the negotiated packet size is split    */
+/*         into packets, which are sent back to back as long as    */
+/*         there is credit for them.  More credit is only asked    */
+/*         for when it runs out.                                   */
+/*                                                                 */
+/*******************************************************************/
+
+int writeData(int fd, unsigned char socketID, const unsigned char *buf, int len, int eoj)
+{
+   int maxData = hostPacketSize[socketID] - 6;
+   int sent = 0;
+   int wr;
+
+   if ( maxData <= 0 )
+      maxData = len;
+   do
+   {
+      int toSend = len - sent > maxData ? maxData : len - sent;
+      if ( hostPacketSize[socketID] > 0 && hostCredit[socketID] <= 0 )
+      {
+         int sndSz = hostPacketSize[socketID];
+         int rcvSz = sndSz;
+         if ( askForCredit(fd, socketID, &sndSz, &rcvSz) <= 0 )
+            break;
+      }
+      wr = writePacket(fd, socketID, buf + sent, toSend,
+                       eoj && sent + toSend == len);
+      if ( wr < 0 )
+         break;
+      if ( hostCredit[socketID] > 0 )
+         hostCredit[socketID]--;
+      sent += wr;
+   }
+   while ( sent < len );
+   return sent > 0 ? sent : -1;
+}
+
 /*******************************************************************/
 /* Function readData()                                             */
 /*        Convenience function                                     */
@@ -1288,8 +1396,6 @@ int readData(int fd, unsigned char socketID, unsigned char *buf, int len)
    /* give credit */
    if ( Credit(fd, socketID, 1) == 1 )
    {
-      /* wait a little bit */
-      d4USleep(d4RdDataTimeout);
       ret = _readData(fd, buf, len);
       return ret;
    }
@@ -1337,10 +1443,8 @@ int writeAndReadData(int fd, unsigned char socketID,
      {
        if (writeData(fd, socketID, cmd, cmd_len, eoj) <= 0)
 	 return -1;
-       /* wait a little bit */
        do
 	 {
-	   d4USleep(d4RdDataTimeout);
 	   ret = _readData(fd, buf, len);
 	   if (ret < 0)
 	     return ret;
@@ -1372,11 +1476,7 @@ void flushData(int fd, unsigned char socketID)
    if (socketID != (unsigned char) -1)
      {
        if ( Credit(fd, socketID, 1) == 1 )
-	 {
-	   /* wait a little bit */
-	   d4USleep(d4RdDataTimeout);
-	   _flushData(fd);
-	 }
+	 _flushData(fd);
      }
    else
      _flushData(fd);
@@ -1396,12 +1496,10 @@ void flushData(int fd, unsigned char socketID)
 static inline void clearSndBuf(int fd)
 {
    char             buf[256];
-   struct itimerval ti, oti;
 
-   SET_TIMER(ti,oti, d4RdTimeout);
-   while ( read(fd, buf, sizeof(buf) ) > 0 )
-      SET_TIMER(ti,oti, d4RdTimeout);
-   RESET_TIMER(ti,oti);
+   while ( d4Read(fd, buf, sizeof(buf), d4RdTimeout) > 0 )
+      ;
+   timeoutGot = 0;
 }
 #pragma GCC diagnostic pop
 
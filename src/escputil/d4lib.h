@@ -44,6 +44,7 @@ extern void setDebug(int debug);
 
 extern int d4WrTimeout;
 extern int d4RdTimeout;
+extern int d4FlushTimeout;
 extern int ppid;
 
 #if D4_DEBUG
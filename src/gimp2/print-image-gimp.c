@@ -87,6 +87,7 @@ typedef struct
   guchar *alpha_table;
   guchar *tmp;
   gint last_printed_percent;
+  gint rows_read;
   gint initialized;
 } Gimp_Image_t;
 
@@ -119,6 +120,7 @@ static stpui_image_t theImage =
     Image_get_appname,
     Image_conclude,
     NULL,
+    STP_IMAGE_RANDOM_ACCESS
   },
   Image_transpose,
   Image_hflip,
@@ -194,6 +196,7 @@ Image_reset(stp_image_t *image)
   im->w = im->drawable->width;
   im->h = im->drawable->height;
   im->mirror = FALSE;
+  im->rows_read = 0;
 }
 
 static int
@@ -307,12 +310,14 @@ Image_get_row(stp_image_t *image, unsigned char *data, size_t byte_limit,
 	    }
 	}
     }
-  last_printed_percent = row * 100 / im->h;
+  /* Rows may be requested in any order, so count them for progress */
+  last_printed_percent = im->rows_read * 100 / im->h;
   if (last_printed_percent > im->last_printed_percent)
     {
-      gimp_progress_update((double) row / (double) im->h);
+      gimp_progress_update((double) im->rows_read / (double) im->h);
       im->last_printed_percent = last_printed_percent;
     }
+  im->rows_read++;
   return STP_IMAGE_STATUS_OK;
 }
 
@@ -41,6 +41,9 @@ static void Thumbnail_conclude(stp_image_t *image);
 static stp_image_status_t Thumbnail_get_row(stp_image_t *image,
 					    unsigned char *data,
 					    size_t byte_limit, int row);
+static const unsigned char *Thumbnail_map_rows(stp_image_t *image,
+					       size_t byte_limit, int row,
+					       int *count);
 static int Thumbnail_height(stp_image_t *image);
 static int Thumbnail_width(stp_image_t *image);
 static void Thumbnail_reset(stp_image_t *image);
@@ -55,7 +58,10 @@ static stp_image_t theImage =
   Thumbnail_get_row,
   Thumbnail_get_appname,
   Thumbnail_conclude,
-  NULL
+  NULL,
+  STP_IMAGE_RANDOM_ACCESS,
+  NULL,
+  Thumbnail_map_rows
 };
 
 stp_image_t *
@@ -99,6 +105,17 @@ Thumbnail_get_row(stp_image_t *image, unsigned char *data,
   return STP_IMAGE_STATUS_OK;
 }
 
+static const unsigned char *
+Thumbnail_map_rows(stp_image_t *image, size_t byte_limit, int row,
+		   int *count)
+{
+  thumbnail_image_t *im = (thumbnail_image_t *) (image->rep);
+  if (byte_limit != (size_t) (im->w * im->bpp) || row < 0 || row >= im->h)
+    return NULL;
+  *count = im->h - row;
+  return im->data + (row * im->w * im->bpp);
+}
+
 static void
 Thumbnail_init(stp_image_t *image)
 {
@@ -234,7 +234,7 @@ stp_array_create_from_file(const char* file)
 
   stp_xml_init();
 
-  doc = stp_mxmlLoadFile(NULL, fp, STP_MXML_NO_CALLBACK);
+  doc = stp_mxmlLoadFile(NULL, fp, stpi_xml_type_callback);
 
   array = xml_doc_get_array(doc);
 
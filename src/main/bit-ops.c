@@ -33,6 +33,9 @@
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #ifdef __GNUC__
 #define inline __inline__
@@ -41,88 +44,175 @@
 $define NOINLINE
 #endif
 
+/*
+ * Lookup tables for the bit interleaving and deinterleaving primitives
+ * below.  They are filled in once, on first use, by whichever thread
+ * gets there first.
+ *
+ * spread_N[v] has bit k of v moved to bit N * k; folding N planes
+ * together is then a matter of ORing the spread bytes with shifts of
+ * 0 through N - 1.
+ *
+ * unpack_B_N[v] holds in byte j the units (of B bits each) of v that
+ * an N-way unpack deals to output j, earliest unit most significant.
+ * A byte holds at most 8 / B units, so wider unpacks deal consecutive
+ * input bytes to consecutive groups of outputs.
+ *
+ * split_tab[B - 1][N - 1][v] holds in byte k the nonzero units of v whose
+ * ordinal among the nonzero units (counting from the least significant)
+ * is k modulo N; split_count[B - 1][v] is the number of nonzero units.
+ */
+
+#define SPLIT_TABLE_ROWS 4
+
+#ifdef HAVE_PTHREAD_H
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+#else
+static int tables_initialized = 0;
+#endif
+static unsigned short spread_2[256];
+static unsigned spread_3[256];
+static unsigned spread_4[256];
+static unsigned long long spread_8[256];
+static unsigned long long unpack_1_2[256];
+static unsigned long long unpack_1_4[256];
+static unsigned long long unpack_1_8[256];
+static unsigned long long unpack_2_2[256];
+static unsigned long long unpack_2_4[256];
+static unsigned split_tab[2][SPLIT_TABLE_ROWS][256];
+static unsigned char split_count[2][256];
+
+static unsigned long long
+compute_unpack_entry(int v, int bits, int lanes)
+{
+  int units = 8 / bits;
+  int mask = (1 << bits) - 1;
+  unsigned long long answer = 0;
+  int j, u;
+  for (j = 0; j < lanes; j++)
+    {
+      unsigned lane = 0;
+      for (u = j; u < units; u += lanes)
+	lane = (lane << bits) | ((v >> (8 - bits * (u + 1))) & mask);
+      answer |= (unsigned long long) lane << (8 * j);
+    }
+  return answer;
+}
+
+static void
+initialize_tables(void)
+{
+  int v, k, n, bits;
+  for (v = 0; v < 256; v++)
+    {
+      spread_2[v] = 0;
+      spread_3[v] = 0;
+      spread_4[v] = 0;
+      spread_8[v] = 0;
+      for (k = 0; k < 8; k++)
+	if (v & (1 << k))
+	  {
+	    spread_2[v] |= 1 << (2 * k);
+	    spread_3[v] |= 1u << (3 * k);
+	    spread_4[v] |= 1u << (4 * k);
+	    spread_8[v] |= 1ull << (8 * k);
+	  }
+      unpack_1_2[v] = compute_unpack_entry(v, 1, 2);
+      unpack_1_4[v] = compute_unpack_entry(v, 1, 4);
+      unpack_1_8[v] = compute_unpack_entry(v, 1, 8);
+      unpack_2_2[v] = compute_unpack_entry(v, 2, 2);
+      unpack_2_4[v] = compute_unpack_entry(v, 2, 4);
+      for (bits = 1; bits <= 2; bits++)
+	{
+	  int count = 0;
+	  for (n = 0; n < SPLIT_TABLE_ROWS; n++)
+	    split_tab[bits - 1][n][v] = 0;
+	  for (k = 0; k < 8; k += bits)
+	    {
+	      unsigned unit = v & (((1u << bits) - 1) << k);
+	      if (unit)
+		{
+		  for (n = 0; n < SPLIT_TABLE_ROWS; n++)
+		    split_tab[bits - 1][n][v] |= unit << (8 * (count % (n + 1)));
+		  count++;
+		}
+	    }
+	  split_count[bits - 1][v] = count;
+	}
+    }
+}
+
+static inline void
+check_tables(void)
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_once(&tables_once, initialize_tables);
+#else
+  if (!tables_initialized)
+    {
+      initialize_tables();
+      tables_initialized = 1;
+    }
+#endif
+}
+
 void
 stp_fold(const unsigned char *line,
 	 int single_length,
 	 unsigned char *outbuf)
 {
   int i;
-  memset(outbuf, 0, single_length * 2);
+  check_tables();
   for (i = 0; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      if (l0 || l1)
-	{
-	  outbuf[0] =		/* B7 A7 B6 A6 B5 A5 B4 A4 */
-	    ((l0 & (1 << 7)) >> 1) +
-	    ((l0 & (1 << 6)) >> 2) +
-	    ((l0 & (1 << 5)) >> 3) +
-	    ((l0 & (1 << 4)) >> 4) +
-	    ((l1 & (1 << 7)) >> 0) +
-	    ((l1 & (1 << 6)) >> 1) +
-	    ((l1 & (1 << 5)) >> 2) +
-	    ((l1 & (1 << 4)) >> 3);
-	  outbuf[1] =		/* B3 A3 B2 A2 B1 A1 B0 A0 */
-	    ((l0 & (1 << 3)) << 3) +
-	    ((l0 & (1 << 2)) << 2) +
-	    ((l0 & (1 << 1)) << 1) +
-	    ((l0 & (1 << 0)) << 0) +
-	    ((l1 & (1 << 3)) << 4) +
-	    ((l1 & (1 << 2)) << 3) +
-	    ((l1 & (1 << 1)) << 2) +
-	    ((l1 & (1 << 0)) << 1);
-	}
+      /* B7 A7 B6 A6 B5 A5 B4 A4   B3 A3 B2 A2 B1 A1 B0 A0 */
+      unsigned folded =
+	spread_2[line[0]] | (spread_2[line[single_length]] << 1);
+      outbuf[0] = folded >> 8;
+      outbuf[1] = folded;
       line++;
       outbuf += 2;
     }
 }
 
+void
+stp_fold_extent(const unsigned char *line,
+		int single_length,
+		int first,
+		int last,
+		unsigned char *outbuf)
+{
+  int i;
+  check_tables();
+  for (i = first; i <= last; i++)
+    {
+      unsigned folded =
+	spread_2[line[i]] | (spread_2[line[i + single_length]] << 1);
+      outbuf[2 * i] = folded >> 8;
+      outbuf[2 * i + 1] = folded;
+    }
+}
+
 void
 stp_fold_3bit(const unsigned char *line,
                 int single_length,
                 unsigned char *outbuf)
 {
   int i;
-  memset(outbuf, 0, single_length * 3);
+  check_tables();
   for (i = 0; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      unsigned char l2 = line[single_length * 2];
-      if (l0 || l1 || l2)
-	{
-	  outbuf[0] =		/* C7 B7 A7 C6 B6 A6 C5 B5  */
-	    ((l0 & (1 << 7)) >> 2) |
-	    ((l0 & (1 << 6)) >> 4) |
-	    ((l1 & (1 << 7)) >> 1) |
-	    ((l1 & (1 << 6)) >> 3) |
-	    ((l1 & (1 << 5)) >> 5) |
-	    ((l2 & (1 << 7)) << 0) |
-	    ((l2 & (1 << 6)) >> 2) |
-	    ((l2 & (1 << 5)) >> 4);
-	  outbuf[1] =		/* A5 C4 B4 A4 C3 B3 A3 C2 */
-	    ((l0 & (1 << 5)) << 2) |
-	    ((l0 & (1 << 4)) << 0) |
-	    ((l0 & (1 << 3)) >> 2) |
-	    ((l1 & (1 << 4)) << 1) |
-	    ((l1 & (1 << 3)) >> 1) |
-	    ((l2 & (1 << 4)) << 2) |
-	    ((l2 & (1 << 3)) << 0) |
-	    ((l2 & (1 << 2)) >> 2);
-	  outbuf[2] =		/* B2 A2 C1 B1 A1 C0 B0 A0 */
-	    ((l0 & (1 << 2)) << 4) |
-	    ((l0 & (1 << 1)) << 2) |
-	    ((l0 & (1 << 0)) << 0) |
-	    ((l1 & (1 << 2)) << 5) |
-	    ((l1 & (1 << 1)) << 3) |
-	    ((l1 & (1 << 0)) << 1) |
-	    ((l2 & (1 << 1)) << 4) |
-	    ((l2 & (1 << 0)) << 2);
-	}
-    line++;
-    outbuf += 3;
-  }
+      /* C7 B7 A7 C6 B6 A6 C5 B5   A5 C4 ... A3 C2   B2 A2 ... B0 A0 */
+      unsigned folded =
+	spread_3[line[0]] |
+	(spread_3[line[single_length]] << 1) |
+	(spread_3[line[single_length * 2]] << 2);
+      outbuf[0] = folded >> 16;
+      outbuf[1] = folded >> 8;
+      outbuf[2] = folded;
+      line++;
+      outbuf += 3;
+    }
 }
 
 void
@@ -230,55 +320,19 @@ stp_fold_4bit(const unsigned char *line,
                 unsigned char *outbuf)
 {
   int i;
-  memset(outbuf, 0, single_length * 4);
+  check_tables();
   for (i = 0; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      unsigned char l2 = line[single_length*2];
-      unsigned char l3 = line[single_length*3];
-      if (l0 || l1 || l2 || l3)
-	{
-	  outbuf[0] =		/* D7 C7 B7 A7 D6 C6 B6 A6 */
-            ((l3 & (1 << 7)) >> 0)|
-            ((l2 & (1 << 7)) >> 1)|
-            ((l1 & (1 << 7)) >> 2)|
-            ((l0 & (1 << 7)) >> 3)|
-            ((l3 & (1 << 6)) >> 3)|
-            ((l2 & (1 << 6)) >> 4)|
-            ((l1 & (1 << 6)) >> 5)|
-            ((l0 & (1 << 6)) >> 6);
-
-	  outbuf[1] =		/* D5 C5 B5 A5 D4 C4 B4 A4 */
-            ((l3 & (1 << 5)) << 2)|
-            ((l2 & (1 << 5)) << 1)|
-            ((l1 & (1 << 5)) << 0)|
-            ((l0 & (1 << 5)) >> 1)|
-            ((l3 & (1 << 4)) >> 1)|
-            ((l2 & (1 << 4)) >> 2)|
-            ((l1 & (1 << 4)) >> 3)|
-            ((l0 & (1 << 4)) >> 4);
-
-	  outbuf[2] =		/* D3 C3 B3 A3 D2 C2 B2 A2 */
-            ((l3 & (1 << 3)) << 4)|
-            ((l2 & (1 << 3)) << 3)|
-            ((l1 & (1 << 3)) << 2)|
-            ((l0 & (1 << 3)) << 1)|
-            ((l3 & (1 << 2)) << 1)|
-            ((l2 & (1 << 2)) << 0)|
-            ((l1 & (1 << 2)) >> 1)|
-            ((l0 & (1 << 2)) >> 2);
-
-	  outbuf[3] =		/* D1 C1 B1 A1 D0 C0 B0 A0 */
-            ((l3 & (1 << 1)) << 6)|
-            ((l2 & (1 << 1)) << 5)|
-            ((l1 & (1 << 1)) << 4)|
-            ((l0 & (1 << 1)) << 3)|
-            ((l3 & (1 << 0)) << 3)|
-            ((l2 & (1 << 0)) << 2)|
-            ((l1 & (1 << 0)) << 1)|
-            ((l0 & (1 << 0)) << 0);
-	}
+      /* D7 C7 B7 A7 D6 C6 B6 A6 ... D1 C1 B1 A1 D0 C0 B0 A0 */
+      unsigned folded =
+	spread_4[line[0]] |
+	(spread_4[line[single_length]] << 1) |
+	(spread_4[line[single_length * 2]] << 2) |
+	(spread_4[line[single_length * 3]] << 3);
+      outbuf[0] = folded >> 24;
+      outbuf[1] = folded >> 16;
+      outbuf[2] = folded >> 8;
+      outbuf[3] = folded;
       line++;
       outbuf += 4;
     }
@@ -289,99 +343,16 @@ stp_fold_8bit(const unsigned char *line,
                 int single_length,
                 unsigned char *outbuf)
 {
-  int i;
-  memset(outbuf, 0, single_length * 8);
+  int i, j;
+  check_tables();
   for (i = 0; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      unsigned char l2 = line[single_length*2];
-      unsigned char l3 = line[single_length*3];
-      unsigned char l4 = line[single_length*4];
-      unsigned char l5 = line[single_length*5];
-      unsigned char l6 = line[single_length*6];
-      unsigned char l7 = line[single_length*7];
-      if (l0 || l1 || l2 || l3 || l4 || l5 || l6 || l7)
-	{
-	  outbuf[0] =		/* H7 G7 F7 E7 D7 C7 B7 A7 */
-            ((l7 & (1 << 7)) >> 0)|
-            ((l6 & (1 << 7)) >> 1)|
-            ((l5 & (1 << 7)) >> 2)|
-            ((l4 & (1 << 7)) >> 3)|
-            ((l3 & (1 << 7)) >> 4)|
-            ((l2 & (1 << 7)) >> 5)|
-            ((l1 & (1 << 7)) >> 6)|
-            ((l0 & (1 << 7)) >> 7);
-
-	  outbuf[1] =		/* H6 G6 F6 E6 D6 C6 B6 A6 */
-            ((l7 & (1 << 6)) << 1)|
-            ((l6 & (1 << 6)) >> 0)|
-            ((l5 & (1 << 6)) >> 1)|
-            ((l4 & (1 << 6)) >> 2)|
-            ((l3 & (1 << 6)) >> 3)|
-            ((l2 & (1 << 6)) >> 4)|
-            ((l1 & (1 << 6)) >> 5)|
-            ((l0 & (1 << 6)) >> 6);
-
-	  outbuf[2] =		/* H5 G5 F5 E5 D5 C5 B5 A5 */
-            ((l7 & (1 << 5)) << 2)|
-            ((l6 & (1 << 5)) << 1)|
-            ((l5 & (1 << 5)) >> 0)|
-            ((l4 & (1 << 5)) >> 1)|
-            ((l3 & (1 << 5)) >> 2)|
-            ((l2 & (1 << 5)) >> 3)|
-            ((l1 & (1 << 5)) >> 4)|
-            ((l0 & (1 << 5)) >> 5);
-
-	  outbuf[3] =		/* H4 G4 F4 E4 D4 C4 B4 A4 */
-            ((l7 & (1 << 4)) << 3)|
-            ((l6 & (1 << 4)) << 2)|
-            ((l5 & (1 << 4)) << 1)|
-            ((l4 & (1 << 4)) >> 0)|
-            ((l3 & (1 << 4)) >> 1)|
-            ((l2 & (1 << 4)) >> 2)|
-            ((l1 & (1 << 4)) >> 3)|
-            ((l0 & (1 << 4)) >> 4);
-	  outbuf[4] =		/* H3 G3 F3 E3 D3 C3 B3 A3 */
-            ((l7 & (1 << 3)) << 4)|
-            ((l6 & (1 << 3)) << 3)|
-            ((l5 & (1 << 3)) << 2)|
-            ((l4 & (1 << 3)) << 1)|
-            ((l3 & (1 << 3)) >> 0)|
-            ((l2 & (1 << 3)) >> 1)|
-            ((l1 & (1 << 3)) >> 2)|
-            ((l0 & (1 << 3)) >> 3);
-
-	  outbuf[5] =		/* H2 G2 F2 E2 D2 C2 B2 A2 */
-            ((l7 & (1 << 2)) << 5)|
-            ((l6 & (1 << 2)) << 4)|
-            ((l5 & (1 << 2)) << 3)|
-            ((l4 & (1 << 2)) << 2)|
-            ((l3 & (1 << 2)) << 1)|
-            ((l2 & (1 << 2)) >> 0)|
-            ((l1 & (1 << 2)) >> 1)|
-            ((l0 & (1 << 2)) >> 2);
-
-	  outbuf[6] =		/* H1 G1 F1 E1 D1 C1 B1 A1 */
-            ((l7 & (1 << 1)) << 6)|
-            ((l6 & (1 << 1)) << 5)|
-            ((l5 & (1 << 1)) << 4)|
-            ((l4 & (1 << 1)) << 3)|
-            ((l3 & (1 << 1)) << 2)|
-            ((l2 & (1 << 1)) << 1)|
-            ((l1 & (1 << 1)) >> 0)|
-            ((l0 & (1 << 1)) >> 1);
-
-	  outbuf[7] =		/* H0 G0 F0 E0 D0 C0 B0 A0 */
-            ((l7 & (1 << 0)) << 7)|
-            ((l6 & (1 << 0)) << 6)|
-            ((l5 & (1 << 0)) << 5)|
-            ((l4 & (1 << 0)) << 4)|
-            ((l3 & (1 << 0)) << 3)|
-            ((l2 & (1 << 0)) << 2)|
-            ((l1 & (1 << 0)) << 1)|
-            ((l0 & (1 << 0)) >> 0);
-	}
+      /* H7 G7 F7 E7 D7 C7 B7 A7 ... H0 G0 F0 E0 D0 C0 B0 A0 */
+      unsigned long long folded = 0;
+      for (j = 0; j < 8; j++)
+	folded |= spread_8[line[single_length * j]] << j;
+      for (j = 0; j < 8; j++)
+	outbuf[j] = folded >> (8 * (7 - j));
       line++;
       outbuf += 8;
     }
@@ -416,7 +387,38 @@ stp_split(int length,
   for (i = 1; i < n; i++)
     memset(outs[i * increment], 0, limit);
 
-  if (bits == 1)
+  if (n >= 1 && n <= SPLIT_TABLE_ROWS)
+    {
+      /*
+       * Deal the nonzero units of each byte round robin a whole byte
+       * at a time.  Row is an index into the n rows here, not an
+       * offset into outs.
+       */
+      const unsigned *tab;
+      const unsigned char *count;
+      check_tables();
+      tab = split_tab[bits == 1 ? 0 : 1][n - 1];
+      count = split_count[bits == 1 ? 0 : 1];
+      for (i = 0; i < limit; i++)
+	{
+	  unsigned char inbyte = in[i];
+	  unsigned dealt;
+	  int r, k;
+	  outs[0][i] = 0;
+	  if (inbyte == 0)
+	    continue;
+	  dealt = tab[inbyte];
+	  for (k = 0, r = row; k < n; k++, dealt >>= 8)
+	    {
+	      if (dealt & 0xff)
+		outs[r * increment][i] |= dealt & 0xff;
+	      if (++r == n)
+		r = 0;
+	    }
+	  row = (row + count[inbyte]) % n;
+	}
+    }
+  else if (bits == 1)
     {
       for (i = 0; i < limit; i++)
 	{
@@ -483,59 +485,58 @@ stp_split_4(int length,
 }
 
 
-static void NOINLINE
-stpi_unpack_2_1(int length,
-		const unsigned char *in,
-		unsigned char **outs)
+/*
+ * Deal the units of the input round robin to the outputs.  Each step
+ * consumes one input byte for each group of lanes outputs; every output
+ * receives 8 / lanes bits per step and is written out after lanes steps.
+ * A partial final output byte is left justified.
+ */
+static inline void
+unpack_lanes(int steps,
+	     int groups,
+	     int lanes,
+	     const unsigned long long *table,
+	     const unsigned char *in,
+	     unsigned char **outs)
 {
-  unsigned char	tempin, bit, temp0, temp1;
+  unsigned long long acc[4] = { 0, 0, 0, 0 };
+  int shift = 8 / lanes;
+  int count = 0;
+  int g, j;
 
-  if (length <= 0)
+  if (steps <= 0)
     return;
-  for (bit = 128, temp0 = 0, temp1 = 0;
-       length > 0;
-       length --)
+  for (; steps > 0; steps--)
     {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp0 |= bit;
-      if (tempin & 64)
-        temp1 |= bit;
-      bit >>= 1;
-      if (tempin & 32)
-        temp0 |= bit;
-      if (tempin & 16)
-        temp1 |= bit;
-      bit >>= 1;
-      if (tempin & 8)
-        temp0 |= bit;
-      if (tempin & 4)
-        temp1 |= bit;
-      bit >>= 1;
-      if (tempin & 2)
-        temp0 |= bit;
-      if (tempin & 1)
-        temp1 |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-      {
-        bit     = 128;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
+      for (g = 0; g < groups; g++)
+	acc[g] = (acc[g] << shift) | table[*in++];
+      if (++count == lanes)
+	{
+	  for (g = 0; g < groups; g++)
+	    {
+	      for (j = 0; j < lanes; j++)
+		*outs[g * lanes + j]++ = acc[g] >> (8 * j);
+	      acc[g] = 0;
+	    }
+	  count = 0;
+	}
+    }
 
-	temp0   = 0;
-	temp1   = 0;
+  if (count)
+    for (g = 0; g < groups; g++)
+      {
+	acc[g] <<= shift * (lanes - count);
+	for (j = 0; j < lanes; j++)
+	  *outs[g * lanes + j]++ = acc[g] >> (8 * j);
       }
-    }
+}
 
-  if (bit < 128)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-    }
+static void NOINLINE
+stpi_unpack_2_1(int length,
+		const unsigned char *in,
+		unsigned char **outs)
+{
+  unpack_lanes(length, 1, 2, unpack_1_2, in, outs);
 }
 
 static void NOINLINE
@@ -543,25 +544,7 @@ stpi_unpack_2_2(int length,
 		const unsigned char *in,
 		unsigned char **outs)
 {
-  if (length <= 0)
-    return;
-
-  for (;length;length --)
-    {
-      unsigned char ti0, ti1;
-      ti0 = in[0];
-      ti1 = in[1];
-
-      *outs[0]++  = (ti0 & 0xc0) << 0
-	| (ti0 & 0x0c) << 2
-	| (ti1 & 0xc0) >> 4
-	| (ti1 & 0x0c) >> 2;
-      *outs[1]++  = (ti0 & 0x30) << 2
-	| (ti0 & 0x03) << 4
-	| (ti1 & 0x30) >> 2
-	| (ti1 & 0x03) >> 0;
-      in += 2;
-    }
+  unpack_lanes(length * 2, 1, 2, unpack_2_2, in, outs);
 }
 
 static void NOINLINE
@@ -569,58 +552,7 @@ stpi_unpack_4_1(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin, bit, temp0, temp1, temp2, temp3;
-
-  if (length <= 0)
-    return;
-  for (bit = 128, temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
-       length > 0;
-       length --)
-    {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp0 |= bit;
-      if (tempin & 64)
-        temp1 |= bit;
-      if (tempin & 32)
-        temp2 |= bit;
-      if (tempin & 16)
-        temp3 |= bit;
-      bit >>= 1;
-      if (tempin & 8)
-        temp0 |= bit;
-      if (tempin & 4)
-        temp1 |= bit;
-      if (tempin & 2)
-        temp2 |= bit;
-      if (tempin & 1)
-        temp3 |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-      {
-        bit     = 128;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-      }
-    }
-
-  if (bit < 128)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-    }
+  unpack_lanes(length, 1, 4, unpack_1_4, in, outs);
 }
 
 static void NOINLINE
@@ -628,59 +560,7 @@ stpi_unpack_4_2(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin,
-		shift,
-		temp0,
-		temp1,
-		temp2,
-		temp3;
-
-  length *= 2;
-
-  for (shift = 0, temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
-       length > 0;
-       length --)
-    {
-     /*
-      * Note - we can't use (tempin & N) >> (shift - M) since negative
-      * right-shifts are not always implemented.
-      */
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp0 |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp1 |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp2 |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp3 |= ((tempin & 3) << 6) >> shift;
-
-      if (shift < 6)
-        shift += 2;
-      else
-      {
-        shift   = 0;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-      }
-    }
-
-  if (shift)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-    }
+  unpack_lanes(length * 2, 1, 4, unpack_2_4, in, outs);
 }
 
 static void NOINLINE
@@ -688,72 +568,7 @@ stpi_unpack_8_1(int length,
 		const unsigned char *in,
 		unsigned char **outs)
 {
-  unsigned char	tempin, bit, temp0, temp1, temp2, temp3, temp4, temp5, temp6,
-    temp7;
-
-  if (length <= 0)
-    return;
-
-  for (bit = 128, temp0 = 0, temp1 = 0, temp2 = 0,
-       temp3 = 0, temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
-       length > 0;
-       length --)
-    {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp0 |= bit;
-      if (tempin & 64)
-        temp1 |= bit;
-      if (tempin & 32)
-        temp2 |= bit;
-      if (tempin & 16)
-        temp3 |= bit;
-      if (tempin & 8)
-        temp4 |= bit;
-      if (tempin & 4)
-        temp5 |= bit;
-      if (tempin & 2)
-        temp6 |= bit;
-      if (tempin & 1)
-        temp7 |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-      {
-        bit     = 128;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-	*outs[4]++ = temp4;
-	*outs[5]++ = temp5;
-	*outs[6]++ = temp6;
-	*outs[7]++ = temp7;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-	temp4   = 0;
-	temp5   = 0;
-	temp6   = 0;
-	temp7   = 0;
-      }
-    }
-
-  if (bit < 128)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-      *outs[4]++ = temp4;
-      *outs[5]++ = temp5;
-      *outs[6]++ = temp6;
-      *outs[7]++ = temp7;
-    }
+  unpack_lanes(length, 1, 8, unpack_1_8, in, outs);
 }
 
 static void NOINLINE
@@ -761,86 +576,7 @@ stpi_unpack_8_2(int length,
 		const unsigned char *in,
 		unsigned char **outs)
 {
-  unsigned char	tempin,
-		shift,
-		temp0,
-		temp1,
-		temp2,
-		temp3,
-		temp4,
-		temp5,
-		temp6,
-		temp7;
-
-
-  for (shift = 0, temp0 = 0, temp1 = 0,
-       temp2 = 0, temp3 = 0, temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
-       length > 0;
-       length --)
-    {
-     /*
-      * Note - we can't use (tempin & N) >> (shift - M) since negative
-      * right-shifts are not always implemented.
-      */
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp0 |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp1 |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp2 |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp3 |= ((tempin & 3) << 6) >> shift;
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp4 |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp5 |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp6 |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp7 |= ((tempin & 3) << 6) >> shift;
-
-      if (shift < 6)
-        shift += 2;
-      else
-      {
-        shift   = 0;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-	*outs[4]++ = temp4;
-	*outs[5]++ = temp5;
-	*outs[6]++ = temp6;
-	*outs[7]++ = temp7;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-	temp4   = 0;
-	temp5   = 0;
-	temp6   = 0;
-	temp7   = 0;
-      }
-    }
-
-  if (shift)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-      *outs[4]++ = temp4;
-      *outs[5]++ = temp5;
-      *outs[6]++ = temp6;
-      *outs[7]++ = temp7;
-    }
+  unpack_lanes(length, 2, 4, unpack_2_4, in, outs);
 }
 
 static void NOINLINE
@@ -848,70 +584,7 @@ stpi_unpack_16_1(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin, bit;
-  unsigned char temp[16];
-  int j;
-
-  if (length <= 0)
-    return;
-
-  memset(temp, 0, 16);
-
-  for (bit = 128; length > 0; length--)
-    {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp[0] |= bit;
-      if (tempin & 64)
-        temp[1] |= bit;
-      if (tempin & 32)
-        temp[2] |= bit;
-      if (tempin & 16)
-        temp[3] |= bit;
-      if (tempin & 8)
-        temp[4] |= bit;
-      if (tempin & 4)
-        temp[5] |= bit;
-      if (tempin & 2)
-        temp[6] |= bit;
-      if (tempin & 1)
-        temp[7] |= bit;
-
-      tempin = *in++;
-
-      if (tempin & 128)
-	temp[8] |= bit;
-      if (tempin & 64)
-	temp[9] |= bit;
-      if (tempin & 32)
-	temp[10] |= bit;
-      if (tempin & 16)
-	temp[11] |= bit;
-      if (tempin & 8)
-	temp[12] |= bit;
-      if (tempin & 4)
-	temp[13] |= bit;
-      if (tempin & 2)
-	temp[14] |= bit;
-      if (tempin & 1)
-	temp[15] |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-	{
-	  bit     = 128;
-	  for (j = 0; j < 16; j++)
-	    *outs[j]++ = temp[j];
-
-	  memset(temp, 0, 16);
-	}
-    }
-
-  if (bit < 128)
-    for (j = 0; j < 16; j++)
-      *outs[j]++ = temp[j];
+  unpack_lanes(length, 2, 8, unpack_1_8, in, outs);
 }
 
 static void NOINLINE
@@ -919,84 +592,9 @@ stpi_unpack_16_2(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin, shift;
-  unsigned char temp[16];
-  int j;
-
-  if (length <= 0)
-    return;
-
-  memset(temp, 0, 16);
-
-  for (shift = 0; length > 0; length--)
-    {
-      /*
-       * Note - we can't use (tempin & N) >> (shift - M) since negative
-       * right-shifts are not always implemented.
-       */
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp[0] |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp[1] |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp[2] |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp[3] |= ((tempin & 3) << 6) >> shift;
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp[4] |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp[5] |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp[6] |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp[7] |= ((tempin & 3) << 6) >> shift;
-
-      if (length-- > 0)
-	{
-	  tempin = *in++;
-
-	  if (tempin & 192)
-	    temp[8] |= (tempin & 192) >> shift;
-	  if (tempin & 48)
-	    temp[9] |= ((tempin & 48) << 2) >> shift;
-	  if (tempin & 12)
-	    temp[10] |= ((tempin & 12) << 4) >> shift;
-	  if (tempin & 3)
-	    temp[11] |= ((tempin & 3) << 6) >> shift;
-
-	  tempin = *in++;
-
-	  if (tempin & 192)
-	    temp[12] |= (tempin & 192) >> shift;
-	  if (tempin & 48)
-	    temp[13] |= ((tempin & 48) << 2) >> shift;
-	  if (tempin & 12)
-	    temp[14] |= ((tempin & 12) << 4) >> shift;
-	  if (tempin & 3)
-	    temp[15] |= ((tempin & 3) << 6) >> shift;
-	}
-
-      if (shift < 6)
-        shift += 2;
-      else
-	{
-	  shift   = 0;
-	  for (j = 0; j < 16; j++)
-	    *outs[j]++ = temp[j];
-
-	  memset(temp, 0, 16);
-	}
-    }
-
-  if (shift)
-    for (j = 0; j < 16; j++)
-      *outs[j]++ = temp[j];
+  /* Historically each step here reads four bytes but counts as two. */
+  if (length > 0)
+    unpack_lanes((length + 1) / 2, 4, 4, unpack_2_4, in, outs);
 }
 
 void
@@ -1006,11 +604,11 @@ stp_unpack(int length,
 	   const unsigned char *in,
 	   unsigned char **outs)
 {
-  unsigned char **touts;
+  unsigned char *touts[16];
   int i;
-  if (n < 2)
+  if (n < 2 || n > 16)
     return;
-  touts = stp_malloc(sizeof(unsigned char *) * n);
+  check_tables();
   for (i = 0; i < n; i++)
     touts[i] = outs[i];
   if (bits == 1)
@@ -1045,7 +643,95 @@ stp_unpack(int length,
 	stpi_unpack_16_2(length, in, touts);
 	break;
       }
-  stp_free(touts);
+}
+
+/*
+ * How stp_unpack walks its input: the number of steps, the bytes read
+ * at each step (groups), and the steps that make up one output byte
+ * (lanes).  This must match the stpi_unpack_* functions above.
+ */
+static const unsigned long long *
+unpack_geometry(int length, int bits, int n,
+		int *steps, int *groups, int *lanes)
+{
+  if (bits == 1)
+    switch (n)
+      {
+      case 2:
+	*steps = length, *groups = 1, *lanes = 2;
+	return unpack_1_2;
+      case 4:
+	*steps = length, *groups = 1, *lanes = 4;
+	return unpack_1_4;
+      case 8:
+	*steps = length, *groups = 1, *lanes = 8;
+	return unpack_1_8;
+      case 16:
+	*steps = length, *groups = 2, *lanes = 8;
+	return unpack_1_8;
+      }
+  else
+    switch (n)
+      {
+      case 2:
+	*steps = length * 2, *groups = 1, *lanes = 2;
+	return unpack_2_2;
+      case 4:
+	*steps = length * 2, *groups = 1, *lanes = 4;
+	return unpack_2_4;
+      case 8:
+	*steps = length, *groups = 2, *lanes = 4;
+	return unpack_2_4;
+      case 16:
+	*steps = (length + 1) / 2, *groups = 4, *lanes = 4;
+	return unpack_2_4;
+      }
+  return NULL;
+}
+
+int
+stp_unpack_extent(int length,
+		  int bits,
+		  int n,
+		  const unsigned char *in,
+		  unsigned char **outs,
+		  int first,
+		  int last,
+		  int *out_first,
+		  int *out_last)
+{
+  const unsigned long long *table;
+  unsigned char *touts[16];
+  int steps, groups, lanes;
+  int start, end;
+  int i;
+
+  check_tables();
+  table = unpack_geometry(length, bits, n, &steps, &groups, &lanes);
+  if (!table || first > last)
+    return 0;
+  /*
+   * Start and end on output byte boundaries, so the bytes written are
+   * exactly those the whole row would have produced there.  Some cases
+   * read whole groups past the end of the input; those bytes are always
+   * included, as they may not be zero.
+   */
+  if (steps * groups > length * bits)
+    last = steps * groups - 1;
+  start = first / groups;
+  start -= start % lanes;
+  end = last / groups + 1;
+  end += (lanes - end % lanes) % lanes;
+  if (end > steps)
+    end = steps;
+  if (start >= end)
+    return 0;
+  for (i = 0; i < n; i++)
+    touts[i] = outs[i] + start / lanes;
+  unpack_lanes(end - start, groups, lanes, table, in + start * groups, touts);
+  *out_first = start / lanes;
+  *out_last = (end + lanes - 1) / lanes - 1;
+  return 1;
 }
 
 void
@@ -1144,14 +830,26 @@ stp_unpack_16(int length,
   stp_unpack(length, bits, 16, in, outs);
 }
 
+/*
+ * Blank runs are skipped a word at a time before looking at single
+ * bytes.
+ */
 static void NOINLINE
 find_first_and_last(const unsigned char *line, int length,
 		    int *first, int *last)
 {
+  unsigned long long word;
   int found_first = 0;
   int f = 0;
   int l = 0;
-  for (f = 0; f < length; f++)
+  while (f + (int) sizeof(word) <= length)
+    {
+      memcpy(&word, line + f, sizeof(word));
+      if (word)
+	break;
+      f += sizeof(word);
+    }
+  for (; f < length; f++)
     {
       if (line[f])
 	{
@@ -1165,13 +863,28 @@ find_first_and_last(const unsigned char *line, int length,
       *last = 0;
       return;
     }
-  for (l = length - 1; l >= f; l--)
+  l = length;
+  while (l - (int) sizeof(word) > f)
+    {
+      memcpy(&word, line + l - sizeof(word), sizeof(word));
+      if (word)
+	break;
+      l -= sizeof(word);
+    }
+  for (l = l - 1; l >= f; l--)
     if (line[l])
       break;
   ;
   *last = l;
 }
 
+int
+stp_find_extent(const unsigned char *line, int length, int *first, int *last)
+{
+  find_first_and_last(line, length, first, last);
+  return *first < length;
+}
+
 int
 stp_pack_uncompressed(stp_vars_t *v,
 		      const unsigned char *line,
@@ -1287,3 +1000,52 @@ stp_pack_tiff(stp_vars_t *v,
   else
     return 1;
 }
+
+static unsigned char *
+pack_tiff_blank(unsigned char *comp_ptr, int count)
+{
+  while (count > 0)
+    {
+      int tcount = count > 128 ? 128 : count;
+      comp_ptr[0] = 1 - tcount;
+      comp_ptr[1] = 0;
+      comp_ptr += 2;
+      count -= tcount;
+    }
+  return comp_ptr;
+}
+
+/*
+ * A run of three or more zero bytes always ends one packbits run and
+ * starts another, so when the margins on either side of the extent are
+ * at least that wide they can be written directly, and only the extent
+ * (and three bytes of the right margin, to end it the same way) needs
+ * to be compressed.  The result is the same as stp_pack_tiff's.
+ */
+int
+stp_pack_tiff_extent(const unsigned char *line,
+		     int length,
+		     int first,
+		     int last,
+		     unsigned char *comp_buf,
+		     unsigned char **comp_ptr)
+{
+  unsigned char *comp_pti = comp_buf;
+  int start = 0;
+  int end = length;
+  if (first > last)
+    return stp_pack_tiff(NULL, line, length, comp_buf, comp_ptr, NULL, NULL);
+  if (first >= 3)
+    {
+      comp_pti = pack_tiff_blank(comp_pti, first);
+      start = first;
+    }
+  if (length - 1 - last >= 3)
+    end = last + 4;
+  stp_pack_tiff(NULL, line + start, end - start, comp_pti, &comp_pti,
+		NULL, NULL);
+  if (end < length)
+    comp_pti = pack_tiff_blank(comp_pti - 2, length - 1 - last);
+  *comp_ptr = comp_pti;
+  return 1;
+}
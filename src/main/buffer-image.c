@@ -22,14 +22,169 @@
 #endif
 #include <gutenprint/gutenprint.h>
 #include "gutenprint-internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/*
+ * Pages larger than this (in megabytes, overridden by the environment
+ * variable STP_IMAGE_BUFFER_LIMIT; 0 means no limit) are buffered in a
+ * temporary file mapped into memory rather than in anonymous memory,
+ * so that a large format or high resolution duplex page doesn't have
+ * to fit in RAM plus swap.
+ */
+#define DEFAULT_BUFFER_LIMIT 512
 
 struct buffered_image_priv
 {
 	stp_image_t* image;
-	unsigned char** buf;
+	unsigned char* buf;	/* height rows of row_bytes each */
+	size_t row_bytes;
+	size_t buf_size;
+	FILE* spill;		/* backing file if buf is mapped */
 	unsigned int flags;
 };
 
+/*
+ * Reverse the order of the pixels in a row.  The pixel size is a
+ * compile time constant in all the common cases, so each pixel is moved
+ * with a single load and store rather than a call to memcpy.
+ */
+#define FLIP_FUNCS(bpp)							\
+static void								\
+flip_copy_##bpp(unsigned char *dst, const unsigned char *src,		\
+		size_t pixels)						\
+{									\
+	const unsigned char *s = src + (pixels - 1) * bpp;		\
+	size_t i;							\
+	for (i = 0; i < pixels; i++, dst += bpp, s -= bpp)		\
+		memcpy(dst, s, bpp);					\
+}									\
+									\
+static void								\
+flip_in_place_##bpp(unsigned char *row, size_t pixels)			\
+{									\
+	unsigned char *l = row;						\
+	unsigned char *r = row + (pixels - 1) * bpp;			\
+	unsigned char tmp[bpp];						\
+	for (; l < r; l += bpp, r -= bpp){				\
+		memcpy(tmp, l, bpp);					\
+		memcpy(l, r, bpp);					\
+		memcpy(r, tmp, bpp);					\
+	}								\
+}
+
+FLIP_FUNCS(1)
+FLIP_FUNCS(2)
+FLIP_FUNCS(3)
+FLIP_FUNCS(4)
+FLIP_FUNCS(6)
+FLIP_FUNCS(8)
+
+static void
+flip_row(unsigned char *dst, const unsigned char *src, size_t pixels,
+	 int bytes_per_pixel)
+{
+	size_t i;
+	if(pixels == 0)
+		return;
+	if(dst == src){
+		switch(bytes_per_pixel){
+		case 1: flip_in_place_1(dst, pixels); return;
+		case 2: flip_in_place_2(dst, pixels); return;
+		case 3: flip_in_place_3(dst, pixels); return;
+		case 4: flip_in_place_4(dst, pixels); return;
+		case 6: flip_in_place_6(dst, pixels); return;
+		case 8: flip_in_place_8(dst, pixels); return;
+		default:
+			for(i = 0; i < pixels / 2; i++){
+				unsigned char *l = dst + i * bytes_per_pixel;
+				unsigned char *r = dst + (pixels - i - 1) * bytes_per_pixel;
+				int j;
+				for(j = 0; j < bytes_per_pixel; j++){
+					unsigned char tmp = l[j];
+					l[j] = r[j];
+					r[j] = tmp;
+				}
+			}
+			return;
+		}
+	}
+	switch(bytes_per_pixel){
+	case 1: flip_copy_1(dst, src, pixels); return;
+	case 2: flip_copy_2(dst, src, pixels); return;
+	case 3: flip_copy_3(dst, src, pixels); return;
+	case 4: flip_copy_4(dst, src, pixels); return;
+	case 6: flip_copy_6(dst, src, pixels); return;
+	case 8: flip_copy_8(dst, src, pixels); return;
+	default:
+		src += (pixels - 1) * bytes_per_pixel;
+		for(i = 0; i < pixels; i++){
+			memcpy(dst, src, bytes_per_pixel);
+			dst += bytes_per_pixel;
+			src -= bytes_per_pixel;
+		}
+		return;
+	}
+}
+
+static size_t
+buffer_limit(void)
+{
+	const char *limit = getenv("STP_IMAGE_BUFFER_LIMIT");
+	if(limit)
+		return (size_t) strtoul(limit, NULL, 10) << 20;
+	return (size_t) DEFAULT_BUFFER_LIMIT << 20;
+}
+
+static void
+allocate_buffer(struct buffered_image_priv *priv)
+{
+	size_t limit = buffer_limit();
+#ifdef HAVE_SYS_MMAN_H
+	if(limit > 0 && priv->buf_size > limit){
+		priv->spill = tmpfile();
+		if(priv->spill){
+			int fd = fileno(priv->spill);
+			void *buf = MAP_FAILED;
+			if(ftruncate(fd, priv->buf_size) == 0)
+				buf = mmap(NULL, priv->buf_size,
+					   PROT_READ | PROT_WRITE, MAP_SHARED,
+					   fd, 0);
+			if(buf != MAP_FAILED){
+				priv->buf = buf;
+				return;
+			}
+			fclose(priv->spill);
+			priv->spill = NULL;
+		}
+	}
+#endif
+	priv->buf = stp_malloc(priv->buf_size);
+}
+
+static void
+free_buffer(struct buffered_image_priv *priv)
+{
+	if(!priv->buf)
+		return;
+#ifdef HAVE_SYS_MMAN_H
+	if(priv->spill){
+		munmap(priv->buf, priv->buf_size);
+		fclose(priv->spill);
+		priv->spill = NULL;
+		priv->buf = NULL;
+		return;
+	}
+#endif
+	stp_free(priv->buf);
+	priv->buf = NULL;
+}
+
 static void
 buffered_image_init(stp_image_t* image)
 {
@@ -69,37 +224,43 @@ buffered_image_get_row(stp_image_t* image,unsigned char *data, size_t byte_limit
 	int height = buffered_image_height(image);
 	/* FIXME this will break with padding bytes */
 	int bytes_per_pixel = byte_limit / width;
-	int inc = bytes_per_pixel;
-	unsigned char* src;
 	int i;
+
+	if(priv->flags & BUFFER_FLAG_FLIP_Y)
+		row = height - row - 1;
+
+	/*
+	 * If the rows can be read in the order they're wanted, there's
+	 * no need to keep the page.
+	 */
+	if(!(priv->flags & BUFFER_FLAG_FLIP_Y) ||
+	   (priv->image->flags & STP_IMAGE_RANDOM_ACCESS)){
+		if(STP_IMAGE_STATUS_OK != priv->image->get_row(priv->image,data,byte_limit,row))
+			return STP_IMAGE_STATUS_ABORT;
+		if(priv->flags & BUFFER_FLAG_FLIP_X)
+			flip_row(data, data, width, bytes_per_pixel);
+		return STP_IMAGE_STATUS_OK;
+	}
+
 	/* fill buffer */
 	if(!priv->buf){
-		priv->buf = stp_zalloc((sizeof(unsigned short*) + 1) * height);
+		priv->row_bytes = byte_limit;
+		priv->buf_size = byte_limit * height;
+		allocate_buffer(priv);
 		if(!priv->buf){
 			return STP_IMAGE_STATUS_ABORT;
 		}
 		for(i=0;i<height;i++){
-			priv->buf[i] = stp_malloc(byte_limit);
-			if(STP_IMAGE_STATUS_OK != priv->image->get_row(priv->image,priv->buf[i],byte_limit,i))
+			if(STP_IMAGE_STATUS_OK != priv->image->get_row(priv->image,priv->buf + i * byte_limit,byte_limit,i))
 				return STP_IMAGE_STATUS_ABORT;
 		}
 	}
-	if(priv->flags & BUFFER_FLAG_FLIP_Y)
-		row = height - row - 1;
-
-	src = priv->buf[row];
-
-	if(priv->flags & BUFFER_FLAG_FLIP_X){
-		src += byte_limit - bytes_per_pixel;
-		inc = -bytes_per_pixel;
-	}
 
-	/* copy data */
-	for( i = 0 ; i < width ; i++){
-		memcpy(data,src,bytes_per_pixel);
-		src += inc;
-		data += bytes_per_pixel;
-	}
+	if(priv->flags & BUFFER_FLAG_FLIP_X)
+		flip_row(data, priv->buf + row * priv->row_bytes, width,
+			 bytes_per_pixel);
+	else
+		memcpy(data, priv->buf + row * priv->row_bytes, byte_limit);
 	return STP_IMAGE_STATUS_OK;
 }
 
@@ -107,15 +268,7 @@ static void
 buffered_image_conclude(stp_image_t * image)
 {
 	struct buffered_image_priv *priv = image->rep;
-	if(priv->buf){
-		int i = 0;
-		while(priv->buf[i]){
-			stp_free(priv->buf[i]);
-			++i;
-		}
-		stp_free(priv->buf);
-		priv->buf = NULL;
-	}
+	free_buffer(priv);
 	if(priv->image->conclude)
 		priv->image->conclude(priv->image);
 
@@ -145,6 +298,8 @@ stpi_buffer_image(stp_image_t* image, unsigned int flags)
 	buffered_image->conclude = buffered_image_conclude;
 	priv->image = image;
 	priv->flags = flags;
+	if((flags & BUFFER_FLAG_FLIP_Y) || (image->flags & STP_IMAGE_RANDOM_ACCESS))
+		buffered_image->flags = STP_IMAGE_RANDOM_ACCESS;
 	if(image->get_appname)
 		buffered_image->get_appname = buffered_image_get_appname;
 
@@ -132,7 +132,7 @@ typedef struct
   size_t bits;
 } channel_depth_t;
 
-typedef struct
+typedef struct lut
 {
   unsigned steps;
   int channel_depth;
@@ -148,6 +148,7 @@ typedef struct
   stp_cached_curve_t contrast_correction;
   stp_cached_curve_t user_color_correction;
   stp_cached_curve_t channel_curves[STP_CHANNEL_LIMIT];
+  unsigned long long computed_curves; /* Channel curves from gamma values */
   double gamma_values[STP_CHANNEL_LIMIT];
   double print_gamma;
   double app_gamma;
@@ -163,6 +164,11 @@ typedef struct
   unsigned short *gray_tmp;	/* Color -> Gray */
   unsigned short *cmy_tmp;	/* CMY -> CMYK */
   unsigned char *in_data;
+  unsigned char *in_tile;	/* Rows read ahead from the image */
+  const unsigned char *tile_data; /* in_tile or mapped image rows */
+  int tile_row;
+  int tile_count;
+  const struct lut *previous;	/* Previous page's LUT, while compiling */
 } lut_t;
 
 extern unsigned stpi_color_convert_to_gray(const stp_vars_t *v,
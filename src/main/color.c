@@ -207,6 +207,60 @@ stp_color_describe_parameter(const stp_vars_t *v, const char *name,
   colorfuncs->describe_parameter(v, name, description);
 }
 
+/*
+ * The image is converted to RGB the same way the raw-data-8 driver
+ * would convert it (that is the route the GTK UI takes for its
+ * thumbnail), but without a printer driver or output stream involved.
+ * The color module keeps the settings-derived state between calls,
+ * so repeated previews with slightly different settings are cheap.
+ */
+int
+stp_color_preview(const stp_vars_t *v, stp_image_t *image,
+		  unsigned char *out)
+{
+  stp_vars_t *nv = stp_vars_create_copy(v);
+  int width, height;
+  int out_channels;
+  int status = 1;
+  int i, y;
+
+  stp_image_init(image);
+  width = stp_image_width(image);
+  height = stp_image_height(image);
+  stp_set_string_parameter(nv, "STPIOutputType", "RGB");
+  stp_set_boolean_parameter(nv, "SimpleGamma", 1);
+  if (!stp_check_string_parameter(nv, "ChannelBitDepth",
+				  STP_PARAMETER_ACTIVE))
+    stp_set_string_parameter(nv, "ChannelBitDepth", "8");
+  stp_channel_reset(nv);
+  for (i = 0; i < 3; i++)
+    stp_channel_add(nv, i, 0, 1.0);
+
+  out_channels = stp_color_init(nv, image, 256);
+  if (out_channels != 3)
+    {
+      stp_eprintf(nv, "stp_color_preview: cannot convert to RGB\n");
+      status = 0;
+    }
+  else
+    for (y = 0; y < height; y++)
+      {
+	const unsigned short *row;
+	unsigned zero_mask;
+	if (stp_color_get_row(nv, image, y, &zero_mask))
+	  {
+	    status = 0;
+	    break;
+	  }
+	row = stp_channel_get_input(nv);
+	for (i = 0; i < width * 3; i++)
+	  *out++ = row[i] / 257;
+      }
+  stp_image_conclude(image);
+  stp_vars_destroy(nv);
+  return status;
+}
+
 
 int
 stp_color_register(const stp_color_t *color)
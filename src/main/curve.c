@@ -36,6 +36,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <strings.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #ifdef __GNUC__
 #define inline __inline__
@@ -1152,6 +1155,215 @@ stp_curve_interpolate_value(const stp_curve_t *curve, double where,
   return 1;
 }
 
+/*
+ * Resampling to 65536 points costs a pow() or a spline evaluation per
+ * point, and the color code resamples the same few curves to the same
+ * sizes on every page of every job.  The results of stp_curve_resample()
+ * and stp_curve_compose() are remembered here, keyed by everything the
+ * result depends on: the operation, the number of points, and the
+ * type, wrap mode, gamma, bounds and data of the source curves.  Only
+ * operations whose key is smaller than their result are remembered;
+ * otherwise hashing the key costs as much as the work it would save.
+ * The least recently used results are dropped once the cache holds
+ * more than CURVE_MEMO_LIMIT bytes.  The cache is shared by every
+ * curve, so it is only searched or changed with curve_memo_lock held,
+ * and a result found is copied out before the lock is released.
+ */
+#define CURVE_MEMO_LIMIT (8 * 1024 * 1024)
+#define CURVE_MEMO_BUCKETS 64
+#define CURVE_MEMO_HEADER 3
+#define CURVE_SIGNATURE_HEADER 7
+
+typedef struct curve_memo
+{
+  struct curve_memo *next;	/* Next in the same hash bucket */
+  struct curve_memo *newer;	/* Least recently used chain */
+  struct curve_memo *older;
+  unsigned long long hash;
+  size_t key_count;
+  double *key;
+  double *data;			/* Resampled data, for resample */
+  stp_curve_t *curve;		/* Result, for compose */
+  size_t size;			/* Bytes accounted to this entry */
+} curve_memo_t;
+
+static curve_memo_t *curve_memo_buckets[CURVE_MEMO_BUCKETS];
+static curve_memo_t *curve_memo_newest = NULL;
+static curve_memo_t *curve_memo_oldest = NULL;
+static size_t curve_memo_size = 0;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t curve_memo_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CURVE_MEMO() pthread_mutex_lock(&curve_memo_lock)
+#define UNLOCK_CURVE_MEMO() pthread_mutex_unlock(&curve_memo_lock)
+#else
+#define LOCK_CURVE_MEMO() do { } while (0)
+#define UNLOCK_CURVE_MEMO() do { } while (0)
+#endif
+
+static size_t
+curve_signature_count(const stp_curve_t *curve)
+{
+  return CURVE_SIGNATURE_HEADER + stp_sequence_get_size(curve->seq);
+}
+
+static double *
+curve_signature(double *sig, const stp_curve_t *curve)
+{
+  const double *data;
+  size_t count;
+  stp_sequence_get_data(curve->seq, &count, &data);
+  sig[0] = curve->curve_type;
+  sig[1] = curve->wrap_mode;
+  sig[2] = curve->piecewise;
+  sig[3] = curve->gamma;
+  stp_sequence_get_bounds(curve->seq, &(sig[4]), &(sig[5]));
+  sig[6] = count;
+  if (count)
+    memcpy(sig + CURVE_SIGNATURE_HEADER, data, count * sizeof(double));
+  return sig + CURVE_SIGNATURE_HEADER + count;
+}
+
+/*
+ * Build the key for an operation on one or two curves.  The operation
+ * is 0 for resampling, or 1 + the compose mode.
+ */
+static double *
+curve_memo_key(int operation, int points, const stp_curve_t *a,
+	       const stp_curve_t *b, size_t *key_count)
+{
+  double *key;
+  double *sig;
+  *key_count = CURVE_MEMO_HEADER + curve_signature_count(a);
+  if (b)
+    *key_count += curve_signature_count(b);
+  key = stp_malloc(*key_count * sizeof(double));
+  key[0] = operation;
+  key[1] = points;
+  key[2] = b ? 2 : 1;
+  sig = curve_signature(key + CURVE_MEMO_HEADER, a);
+  if (b)
+    curve_signature(sig, b);
+  return key;
+}
+
+static unsigned long long
+curve_memo_hash(const double *key, size_t key_count)
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  size_t i;
+  for (i = 0; i < key_count; i++)
+    {
+      unsigned long long word;
+      memcpy(&word, &(key[i]), sizeof(word));
+      hash = (hash ^ word) * 1099511628211ULL;
+      hash ^= hash >> 29;
+    }
+  return hash;
+}
+
+static void
+curve_memo_unlink(curve_memo_t *memo)
+{
+  if (memo->newer)
+    memo->newer->older = memo->older;
+  else
+    curve_memo_newest = memo->older;
+  if (memo->older)
+    memo->older->newer = memo->newer;
+  else
+    curve_memo_oldest = memo->newer;
+  memo->newer = NULL;
+  memo->older = NULL;
+}
+
+static void
+curve_memo_link_newest(curve_memo_t *memo)
+{
+  memo->older = curve_memo_newest;
+  memo->newer = NULL;
+  if (curve_memo_newest)
+    curve_memo_newest->newer = memo;
+  else
+    curve_memo_oldest = memo;
+  curve_memo_newest = memo;
+}
+
+static const curve_memo_t *
+curve_memo_find(const double *key, size_t key_count, unsigned long long hash)
+{
+  curve_memo_t *memo = curve_memo_buckets[hash % CURVE_MEMO_BUCKETS];
+  while (memo)
+    {
+      if (memo->hash == hash && memo->key_count == key_count &&
+	  memcmp(memo->key, key, key_count * sizeof(double)) == 0)
+	{
+	  curve_memo_unlink(memo);
+	  curve_memo_link_newest(memo);
+	  return memo;
+	}
+      memo = memo->next;
+    }
+  return NULL;
+}
+
+static void
+curve_memo_evict_oldest(void)
+{
+  curve_memo_t *memo = curve_memo_oldest;
+  curve_memo_t **link = &(curve_memo_buckets[memo->hash % CURVE_MEMO_BUCKETS]);
+  while (*link != memo)
+    link = &((*link)->next);
+  *link = memo->next;
+  curve_memo_unlink(memo);
+  curve_memo_size -= memo->size;
+  stp_free(memo->key);
+  STP_SAFE_FREE(memo->data);
+  if (memo->curve)
+    stp_curve_destroy(memo->curve);
+  stp_free(memo);
+}
+
+/*
+ * Remember a result.  The memo takes over the key; the data or curve
+ * is copied.
+ */
+static void
+curve_memo_insert(double *key, size_t key_count, unsigned long long hash,
+		  const double *data, size_t count, const stp_curve_t *curve)
+{
+  curve_memo_t *memo;
+  size_t size = sizeof(curve_memo_t) + key_count * sizeof(double);
+  if (curve)
+    size += sizeof(stp_curve_t) +
+      stp_sequence_get_size(curve->seq) * sizeof(double);
+  else
+    size += count * sizeof(double);
+  if (size > CURVE_MEMO_LIMIT / 4)
+    {
+      stp_free(key);
+      return;
+    }
+  while (curve_memo_oldest && curve_memo_size + size > CURVE_MEMO_LIMIT)
+    curve_memo_evict_oldest();
+
+  memo = stp_zalloc(sizeof(curve_memo_t));
+  memo->hash = hash;
+  memo->key_count = key_count;
+  memo->key = key;
+  memo->size = size;
+  if (curve)
+    memo->curve = stp_curve_create_copy(curve);
+  else
+    {
+      memo->data = stp_malloc(count * sizeof(double));
+      memcpy(memo->data, data, count * sizeof(double));
+    }
+  memo->next = curve_memo_buckets[hash % CURVE_MEMO_BUCKETS];
+  curve_memo_buckets[hash % CURVE_MEMO_BUCKETS] = memo;
+  curve_memo_link_newest(memo);
+  curve_memo_size += size;
+}
+
 int
 stp_curve_resample(stp_curve_t *curve, size_t points)
 {
@@ -1159,6 +1371,9 @@ stp_curve_resample(stp_curve_t *curve, size_t points)
   size_t old;
   size_t i;
   double *new_vec;
+  double *key = NULL;
+  size_t key_count = 0;
+  unsigned long long hash = 0;
 
   CHECK_CURVE(curve);
 
@@ -1172,6 +1387,25 @@ stp_curve_resample(stp_curve_t *curve, size_t points)
     limit++;
   if (limit > curve_point_limit)
     return 0;
+
+  if (curve_signature_count(curve) + CURVE_MEMO_HEADER < limit)
+    {
+      const curve_memo_t *memo;
+      key = curve_memo_key(0, points, curve, NULL, &key_count);
+      hash = curve_memo_hash(key, key_count);
+      LOCK_CURVE_MEMO();
+      memo = curve_memo_find(key, key_count, hash);
+      if (memo)
+	{
+	  stp_free(key);
+	  curve->piecewise = 0;
+	  stpi_curve_set_data(curve, points, memo->data);
+	  UNLOCK_CURVE_MEMO();
+	  curve->recompute_interval = 1;
+	  return 1;
+	}
+      UNLOCK_CURVE_MEMO();
+    }
   old = get_real_point_count(curve);
   if (old)
     old--;
@@ -1202,6 +1436,7 @@ stp_curve_resample(stp_curve_t *curve, size_t points)
 	  if (!stp_sequence_get_point(curve->seq, i * 2, &low))
 	    {
 	      stp_free(new_vec);
+	      STP_SAFE_FREE(key);
 	      return 0;
 	    }
 	  if (i == old - 1)
@@ -1209,16 +1444,19 @@ stp_curve_resample(stp_curve_t *curve, size_t points)
 	  else if (!stp_sequence_get_point(curve->seq, ((i + 1) * 2), &high))
 	    {
 	      stp_free(new_vec);
+	      STP_SAFE_FREE(key);
 	      return 0;
 	    }
 	  if (!stp_sequence_get_point(curve->seq, (i * 2) + 1, &low_y))
 	    {
 	      stp_free(new_vec);
+	      STP_SAFE_FREE(key);
 	      return 0;
 	    }
 	  if (!stp_sequence_get_point(curve->seq, ((i + 1) * 2) + 1, &high_y))
 	    {
 	      stp_free(new_vec);
+	      STP_SAFE_FREE(key);
 	      return 0;
 	    }
 	  stp_deprintf(STP_DBG_CURVE,
@@ -1306,6 +1544,12 @@ stp_curve_resample(stp_curve_t *curve, size_t points)
     }
   stpi_curve_set_data(curve, points, new_vec);
   curve->recompute_interval = 1;
+  if (key)
+    {
+      LOCK_CURVE_MEMO();
+      curve_memo_insert(key, key_count, hash, new_vec, limit, NULL);
+      UNLOCK_CURVE_MEMO();
+    }
   stp_free(new_vec);
   return 1;
 }
@@ -1402,10 +1646,10 @@ interpolate_points(stp_curve_t *a, stp_curve_t *b,
   return 1;
 }
 
-int
-stp_curve_compose(stp_curve_t **retval,
-		  stp_curve_t *a, stp_curve_t *b,
-		  stp_curve_compose_t mode, int points)
+static int
+curve_compose_internal(stp_curve_t **retval,
+		       stp_curve_t *a, stp_curve_t *b,
+		       stp_curve_compose_t mode, int points)
 {
   stp_curve_t *ret;
   double *tmp_data;
@@ -1491,6 +1735,45 @@ stp_curve_compose(stp_curve_t **retval,
   return 0;
 }
 
+int
+stp_curve_compose(stp_curve_t **retval,
+		  stp_curve_t *a, stp_curve_t *b,
+		  stp_curve_compose_t mode, int points)
+{
+  const curve_memo_t *memo;
+  double *key;
+  size_t key_count;
+  unsigned long long hash;
+
+  /* With points == -1 the result has the lcm of the two sizes */
+  if (points != -1 &&
+      (curve_signature_count(a) + curve_signature_count(b) +
+       CURVE_MEMO_HEADER >= points))
+    return curve_compose_internal(retval, a, b, mode, points);
+
+  key = curve_memo_key(1 + mode, points, a, b, &key_count);
+  hash = curve_memo_hash(key, key_count);
+  LOCK_CURVE_MEMO();
+  memo = curve_memo_find(key, key_count, hash);
+  if (memo)
+    {
+      stp_free(key);
+      *retval = stp_curve_create_copy(memo->curve);
+      UNLOCK_CURVE_MEMO();
+      return 1;
+    }
+  UNLOCK_CURVE_MEMO();
+  if (!curve_compose_internal(retval, a, b, mode, points))
+    {
+      stp_free(key);
+      return 0;
+    }
+  LOCK_CURVE_MEMO();
+  curve_memo_insert(key, key_count, hash, NULL, 0, *retval);
+  UNLOCK_CURVE_MEMO();
+  return 1;
+}
+
 
 stp_curve_t *
 stp_curve_create_from_xmltree(stp_mxml_node_t *curve)  /* The curve node */
@@ -1955,7 +2238,7 @@ stp_curve_create_from_file(const char* file)
 
   stp_xml_init();
 
-  doc = stp_mxmlLoadFile(NULL, fp, STP_MXML_NO_CALLBACK);
+  doc = stp_mxmlLoadFile(NULL, fp, stpi_xml_type_callback);
 
   curve = xml_doc_get_curve(doc);
 
@@ -1977,7 +2260,7 @@ stp_curve_create_from_stream(FILE* fp)
 
   stp_xml_init();
 
-  doc = stp_mxmlLoadFile(NULL, fp, STP_MXML_NO_CALLBACK);
+  doc = stp_mxmlLoadFile(NULL, fp, stpi_xml_type_callback);
 
   curve = xml_doc_get_curve(doc);
 
@@ -1998,7 +2281,7 @@ stp_curve_create_from_string(const char* string)
 	       "stp_curve_create_from_string: reading '%s'...\n", string);
   stp_xml_init();
 
-  doc = stp_mxmlLoadString(NULL, string, STP_MXML_NO_CALLBACK);
+  doc = stp_mxmlLoadString(NULL, string, stpi_xml_type_callback);
 
   curve = xml_doc_get_curve(doc);
 
@@ -30,6 +30,10 @@
 #include "gutenprint-internal.h"
 #include <gutenprint/gutenprint-intl-internal.h>
 #include <string.h>
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #include "dither-impl.h"
 #include "dither-inlined-functions.h"
 
@@ -119,8 +123,8 @@ update_dither(stpi_dither_t *d, int channel, int width,
 
 static inline int
 print_color(const stpi_dither_t *d, stpi_dither_channel_t *dc, int x, int y,
-	    unsigned char bit, int length, int dontprint, int stpi_dither_type,
-	    const unsigned char *mask)
+	    unsigned char bit, int ptr_offset, int length, int dontprint,
+	    int stpi_dither_type, const unsigned char *mask)
 {
   int base = dc->b;
   int density = dc->o;
@@ -291,11 +295,11 @@ print_color(const stpi_dither_t *d, stpi_dither_channel_t *dc, int x, int y,
 		subc = lower;
 	    }
 	  v = subc->value;
-	  if (!mask || (*(mask + d->ptr_offset) & bit))
+	  if (!mask || (*(mask + ptr_offset) & bit))
 	    {
 	      if (dc->ptr)
 		{
-		  tptr = dc->ptr + d->ptr_offset;
+		  tptr = dc->ptr + ptr_offset;
 
 		  /*
 		   * Lay down all of the bits in the pixel.
@@ -396,6 +400,286 @@ shared_ed_deinitializer(stpi_dither_t *d,
   STP_SAFE_FREE(ndither);
 }
 
+/*
+ * Error diffusion never moves error between channels, so each channel
+ * is dithered across the whole row on its own.  This keeps one
+ * channel's error rows and output in cache at a time, and lets
+ * separate threads dither different channels of the same row.  Nothing
+ * shared between channels is written here; in particular the output
+ * byte offset is kept locally rather than in the dither.
+ */
+
+typedef struct
+{
+  stpi_dither_t *d;
+  int row;
+  const unsigned short *raw;
+  int direction;
+  int length;
+  int *ndither;
+  int ***error;
+  const unsigned char *mask;
+} ed_row_t;
+
+static void
+ed_dither_channel(const ed_row_t *r, int channel)
+{
+  stpi_dither_t *d = r->d;
+  stpi_dither_channel_t *dc = &(CHANNEL(d, channel));
+  const unsigned short *raw = r->raw + channel;
+  int direction = r->direction;
+  int ndither = r->ndither[channel];
+  int *error0 = r->error[channel][0];
+  int *error1 = r->error[channel][1];
+  int		x;
+  unsigned char	bit;
+  int		terminate;
+  int		ptr_offset;
+  int xerror, xstep, xmod;
+
+  x = (direction == 1) ? 0 : d->dst_width - 1;
+  bit = 1 << (7 - (x & 7));
+  xstep  = CHANNEL_COUNT(d) * (d->src_width / d->dst_width);
+  xmod   = d->src_width % d->dst_width;
+  xerror = (xmod * x) % d->dst_width;
+  terminate = (direction == 1) ? d->dst_width : -1;
+  ptr_offset = (direction == 1) ? 0 : r->length - 1;
+
+  if (direction == -1)
+    raw += (CHANNEL_COUNT(d) * (d->src_width - 1));
+
+  for (; x != terminate; x += direction)
+    {
+      dc->v = raw[0];
+      dc->o = dc->v;
+      dc->b = dc->v;
+      dc->v = UPDATE_COLOR(dc->v, ndither);
+      dc->v = print_color(d, dc, x, r->row, bit, ptr_offset, r->length, 0,
+			  d->stpi_dither_type, r->mask);
+      ndither = update_dither(d, channel, d->src_width,
+			      direction, error0, error1);
+      error0 += direction;
+      error1 += direction;
+      if (direction == 1)
+	{
+	  bit >>= 1;
+	  if (bit == 0)
+	    {
+	      ptr_offset++;
+	      bit = 128;
+	    }
+	  raw += xstep;
+	  if (xmod)
+	    {
+	      xerror += xmod;
+	      if (xerror >= d->dst_width)
+		{
+		  xerror -= d->dst_width;
+		  raw += CHANNEL_COUNT(d);
+		}
+	    }
+	}
+      else
+	{
+	  if (bit == 128)
+	    {
+	      ptr_offset--;
+	      bit = 1;
+	    }
+	  else
+	    bit <<= 1;
+	  raw -= xstep;
+	  if (xmod)
+	    {
+	      xerror -= xmod;
+	      if (xerror < 0)
+		{
+		  xerror += d->dst_width;
+		  raw -= CHANNEL_COUNT(d);
+		}
+	    }
+	}
+    }
+}
+
+#ifdef HAVE_PTHREAD_H
+
+/*
+ * Rows narrower than this are not worth handing to other threads.
+ */
+#define ED_MIN_THREAD_WIDTH (1024)
+
+/*
+ * Helper threads for one dither.  By default there are none and the
+ * channels are dithered by the caller in turn.  An application that
+ * wants more may set the integer parameter DitherThreads (or, failing
+ * that, the environment variable STP_DITHER_THREADS) to the number of
+ * threads, including the caller, to use; no more are used than there
+ * are channels.  The helpers are started on the first row and wait
+ * between rows; for each row, the calling thread and the helpers take
+ * channels from next_channel until there are none left.
+ */
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t start;		/* A row has been posted */
+  pthread_cond_t finish;	/* All helpers are done with the row */
+  pthread_t *threads;
+  int nthreads;
+  unsigned generation;		/* Incremented for each row */
+  int busy;			/* Helpers still working on this row */
+  int next_channel;
+  int shutdown;
+  const ed_row_t *r;
+} ed_threads_t;
+
+/* Called with t->lock held */
+static void
+ed_run_channels(ed_threads_t *t)
+{
+  const ed_row_t *r = t->r;
+  while (t->next_channel < CHANNEL_COUNT(r->d))
+    {
+      int channel = t->next_channel++;
+      if (CHANNEL(r->d, channel).ptr)
+	{
+	  pthread_mutex_unlock(&t->lock);
+	  ed_dither_channel(r, channel);
+	  pthread_mutex_lock(&t->lock);
+	}
+    }
+}
+
+static void *
+ed_thread(void *arg)
+{
+  ed_threads_t *t = (ed_threads_t *) arg;
+  unsigned seen = 0;
+  pthread_mutex_lock(&t->lock);
+  while (1)
+    {
+      while (!t->shutdown && t->generation == seen)
+	pthread_cond_wait(&t->start, &t->lock);
+      if (t->shutdown)
+	break;
+      seen = t->generation;
+      ed_run_channels(t);
+      if (--t->busy == 0)
+	pthread_cond_signal(&t->finish);
+    }
+  pthread_mutex_unlock(&t->lock);
+  return NULL;
+}
+
+static void
+free_ed_threads(stpi_dither_t *d)
+{
+  ed_threads_t *t = (ed_threads_t *) d->aux_data;
+  int i;
+  if (!t)
+    return;
+  pthread_mutex_lock(&t->lock);
+  t->shutdown = 1;
+  pthread_cond_broadcast(&t->start);
+  pthread_mutex_unlock(&t->lock);
+  for (i = 0; i < t->nthreads; i++)
+    pthread_join(t->threads[i], NULL);
+  pthread_cond_destroy(&t->start);
+  pthread_cond_destroy(&t->finish);
+  pthread_mutex_destroy(&t->lock);
+  STP_SAFE_FREE(t->threads);
+  stp_free(t);
+  d->aux_data = NULL;
+}
+
+static ed_threads_t *
+ed_threads(const stp_vars_t *v, stpi_dither_t *d)
+{
+  ed_threads_t *t;
+  const char *limit;
+  int wanted = 1;
+  int channels = 0;
+  int i;
+
+  if (d->aux_data)
+    return (ed_threads_t *) d->aux_data;
+
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    if (CHANNEL(d, i).ptr)
+      channels++;
+  if (stp_check_int_parameter(v, "DitherThreads", STP_PARAMETER_ACTIVE))
+    wanted = stp_get_int_parameter(v, "DitherThreads");
+  else if ((limit = getenv("STP_DITHER_THREADS")) != NULL)
+    wanted = atoi(limit);
+  if (wanted > channels)
+    wanted = channels;
+  if (d->dst_width < ED_MIN_THREAD_WIDTH)
+    wanted = 1;
+
+  t = stp_zalloc(sizeof(ed_threads_t));
+  pthread_mutex_init(&t->lock, NULL);
+  pthread_cond_init(&t->start, NULL);
+  pthread_cond_init(&t->finish, NULL);
+  if (wanted > 1)
+    {
+      t->threads = stp_malloc(sizeof(pthread_t) * (wanted - 1));
+      for (i = 0; i < wanted - 1; i++)
+	if (pthread_create(&(t->threads[t->nthreads]), NULL, ed_thread, t) == 0)
+	  t->nthreads++;
+    }
+  d->aux_data = t;
+  d->aux_freefunc = free_ed_threads;
+  return t;
+}
+
+/*
+ * Channels can only be dithered concurrently if they write to different
+ * output rows.
+ */
+static int
+ed_outputs_overlap(const stpi_dither_t *d, int length)
+{
+  int i, j;
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    {
+      const stpi_dither_channel_t *a = &(CHANNEL(d, i));
+      if (!a->ptr)
+	continue;
+      for (j = i + 1; j < CHANNEL_COUNT(d); j++)
+	{
+	  const stpi_dither_channel_t *b = &(CHANNEL(d, j));
+	  if (b->ptr &&
+	      a->ptr < b->ptr + length * b->signif_bits &&
+	      b->ptr < a->ptr + length * a->signif_bits)
+	    return 1;
+	}
+    }
+  return 0;
+}
+
+static int
+ed_dither_threaded(const stp_vars_t *v, const ed_row_t *r)
+{
+  ed_threads_t *t = ed_threads(v, r->d);
+  if (t->nthreads == 0 || ed_outputs_overlap(r->d, r->length))
+    return 0;
+  pthread_mutex_lock(&t->lock);
+  t->r = r;
+  t->next_channel = 0;
+  t->busy = t->nthreads;
+  t->generation++;
+  pthread_cond_broadcast(&t->start);
+  ed_run_channels(t);
+  while (t->busy > 0)
+    pthread_cond_wait(&t->finish, &t->lock);
+  t->r = NULL;
+  pthread_mutex_unlock(&t->lock);
+  return 1;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
 void
 stpi_dither_ed(stp_vars_t *v,
 	       int row,
@@ -405,16 +689,13 @@ stpi_dither_ed(stp_vars_t *v,
 	       const unsigned char *mask)
 {
   stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
-  int		x,
-    		length;
-  unsigned char	bit;
+  ed_row_t	r;
+  int		length;
   int		i;
   int		*ndither;
   int		***error;
 
-  int		terminate;
   int		direction = row & 1 ? 1 : -1;
-  int xerror, xstep, xmod;
 
   length = (d->dst_width + 7) / 8;
   if (d->stpi_dither_type & D_ADAPTIVE_BASE)
@@ -428,36 +709,21 @@ stpi_dither_ed(stp_vars_t *v,
 			     direction, &error, &ndither))
     return;
 
-  x = (direction == 1) ? 0 : d->dst_width - 1;
-  bit = 1 << (7 - (x & 7));
-  xstep  = CHANNEL_COUNT(d) * (d->src_width / d->dst_width);
-  xmod   = d->src_width % d->dst_width;
-  xerror = (xmod * x) % d->dst_width;
-  terminate = (direction == 1) ? d->dst_width : -1;
-
-  if (direction == -1)
-    raw += (CHANNEL_COUNT(d) * (d->src_width - 1));
+  r.d = d;
+  r.row = row;
+  r.raw = raw;
+  r.direction = direction;
+  r.length = length;
+  r.ndither = ndither;
+  r.error = error;
+  r.mask = mask;
+#ifdef HAVE_PTHREAD_H
+  if (!ed_dither_threaded(v, &r))
+#endif
+    for (i = 0; i < CHANNEL_COUNT(d); i++)
+      if (CHANNEL(d, i).ptr)
+	ed_dither_channel(&r, i);
 
-  for (; x != terminate; x += direction)
-    {
-      for (i = 0; i < CHANNEL_COUNT(d); i++)
-	{
-	  if (CHANNEL(d, i).ptr)
-	    {
-	      CHANNEL(d, i).v = raw[i];
-	      CHANNEL(d, i).o = CHANNEL(d, i).v;
-	      CHANNEL(d, i).b = CHANNEL(d, i).v;
-	      CHANNEL(d, i).v = UPDATE_COLOR(CHANNEL(d, i).v, ndither[i]);
-	      CHANNEL(d, i).v = print_color(d, &(CHANNEL(d, i)), x, row, bit,
-					    length, 0, d->stpi_dither_type,
-					    mask);
-	      ndither[i] = update_dither(d, i, d->src_width,
-					 direction, error[i][0], error[i][1]);
-	    }
-	}
-      ADVANCE_BIDIRECTIONAL(d, bit, raw, direction, CHANNEL_COUNT(d), xerror,
-			    xstep, xmod, error, d->error_rows);
-    }
   shared_ed_deinitializer(d, error, ndither);
   if (direction == -1)
     stpi_dither_reverse_row_ends(d);
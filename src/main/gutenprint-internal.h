@@ -55,6 +55,26 @@ extern void stpi_init_printer(void);
 #define BUFFER_FLAG_FLIP_Y	0x2
 extern stp_image_t* stpi_buffer_image(stp_image_t* image, unsigned int flags);
 
+/**
+ * Keep hash indexes of the names and long names of the items in a list,
+ * so that stp_list_get_item_by_name() and
+ * stp_list_get_item_by_long_name() need not search it.  Each is built
+ * on the first lookup, kept up to date as items are appended, and
+ * rebuilt after items are inserted elsewhere or removed, or after an
+ * item's data is replaced with stp_list_item_set_data().  An item's
+ * names must not otherwise change while it is in the list.
+ * @param list the list to index.
+ */
+extern void stpi_list_index_names(stp_list_t *list);
+
+/**
+ * Copy the driver, color conversion, dimensions and parameters of a vars
+ * object, but not its component data or output functions.
+ * @param v the vars to copy.
+ * @returns the new vars.
+ */
+extern stp_vars_t *stpi_vars_create_settings_copy(const stp_vars_t *v);
+
 #define STPI_ASSERT(x,v)						\
 do									\
 {									\
@@ -201,6 +221,15 @@ extern const stp_papersize_t *stpi_standard_describe_papersize(const stp_vars_t
 extern int stpi_papersize_create(stp_papersize_list_t *list,
 				 stp_papersize_t *p);
 
+/**
+ * Remove a papersize from a list
+ * @param list the list to remove it from
+ * @param name the name of the paper size
+ * @returns 0 on success, 1 if there is no such paper size
+ */
+extern int stpi_papersize_destroy(stp_papersize_list_t *list,
+				  const char *name);
+
 /**
  * Get a papersize by its name from a list
  * @param list the name of the list to search
@@ -248,6 +277,17 @@ extern void stpi_find_duplicate_printers(void);
 
 extern time_t stpi_time(time_t *t);
 
+/**
+ * Convert a decimal string into a double; a faster equivalent of strtod().
+ */
+extern double stpi_xmlstrtod(const char *textval, char **endptr);
+
+/**
+ * Type callback for loading Gutenprint XML; keeps the contents of each
+ * sequence element as a single opaque node.
+ */
+extern stp_mxml_type_t stpi_xml_type_callback(stp_mxml_node_t *node);
+
 #define CAST_IS_SAFE GCC_DIAG_OFF(cast-qual)
 #define CAST_IS_UNSAFE GCC_DIAG_ON(cast-qual)
 
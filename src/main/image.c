@@ -58,6 +58,33 @@ stp_image_get_row(stp_image_t *image, unsigned char *data,
   return image->get_row(image, data, byte_limit, row);
 }
 
+stp_image_status_t
+stp_image_get_rows(stp_image_t *image, unsigned char *data,
+		   size_t byte_limit, int row, int count)
+{
+  int i;
+  if (image->get_rows)
+    return image->get_rows(image, data, byte_limit, row, count);
+  for (i = 0; i < count; i++)
+    {
+      stp_image_status_t status =
+	image->get_row(image, data + i * byte_limit, byte_limit, row + i);
+      if (status != STP_IMAGE_STATUS_OK)
+	return status;
+    }
+  return STP_IMAGE_STATUS_OK;
+}
+
+const unsigned char *
+stp_image_map_rows(stp_image_t *image, size_t byte_limit, int row,
+		   int *count)
+{
+  if (image->map_rows)
+    return image->map_rows(image, byte_limit, row, count);
+  else
+    return NULL;
+}
+
 const char *
 stp_image_get_appname(stp_image_t *image)
 {
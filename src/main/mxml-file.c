@@ -22,10 +22,10 @@
  *   stp_mxmlSaveFile()        - Save an XML tree to a file.
  *   stp_mxmlSaveString()      - Save an XML node tree to a string.
  *   mxml_add_char()       - Add a character to a buffer, expanding as needed.
- *   mxml_file_getc()      - Get a character from a file.
+ *   mxml_add_span()       - Add a run of characters to a buffer.
+ *   mxml_read_stream()    - Read the remainder of a stream into memory.
  *   mxml_load_data()      - Load data into an XML node tree.
  *   mxml_parse_element()  - Parse an element for any attributes...
- *   mxml_string_getc()    - Get a character from a string.
  *   mxml_write_node()     - Save an XML node to a file.
  *   mxml_write_string()   - Write a string, escaping & and < as needed.
  *   mxml_write_ws()       - Do whitespace callback...
@@ -37,8 +37,33 @@
 
 #include <gutenprint/mxml.h>
 #include "config.h"
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #define MXML_BUFSIZE (64)
 #define ENTITY_BUFSIZE (64)
+#define MXML_READSIZE (65536)
+
+/*
+ * Input is always parsed from memory: files are mapped (or read) in
+ * their entirety, so fetching a character is a pointer comparison
+ * rather than a call through a callback into stdio.
+ */
+
+typedef struct mxml_buf_s
+{
+  const char	*ptr;			/* Next character */
+  const char	*end;			/* End of data */
+} mxml_buf_t;
+
+#define mxml_getc(b) \
+  ((b)->ptr < (b)->end ? (int) (unsigned char) *((b)->ptr)++ : EOF)
 
 /*
  * Local functions...
@@ -46,14 +71,13 @@
 
 static int		mxml_add_char(int ch, char **ptr, char **buffer,
 			              int *bufsize);
-static int		mxml_file_getc(void *p);
+static int		mxml_add_span(const char *s, size_t len, char **ptr,
+				      char **buffer, int *bufsize);
 static int		mxml_file_putc(int ch, void *p);
-static stp_mxml_node_t	*mxml_load_data(stp_mxml_node_t *top, void *p,
-			                stp_mxml_type_t (*cb)(stp_mxml_node_t *),
-			                int (*getc_cb)(void *));
-static int		mxml_parse_element(stp_mxml_node_t *node, void *p,
-			                   int (*getc_cb)(void *));
-static int		mxml_string_getc(void *p);
+static char		*mxml_read_stream(FILE *fp, size_t *len);
+static stp_mxml_node_t	*mxml_load_data(stp_mxml_node_t *top, mxml_buf_t *p,
+			                stp_mxml_type_t (*cb)(stp_mxml_node_t *));
+static int		mxml_parse_element(stp_mxml_node_t *node, mxml_buf_t *p);
 static int		mxml_string_putc(int ch, void *p);
 static int		mxml_write_node(stp_mxml_node_t *node, void *p,
 			                int (*cb)(stp_mxml_node_t *, int),
@@ -83,7 +107,22 @@ stp_mxmlLoadFile(stp_mxml_node_t *top,		/* I - Top node */
              stp_mxml_type_t (*cb)(stp_mxml_node_t *))
 					/* I - Callback function or STP_MXML_NO_CALLBACK */
 {
-  return (mxml_load_data(top, fp, cb, mxml_file_getc));
+  stp_mxml_node_t	*doc;			/* Loaded document */
+  mxml_buf_t	buf;			/* Input buffer */
+  size_t	len;			/* Length of data */
+  char		*data;			/* Data read */
+
+
+  if ((data = mxml_read_stream(fp, &len)) == NULL)
+    return (NULL);
+
+  buf.ptr = data;
+  buf.end = data + len;
+  doc     = mxml_load_data(top, &buf, cb);
+
+  free(data);
+
+  return (doc);
 }
 
 /*
@@ -103,12 +142,36 @@ stp_mxmlLoadFromFile(stp_mxml_node_t *top,	/* I - Top node */
 		     stp_mxml_type_t (*cb)(stp_mxml_node_t *))
 					/* I - Callback function or STP_MXML_NO_CALLBACK */
 {
-  FILE *fp = fopen(file, "r");
   stp_mxml_node_t *doc;
-  if (! fp)
+#ifdef HAVE_SYS_MMAN_H
+  struct stat st;
+  mxml_buf_t buf;
+  void *data;
+  int fd = open(file, O_RDONLY);
+  if (fd < 0)
     return NULL;
-  doc = stp_mxmlLoadFile(top, fp, cb);
-  fclose(fp);
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+      data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED)
+	{
+	  close(fd);
+	  buf.ptr = data;
+	  buf.end = (const char *) data + st.st_size;
+	  doc = mxml_load_data(top, &buf, cb);
+	  munmap(data, st.st_size);
+	  return doc;
+	}
+    }
+  close(fd);
+#endif
+  {
+    FILE *fp = fopen(file, "r");
+    if (! fp)
+      return NULL;
+    doc = stp_mxmlLoadFile(top, fp, cb);
+    fclose(fp);
+  }
   return doc;
 }
 
@@ -130,7 +193,13 @@ stp_mxmlLoadString(stp_mxml_node_t *top,	/* I - Top node */
                stp_mxml_type_t (*cb)(stp_mxml_node_t *))
 					/* I - Callback function or STP_MXML_NO_CALLBACK */
 {
-  return (mxml_load_data(top, &s, cb, mxml_string_getc));
+  mxml_buf_t	buf;			/* Input buffer */
+
+
+  buf.ptr = s;
+  buf.end = s + strlen(s);
+
+  return (mxml_load_data(top, &buf, cb));
 }
 
 
@@ -307,6 +376,7 @@ mxml_add_char(int  ch,			/* I  - Character to add */
 	      int  *bufsize)		/* IO - Current buffer size */
 {
   char	*newbuffer;			/* New buffer value */
+  size_t used;				/* Characters already in buffer */
 
 
   if (*bufptr >= (*buffer + *bufsize - 1))
@@ -315,10 +385,8 @@ mxml_add_char(int  ch,			/* I  - Character to add */
     * Increase the size of the buffer...
     */
 
-    if (*bufsize < 1024)
-      (*bufsize) *= 2;
-    else
-      (*bufsize) += 1024;
+    used = *bufptr - *buffer;
+    (*bufsize) *= 2;
 
     if ((newbuffer = realloc(*buffer, *bufsize)) == NULL)
     {
@@ -330,8 +398,8 @@ mxml_add_char(int  ch,			/* I  - Character to add */
       return (-1);
     }
 
-    *bufptr = newbuffer + (*bufptr - *buffer);
     *buffer = newbuffer;
+    *bufptr = newbuffer + used;
   }
 
   *(*bufptr)++ = ch;
@@ -341,13 +409,91 @@ mxml_add_char(int  ch,			/* I  - Character to add */
 
 
 /*
- * 'mxml_file_getc()' - Get a character from a file.
+ * 'mxml_add_span()' - Add a run of characters to a buffer.
  */
 
-static int				/* O - Character or EOF */
-mxml_file_getc(void *p)			/* I - Pointer to file */
+static int				/* O  - 0 on success, -1 on error */
+mxml_add_span(const char *s,		/* I  - Characters to add */
+	      size_t     len,		/* I  - Number of characters */
+              char       **bufptr,	/* IO - Current position in buffer */
+	      char       **buffer,	/* IO - Current buffer */
+	      int        *bufsize)	/* IO - Current buffer size */
 {
-  return (getc((FILE *)p));
+  char	*newbuffer;			/* New buffer value */
+  size_t used = *bufptr - *buffer;	/* Characters already in buffer */
+  int	newsize = *bufsize;		/* New buffer size */
+
+
+  while (used + len >= (size_t) newsize)
+    newsize *= 2;
+
+  if (newsize != *bufsize)
+  {
+    if ((newbuffer = realloc(*buffer, newsize)) == NULL)
+    {
+      free(*buffer);
+
+      fprintf(stderr, "Unable to expand string buffer to %d bytes!\n",
+	      newsize);
+
+      return (-1);
+    }
+
+    *buffer  = newbuffer;
+    *bufptr  = newbuffer + used;
+    *bufsize = newsize;
+  }
+
+  memcpy(*bufptr, s, len);
+  *bufptr += len;
+
+  return (0);
+}
+
+
+/*
+ * 'mxml_read_stream()' - Read the remainder of a stream into memory.
+ */
+
+static char *				/* O - Data or NULL on error */
+mxml_read_stream(FILE   *fp,		/* I - File to read from */
+		 size_t *len)		/* O - Number of bytes read */
+{
+  char		*data,			/* Data read so far */
+		*newdata;		/* Expanded data */
+  size_t	size,			/* Allocated size */
+		bytes;			/* Bytes from this read */
+
+
+  size = MXML_READSIZE;
+  *len = 0;
+
+  if ((data = malloc(size)) == NULL)
+  {
+    fputs("Unable to allocate input buffer!\n", stderr);
+    return (NULL);
+  }
+
+  while ((bytes = fread(data + *len, 1, size - *len, fp)) > 0)
+  {
+    *len += bytes;
+
+    if (*len == size)
+    {
+      size *= 2;
+
+      if ((newdata = realloc(data, size)) == NULL)
+      {
+        free(data);
+	fputs("Unable to expand input buffer!\n", stderr);
+	return (NULL);
+      }
+
+      data = newdata;
+    }
+  }
+
+  return (data);
 }
 
 
@@ -369,11 +515,9 @@ mxml_file_putc(int  ch,			/* I - Character to write */
 
 static stp_mxml_node_t *			/* O - First node or NULL if the file could not be read. */
 mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
-               void        *p,		/* I - Pointer to data */
-               stp_mxml_type_t (*cb)(stp_mxml_node_t *),
+               mxml_buf_t  *p,		/* I - Data to read from */
+               stp_mxml_type_t (*cb)(stp_mxml_node_t *))
 					/* I - Callback function or STP_MXML_NO_CALLBACK */
-               int         (*getc_cb)(void *))
-					/* I - Read function */
 {
   stp_mxml_node_t	*node,			/* Current node */
 		*parent;		/* Current parent node */
@@ -405,7 +549,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
   else
     type = STP_MXML_TEXT;
 
-  while ((ch = (*getc_cb)(p)) != EOF)
+  while ((ch = mxml_getc(p)) != EOF)
   {
     if ((ch == '<' || (isspace(ch) && type != STP_MXML_OPAQUE)) && bufptr > buffer)
     {
@@ -490,7 +634,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
 
       bufptr = buffer;
 
-      while ((ch = (*getc_cb)(p)) != EOF)
+      while ((ch = mxml_getc(p)) != EOF)
         if (isspace(ch) || ch == '>' || (ch == '/' && bufptr > buffer))
 	  break;
 	else if (mxml_add_char(ch, &bufptr, &buffer, &bufsize))
@@ -508,7 +652,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
         * Gather rest of comment...
 	*/
 
-	while ((ch = (*getc_cb)(p)) != EOF)
+	while ((ch = mxml_getc(p)) != EOF)
 	{
 	  if (ch == '>' && bufptr > (buffer + 4) &&
 	      !strncmp(bufptr - 2, "--", 2))
@@ -558,7 +702,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
 	    return (NULL);
 	  }
 	}
-        while ((ch = (*getc_cb)(p)) != EOF);
+        while ((ch = mxml_getc(p)) != EOF);
 
        /*
         * Error out if we didn't get the whole declaration...
@@ -616,7 +760,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
 	*/
 
         while (ch != '>' && ch != EOF)
-	  ch = (*getc_cb)(p);
+	  ch = mxml_getc(p);
 
        /*
 	* Ascend into the parent and set the value type as needed...
@@ -647,10 +791,10 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
 	}
 
         if (isspace(ch))
-          ch = mxml_parse_element(node, p, getc_cb);
+          ch = mxml_parse_element(node, p);
         else if (ch == '/')
 	{
-	  if ((ch = (*getc_cb)(p)) != '>')
+	  if ((ch = mxml_getc(p)) != '>')
 	  {
 	    fprintf(stderr, "Expected > but got '%c' instead for element <%s/>!\n",
 	            ch, buffer);
@@ -692,7 +836,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
       entity[0] = ch;
       entptr    = entity + 1;
 
-      while ((ch = (*getc_cb)(p)) != EOF)
+      while ((ch = mxml_getc(p)) != EOF)
         if (!isalnum(ch) && ch != '#')
 	  break;
 	else if (entptr < (entity + sizeof(entity) - 1))
@@ -804,10 +948,26 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
     else if (type == STP_MXML_OPAQUE || !isspace(ch))
     {
      /*
-      * Add character to current buffer...
+      * Add character to current buffer, along with the rest of the run
+      * of characters that need no special handling...
       */
 
-      if (mxml_add_char(ch, &bufptr, &buffer, &bufsize))
+      const char *start = p->ptr;
+
+      if (type == STP_MXML_OPAQUE)
+      {
+        while (p->ptr < p->end && *p->ptr != '<' && *p->ptr != '&')
+	  p->ptr++;
+      }
+      else
+      {
+        while (p->ptr < p->end && *p->ptr != '<' && *p->ptr != '&' &&
+	       !isspace((unsigned char) *p->ptr))
+	  p->ptr++;
+      }
+
+      if (mxml_add_char(ch, &bufptr, &buffer, &bufsize) ||
+          mxml_add_span(start, p->ptr - start, &bufptr, &buffer, &bufsize))
       {
 	return (NULL);
       }
@@ -840,9 +1000,7 @@ mxml_load_data(stp_mxml_node_t *top,	/* I - Top node */
 
 static int				/* O - Terminating character */
 mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
-                   void        *p,	/* I - Data to read from */
-                   int         (*getc_cb)(void *))
-					/* I - Data callback */
+                   mxml_buf_t  *p)	/* I - Data to read from */
 {
   int	ch,				/* Current character in file */
 	quote;				/* Quoting character */
@@ -878,7 +1036,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
   * Loop until we hit a >, /, ?, or EOF...
   */
 
-  while ((ch = (*getc_cb)(p)) != EOF)
+  while ((ch = mxml_getc(p)) != EOF)
   {
 #ifdef DEBUG
     fprintf(stderr, "parse_element: ch='%c'\n", ch);
@@ -901,7 +1059,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
       * Grab the > character and print an error if it isn't there...
       */
 
-      quote = (*getc_cb)(p);
+      quote = mxml_getc(p);
 
       if (quote != '>')
       {
@@ -922,7 +1080,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
     name[0] = ch;
     ptr     = name + 1;
 
-    while ((ch = (*getc_cb)(p)) != EOF)
+    while ((ch = mxml_getc(p)) != EOF)
       if (isspace(ch) || ch == '=' || ch == '/' || ch == '>' || ch == '?')
         break;
       else if (mxml_add_char(ch, &ptr, &name, &namesize))
@@ -939,7 +1097,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
       * Read the attribute value...
       */
 
-      if ((ch = (*getc_cb)(p)) == EOF)
+      if ((ch = mxml_getc(p)) == EOF)
       {
         fprintf(stderr, "Missing value for attribute '%s' in element %s!\n",
 	        name, node->value.element.name);
@@ -957,7 +1115,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
         quote = ch;
 	ptr   = value;
 
-        while ((ch = (*getc_cb)(p)) != EOF)
+        while ((ch = mxml_getc(p)) != EOF)
 	  if (ch == quote)
 	    break;
 	  else if (mxml_add_char(ch, &ptr, &value, &valsize))
@@ -977,7 +1135,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
 	value[0] = ch;
 	ptr      = value + 1;
 
-	while ((ch = (*getc_cb)(p)) != EOF)
+	while ((ch = mxml_getc(p)) != EOF)
 	  if (isspace(ch) || ch == '=' || ch == '/' || ch == '>')
             break;
 	  else if (mxml_add_char(ch, &ptr, &value, &valsize))
@@ -1002,7 +1160,7 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
       * Grab the > character and print an error if it isn't there...
       */
 
-      quote = (*getc_cb)(p);
+      quote = mxml_getc(p);
 
       if (quote != '>')
       {
@@ -1034,29 +1192,6 @@ mxml_parse_element(stp_mxml_node_t *node,	/* I - Element node */
 }
 
 
-/*
- * 'mxml_string_getc()' - Get a character from a string.
- */
-
-static int				/* O - Character or EOF */
-mxml_string_getc(void *p)		/* I - Pointer to file */
-{
-  int		ch;			/* Character */
-  const char	**s;			/* Pointer to string pointer */
-
-
-  s = (const char **)p;
-
-  if ((ch = *s[0]) != 0)
-  {
-    (*s)++;
-    return (ch);
-  }
-  else
-    return (EOF);
-}
-
-
 /*
  * 'mxml_string_putc()' - Write a character to a string.
  */
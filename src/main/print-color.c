@@ -36,6 +36,9 @@
 #include <limits.h>
 #endif
 #include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #include "color-conversion.h"
 
 #ifdef __GNUC__
@@ -509,6 +512,33 @@ static stp_curve_t *sat_map_bounds = NULL;
 static stp_curve_t *color_curve_bounds = NULL;
 static stp_curve_t *gcr_curve_bounds = NULL;
 
+/*
+ * Settings-derived state of the most recently initialized page, kept so
+ * that subsequent pages printed with the same settings can skip
+ * recomputing it.  The per-page input buffer is not part of this.
+ * Drivers print each page from a private copy of the caller's vars, so
+ * this belongs to the color module rather than to any vars object; it
+ * is freed when the module exits.  It is only read or replaced with
+ * page_lut_lock held.
+ */
+typedef struct
+{
+  stp_vars_t *settings;		/* Settings the LUT was computed from */
+  unsigned long fingerprint;	/* stp_vars_get_fingerprint(settings) */
+  lut_t *lut;
+  stp_curve_t *gcr_curve;
+} page_lut_t;
+
+static page_lut_t *page_lut = NULL;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t page_lut_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_PAGE_LUT() pthread_mutex_lock(&page_lut_lock)
+#define UNLOCK_PAGE_LUT() pthread_mutex_unlock(&page_lut_lock)
+#else
+#define LOCK_PAGE_LUT() do { } while (0)
+#define UNLOCK_PAGE_LUT() do { } while (0)
+#endif
+
 
 #define RAW_CURVE_CHANNEL(channel)				\
   {								\
@@ -751,22 +781,82 @@ initialize_channels(stp_vars_t *v, stp_image_t *image)
   lut->channels_are_initialized = 1;
 }
 
+/*
+ * Images that can deliver (or map) several rows at a time are read a
+ * tile of rows ahead of the driver, which saves a callback and usually
+ * a copy per row.  Drivers may skip rows, so the tile is bounded in
+ * size, and any row outside it starts a new tile.
+ */
+#define TILE_BYTES (256 * 1024)
+#define TILE_MAX_ROWS 32
+
+static const unsigned char *
+get_tiled_row(lut_t *lut, stp_image_t *image, size_t row_bytes, int row)
+{
+  int max_rows = TILE_BYTES / row_bytes;
+  int count;
+  if (lut->tile_data && row >= lut->tile_row &&
+      row < lut->tile_row + lut->tile_count)
+    return lut->tile_data + (row - lut->tile_row) * row_bytes;
+
+  lut->tile_data = NULL;
+  count = stp_image_height(image) - row;
+  if (image->map_rows)
+    {
+      int mapped = 0;
+      const unsigned char *data =
+	stp_image_map_rows(image, row_bytes, row, &mapped);
+      if (data && mapped > 0)
+	{
+	  lut->tile_data = data;
+	  lut->tile_row = row;
+	  lut->tile_count = mapped < count ? mapped : count;
+	  return data;
+	}
+    }
+  if (max_rows > TILE_MAX_ROWS)
+    max_rows = TILE_MAX_ROWS;
+  else if (max_rows < 1)
+    max_rows = 1;
+  if (count > max_rows)
+    count = max_rows;
+  else if (count < 1)
+    count = 1;
+  if (!lut->in_tile)
+    lut->in_tile = stp_malloc(max_rows * row_bytes);
+  if (stp_image_get_rows(image, lut->in_tile, row_bytes, row, count) !=
+      STP_IMAGE_STATUS_OK)
+    return NULL;
+  lut->tile_data = lut->in_tile;
+  lut->tile_row = row;
+  lut->tile_count = count;
+  return lut->tile_data;
+}
+
 static int
 stpi_color_traditional_get_row(stp_vars_t *v,
 			       stp_image_t *image,
 			       int row,
 			       unsigned *zero_mask)
 {
-  const lut_t *lut = (const lut_t *)(stp_get_component_data(v, "Color"));
+  lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
+  size_t row_bytes =
+    lut->image_width * lut->in_channels * lut->channel_depth / 8;
+  const unsigned char *in = lut->in_data;
   unsigned zero;
-  if (stp_image_get_row(image, lut->in_data,
-			lut->image_width * lut->in_channels * lut->channel_depth / 8, row)
-      != STP_IMAGE_STATUS_OK)
+  if (image->get_rows || image->map_rows)
+    {
+      in = get_tiled_row(lut, image, row_bytes, row);
+      if (!in)
+	return 2;
+    }
+  else if (stp_image_get_row(image, lut->in_data, row_bytes, row)
+	   != STP_IMAGE_STATUS_OK)
     return 2;
   if (!lut->channels_are_initialized)
     initialize_channels(v, image);
   zero = (lut->output_color_description->conversion_function)
-    (v, lut->in_data, stp_channel_get_input(v));
+    (v, in, stp_channel_get_input(v));
   if (zero_mask)
     *zero_mask = zero;
   stp_channel_convert(v, zero_mask);
@@ -824,6 +914,7 @@ copy_lut(void *vlut)
       stp_curve_cache_copy(&(dest->channel_curves[i]), &(src->channel_curves[i]));
       dest->gamma_values[i] = src->gamma_values[i];
     }
+  dest->computed_curves = src->computed_curves;
   stp_curve_cache_copy(&(dest->brightness_correction),
 		       &(src->brightness_correction));
   stp_curve_cache_copy(&(dest->contrast_correction),
@@ -842,6 +933,7 @@ copy_lut(void *vlut)
   stp_curve_cache_copy(&(dest->sat_map), &(src->sat_map));
   /* Don't copy gray_tmp */
   /* Don't copy cmy_tmp */
+  /* Don't copy in_tile */
   if (src->in_data)
     {
       dest->in_data = stp_malloc(src->image_width * src->in_channels);
@@ -864,6 +956,7 @@ free_lut(void *vlut)
   STP_SAFE_FREE(lut->gray_tmp);
   STP_SAFE_FREE(lut->cmy_tmp);
   STP_SAFE_FREE(lut->in_data);
+  STP_SAFE_FREE(lut->in_tile);
   memset(lut, 0, sizeof(lut_t));
   stp_free(lut);
 }
@@ -932,6 +1025,18 @@ compute_gcr_curve(const stp_vars_t *vars)
   return curve;
 }
 
+static int
+lut_uses_gcr_curve(const lut_t *lut)
+{
+  return (((lut->output_color_description->channels & CMASK_CMYK) ==
+	   CMASK_CMYK) &&
+	  (lut->color_correction->correction == COLOR_CORRECTION_DESATURATED ||
+	   lut->input_color_description->color_id == COLOR_ID_GRAY ||
+	   lut->input_color_description->color_id == COLOR_ID_WHITE ||
+	   lut->input_color_description->color_id == COLOR_ID_RGB ||
+	   lut->input_color_description->color_id == COLOR_ID_CMY));
+}
+
 static void
 initialize_gcr_curve(stp_vars_t *vars)
 {
@@ -1274,9 +1379,42 @@ invert_curve(stp_curve_t *curve, int invert_output)
     }
 }
 
+/*
+ * When the settings change between pages (or, more commonly, between
+ * successive previews while the user adjusts one control), most of the
+ * curves are still the same as last time.  If the previous LUT was
+ * computed for the same color spaces and number of steps, any curve
+ * whose own inputs are unchanged can simply be copied from it.
+ */
+static const lut_t *
+comparable_page_lut(const lut_t *lut)
+{
+  const lut_t *prev = lut->previous;
+  if (prev &&
+      prev->steps == lut->steps &&
+      prev->input_color_description == lut->input_color_description &&
+      prev->output_color_description == lut->output_color_description &&
+      prev->invert_output == lut->invert_output)
+    return prev;
+  else
+    return NULL;
+}
+
+static int
+channel_curve_is_reusable(const lut_t *lut, const lut_t *prev, int channel)
+{
+  return (prev &&
+	  (prev->computed_curves & (1ull << channel)) &&
+	  prev->gamma_values[channel] == lut->gamma_values[channel] &&
+	  prev->screen_gamma == lut->screen_gamma &&
+	  prev->print_gamma == lut->print_gamma &&
+	  prev->simple_gamma_correction == lut->simple_gamma_correction);
+}
+
 static void
 compute_one_lut(lut_t *lut, int i)
 {
+  const lut_t *prev;
   stp_curve_t *curve =
     stp_curve_cache_get_curve(&(lut->channel_curves[i]));
   if (curve)
@@ -1291,6 +1429,13 @@ compute_one_lut(lut_t *lut, int i)
 	invert_curve(curve, invert_output);
       stp_curve_resample(curve, lut->steps);
     }
+  else if (channel_curve_is_reusable(lut, (prev = comparable_page_lut(lut)),
+				     i))
+    {
+      stp_curve_cache_copy(&(lut->channel_curves[i]),
+			   &(prev->channel_curves[i]));
+      lut->computed_curves |= 1ull << i;
+    }
   else
     {
       curve = stp_curve_create_copy(color_curve_bounds);
@@ -1298,6 +1443,7 @@ compute_one_lut(lut_t *lut, int i)
 			STP_CURVE_BOUNDS_RESCALE);
       stp_curve_cache_set_curve(&(lut->channel_curves[i]), curve);
       compute_a_curve(lut, i);
+      lut->computed_curves |= 1ull << i;
     }
 }
 
@@ -1395,6 +1541,7 @@ stpi_compute_lut(stp_vars_t *v)
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
   double app_gamma_scale = 4.0;
   stp_curve_t *curve;
+  const lut_t *prev;
   stp_dprintf(STP_DBG_LUT, v, "stpi_compute_lut\n");
 
   if (lut->input_color_description->color_model == COLOR_UNKNOWN ||
@@ -1429,19 +1576,35 @@ stpi_compute_lut(stp_vars_t *v)
   if (stp_check_boolean_parameter(v, "SimpleGamma", STP_PARAMETER_ACTIVE))
     lut->simple_gamma_correction = stp_get_boolean_parameter(v, "SimpleGamma");
   lut->screen_gamma = lut->app_gamma / app_gamma_scale; /* "Empirical" */
-  curve = stp_curve_create_copy(color_curve_bounds);
-  stp_curve_rescale(curve, 65535.0, STP_CURVE_COMPOSE_MULTIPLY,
-		    STP_CURVE_BOUNDS_RESCALE);
-  stp_curve_cache_set_curve(&(lut->user_color_correction), curve);
-  curve = stp_curve_create_copy(color_curve_bounds);
-  stp_curve_rescale(curve, 65535.0, STP_CURVE_COMPOSE_MULTIPLY,
-		    STP_CURVE_BOUNDS_RESCALE);
-  stp_curve_cache_set_curve(&(lut->brightness_correction), curve);
-  curve = stp_curve_create_copy(color_curve_bounds);
-  stp_curve_rescale(curve, 65535.0, STP_CURVE_COMPOSE_MULTIPLY,
-		    STP_CURVE_BOUNDS_RESCALE);
-  stp_curve_cache_set_curve(&(lut->contrast_correction), curve);
-  compute_user_correction(lut);
+  prev = comparable_page_lut(lut);
+  if (prev && prev->brightness == lut->brightness &&
+      prev->contrast == lut->contrast &&
+      prev->linear_contrast_adjustment == lut->linear_contrast_adjustment)
+    {
+      stp_dprintf(STP_DBG_LUT, v, " reusing user correction\n");
+      stp_curve_cache_copy(&(lut->user_color_correction),
+			   &(prev->user_color_correction));
+      stp_curve_cache_copy(&(lut->brightness_correction),
+			   &(prev->brightness_correction));
+      stp_curve_cache_copy(&(lut->contrast_correction),
+			   &(prev->contrast_correction));
+    }
+  else
+    {
+      curve = stp_curve_create_copy(color_curve_bounds);
+      stp_curve_rescale(curve, 65535.0, STP_CURVE_COMPOSE_MULTIPLY,
+			STP_CURVE_BOUNDS_RESCALE);
+      stp_curve_cache_set_curve(&(lut->user_color_correction), curve);
+      curve = stp_curve_create_copy(color_curve_bounds);
+      stp_curve_rescale(curve, 65535.0, STP_CURVE_COMPOSE_MULTIPLY,
+			STP_CURVE_BOUNDS_RESCALE);
+      stp_curve_cache_set_curve(&(lut->brightness_correction), curve);
+      curve = stp_curve_create_copy(color_curve_bounds);
+      stp_curve_rescale(curve, 65535.0, STP_CURVE_COMPOSE_MULTIPLY,
+			STP_CURVE_BOUNDS_RESCALE);
+      stp_curve_cache_set_curve(&(lut->contrast_correction), curve);
+      compute_user_correction(lut);
+    }
 
   /*
    * TODO check that these are wraparound curves and all that
@@ -1487,41 +1650,19 @@ stpi_compute_lut(stp_vars_t *v)
 	       lut->output_color_description->channels & (1 << i))
 	setup_channel(v, i, &(channel_params[i]));
     }
-  if (((lut->output_color_description->channels & CMASK_CMYK) == CMASK_CMYK) &&
-      (lut->color_correction->correction == COLOR_CORRECTION_DESATURATED ||
-       lut->input_color_description->color_id == COLOR_ID_GRAY ||
-       lut->input_color_description->color_id == COLOR_ID_WHITE ||
-       lut->input_color_description->color_id == COLOR_ID_RGB ||
-       lut->input_color_description->color_id == COLOR_ID_CMY))
+  if (lut_uses_gcr_curve(lut))
     initialize_gcr_curve(v);
   if (stp_check_file_parameter(v, "LUTDumpFile", STP_PARAMETER_ACTIVE))
     stpi_dump_lut_to_file(v, stp_get_file_parameter(v, "LUTDumpFile"));
 }
 
-static int
-stpi_color_traditional_init(stp_vars_t *v,
-			    stp_image_t *image,
-			    size_t steps)
+static lut_t *
+compile_lut(stp_vars_t *v, size_t steps, const channel_depth_t *channel_depth,
+	    const lut_t *previous)
 {
   lut_t *lut;
   const char *image_type = stp_get_string_parameter(v, "ImageType");
   const char *color_correction = stp_get_string_parameter(v, "ColorCorrection");
-  const channel_depth_t *channel_depth =
-    get_channel_depth(stp_get_string_parameter(v, "ChannelBitDepth"));
-  size_t total_channel_bits;
-
-  if (steps != 256 && steps != 65536)
-    {
-      stp_eprintf(v,
-		  "stpi_color_traditional_init: Invalid color steps %lu (must be 256 or 65536)\n",
-		  (unsigned long) steps);
-      return -1;
-    }
-  if (!channel_depth)
-    {
-      stp_eprintf(v, "stpi_color_traditional_init: ChannelBitDepth not set\n");
-      return -1;
-    }
 
   lut = allocate_lut();
   lut->input_color_description =
@@ -1533,7 +1674,7 @@ stpi_color_traditional_init(stp_vars_t *v,
     {
       stp_eprintf(v, "stpi_color_traditional_init: input/output types not specified\n");
       free_lut(lut);
-      return -1;
+      return NULL;
     }
 
   if (lut->input_color_description->color_id == COLOR_ID_RAW)
@@ -1542,7 +1683,7 @@ stpi_color_traditional_init(stp_vars_t *v,
 	{
 	  stp_eprintf(v, "stpi_color_traditional_init: raw printing requested but STPIRawChannels not set\n");
 	  free_lut(lut);
-	  return -1;
+	  return NULL;
 	}
       lut->out_channels = stp_get_int_parameter(v, "STPIRawChannels");
       lut->in_channels = lut->out_channels;
@@ -1574,7 +1715,130 @@ stpi_color_traditional_init(stp_vars_t *v,
       (get_color_correction_by_tag
        (lut->output_color_description->default_correction));
 
+  lut->previous = previous;
   stpi_compute_lut(v);
+  lut->previous = NULL;
+  return lut;
+}
+
+static void
+free_page_lut(page_lut_t *cache)
+{
+  if (cache)
+    {
+      stp_vars_destroy(cache->settings);
+      free_lut(cache->lut);
+      if (cache->gcr_curve)
+	stp_curve_destroy(cache->gcr_curve);
+      stp_free(cache);
+    }
+}
+
+static void
+forget_page_lut(void)
+{
+  page_lut_t *old;
+  LOCK_PAGE_LUT();
+  old = page_lut;
+  page_lut = NULL;
+  UNLOCK_PAGE_LUT();
+  free_page_lut(old);
+}
+
+static void
+remember_page_lut(stp_vars_t *v, stp_vars_t *settings, const lut_t *lut,
+		  unsigned long fingerprint)
+{
+  page_lut_t *cache = stp_zalloc(sizeof(page_lut_t));
+  page_lut_t *old;
+  cache->settings = settings;
+  cache->fingerprint = fingerprint;
+  cache->lut = copy_lut(stpi_cast_safe(lut));
+  if (lut_uses_gcr_curve(lut))
+    {
+      const stp_curve_t *gcr_curve = stp_channel_get_gcr_curve(v);
+      if (gcr_curve)
+	cache->gcr_curve = stp_curve_create_copy(gcr_curve);
+    }
+  LOCK_PAGE_LUT();
+  old = page_lut;
+  page_lut = cache;
+  UNLOCK_PAGE_LUT();
+  free_page_lut(old);
+}
+
+static int
+stpi_color_traditional_init(stp_vars_t *v,
+			    stp_image_t *image,
+			    size_t steps)
+{
+  lut_t *lut;
+  const channel_depth_t *channel_depth =
+    get_channel_depth(stp_get_string_parameter(v, "ChannelBitDepth"));
+  size_t total_channel_bits;
+  unsigned long fingerprint;
+  lut_t *previous = NULL;
+  stp_curve_t *gcr_curve = NULL;
+
+  if (steps != 256 && steps != 65536)
+    {
+      stp_eprintf(v,
+		  "stpi_color_traditional_init: Invalid color steps %lu (must be 256 or 65536)\n",
+		  (unsigned long) steps);
+      return -1;
+    }
+  if (!channel_depth)
+    {
+      stp_eprintf(v, "stpi_color_traditional_init: ChannelBitDepth not set\n");
+      return -1;
+    }
+
+  /*
+   * Successive pages of a job are normally printed with identical
+   * settings, in which case everything computed from the settings
+   * (the curves, in particular) is the same as last time.
+   */
+  fingerprint = stp_vars_get_fingerprint(v);
+  lut = NULL;
+  LOCK_PAGE_LUT();
+  if (page_lut)
+    {
+      if (page_lut->fingerprint == fingerprint &&
+	  page_lut->lut->steps == steps &&
+	  !stp_check_file_parameter(v, "LUTDumpFile", STP_PARAMETER_ACTIVE) &&
+	  stp_vars_settings_equal(page_lut->settings, v))
+	{
+	  lut = copy_lut(page_lut->lut);
+	  if (page_lut->gcr_curve)
+	    gcr_curve = stp_curve_create_copy(page_lut->gcr_curve);
+	}
+      else
+	previous = copy_lut(page_lut->lut);
+    }
+  UNLOCK_PAGE_LUT();
+  if (lut)
+    {
+      stp_dprintf(STP_DBG_LUT, v, "stpi_color_traditional_init: reusing LUT\n");
+      stp_allocate_component_data(v, "Color", copy_lut, free_lut, lut);
+      if (gcr_curve)
+	{
+	  stp_channel_set_gcr_curve(v, gcr_curve);
+	  stp_curve_destroy(gcr_curve);
+	}
+    }
+  else
+    {
+      stp_vars_t *settings = stpi_vars_create_settings_copy(v);
+      lut = compile_lut(v, steps, channel_depth, previous);
+      if (previous)
+	free_lut(previous);
+      if (!lut)
+	{
+	  stp_vars_destroy(settings);
+	  return -1;
+	}
+      remember_page_lut(v, settings, lut, fingerprint);
+    }
 
   lut->image_width = stp_image_width(image);
   total_channel_bits = lut->in_channels * lut->channel_depth;
@@ -1861,6 +2125,7 @@ color_traditional_module_init(void)
 static int
 color_traditional_module_exit(void)
 {
+  forget_page_lut();
   return stp_color_unregister(&stpi_color_traditional_module_data);
 }
 
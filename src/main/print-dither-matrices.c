@@ -638,7 +638,7 @@ stpi_dither_array_create_from_file(const char* file, int x, int y)
   stp_deprintf(STP_DBG_XML,
 	       "stpi_dither_array_create_from_file: reading `%s'...\n", file);
 
-  doc = stp_mxmlLoadFile(NULL, fp, STP_MXML_NO_CALLBACK);
+  doc = stp_mxmlLoadFile(NULL, fp, stpi_xml_type_callback);
   (void) fclose(fp);
 
   if (doc)
@@ -2400,6 +2400,58 @@ typedef struct Lexmark_head_colors {
   int used_jets;
 } Lexmark_head_colors;
 
+/*
+ * The printer takes the image one column at a time, with a bit for each
+ * nozzle, while the weave hands us rows.  Rather than extract the bits
+ * one by one we transpose 8x8 blocks: for each of 8 adjacent columns,
+ * byte g of the result holds nozzles 8g through 8g+7, lowest nozzle in
+ * the high bit.
+ */
+static unsigned long long
+lexmark_transpose8(unsigned long long x)
+{
+  unsigned long long t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+/* rows[n] is the raster line for nozzle n, or NULL if it doesn't fire. */
+static void
+lexmark_transpose_block(unsigned char *const *rows, int nozzles, int block,
+			unsigned char *cols, int groups)
+{
+  int g, i;
+  for (g = 0; g < groups; g++)
+    {
+      unsigned long long w = 0;
+      for (i = 0; i < 8 && (g * 8) + i < nozzles; i++)
+	if (rows[(g * 8) + i])
+	  w |= (unsigned long long) rows[(g * 8) + i][block] << (56 - (8 * i));
+      if (w)
+	w = lexmark_transpose8(w);
+      for (i = 0; i < 8; i++)
+	cols[(i * groups) + g] = (unsigned char) (w >> (56 - (8 * i)));
+    }
+}
+
+/* Interleave two nozzle bytes into the 16 bit form the head takes. */
+static unsigned short
+lexmark_interleave(unsigned even, unsigned odd)
+{
+  even = (even | (even << 4)) & 0x0f0f;
+  even = (even | (even << 2)) & 0x3333;
+  even = (even | (even << 1)) & 0x5555;
+  odd = (odd | (odd << 4)) & 0x0f0f;
+  odd = (odd | (odd << 2)) & 0x3333;
+  odd = (odd | (odd << 1)) & 0x5555;
+  return (unsigned short) ((even << 1) | odd);
+}
+
 /* lexmark_write
    This method is has NO printer type dependent code.
    This method writes a single line of the print. The line consists of "pass_length"
@@ -2431,6 +2483,7 @@ lexmark_write(const stp_vars_t *v,		/* I - Print file or command */
   int y;  /* actual horizontal position */
   int dy; /* horiz. inkjet position */
   int x1;
+  int g;
   unsigned short pixelline;  /* byte to be written */
   unsigned int valid_bytes; /* bit list which tells the present bytes */
   int xStart=0; /* count start for horizontal line */
@@ -2439,6 +2492,11 @@ lexmark_write(const stp_vars_t *v,		/* I - Print file or command */
   int anyCol=0;
   int colIndex;
   int rwidth; /* real with used at printing (includes shift between even & odd nozzles) */
+  int nozzles = 0; /* nozzle pairs across all heads */
+  int groups;
+  unsigned char **even_rows, **odd_rows;
+  unsigned char *even_cols, *odd_cols;
+  int even_block = -1, odd_block = -1;
   /* stp_dprintf(STP_DBG_LEXMARK, v, "<%c>",("CMYKcmy"[coloridx])); */
   stp_dprintf(STP_DBG_LEXMARK, v, "pass length %d\n", pass_length);
 
@@ -2480,9 +2538,47 @@ lexmark_write(const stp_vars_t *v,		/* I - Print file or command */
   /* now we can start to write the pixels */
   yCount = 2;
 
+  /*
+   * Work out which raster line feeds each nozzle.  Each head covers a
+   * range of nozzle pairs; the first of each pair prints at x, the
+   * second at x + lr_shift.  Nozzles that no head covers are sent as
+   * blank.  Two heads sharing a nozzle is a bug in the head tables.
+   */
+  for (colIndex=0; colIndex < 3; colIndex++) {
+    const Lexmark_head_colors *h = &head_colors[colIndex];
+    int other;
+    if (h->head_nozzle_end <= h->head_nozzle_start)
+      continue;
+    for (other=0; other < colIndex; other++) {
+      const Lexmark_head_colors *o = &head_colors[other];
+      STPI_ASSERT(o->head_nozzle_end <= o->head_nozzle_start ||
+		  h->head_nozzle_start >= o->head_nozzle_end ||
+		  o->head_nozzle_start >= h->head_nozzle_end, v);
+    }
+    if (h->head_nozzle_end > nozzles)
+      nozzles = h->head_nozzle_end;
+  }
+  groups = (nozzles + 7) / 8;
+  even_rows = stp_zalloc(2 * (nozzles + 1) * sizeof(unsigned char *));
+  odd_rows = even_rows + nozzles + 1;
+  even_cols = stp_zalloc(2 * 8 * (groups + 1));
+  odd_cols = even_cols + (8 * (groups + 1));
+  for (colIndex=0; colIndex < 3; colIndex++) {
+    if (head_colors[colIndex].line != NULL) {
+      for (dy=head_colors[colIndex].head_nozzle_start,y=head_colors[colIndex].v_start*yCount;
+	   (dy < head_colors[colIndex].head_nozzle_end);
+	   y+=yCount, dy++) {
+	if ((dy - head_colors[colIndex].head_nozzle_start) < (head_colors[colIndex].used_jets/2))
+	  even_rows[dy] = head_colors[colIndex].line + (y*length);
+	if (((dy - head_colors[colIndex].head_nozzle_start)+1) < (head_colors[colIndex].used_jets/2))
+	  odd_rows[dy] = head_colors[colIndex].line + (((yCount>>1)+y)*length);
+      }
+    }
+  }
 
   for (x=xStart; x != xEnd; x+=xIter) {
     int  anyDots=0; /* tells us if there was any dot to print */
+    const unsigned char *even = NULL, *odd = NULL;
 
        switch(caps->model)	{
 	case m_z52:
@@ -2509,62 +2605,59 @@ lexmark_write(const stp_vars_t *v,		/* I - Print file or command */
     anyDots =0;
     x1 = x+get_lr_shift(mode);
 
-    for (colIndex=0; colIndex < 3; colIndex++) {
-      for (dy=head_colors[colIndex].head_nozzle_start,y=head_colors[colIndex].v_start*yCount;
-	   (dy < head_colors[colIndex].head_nozzle_end);
-	   y+=yCount, dy++) { /* we start counting with 1 !!!! */
-	if (head_colors[colIndex].line != NULL) {
-	  pixelline = pixelline << 1;
-	  if ((x >= 0) &&
-	      ((dy - head_colors[colIndex].head_nozzle_start) < (head_colors[colIndex].used_jets/2)))
-	    pixelline = pixelline | ((head_colors[colIndex].line[(y*length)+(x/8)] >> (7-(x%8))) & 0x1);
-	  pixelline = pixelline << 1;
-	  if ((x1 < width) &&
-	      (((dy - head_colors[colIndex].head_nozzle_start)+1) < (head_colors[colIndex].used_jets/2)))
-	    pixelline = pixelline | ((head_colors[colIndex].line[(((yCount>>1)+y)*length)+ (x1/8)] >> (7-(x1%8))) & 0x1);
+    if (x >= 0) {
+      if ((x / 8) != even_block) {
+	even_block = x / 8;
+	lexmark_transpose_block(even_rows, nozzles, even_block, even_cols, groups);
+      }
+      even = even_cols + ((x % 8) * groups);
+    }
+    if (x1 < width) {
+      if ((x1 / 8) != odd_block) {
+	odd_block = x1 / 8;
+	lexmark_transpose_block(odd_rows, nozzles, odd_block, odd_cols, groups);
+      }
+      odd = odd_cols + ((x1 % 8) * groups);
+    }
 
+    switch(caps->model)		{
+    case m_z52:
+      for (g = 0; g < nozzles / 8; g++) {
+	pixelline = lexmark_interleave(even ? even[g] : 0, odd ? odd[g] : 0);
+	/* we have two bytes, write them */
+	anyDots |= pixelline;
+	valid_bytes = valid_bytes >> 1;
+	if (pixelline) {
+	  /* we have some dots */
+	  *((p++)) = (unsigned char)(pixelline >> 8);
+	  *((p++)) = (unsigned char)(pixelline & 0xff);
 	} else {
-	  pixelline = pixelline << 2;
+	  /* there are no dots ! */
+	  valid_bytes |= 0x1000;
 	}
-	switch(caps->model)		{
-	case m_z52:
-	  if ((dy%8) == 7) {
-	    /* we have two bytes, write them */
-	    anyDots |= pixelline;
-	    if (pixelline) {
-	      /* we have some dots */
-	      valid_bytes = valid_bytes >> 1;
-	      *((p++)) = (unsigned char)(pixelline >> 8);
-	      *((p++)) = (unsigned char)(pixelline & 0xff);
-	    } else {
-	      /* there are no dots ! */
-	      valid_bytes = valid_bytes >> 1;
-	      valid_bytes |= 0x1000;
-	    }
-	    pixelline =0;
-	  }
-	  break;
-
-	case m_3200:
-	case m_z42:
-	  if((dy % 4) == 3)
-	    {
-	      anyDots |= pixelline;
-	      valid_bytes <<= 1;
-
-	      if(pixelline)
-		*(p++) = (unsigned char)(pixelline & 0xff);
-	      else
-		valid_bytes |= 0x01;
+      }
+      break;
 
-	      pixelline = 0;
-	    }
-	  break;
+    case m_3200:
+    case m_z42:
+      for (g = 0; g < nozzles / 4; g++) {
+	pixelline = lexmark_interleave(even ? even[g / 2] : 0, odd ? odd[g / 2] : 0);
+	if (g & 1)
+	  pixelline &= 0xff;
+	else
+	  pixelline >>= 8;
+	anyDots |= pixelline;
+	valid_bytes <<= 1;
 
-	case m_lex7500:
-	  break;
-	}
+	if(pixelline)
+	  *(p++) = (unsigned char)(pixelline & 0xff);
+	else
+	  valid_bytes |= 0x01;
       }
+      break;
+
+    case m_lex7500:
+      break;
     }
 
     switch(caps->model)	{
@@ -2600,6 +2693,9 @@ lexmark_write(const stp_vars_t *v,		/* I - Print file or command */
     }
   }
 
+  stp_free(even_rows);
+  stp_free(even_cols);
+
   stp_dprintf(STP_DBG_LEXMARK, v, "lexmark: 4\n");
 
   clen=((unsigned char *)p)-prnBuf;
@@ -42,8 +42,17 @@ struct stp_list_item
   void *data;			/*!< Data		*/
   struct stp_list_item *prev;	/*!< Previous node	*/
   struct stp_list_item *next;	/*!< Next node		*/
+  struct stp_list *list;	/*!< List holding node	*/
 };
 
+/** An open addressing hash of list nodes by name. */
+typedef struct
+{
+  struct stp_list_item **slots;	/*!< Nodes by name hash			*/
+  int size;			/*!< Slots (power of 2)			*/
+  int count;			/*!< Names indexed			*/
+} name_index_t;
+
 /** The internal representation of an stp_list_t list. */
 struct stp_list
 {
@@ -61,8 +70,16 @@ struct stp_list
   stp_node_sortfunc sortfunc;			/*!< Callback to compare (sort) nodes	*/
   int index_cache;				/*!< Cached node index			*/
   int length;					/*!< Number of nodes			*/
+  int index_names;				/*!< Keep name indexes			*/
+  name_index_t name_index;			/*!< Index by name			*/
+  name_index_t long_name_index;			/*!< Index by long name			*/
 };
 
+/**
+ * Lists shorter than this are searched rather than indexed.
+ */
+#define NAME_INDEX_MIN 8
+
 /**
  * Cache a list node by its short name.
  * @param list the list to use.
@@ -114,6 +131,110 @@ clear_cache(stp_list_t *list)
   set_long_name_cache(list, NULL, NULL);
 }
 
+static unsigned
+name_hash(const char *name)
+{
+  unsigned hash = 2166136261U;
+  while (*name)
+    hash = (hash ^ (unsigned char) *name++) * 16777619U;
+  return hash;
+}
+
+/**
+ * Find the slot holding a name, or the empty slot where it belongs.
+ * @param index the index to use.
+ * @param namefunc the function giving the names indexed.
+ * @param name the name to find.
+ * @returns the slot number.
+ */
+static int
+name_index_slot(const name_index_t *index, stp_node_namefunc namefunc,
+		const char *name)
+{
+  int mask = index->size - 1;
+  int slot = name_hash(name) & mask;
+  while (index->slots[slot] &&
+	 strcmp(name, namefunc(index->slots[slot]->data)))
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+/**
+ * Add a node to a name index.  If the name is already present, the
+ * node earlier in the list is kept, as that is the one a search finds.
+ * @param index the index to use.
+ * @param namefunc the function giving the names indexed.
+ * @param node the node to add; it must follow every node already indexed.
+ */
+static void
+name_index_add(name_index_t *index, stp_node_namefunc namefunc,
+	       stp_list_item_t *node)
+{
+  int slot;
+  if (2 * (index->count + 1) > index->size)
+    {
+      stp_list_item_t **old = index->slots;
+      int old_size = index->size;
+      int i;
+      index->size = old_size ? old_size * 2 : 2 * NAME_INDEX_MIN;
+      index->slots = stp_zalloc(index->size * sizeof(stp_list_item_t *));
+      for (i = 0; i < old_size; i++)
+	if (old[i])
+	  index->slots[name_index_slot(index, namefunc,
+				       namefunc(old[i]->data))] = old[i];
+      STP_SAFE_FREE(old);
+    }
+  slot = name_index_slot(index, namefunc, namefunc(node->data));
+  if (!index->slots[slot])
+    {
+      index->slots[slot] = node;
+      index->count++;
+    }
+}
+
+static void
+name_index_free(name_index_t *index)
+{
+  STP_SAFE_FREE(index->slots);
+  index->size = 0;
+  index->count = 0;
+}
+
+/**
+ * Discard the name indexes; they are rebuilt when next needed.
+ * @param list the list to use.
+ */
+static void
+clear_name_index(stp_list_t *list)
+{
+  name_index_free(&(list->name_index));
+  name_index_free(&(list->long_name_index));
+}
+
+/**
+ * Find the first node with a name, building the index if need be.
+ * @param list the list to use.
+ * @param index the index to use.
+ * @param namefunc the function giving the names indexed.
+ * @param name the name to find.
+ * @returns the node, or NULL if there is none.
+ */
+static stp_list_item_t *
+name_index_find(stp_list_t *list, name_index_t *index,
+		stp_node_namefunc namefunc, const char *name)
+{
+  if (!index->slots)
+    {
+      stp_list_item_t *node = list->start;
+      while (node)
+	{
+	  name_index_add(index, namefunc, node);
+	  node = node->next;
+	}
+    }
+  return index->slots[name_index_slot(index, namefunc, name)];
+}
+
 void
 stp_list_node_free_data (void *item)
 {
@@ -150,6 +271,13 @@ stp_list_create(void)
   list->name_cache_node = NULL;
   list->long_name_cache = NULL;
   list->long_name_cache_node = NULL;
+  list->index_names = 0;
+  list->name_index.slots = NULL;
+  list->name_index.size = 0;
+  list->name_index.count = 0;
+  list->long_name_index.slots = NULL;
+  list->long_name_index.size = 0;
+  list->long_name_index.count = 0;
 
   stp_deprintf(STP_DBG_LIST, "stp_list_head constructor\n");
   return list;
@@ -172,6 +300,7 @@ stp_list_copy(const stp_list_t *list)
   stp_list_set_namefunc(ret, stp_list_get_namefunc(list));
   stp_list_set_long_namefunc(ret, stp_list_get_long_namefunc(list));
   stp_list_set_sortfunc(ret, stp_list_get_sortfunc(list));
+  ret->index_names = list->index_names;
   while (item)
     {
       void *data = item->data;
@@ -200,6 +329,7 @@ stp_list_destroy(stp_list_t *list)
       stp_list_item_destroy(list, cur);
       cur = next;
     }
+  clear_name_index(list);
   stp_deprintf(STP_DBG_LIST, "stp_list_head destructor\n");
   stp_free(list);
 
@@ -374,6 +504,14 @@ stp_list_get_item_by_name(const stp_list_t *list, const char *name)
   if (!list->namefunc || !name)
     return NULL;
 
+  if (list->index_names)
+    {
+      if (list->length < NAME_INDEX_MIN)
+	return stp_list_get_item_by_name_internal(list, name);
+      return name_index_find(ulist, &(ulist->name_index), list->namefunc,
+			     name);
+    }
+
   if (list->name_cache && list->name_cache_node)
     {
       const char *new_name;
@@ -448,6 +586,14 @@ stp_list_get_item_by_long_name(const stp_list_t *list, const char *long_name)
   if (!list->long_namefunc || !long_name)
     return NULL;
 
+  if (list->index_names)
+    {
+      if (list->length < NAME_INDEX_MIN)
+	return stp_list_get_item_by_long_name_internal(list, long_name);
+      return name_index_find(ulist, &(ulist->long_name_index),
+			     list->long_namefunc, long_name);
+    }
+
   if (list->long_name_cache && list->long_name_cache_node)
     {
       const char *new_long_name;
@@ -525,6 +671,7 @@ void
 stp_list_set_namefunc(stp_list_t *list, stp_node_namefunc namefunc)
 {
   check_list(list);
+  clear_name_index(list);
   list->namefunc = namefunc;
 }
 
@@ -540,6 +687,7 @@ void
 stp_list_set_long_namefunc(stp_list_t *list, stp_node_namefunc long_namefunc)
 {
   check_list(list);
+  clear_name_index(list);
   list->long_namefunc = long_namefunc;
 }
 
@@ -550,6 +698,13 @@ stp_list_get_long_namefunc(const stp_list_t *list)
   return list->long_namefunc;
 }
 
+void
+stpi_list_index_names(stp_list_t *list)
+{
+  check_list(list);
+  list->index_names = 1;
+}
+
 /* callback for sorting nodes */
 void
 stp_list_set_sortfunc(stp_list_t *list, stp_node_sortfunc sortfunc)
@@ -591,6 +746,7 @@ stp_list_item_create(stp_list_t *list,
 
   ln = stp_malloc(sizeof(stp_list_item_t));
   ln->prev = ln->next = NULL;
+  ln->list = list;
 
   if (data)
     ln->data = stpi_cast_safe(data);
@@ -649,6 +805,16 @@ stp_list_item_create(stp_list_t *list,
   /* increment reference count */
   list->length++;
 
+  if (ln->next)
+    clear_name_index(list);
+  else
+    {
+      if (list->name_index.slots)
+	name_index_add(&(list->name_index), list->namefunc, ln);
+      if (list->long_name_index.slots)
+	name_index_add(&(list->long_name_index), list->long_namefunc, ln);
+    }
+
   stp_deprintf(STP_DBG_LIST, "stp_list_node constructor\n");
   return 0;
 }
@@ -660,6 +826,7 @@ stp_list_item_destroy(stp_list_t *list, stp_list_item_t *item)
   check_list(list);
 
   clear_cache(list);
+  clear_name_index(list);
   /* decrement reference count */
   list->length--;
 
@@ -706,6 +873,9 @@ stp_list_item_set_data(stp_list_item_t *item, void *data)
 {
   if (data)
     {
+      /* The node may now have a different name */
+      clear_cache(item->list);
+      clear_name_index(item->list);
       item->data = data;
       return 0;
     }
@@ -38,10 +38,32 @@
 #include <stdlib.h>
 #include <sys/param.h>
 
+/*
+ * Lists of paper sizes index their names (see stpi_list_index_names()).
+ * Each named list also carries a size index, which holds the papers
+ * sorted by width, so that the papers within the matching tolerance of
+ * a given size can be found by binary search; it is rebuilt when it is
+ * next needed after papers have been added or removed.
+ */
+typedef struct
+{
+  stp_dimension_t width;
+  stp_dimension_t height;
+  int position;			/* Position in the list */
+  const stp_papersize_t *paper;
+} papersize_slot_t;
+
+typedef struct
+{
+  int width_count;
+  papersize_slot_t *by_width;
+} papersize_index_t;
+
 typedef struct
 {
   char *name;
   stp_papersize_list_t *list;
+  papersize_index_t index;
 } papersize_list_impl_t;
 
 static stp_list_t *list_of_papersize_lists = NULL;
@@ -52,6 +74,7 @@ papersize_list_impl_freefunc(void *item)
   papersize_list_impl_t *papersize_list = (papersize_list_impl_t *) item;
   stp_list_destroy(papersize_list->list);
   STP_SAFE_FREE(papersize_list->name);
+  STP_SAFE_FREE(papersize_list->index.by_width);
   STP_SAFE_FREE(papersize_list);
 }
 
@@ -106,6 +129,70 @@ stpi_papersize_long_namefunc(const void *item)
   return paper->text;
 }
 
+static void
+invalidate_papersize_index(papersize_index_t *index)
+{
+  STP_SAFE_FREE(index->by_width);
+  index->width_count = 0;
+}
+
+static papersize_index_t *
+get_papersize_index(const stp_papersize_list_t *list)
+{
+  stp_list_item_t *item;
+  if (!list_of_papersize_lists)
+    return NULL;
+  item = stp_list_get_start(list_of_papersize_lists);
+  while (item)
+    {
+      papersize_list_impl_t *impl =
+	(papersize_list_impl_t *) stp_list_item_get_data(item);
+      if (impl->list == list)
+	return &(impl->index);
+      item = stp_list_item_next(item);
+    }
+  return NULL;
+}
+
+static int
+compare_papersize_slots(const void *a, const void *b)
+{
+  const papersize_slot_t *sa = (const papersize_slot_t *) a;
+  const papersize_slot_t *sb = (const papersize_slot_t *) b;
+  if (sa->width < sb->width)
+    return -1;
+  else if (sa->width > sb->width)
+    return 1;
+  else
+    return sa->position - sb->position;
+}
+
+static void
+check_papersize_size_index(papersize_index_t *index,
+			   const stp_papersize_list_t *list)
+{
+  const stp_papersize_list_item_t *ptli;
+  int count = stpi_papersize_count(list);
+  int i = 0;
+  if (index->by_width && index->width_count == count)
+    return;
+  STP_SAFE_FREE(index->by_width);
+  index->by_width = stp_malloc((count ? count : 1) * sizeof(papersize_slot_t));
+  ptli = stpi_papersize_list_get_start(list);
+  while (ptli)
+    {
+      const stp_papersize_t *paper = stpi_paperlist_item_get_data(ptli);
+      index->by_width[i].width = paper->width;
+      index->by_width[i].height = paper->height;
+      index->by_width[i].position = i;
+      index->by_width[i].paper = paper;
+      i++;
+      ptli = stpi_paperlist_item_next(ptli);
+    }
+  index->width_count = i;
+  qsort(index->by_width, i, sizeof(papersize_slot_t), compare_papersize_slots);
+}
+
 stp_papersize_list_t *
 stpi_create_papersize_list(void)
 {
@@ -113,39 +200,46 @@ stpi_create_papersize_list(void)
   stp_list_set_freefunc(papersize_list, stpi_papersize_freefunc);
   stp_list_set_namefunc(papersize_list, stpi_papersize_namefunc);
   stp_list_set_long_namefunc(papersize_list, stpi_papersize_long_namefunc);
+  stpi_list_index_names(papersize_list);
   return (stp_papersize_list_t *) papersize_list;
 }
 
 int
 stpi_papersize_create(stp_papersize_list_t *list, stp_papersize_t *p)
 {
-  stp_list_item_t *papersize_item;
+  papersize_index_t *index;
 
-  /*
-   * Check the paper does not already exist
-   * Not the most efficient way of doing it, but the number of papers
-   * is not large enough to be a significant bottleneck.
-   */
-  papersize_item = stp_list_get_start(list);
-  while (papersize_item)
+  /* Check the paper does not already exist */
+  if (stp_list_get_item_by_name(list, p->name))
     {
-      const stp_papersize_t *ep =
-	(const stp_papersize_t *) stp_list_item_get_data(papersize_item);
-      if (ep && !strcmp(p->name, ep->name))
-	{
-	  stp_erprintf("Duplicate paper size `%s'\n", p->name);
-	  stpi_papersize_freefunc(p);
-	  return 1;
-	}
-      papersize_item = stp_list_item_next(papersize_item);
+      stp_erprintf("Duplicate paper size `%s'\n", p->name);
+      stpi_papersize_freefunc(p);
+      return 1;
     }
 
   /* Add paper to list */
   stp_list_item_create(list, NULL, (void *) p);
+  index = get_papersize_index(list);
+  if (index)
+    invalidate_papersize_index(index);
 
   return 0;
 }
 
+int
+stpi_papersize_destroy(stp_papersize_list_t *list, const char *name)
+{
+  stp_list_item_t *item = stp_list_get_item_by_name(list, name);
+  papersize_index_t *index;
+
+  if (!item)
+    return 1;
+  index = get_papersize_index(list);
+  if (index)
+    invalidate_papersize_index(index);
+  return stp_list_item_destroy(list, item);
+}
+
 int
 stpi_papersize_count(const stp_papersize_list_t *paper_size_list)
 {
@@ -197,6 +291,71 @@ papersize_size_mismatch(stp_dimension_t l, stp_dimension_t w,
   return hdiff > vdiff ? hdiff : vdiff;
 }
 
+/*
+ * Only papers less than 5 points off in each dimension can match, so
+ * only the slice of the size index with widths in that range needs to
+ * be examined.  The result is the one the linear search below would
+ * find: the first exact match without margins if there is one, or else
+ * whichever comes later in the list of the last exact match and the
+ * first of the closest near matches.
+ */
+static const stp_papersize_t *
+get_papersize_by_size_indexed(papersize_index_t *index,
+			      const stp_papersize_list_t *list,
+			      stp_dimension_t l, stp_dimension_t w,
+			      int exact)
+{
+  const papersize_slot_t *exact_slot = NULL;
+  const papersize_slot_t *near_slot = NULL;
+  const papersize_slot_t *found = NULL;
+  int score = INT_MAX;
+  int lo = 0;
+  int hi;
+
+  check_papersize_size_index(index, list);
+  hi = index->width_count;
+  while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (index->by_width[mid].width <= w - 5)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  for (; lo < index->width_count && index->by_width[lo].width < w + 5; lo++)
+    {
+      const papersize_slot_t *slot = &(index->by_width[lo]);
+      const stp_papersize_t *val = slot->paper;
+      if (val->width == w && val->height == l)
+	{
+	  if (val->top == 0 && val->left == 0 &&
+	      val->bottom == 0 && val->right == 0)
+	    {
+	      if (!found || slot->position < found->position)
+		found = slot;
+	    }
+	  else if (!exact_slot || slot->position > exact_slot->position)
+	    exact_slot = slot;
+	}
+      else if (!exact)
+	{
+	  int myscore = papersize_size_mismatch(l, w, val);
+	  if (myscore < 5 &&
+	      (myscore < score ||
+	       (myscore == score && slot->position < near_slot->position)))
+	    {
+	      near_slot = slot;
+	      score = myscore;
+	    }
+	}
+    }
+  if (found)
+    return found->paper;
+  if (exact_slot && (!near_slot || exact_slot->position > near_slot->position))
+    return exact_slot->paper;
+  return near_slot ? near_slot->paper : NULL;
+}
+
 static const stp_papersize_t *
 get_papersize_by_size_internal(const stp_papersize_list_t *list,
 			       stp_dimension_t l, stp_dimension_t w,
@@ -205,9 +364,13 @@ get_papersize_by_size_internal(const stp_papersize_list_t *list,
   int score = INT_MAX;
   const stp_papersize_t *ref = NULL;
   const stp_papersize_t *val = NULL;
-  const stp_papersize_list_item_t *ptli =
-    stpi_papersize_list_get_start(list);
+  const stp_papersize_list_item_t *ptli;
+  papersize_index_t *index;
   STPI_ASSERT(list, NULL);
+  index = get_papersize_index(list);
+  if (index)
+    return get_papersize_by_size_indexed(index, list, l, w, exact);
+  ptli = stpi_papersize_list_get_start(list);
   while (ptli)
     {
       val = stpi_paperlist_item_get_data(ptli);
@@ -479,7 +642,7 @@ stpi_get_papersize_list_named(const char *name, const char *file)
 	stp_xml_parse_file_from_path_safe(buf, "paperdef", NULL);
       const char *stmp = stp_mxmlElementGetAttr(node, "name");
       STPI_ASSERT(stmp && !strcmp(name, stmp), NULL);
-      impl = stp_malloc(sizeof(papersize_list_impl_t));
+      impl = stp_zalloc(sizeof(papersize_list_impl_t));
       impl->name = stp_strdup(name);
       impl->list = stpi_create_papersize_list();
       stp_deprintf(STP_DBG_PAPER, "    Loading %s\n", stmp);
@@ -516,7 +679,7 @@ stpi_new_papersize_list(const char *name)
   item = stp_list_get_item_by_name(list_of_papersize_lists, name);
   if (item)
     return NULL;
-  impl = stp_malloc(sizeof(papersize_list_impl_t));
+  impl = stp_zalloc(sizeof(papersize_list_impl_t));
   impl->name = stp_strdup(name);
   impl->list = stpi_create_papersize_list();
   stp_list_item_create(list_of_papersize_lists, NULL, impl);
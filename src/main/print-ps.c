@@ -39,6 +39,12 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <strings.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #include "xmlppd.h"
 
 #ifdef _MSC_VER
@@ -47,11 +53,49 @@
 #endif
 
 /*
- * Local variables...
+ * The last few PPD files read are kept, by name, so that vars objects
+ * naming one of them needn't read it again.  A file is read again if
+ * its size or modification time has changed since.  When another file
+ * is read the oldest is dropped, and with it any strings that
+ * descriptions took from it, so those are only good until
+ * PPD_CACHE_SIZE other files have been read.  The cache is only used
+ * with ppd_cache_lock held.
  */
 
-static char *m_ppd_file = NULL;
-static stp_mxml_node_t *m_ppd = NULL;
+#define PPD_CACHE_SIZE 4
+
+typedef struct
+{
+  stpi_xmlppd_t *ppd;
+  time_t mtime;
+  off_t size;
+} ppd_cache_entry_t;
+
+static stp_list_t *ppd_cache = NULL;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t ppd_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_PPD_CACHE() pthread_mutex_lock(&ppd_cache_lock)
+#define UNLOCK_PPD_CACHE() pthread_mutex_unlock(&ppd_cache_lock)
+#else
+#define LOCK_PPD_CACHE() do { } while (0)
+#define UNLOCK_PPD_CACHE() do { } while (0)
+#endif
+
+typedef struct
+{
+  int ascii85_column;		/* Current column of ASCII85 output */
+} ps_privdata_t;
+
+/*
+ * Raster data is encoded a block at a time into a local buffer, with the
+ * characters for each byte (hex) or for each pair of base-85 digits
+ * looked up in tables that are built when the driver is loaded.
+ */
+
+#define OUTBUF_SIZE 4096
+
+static char hex_pairs[256][2];
+static char base85_pairs[85 * 85][2];
 
 
 /*
@@ -193,74 +237,121 @@ ppd_whitespace_callback(stp_mxml_node_t *node, int where)
   return 0;
 }
 
-static int
-check_ppd_file(const stp_vars_t *v)
+static const char *
+ppd_namefunc(const void *item)
+{
+  const ppd_cache_entry_t *entry = (const ppd_cache_entry_t *) item;
+  return stpi_xmlppd_get_filename(entry->ppd);
+}
+
+static void
+ppd_freefunc(void *item)
+{
+  ppd_cache_entry_t *entry = (ppd_cache_entry_t *) item;
+  stpi_xmlppd_free(entry->ppd);
+  stp_free(entry);
+}
+
+/*
+ * Get the size and modification time of a PPD file, or zeros if it
+ * can't be found.
+ */
+
+static void
+ppd_file_stamp(const char *ppd_file, time_t *mtime, off_t *size)
+{
+#ifdef HAVE_SYS_STAT_H
+  struct stat sbuf;
+  if (stat(ppd_file, &sbuf) == 0)
+    {
+      *mtime = sbuf.st_mtime;
+      *size = sbuf.st_size;
+      return;
+    }
+#endif
+  *mtime = 0;
+  *size = 0;
+}
+
+static stpi_xmlppd_t *
+get_ppd(const stp_vars_t *v)
 {
   const char *ppd_file = stp_get_file_parameter(v, "PPDFile");
+  stp_list_item_t *item;
+  ppd_cache_entry_t *entry;
+  stpi_xmlppd_t *ppd;
+  time_t mtime;
+  off_t size;
 
   if (ppd_file == NULL || ppd_file[0] == 0)
     {
       stp_dprintf(STP_DBG_PS, v, "Empty PPD file\n");
-      return 0;
-    }
-  else if (m_ppd_file && strcmp(m_ppd_file, ppd_file) == 0)
-    {
-      stp_dprintf(STP_DBG_PS, v, "Not replacing PPD file %s\n", m_ppd_file);
-      return 1;
+      return NULL;
     }
-  else
+  ppd_file_stamp(ppd_file, &mtime, &size);
+
+  LOCK_PPD_CACHE();
+  item = stp_list_get_item_by_name(ppd_cache, ppd_file);
+  if (item)
     {
-      stp_dprintf(STP_DBG_PS, v, "Replacing PPD file %s with %s\n",
-		  m_ppd_file ? m_ppd_file : "(null)",
-		  ppd_file ? ppd_file : "(null)");
-      if (m_ppd != NULL)
-	stp_mxmlDelete(m_ppd);
-      m_ppd = NULL;
-
-      if (m_ppd_file)
-	stp_free(m_ppd_file);
-      m_ppd_file = NULL;
-
-      if ((m_ppd = stpi_xmlppd_read_ppd_file(ppd_file)) == NULL)
-	{
-	  stp_eprintf(v, "Unable to open PPD file %s\n", ppd_file);
-	  return 0;
-	}
-      if (stp_get_debug_level() & STP_DBG_PS)
+      entry = (ppd_cache_entry_t *) stp_list_item_get_data(item);
+      if (entry->mtime == mtime && entry->size == size)
 	{
-	  char *ppd_stuff = stp_mxmlSaveAllocString(m_ppd, ppd_whitespace_callback);
-	  stp_dprintf(STP_DBG_PS, v, "%s", ppd_stuff);
-	  stp_free(ppd_stuff);
+	  stp_dprintf(STP_DBG_PS, v, "Not replacing PPD file %s\n", ppd_file);
+	  UNLOCK_PPD_CACHE();
+	  return entry->ppd;
 	}
+      stp_dprintf(STP_DBG_PS, v, "PPD file %s has changed\n", ppd_file);
+      stp_list_item_destroy(ppd_cache, item);
+    }
 
-      m_ppd_file = stp_strdup(ppd_file);
-      return 1;
+  stp_dprintf(STP_DBG_PS, v, "Reading PPD file %s\n", ppd_file);
+  if ((ppd = stpi_xmlppd_read_ppd_file(ppd_file)) == NULL)
+    {
+      UNLOCK_PPD_CACHE();
+      stp_eprintf(v, "Unable to open PPD file %s\n", ppd_file);
+      return NULL;
     }
+  if (stp_get_debug_level() & STP_DBG_PS)
+    {
+      char *ppd_stuff = stp_mxmlSaveAllocString(stpi_xmlppd_get_root(ppd),
+						ppd_whitespace_callback);
+      stp_dprintf(STP_DBG_PS, v, "%s", ppd_stuff);
+      stp_free(ppd_stuff);
+    }
+  if (stp_list_get_length(ppd_cache) >= PPD_CACHE_SIZE)
+    stp_list_item_destroy(ppd_cache, stp_list_get_start(ppd_cache));
+  entry = stp_malloc(sizeof(ppd_cache_entry_t));
+  entry->ppd = ppd;
+  entry->mtime = mtime;
+  entry->size = size;
+  stp_list_item_create(ppd_cache, NULL, entry);
+  UNLOCK_PPD_CACHE();
+  return ppd;
 }
 
-
 static stp_parameter_list_t
 ps_list_parameters(const stp_vars_t *v)
 {
   stp_parameter_list_t *ret = stp_parameter_list_create();
   stp_mxml_node_t *option;
   int i;
-  int status = check_ppd_file(v);
+  stpi_xmlppd_t *ppd = get_ppd(v);
   stp_dprintf(STP_DBG_PS, v, "Adding parameters from %s (%d)\n",
-	      m_ppd_file ? m_ppd_file : "(null)", status);
+	      ppd ? stpi_xmlppd_get_filename(ppd) : "(null)", ppd != NULL);
 
   for (i = 0; i < the_parameter_count; i++)
     stp_parameter_list_add_param(ret, &(the_parameters[i]));
 
-  if (status)
+  if (ppd)
     {
-      int num_options = stpi_xmlppd_find_option_count(m_ppd);
+      int num_options = stpi_xmlppd_find_option_count(ppd);
       stp_dprintf(STP_DBG_PS, v, "Found %d parameters\n", num_options);
       for (i=0; i < num_options; i++)
 	{
 	  /* MEMORY LEAK!!! */
 	  stp_parameter_t *param = stp_malloc(sizeof(stp_parameter_t));
-	  option = stpi_xmlppd_find_option_index(m_ppd, i);
+	  option = stpi_xmlppd_find_option_index(ppd, i);
 	  if (option)
 	    {
 	      ps_option_to_param(v, param, option);
@@ -286,7 +377,8 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
 {
   int		i;
   stp_mxml_node_t *option;
-  int status = 0;
+  stpi_xmlppd_t *ppd;
+  stp_mxml_node_t *root;
   int num_choices;
   const char *defchoice;
 
@@ -297,7 +389,8 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
   if (name == NULL)
     return;
 
-  status = check_ppd_file(v);
+  ppd = get_ppd(v);
+  root = stpi_xmlppd_get_root(ppd);
 
   for (i = 0; i < the_parameter_count; i++)
   {
@@ -310,8 +403,8 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
 	  {
 	    const char *nickname;
 	    description->bounds.str = stp_string_list_create();
-	    if (m_ppd && stp_mxmlElementGetAttr(m_ppd, "nickname"))
-	      nickname = stp_mxmlElementGetAttr(m_ppd, "nickname");
+	    if (root && stp_mxmlElementGetAttr(root, "nickname"))
+	      nickname = stp_mxmlElementGetAttr(root, "nickname");
 	    else
 	      nickname = _("None; please provide a PPD file");
 	    stp_string_list_add_string_unsafe(description->bounds.str,
@@ -322,7 +415,7 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
 	  }
 	else if (strcmp(name, "PrintingMode") == 0)
 	  {
-	    if (! m_ppd || strcmp(stp_mxmlElementGetAttr(m_ppd, "color"), "1") == 0)
+	    if (! root || strcmp(stp_mxmlElementGetAttr(root, "color"), "1") == 0)
 	      {
 		description->bounds.str = stp_string_list_create();
 		stp_string_list_add_string
@@ -340,9 +433,9 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
       }
   }
 
-  if (!status && strcmp(name, "PageSize") != 0)
+  if (!ppd && strcmp(name, "PageSize") != 0)
     return;
-  if ((option = stpi_xmlppd_find_option_named(m_ppd, name)) == NULL)
+  if ((option = stpi_xmlppd_find_option_named(ppd, name)) == NULL)
   {
     if (strcmp(name, "PageSize") == 0)
       {
@@ -364,7 +457,7 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
 	char *tmp = stp_malloc(strlen(name) + 4);
 	strcpy(tmp, "Stp");
 	strncat(tmp, name, strlen(name) + 3);
-	if ((option = stpi_xmlppd_find_option_named(m_ppd, tmp)) == NULL)
+	if ((option = stpi_xmlppd_find_option_named(ppd, tmp)) == NULL)
 	  {
 	    stp_dprintf(STP_DBG_PS, v, "no parameter %s", name);
 	    stp_free(tmp);
@@ -388,7 +481,7 @@ ps_parameters_internal(const stp_vars_t *v, const char *name,
   /* Describe all choices for specified option. */
   for (i=0; i < num_choices; i++)
   {
-    stp_mxml_node_t *choice = stpi_xmlppd_find_choice_index(option, i);
+    stp_mxml_node_t *choice = stpi_xmlppd_find_choice_index(ppd, option, i);
     const char *choice_name = stp_mxmlElementGetAttr(choice, "name");
     const char *choice_text = stp_mxmlElementGetAttr(choice, "text");
     stp_string_list_add_string(description->bounds.str, choice_name, choice_text);
@@ -440,20 +533,20 @@ ps_media_size_internal(const stp_vars_t *v,		/* I */
 		       stp_dimension_t  *height)		/* O - Height in points */
 {
   const char *pagesize = stp_get_string_parameter(v, "PageSize");
-  int status = check_ppd_file(v);
+  stpi_xmlppd_t *ppd = get_ppd(v);
   if (!pagesize)
     pagesize = "";
 
   stp_dprintf(STP_DBG_PS, v,
 	      "ps_media_size(%d, \'%s\', \'%s\', %p, %p)\n",
-	      stp_get_model_id(v), m_ppd_file, pagesize,
+	      stp_get_model_id(v), stpi_xmlppd_get_filename(ppd), pagesize,
 	      (void *) width, (void *) height);
 
   stp_default_media_size(v, width, height);
 
-  if (status)
+  if (ppd)
     {
-      stp_mxml_node_t *paper = stpi_xmlppd_find_page_size(m_ppd, pagesize);
+      stp_mxml_node_t *paper = stpi_xmlppd_find_page_size(ppd, pagesize);
       if (paper)
 	{
 	  *width = atoi(stp_mxmlElementGetAttr(paper, "width"));
@@ -473,13 +566,13 @@ ps_media_size_internal(const stp_vars_t *v,		/* I */
 static const stp_papersize_t *
 ps_describe_papersize(const stp_vars_t *v, const char *name)
 {
-  int status = check_ppd_file(v);
-  if (status)
+  stpi_xmlppd_t *ppd = get_ppd(v);
+  if (ppd)
     {
-      stp_mxml_node_t *paper = stpi_xmlppd_find_page_size(m_ppd, name);
+      stp_mxml_node_t *paper = stpi_xmlppd_find_page_size(ppd, name);
       if (paper)
 	{
-	  const char *papersize_list_name = m_ppd_file ? m_ppd_file : "NOPPD";
+	  const char *papersize_list_name = stpi_xmlppd_get_filename(ppd);
 	  stp_papersize_list_t *ourlist =
 	    stpi_find_papersize_list_named(papersize_list_name);
 	  const stp_papersize_t *papersize;
@@ -566,6 +659,7 @@ ps_imageable_area_internal(const stp_vars_t *v,      /* I */
 {
   stp_dimension_t width, height;
   const char *pagesize = stp_get_string_parameter(v, "PageSize");
+  stpi_xmlppd_t *ppd;
   if (!pagesize)
     pagesize = "";
 
@@ -576,9 +670,10 @@ ps_imageable_area_internal(const stp_vars_t *v,      /* I */
   *top    = 0;
   *bottom = height;
 
-  if (check_ppd_file(v))
+  ppd = get_ppd(v);
+  if (ppd)
     {
-      stp_mxml_node_t *paper = stpi_xmlppd_find_page_size(m_ppd, pagesize);
+      stp_mxml_node_t *paper = stpi_xmlppd_find_page_size(ppd, pagesize);
       if (paper)
 	{
 	  double pleft = atoi(stp_mxmlElementGetAttr(paper, "left"));
@@ -719,6 +814,7 @@ static stp_string_list_t *
 ps_external_options(const stp_vars_t *v)
 {
   stp_parameter_list_t param_list = ps_list_parameters(v);
+  stpi_xmlppd_t *ppd = get_ppd(v);
   stp_string_list_t *answer;
   char *tmp;
   char *ppd_name = NULL;
@@ -741,13 +837,13 @@ ps_external_options(const stp_vars_t *v)
       if (desc.is_active)
 	{
 	  stp_mxml_node_t *option;
-	  if (m_ppd &&
-	      (option = stpi_xmlppd_find_option_named(m_ppd, desc.name)) == NULL)
+	  if (ppd &&
+	      (option = stpi_xmlppd_find_option_named(ppd, desc.name)) == NULL)
 	    {
 	      ppd_name = stp_malloc(strlen(desc.name) + 4);
 	      strcpy(ppd_name, "Stp");
 	      strncat(ppd_name, desc.name, strlen(desc.name) + 3);
-	      if ((option = stpi_xmlppd_find_option_named(m_ppd, ppd_name)) == NULL)
+	      if ((option = stpi_xmlppd_find_option_named(ppd, ppd_name)) == NULL)
 		{
 		  stp_dprintf(STP_DBG_PS, v, "no parameter %s", desc.name);
 		  STP_SAFE_FREE(ppd_name);
@@ -854,6 +950,7 @@ ps_print_device_settings(stp_vars_t *v)
 {
   int i;
   stp_parameter_list_t param_list = ps_list_parameters(v);
+  stpi_xmlppd_t *ppd = get_ppd(v);
   if (! param_list)
     return;
   stp_puts("%%BeginSetup\n", v);
@@ -887,14 +984,14 @@ ps_print_device_settings(stp_vars_t *v)
 		/* We only include the option's code if it's set to a value other than the default. */
 		if(val && defval && (strcmp(val,defval)!=0))
 		  {
-		    if(m_ppd)
+		    if(ppd)
 		      {
 			/* If we have a PPD xml tree we hunt for the appropriate "option" and "choice"... */
-			stp_mxml_node_t *node=m_ppd;
-			node=stp_mxmlFindElement(node,node, "option", "name", desc.name, STP_MXML_DESCEND);
+			stp_mxml_node_t *node;
+			node=stpi_xmlppd_find_option_named(ppd, desc.name);
 			if(node)
 			  {
-			    node=stp_mxmlFindElement(node,node, "choice", "name", val, STP_MXML_DESCEND);
+			    node=stpi_xmlppd_find_choice_named(ppd, node, val);
 			    if(node && node->child)
 			      {
 				if(node->child->value.opaque && (strlen(node->child->value.opaque)>1))
@@ -993,6 +1090,7 @@ ps_print_internal(stp_vars_t *v, stp_image_t *image)
 		image_width;
   int		color_out = 0;
   int		cmyk_out = 0;
+  ps_privdata_t	privdata;
 
   if (print_mode && strcmp(print_mode, "Color") == 0)
     color_out = 1;
@@ -1096,6 +1194,9 @@ ps_print_internal(stp_vars_t *v, stp_image_t *image)
 
   out_channels = stp_color_init(v, image, 256);
 
+  privdata.ascii85_column = 0;
+  stp_allocate_component_data(v, "Driver", NULL, NULL, &privdata);
+
   if (model == 0)
   {
     stp_zprintf(v, "/picture %d string def\n", image_width * out_channels);
@@ -1262,6 +1363,24 @@ ps_print(const stp_vars_t *v, stp_image_t *image)
 }
 
 
+static void
+initialize_tables(void)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  int i;
+  for (i = 0; i < 256; i++)
+    {
+      hex_pairs[i][0] = hex[i >> 4];
+      hex_pairs[i][1] = hex[i & 15];
+    }
+  for (i = 0; i < 85 * 85; i++)
+    {
+      base85_pairs[i][0] = (i / 85) + '!';
+      base85_pairs[i][1] = (i % 85) + '!';
+    }
+}
+
+
 /*
  * 'ps_hex()' - Print binary data as a series of hexadecimal numbers.
  */
@@ -1271,34 +1390,40 @@ ps_hex(const stp_vars_t *v,	/* I - File to print to */
        unsigned short   *data,	/* I - Data to print */
        int              length)	/* I - Number of bytes to print */
 {
-  int		col;		/* Current column */
-  static const char	*hex = "0123456789ABCDEF";
+  char	outbuffer[OUTBUF_SIZE + 80];	/* Whole lines of output */
+  int	outp = 0;
+
+
+ /*
+  * Each line holds the hex for 36 bytes, and the last line of the data
+  * holds whatever is left over.
+  */
 
-  col = 0;
   while (length > 0)
   {
-    unsigned char pixel = (*data & 0xff00) >> 8;
-   /*
-    * Put the hex chars out to the file; note that we don't use stp_zprintf()
-    * for speed reasons...
-    */
-
-    stp_putc(hex[pixel >> 4], v);
-    stp_putc(hex[pixel & 15], v);
+    int count = length < 36 ? length : 36;
+    int i;
 
-    data ++;
-    length --;
+    for (i = 0; i < count; i++, outp += 2)
+    {
+      const char *pair = hex_pairs[data[i] >> 8];
+      outbuffer[outp] = pair[0];
+      outbuffer[outp + 1] = pair[1];
+    }
+    outbuffer[outp++] = '\n';
 
-    col += 2;
-    if (col >= 72)
+    if (outp >= OUTBUF_SIZE)
     {
-      col = 0;
-      stp_putc('\n', v);
+      stp_zfwrite(outbuffer, outp, 1, v);
+      outp = 0;
     }
+
+    data += count;
+    length -= count;
   }
 
-  if (col > 0)
-    stp_putc('\n', v);
+  if (outp)
+    stp_zfwrite(outbuffer, outp, 1, v);
 }
 
 
@@ -1315,59 +1440,65 @@ ps_ascii85(const stp_vars_t *v,	/* I - File to print to */
   int		i;			/* Looping var */
   unsigned	b;			/* Binary data word */
   unsigned char	c[5];			/* ASCII85 encoded chars */
-  static int	column = 0;		/* Current column */
+  ps_privdata_t *pd = (ps_privdata_t *) stp_get_component_data(v, "Driver");
+  int		column = pd->ascii85_column;	/* Current column */
+  char		outbuffer[OUTBUF_SIZE + 10];
+  int		outp = 0;
 
-#define OUTBUF_SIZE 4096
-  unsigned char outbuffer[OUTBUF_SIZE+10];
-  int outp=0;
 
   while (length > 3)
   {
-    unsigned char d0 = (data[0] & 0xff00) >> 8;
-    unsigned char d1 = (data[1] & 0xff00) >> 8;
-    unsigned char d2 = (data[2] & 0xff00) >> 8;
-    unsigned char d3 = (data[3] & 0xff00) >> 8;
-    b = (((((d0 << 8) | d1) << 8) | d2) << 8) | d3;
+    b = ((unsigned) (data[0] >> 8) << 24) |
+      ((unsigned) (data[1] >> 8) << 16) |
+      ((unsigned) (data[2] >> 8) << 8) |
+      (unsigned) (data[3] >> 8);
 
     if (b == 0)
     {
-      outbuffer[outp++]='z';
+      outbuffer[outp++] = 'z';
       column ++;
     }
     else
     {
-      outbuffer[outp+4] = (b % 85) + '!';
-      b /= 85;
-      outbuffer[outp+3] = (b % 85) + '!';
-      b /= 85;
-      outbuffer[outp+2] = (b % 85) + '!';
-      b /= 85;
-      outbuffer[outp+1] = (b % 85) + '!';
-      b /= 85;
-      outbuffer[outp] = b + '!';
-
-      outp+=5;
+     /*
+      * b / (85 * 85) gives the first three digits and the remainder the
+      * last two, so each group takes two divisions rather than four.
+      */
+
+      unsigned high = b / (85 * 85);
+      unsigned low = b - high * (85 * 85);
+      unsigned first = high / 85;
+      const char *pair = base85_pairs[first];
+
+      outbuffer[outp] = pair[0];
+      outbuffer[outp + 1] = pair[1];
+      outbuffer[outp + 2] = (high - first * 85) + '!';
+      pair = base85_pairs[low];
+      outbuffer[outp + 3] = pair[0];
+      outbuffer[outp + 4] = pair[1];
+
+      outp += 5;
       column += 5;
     }
 
     if (column > 72)
     {
-      outbuffer[outp++]='\n';
+      outbuffer[outp++] = '\n';
       column = 0;
     }
 
-    if(outp>=OUTBUF_SIZE)
-	{
-		stp_zfwrite((const char *)outbuffer, outp, 1, v);
-		outp=0;
-	}
+    if (outp >= OUTBUF_SIZE)
+    {
+      stp_zfwrite(outbuffer, outp, 1, v);
+      outp = 0;
+    }
 
     data += 4;
     length -= 4;
   }
 
-  if(outp)
-    stp_zfwrite((const char *)outbuffer, outp, 1, v);
+  if (outp)
+    stp_zfwrite(outbuffer, outp, 1, v);
 
   if (last_line)
   {
@@ -1391,6 +1522,7 @@ ps_ascii85(const stp_vars_t *v,	/* I - File to print to */
     stp_puts("~>\n", v);
     column = 0;
   }
+  pd->ascii85_column = column;
 }
 
 
@@ -1423,6 +1555,10 @@ static stp_family_t print_ps_module_data =
 static int
 print_ps_module_init(void)
 {
+  ppd_cache = stp_list_create();
+  stp_list_set_namefunc(ppd_cache, ppd_namefunc);
+  stp_list_set_freefunc(ppd_cache, ppd_freefunc);
+  initialize_tables();
   return stpi_family_register(print_ps_module_data.printer_list);
 }
 
@@ -1430,6 +1566,8 @@ print_ps_module_init(void)
 static int
 print_ps_module_exit(void)
 {
+  stp_list_destroy(ppd_cache);
+  ppd_cache = NULL;
   return stpi_family_unregister(print_ps_module_data.printer_list);
 }
 
@@ -238,14 +238,25 @@ compdata_freefunc(void *item)
   stp_free(cd);
 }
 
-static void *
-compdata_copyfunc(const void *item)
+/*
+ * Data without a copy function is shared with the copy if nothing frees
+ * it; otherwise it isn't copied at all, as both would free it.
+ */
+static compdata_t *
+compdata_copyfunc(const compdata_t *cd)
 {
-  const compdata_t *cd = (const compdata_t *) (item);
+  compdata_t *ret;
+  if (!cd->copyfunc && cd->freefunc)
+    return NULL;
+  ret = stp_malloc(sizeof(compdata_t));
+  ret->name = stp_strdup(cd->name);
+  ret->copyfunc = cd->copyfunc;
+  ret->freefunc = cd->freefunc;
   if (cd->copyfunc)
-    return (cd->copyfunc)(cd->data);
+    ret->data = (cd->copyfunc)(cd->data);
   else
-    return cd->data;
+    ret->data = cd->data;
+  return ret;
 }
 
 void
@@ -307,7 +318,10 @@ copy_compdata_list(const stp_list_t *src)
   const stp_list_item_t *item = stp_list_get_start(src);
   while (item)
     {
-      stp_list_item_create(ret, NULL, compdata_copyfunc(item));
+      compdata_t *cd =
+	compdata_copyfunc((const compdata_t *) stp_list_item_get_data(item));
+      if (cd)
+	stp_list_item_create(ret, NULL, cd);
       item = stp_list_item_next(item);
     }
   return ret;
@@ -1579,6 +1593,249 @@ stp_vars_create_copy(const stp_vars_t *vs)
   return (vd);
 }
 
+stp_vars_t *
+stpi_vars_create_settings_copy(const stp_vars_t *vs)
+{
+  stp_vars_t *vd = stp_vars_create();
+  int i;
+  CHECK_VARS(vs);
+  stp_set_driver(vd, stp_get_driver(vs));
+  stp_set_color_conversion(vd, stp_get_color_conversion(vs));
+  stp_set_left(vd, stp_get_left(vs));
+  stp_set_top(vd, stp_get_top(vs));
+  stp_set_width(vd, stp_get_width(vs));
+  stp_set_height(vd, stp_get_height(vs));
+  stp_set_page_width(vd, stp_get_page_width(vs));
+  stp_set_page_height(vd, stp_get_page_height(vs));
+  for (i = 0; i < STP_PARAMETER_TYPE_INVALID; i++)
+    {
+      stp_list_destroy(vd->params[i]);
+      vd->params[i] = copy_value_list(vs->params[i]);
+    }
+  return (vd);
+}
+
+/*
+ * FNV-1a over a byte range.  This only needs to be stable within one
+ * process; it is used to tell whether two sets of settings are the same,
+ * not for anything persistent.
+ */
+static unsigned long
+fingerprint_bytes(unsigned long hash, const void *data, size_t bytes)
+{
+  const unsigned char *p = (const unsigned char *) data;
+  size_t i;
+  for (i = 0; i < bytes; i++)
+    {
+      hash ^= p[i];
+      hash *= 16777619UL;
+    }
+  return hash;
+}
+
+static unsigned long
+fingerprint_string(unsigned long hash, const char *s)
+{
+  if (s)
+    return fingerprint_bytes(hash, s, strlen(s) + 1);
+  else
+    return fingerprint_bytes(hash, "", 1);
+}
+
+static unsigned long
+fingerprint_value(const value_t *val)
+{
+  unsigned long hash = 2166136261UL;
+  char *tmp;
+  hash = fingerprint_string(hash, val->name);
+  hash = fingerprint_bytes(hash, &(val->typ), sizeof(val->typ));
+  hash = fingerprint_bytes(hash, &(val->active), sizeof(val->active));
+  switch (val->typ)
+    {
+    case STP_PARAMETER_TYPE_CURVE:
+      tmp = val->value.cval ? stp_curve_write_string(val->value.cval) : NULL;
+      hash = fingerprint_string(hash, tmp);
+      STP_SAFE_FREE(tmp);
+      break;
+    case STP_PARAMETER_TYPE_ARRAY:
+      tmp = val->value.aval ? stp_array_write_string(val->value.aval) : NULL;
+      hash = fingerprint_string(hash, tmp);
+      STP_SAFE_FREE(tmp);
+      break;
+    case STP_PARAMETER_TYPE_STRING_LIST:
+    case STP_PARAMETER_TYPE_FILE:
+    case STP_PARAMETER_TYPE_RAW:
+      hash = fingerprint_bytes(hash, &(val->value.rval.bytes),
+			       sizeof(val->value.rval.bytes));
+      if (val->value.rval.data)
+	hash = fingerprint_bytes(hash, val->value.rval.data,
+				 val->value.rval.bytes);
+      break;
+    case STP_PARAMETER_TYPE_DIMENSION:
+      hash = fingerprint_bytes(hash, &(val->value.sval),
+			       sizeof(val->value.sval));
+      break;
+    case STP_PARAMETER_TYPE_INT:
+    case STP_PARAMETER_TYPE_BOOLEAN:
+      hash = fingerprint_bytes(hash, &(val->value.ival),
+			       sizeof(val->value.ival));
+      break;
+    case STP_PARAMETER_TYPE_DOUBLE:
+      hash = fingerprint_bytes(hash, &(val->value.dval),
+			       sizeof(val->value.dval));
+      break;
+    default:
+      break;
+    }
+  /*
+   * The per-parameter hashes are summed, so mix all of the bits of each
+   * one first; otherwise their low bits would barely affect the sum.
+   */
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bUL;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35UL;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+unsigned long
+stp_vars_get_fingerprint(const stp_vars_t *v)
+{
+  unsigned long hash = 2166136261UL;
+  stp_dimension_t dims[6];
+  int i;
+  CHECK_VARS(v);
+  hash = fingerprint_string(hash, v->driver);
+  hash = fingerprint_string(hash, v->color_conversion);
+  dims[0] = v->left;
+  dims[1] = v->top;
+  dims[2] = v->width;
+  dims[3] = v->height;
+  dims[4] = v->page_width;
+  dims[5] = v->page_height;
+  hash = fingerprint_bytes(hash, dims, sizeof(dims));
+  for (i = 0; i < STP_PARAMETER_TYPE_INVALID; i++)
+    {
+      /*
+       * Parameters may have been set in any order, so combine the
+       * per-parameter hashes in an order-independent way.
+       */
+      unsigned long list_hash = 0;
+      const stp_list_item_t *item = stp_list_get_start(v->params[i]);
+      while (item)
+	{
+	  const value_t *val = (const value_t *) stp_list_item_get_data(item);
+	  /*
+	   * The page number changes on every page of a job without the
+	   * page being set up any differently.
+	   */
+	  if (strcmp(val->name, "PageNumber") != 0)
+	    list_hash += fingerprint_value(val);
+	  item = stp_list_item_next(item);
+	}
+      hash = fingerprint_bytes(hash, &list_hash, sizeof(list_hash));
+    }
+  return hash;
+}
+
+static int
+strings_equal(const char *a, const char *b)
+{
+  if (a && b)
+    return strcmp(a, b) == 0;
+  else
+    return a == b;
+}
+
+static int
+value_equal(const value_t *a, const value_t *b)
+{
+  char *ta, *tb;
+  int ret;
+  if (a->typ != b->typ || a->active != b->active)
+    return 0;
+  switch (a->typ)
+    {
+    case STP_PARAMETER_TYPE_CURVE:
+      ta = a->value.cval ? stp_curve_write_string(a->value.cval) : NULL;
+      tb = b->value.cval ? stp_curve_write_string(b->value.cval) : NULL;
+      ret = strings_equal(ta, tb);
+      STP_SAFE_FREE(ta);
+      STP_SAFE_FREE(tb);
+      return ret;
+    case STP_PARAMETER_TYPE_ARRAY:
+      ta = a->value.aval ? stp_array_write_string(a->value.aval) : NULL;
+      tb = b->value.aval ? stp_array_write_string(b->value.aval) : NULL;
+      ret = strings_equal(ta, tb);
+      STP_SAFE_FREE(ta);
+      STP_SAFE_FREE(tb);
+      return ret;
+    case STP_PARAMETER_TYPE_STRING_LIST:
+    case STP_PARAMETER_TYPE_FILE:
+    case STP_PARAMETER_TYPE_RAW:
+      if (a->value.rval.bytes != b->value.rval.bytes)
+	return 0;
+      if (!a->value.rval.data || !b->value.rval.data)
+	return a->value.rval.data == b->value.rval.data;
+      return memcmp(a->value.rval.data, b->value.rval.data,
+		    a->value.rval.bytes) == 0;
+    case STP_PARAMETER_TYPE_DIMENSION:
+      return a->value.sval == b->value.sval;
+    case STP_PARAMETER_TYPE_INT:
+    case STP_PARAMETER_TYPE_BOOLEAN:
+      return a->value.ival == b->value.ival;
+    case STP_PARAMETER_TYPE_DOUBLE:
+      return a->value.dval == b->value.dval;
+    default:
+      return 1;
+    }
+}
+
+/*
+ * Does every parameter in list a, other than the page number, have the
+ * same setting in list b?
+ */
+static int
+value_list_included(const stp_list_t *a, const stp_list_t *b)
+{
+  const stp_list_item_t *item = stp_list_get_start(a);
+  while (item)
+    {
+      const value_t *val = (const value_t *) stp_list_item_get_data(item);
+      if (strcmp(val->name, "PageNumber") != 0)
+	{
+	  const stp_list_item_t *other = stp_list_get_item_by_name(b, val->name);
+	  if (!other ||
+	      !value_equal(val, (const value_t *) stp_list_item_get_data(other)))
+	    return 0;
+	}
+      item = stp_list_item_next(item);
+    }
+  return 1;
+}
+
+int
+stp_vars_settings_equal(const stp_vars_t *a, const stp_vars_t *b)
+{
+  int i;
+  CHECK_VARS(a);
+  CHECK_VARS(b);
+  if (a == b)
+    return 1;
+  if (!strings_equal(a->driver, b->driver) ||
+      !strings_equal(a->color_conversion, b->color_conversion) ||
+      a->left != b->left || a->top != b->top ||
+      a->width != b->width || a->height != b->height ||
+      a->page_width != b->page_width || a->page_height != b->page_height)
+    return 0;
+  for (i = 0; i < STP_PARAMETER_TYPE_INVALID; i++)
+    if (!value_list_included(a->params[i], b->params[i]) ||
+	!value_list_included(b->params[i], a->params[i]))
+      return 0;
+  return 1;
+}
+
 static const char *
 param_namefunc(const void *item)
 {
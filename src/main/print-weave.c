@@ -26,7 +26,12 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include <gutenprint/gutenprint.h>
 #include "gutenprint-internal.h"
 #include <gutenprint/gutenprint-intl-internal.h>
@@ -34,6 +39,23 @@
 #include <limits.h>
 #endif
 
+/*
+ * Pass buffers start out one row long and grow as rows are added, and
+ * are freed as soon as their pass is printed.  If they would take more
+ * than this many megabytes between them (overridden by the integer
+ * parameter WeaveBufferLimit, or failing that the environment variable
+ * STP_WEAVE_BUFFER_LIMIT; 0 means no limit), a buffer that needs to
+ * grow is moved to a temporary file instead, and read back just before
+ * its pass is printed.  WeaveBufferLimit is not described by any
+ * driver; only applications that know of it set it.  Without pread()
+ * and pwrite() nothing is moved to a file and the limit is ignored.
+ */
+#define DEFAULT_BUFFER_LIMIT 512
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+#define WEAVE_CAN_SPILL 1
+#endif
+
 static int
 gcd(int x, int y)
 {
@@ -92,6 +114,15 @@ typedef struct stpi_softweave
   unsigned char *s[STP_MAX_WEAVE];
   unsigned char *fold_buf;
   unsigned char *comp_buf;
+  int s_first[STP_MAX_WEAVE];	/* Bytes of s[] that may be nonzero; */
+  int s_last[STP_MAX_WEAVE];	/* all the rest are zero */
+  int fold_first;		/* Likewise for fold_buf */
+  int fold_last;
+  unsigned char *blank_buf;	/* A blank line, packed */
+  size_t blank_length;
+  int blank_first;		/* First and last as reported for it */
+  int blank_last;
+  int blank_active;
   stp_weave_t wcache;
   int rcache;
   int vcache;
@@ -99,6 +130,12 @@ typedef struct stpi_softweave
   stp_fillfunc *fillfunc;
   stp_packfunc *pack;
   stp_compute_linewidth_func *compute_linewidth;
+  size_t buffer_size;		/* Most a pass buffer can hold */
+  size_t *buffer_alloc;		/* Allocated size of each pass buffer, */
+				/* indexed by slot * ncolors + color */
+  char *buffer_spilled;		/* Is the pass buffer in the spill file? */
+  FILE *spill;			/* Spill file, once one is needed */
+  stp_weave_memory_t memory;	/* Pass buffer accounting */
 } stpi_softweave_t;
 
 /* RAW WEAVE */
@@ -961,6 +998,21 @@ allocate_linebuf(int count, int ncolors)
  * 4) page_height >= 2 * jets * sep
  */
 
+static size_t
+weave_buffer_limit(const stp_vars_t *v)
+{
+  const char *limit;
+  if (stp_check_int_parameter(v, "WeaveBufferLimit", STP_PARAMETER_ACTIVE))
+    {
+      int mb = stp_get_int_parameter(v, "WeaveBufferLimit");
+      return mb > 0 ? (size_t) mb << 20 : 0;
+    }
+  limit = getenv("STP_WEAVE_BUFFER_LIMIT");
+  if (limit)
+    return (size_t) strtoul(limit, NULL, 10) << 20;
+  return (size_t) DEFAULT_BUFFER_LIMIT << 20;
+}
+
 static void
 stpi_destroy_weave(void *vsw)
 {
@@ -971,6 +1023,8 @@ stpi_destroy_weave(void *vsw)
     stp_free(sw->fold_buf);
   if (sw->comp_buf)
     stp_free(sw->comp_buf);
+  if (sw->blank_buf)
+    stp_free(sw->blank_buf);
   for (i = 0; i < STP_MAX_WEAVE; i++)
     if (sw->s[i])
       stp_free(sw->s[i]);
@@ -994,6 +1048,10 @@ stpi_destroy_weave(void *vsw)
   stp_free(sw->linebases);
   stp_free(sw->linebounds);
   stp_free(sw->head_offset);
+  stp_free(sw->buffer_alloc);
+  stp_free(sw->buffer_spilled);
+  if (sw->spill)
+    fclose(sw->spill);
   stpi_destroy_weave_params(sw->weaveparm);
   stp_free(vsw);
 }
@@ -1133,6 +1191,19 @@ stp_initialize_weave(stp_vars_t *v,
 	      sw->linewidth, sw->horizontal_weave, sw->horizontal_width,
 	      ((sw->horizontal_width + 7) / 8));
   sw->horizontal_width = ((sw->horizontal_width + 7) / 8);
+  sw->buffer_size = sw->virtual_jets * sw->bitwidth * sw->horizontal_width;
+  sw->buffer_alloc = stp_zalloc(sw->vmod * ncolors * sizeof(size_t));
+  sw->buffer_spilled = stp_zalloc(sw->vmod * ncolors);
+  sw->memory.limit = weave_buffer_limit(v);
+  sw->memory.unbounded = sw->vmod * ncolors * sw->buffer_size;
+
+  for (i = 0; i < STP_MAX_WEAVE; i++)
+    {
+      sw->s_first[i] = 0;
+      sw->s_last[i] = -1;
+    }
+  sw->fold_first = 0;
+  sw->fold_last = -1;
 
   for (i = 0; i < sw->vmod; i++)
     {
@@ -1298,6 +1369,13 @@ stp_get_linebases_by_pass(const stp_vars_t *v, int pass)
   return &(sw->linebases[pass % sw->vmod]);
 }
 
+const stp_linebounds_t *
+stp_get_linebounds_by_pass(const stp_vars_t *v, int pass)
+{
+  const stpi_softweave_t *sw = get_sw(v);
+  return &(sw->linebounds[pass % sw->vmod]);
+}
+
 stp_pass_t *
 stp_get_pass_by_pass(const stp_vars_t *v, int pass)
 {
@@ -1305,15 +1383,166 @@ stp_get_pass_by_pass(const stp_vars_t *v, int pass)
   return &(sw->passes[pass % sw->vmod]);
 }
 
+static void
+resize_buffer(stpi_softweave_t *sw, int slot, int color, size_t size)
+{
+  unsigned char **buf = &(sw->linebases[slot].v[color]);
+  size_t *alloc = &(sw->buffer_alloc[slot * sw->ncolors + color]);
+  if (size == 0)
+    {
+      if (*buf)
+	stp_free(*buf);
+      *buf = NULL;
+    }
+  else
+    {
+      *buf = stp_realloc(*buf, size);
+      if (size > *alloc)
+	memset(*buf + *alloc, 0, size - *alloc);
+    }
+  sw->memory.current += size - *alloc;
+  if (sw->memory.current > sw->memory.peak)
+    sw->memory.peak = sw->memory.current;
+  *alloc = size;
+}
+
+static off_t
+spill_offset(const stpi_softweave_t *sw, int slot, int color)
+{
+  return (off_t) (slot * sw->ncolors + color) * sw->buffer_size;
+}
+
+/*
+ * Write to or read from the spill file, returning whether all the
+ * bytes were transferred.
+ */
+static int
+spill_write(const stpi_softweave_t *sw, const unsigned char *buf,
+	    size_t bytes, off_t offset)
+{
+#ifdef WEAVE_CAN_SPILL
+  return pwrite(fileno(sw->spill), buf, bytes, offset) == (ssize_t) bytes;
+#else
+  return 0;
+#endif
+}
+
+static int
+spill_read(const stpi_softweave_t *sw, unsigned char *buf,
+	   size_t bytes, off_t offset)
+{
+#ifdef WEAVE_CAN_SPILL
+  return pread(fileno(sw->spill), buf, bytes, offset) == (ssize_t) bytes;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Move a pass buffer to the spill file.  If that can't be done, it
+ * stays in memory regardless of the limit.
+ */
+static int
+spill_buffer(stp_vars_t *v, stpi_softweave_t *sw, int slot, int color)
+{
+#ifdef WEAVE_CAN_SPILL
+  size_t used = sw->lineoffsets[slot].v[color];
+  if (!sw->spill)
+    {
+      sw->spill = tmpfile();
+      if (!sw->spill)
+	return 0;
+    }
+  if (used > 0 &&
+      !spill_write(sw, sw->linebases[slot].v[color], used,
+		   spill_offset(sw, slot, color)))
+    return 0;
+  stp_dprintf(STP_DBG_WEAVE_PARAMS, v,
+	      "Spilling pass buffer %d color %d (%lu bytes)\n",
+	      slot, color, (unsigned long) used);
+  resize_buffer(sw, slot, color, 0);
+  sw->buffer_spilled[slot * sw->ncolors + color] = 1;
+  sw->memory.spilled += used;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Once the spill file has failed, don't put anything more in it; pass
+ * buffers that are already there are read back as usual.
+ */
+static void
+spill_error(stp_vars_t *v, stpi_softweave_t *sw, const char *what)
+{
+  stp_eprintf(v, "ERROR: Cannot %s the weave spill file\n", what);
+  sw->memory.limit = 0;
+}
+
+/*
+ * Bring a spilled pass buffer back into memory.  If it can't be read,
+ * the pass is printed blank rather than with whatever was read.
+ */
+static void
+reload_buffer(stp_vars_t *v, stpi_softweave_t *sw, int slot, int color)
+{
+  size_t used = sw->lineoffsets[slot].v[color];
+  sw->buffer_spilled[slot * sw->ncolors + color] = 0;
+  resize_buffer(sw, slot, color,
+		used > 0 ? used : sw->bitwidth * sw->horizontal_width);
+  if (used > 0 &&
+      !spill_read(sw, sw->linebases[slot].v[color], used,
+		  spill_offset(sw, slot, color)))
+    {
+      spill_error(v, sw, "read");
+      memset(sw->linebases[slot].v[color], 0, used);
+    }
+}
+
+/*
+ * Make room for size bytes in a pass buffer, and return it, or NULL if
+ * the buffer has been spilled and the data must go to the spill file.
+ * Buffers grow by doubling; if growing one would exceed the limit, it's
+ * spilled instead, unless the caller needs it in memory.
+ */
+static unsigned char *
+reserve_buffer(stp_vars_t *v, stpi_softweave_t *sw, int slot, int color,
+	       size_t size, int may_spill)
+{
+  size_t alloc = sw->buffer_alloc[slot * sw->ncolors + color];
+  if (sw->buffer_spilled[slot * sw->ncolors + color])
+    {
+      if (may_spill)
+	return NULL;
+      reload_buffer(v, sw, slot, color);
+      alloc = sw->buffer_alloc[slot * sw->ncolors + color];
+    }
+  if (size > alloc)
+    {
+      size_t new_alloc = alloc * 2;
+      if (new_alloc > sw->buffer_size)
+	new_alloc = sw->buffer_size;
+      if (new_alloc < size)
+	new_alloc = size;
+      if (may_spill && sw->memory.limit > 0 &&
+	  sw->memory.current + new_alloc - alloc > sw->memory.limit &&
+	  spill_buffer(v, sw, slot, color))
+	return NULL;
+      resize_buffer(sw, slot, color, new_alloc);
+    }
+  return sw->linebases[slot].v[color];
+}
+
 static void
 check_linebases(stp_vars_t *v, stpi_softweave_t *sw,
 		int row, int cpass, int head_offset, int color)
 {
   stp_linebufs_t *bufs =
     (stp_linebufs_t *) stpi_get_linebases(v, sw, row, cpass, head_offset);
-  if (!(bufs->v[color]))
-    bufs->v[color] =
-      stp_zalloc (sw->virtual_jets * sw->bitwidth * sw->horizontal_width);
+  int slot = bufs - sw->linebases;
+  if (!(bufs->v[color]) && !sw->buffer_spilled[slot * sw->ncolors + color])
+    resize_buffer(sw, slot, color, sw->bitwidth * sw->horizontal_width);
 }
 
 /*
@@ -1338,13 +1567,16 @@ stp_fill_tiff(stp_vars_t *v, int row, int subpass,
   int k = 0;
 
   width = sw->bitwidth * width * 8;
+  bufs = stpi_get_linebases(v, sw, row, subpass, sw->head_offset[color]);
+  reserve_buffer(v, sw, bufs - sw->linebases, color,
+		 missingstartrows * 2 * ((width + 128 * 8 - 1) / (128 * 8)),
+		 0);
   for (k = 0; k < missingstartrows; k++)
     {
       int bytes_to_fill = width;
       int full_blocks = bytes_to_fill / (128 * 8);
       int leftover = (7 + (bytes_to_fill % (128 * 8))) / 8;
       int l = 0;
-      bufs = stpi_get_linebases(v, sw, row, subpass, sw->head_offset[color]);
 
       while (l < full_blocks)
 	{
@@ -1386,6 +1618,7 @@ stp_fill_uncompressed(stp_vars_t *v, int row, int subpass,
   lineoffs = stpi_get_lineoffsets(v, sw, row, subpass, sw->head_offset[color]);
   linecount = stpi_get_linecount(v, sw, row, subpass, sw->head_offset[color]);
   width *= sw->bitwidth * missingstartrows;
+  reserve_buffer(v, sw, bufs - sw->linebases, color, width, 0);
   memset(bufs->v[color], 0, width);
   lineoffs->v[color] = width;
   linecount->v[color] = missingstartrows;
@@ -1484,6 +1717,7 @@ add_to_row_1(stp_vars_t *v, stpi_softweave_t *sw, int row, unsigned char *buf,
     stpi_get_linecount(v, sw, sw->lineno, h_pass, sw->head_offset[color]);
   size_t place = lineoffs->v[color];
   size_t count = linecount->v[color];
+  unsigned char *base;
   if (place + nbytes > sw->virtual_jets * sw->bitwidth * sw->horizontal_width)
     {
       int i;
@@ -1526,7 +1760,19 @@ add_to_row_1(stp_vars_t *v, stpi_softweave_t *sw, int row, unsigned char *buf,
       stp_eprintf(v, "ERROR: %s\n", _("Please report the above information to gimp-print-devel@lists.sourceforge.net"));
       stp_abort();
     }
-  memcpy(bufs->v[color] + lineoffs->v[color], buf, nbytes);
+  base = reserve_buffer(v, sw, bufs - sw->linebases, color, place + nbytes, 1);
+  if (!base &&
+      !spill_write(sw, buf, nbytes,
+		   spill_offset(sw, bufs - sw->linebases, color) + place))
+    {
+      spill_error(v, sw, "write");
+      base = reserve_buffer(v, sw, bufs - sw->linebases, color,
+			    place + nbytes, 0);
+    }
+  if (base)
+    memcpy(base + place, buf, nbytes);
+  else
+    sw->memory.spilled += nbytes;
   lineoffs->v[color] += nbytes;
   if (setactive)
     lineactive->v[color] = 1;
@@ -1556,18 +1802,42 @@ stpi_flush_passes(stp_vars_t *v, int flushall)
        * This ought to be   pass->physpassend >  sw->lineno
        * but that causes rubbish to be output for some reason.
        */
+      int slot = pass - sw->passes;
+      int j;
       if (pass->pass < 0 || (!flushall && pass->physpassend >= sw->lineno))
 	return;
+      for (j = 0; j < sw->ncolors; j++)
+	if (sw->buffer_spilled[slot * sw->ncolors + j])
+	  reload_buffer(v, sw, slot, j);
       (sw->flushfunc)(v, pass->pass, pass->subpass);
       sw->last_pass = pass->pass;
       pass->pass = -1;
+      for (j = 0; j < sw->ncolors; j++)
+	resize_buffer(sw, slot, j, 0);
     }
 }
 
 void
 stp_flush_all(stp_vars_t *v)
 {
+  stpi_softweave_t *sw = get_sw(v);
   stpi_flush_passes(v, 1);
+  stp_dprintf(STP_DBG_WEAVE_PARAMS, v,
+	      "Weave buffers: peak %lu of %lu bytes (limit %lu), %lu spilled\n",
+	      (unsigned long) sw->memory.peak,
+	      (unsigned long) sw->memory.unbounded,
+	      (unsigned long) sw->memory.limit,
+	      (unsigned long) sw->memory.spilled);
+}
+
+int
+stp_get_weave_memory(const stp_vars_t *v, stp_weave_memory_t *usage)
+{
+  const stpi_softweave_t *sw = get_sw(v);
+  if (!sw)
+    return 0;
+  *usage = sw->memory;
+  return 1;
 }
 
 static void
@@ -1598,6 +1868,45 @@ finalize_row(stp_vars_t *v, stpi_softweave_t *sw)
     }
 }
 
+static void
+clear_extent(unsigned char *buf, int *first, int *last)
+{
+  if (*first <= *last)
+    memset(buf + *first, 0, *last - *first + 1);
+  *first = 0;
+  *last = -1;
+}
+
+/*
+ * Split the nonzero part of s[idx] among the vertical subpasses.  The
+ * round robin only advances on nonzero bytes, so starting at the first
+ * of them gives the same result as splitting the whole line.
+ */
+static void
+split_extent(stpi_softweave_t *sw, int length, int idx)
+{
+  unsigned char *outs[STP_MAX_WEAVE];
+  int first = sw->s_first[idx];
+  int last = sw->s_last[idx];
+  int k;
+  if (first > last)
+    return;
+  first -= first % sw->bitwidth;
+  last += sw->bitwidth - 1 - last % sw->bitwidth;
+  if (last >= length * sw->bitwidth)
+    last = length * sw->bitwidth - 1;
+  for (k = 0; k < sw->vertical_subpasses; k++)
+    {
+      int out = idx + k * sw->horizontal_weave;
+      outs[k * sw->horizontal_weave] = sw->s[out] + first;
+      sw->s_first[out] = first;
+      sw->s_last[out] = last;
+    }
+  stp_split((last - first + 1) / sw->bitwidth, sw->bitwidth,
+	    sw->vertical_subpasses, sw->s[idx] + first,
+	    sw->horizontal_weave, outs);
+}
+
 void
 stp_write_weave(stp_vars_t *v, unsigned char *const cols[])
 {
@@ -1630,6 +1939,17 @@ stp_write_weave(stp_vars_t *v, unsigned char *const cols[])
       sw->comp_buf = stp_zalloc(sw->bitwidth *
 				(sw->compute_linewidth)(v,ylength));
     }
+  if (!sw->blank_buf)
+    {
+      unsigned char *blank = stp_zalloc(sw->bitwidth * ylength);
+      sw->blank_buf = stp_zalloc(sw->bitwidth *
+				 (sw->compute_linewidth)(v, ylength));
+      sw->blank_active =
+	(sw->pack)(v, blank, sw->bitwidth * xlength, sw->blank_buf,
+		   &comp_ptr, &(sw->blank_first), &(sw->blank_last));
+      sw->blank_length = comp_ptr - sw->blank_buf;
+      stp_free(blank);
+    }
   if (sw->current_vertical_subpass == 0)
     initialize_row(v, sw, sw->lineno, xlength, cols);
 
@@ -1638,6 +1958,7 @@ stp_write_weave(stp_vars_t *v, unsigned char *const cols[])
       if (cols[j])
 	{
 	  const unsigned char *in;
+	  int first, last;
 	  int idx;
 
 	  for (i = 0; i < h_passes; i++)
@@ -1649,36 +1970,107 @@ stp_write_weave(stp_vars_t *v, unsigned char *const cols[])
 				      (sw->compute_linewidth)(v, ylength));
 	      linebounds[i] =
 		stpi_get_linebounds(v, sw, sw->lineno, pass, offset);
+	      clear_extent(sw->s[i], &(sw->s_first[i]), &(sw->s_last[i]));
 	    }
 
+	  /*
+	   * Only the part of the row between its first and last nonzero
+	   * bytes is folded, unpacked and split; the rest of each pass
+	   * line is known to be blank.
+	   */
 	  if (sw->bitwidth == 2)
 	    {
-	      stp_fold(cols[j], length, sw->fold_buf);
+	      int first_hi, last_hi;
+	      int found = stp_find_extent(cols[j], length, &first, &last);
+	      if (stp_find_extent(cols[j] + length, length,
+				  &first_hi, &last_hi))
+		{
+		  if (!found || first_hi < first)
+		    first = first_hi;
+		  if (!found || last_hi > last)
+		    last = last_hi;
+		  found = 1;
+		}
+	      clear_extent(sw->fold_buf, &(sw->fold_first), &(sw->fold_last));
+	      if (found)
+		{
+		  stp_fold_extent(cols[j], length, first, last, sw->fold_buf);
+		  first *= 2;
+		  last = last * 2 + 1;
+		  sw->fold_first = first;
+		  sw->fold_last = last;
+		}
+	      else
+		first = last + 1;
 	      in = sw->fold_buf;
 	    }
 	  else
-	    in = cols[j];
-	  if (sw->horizontal_weave == 1)
-	    memcpy(sw->s[0], in, length * sw->bitwidth);
-	  else
-	    stp_unpack(length, sw->bitwidth, sw->horizontal_weave, in, sw->s);
+	    {
+	      if (!stp_find_extent(cols[j], length * sw->bitwidth,
+				   &first, &last))
+		first = last + 1;
+	      in = cols[j];
+	    }
+	  if (first > last)
+	    ;
+	  else if (sw->horizontal_weave == 1)
+	    {
+	      memcpy(sw->s[0] + first, in + first, last - first + 1);
+	      sw->s_first[0] = first;
+	      sw->s_last[0] = last;
+	    }
+	  else if (stp_unpack_extent(length, sw->bitwidth, sw->horizontal_weave,
+				     in, sw->s, first, last, &first, &last))
+	    {
+	      for (idx = 0; idx < sw->horizontal_weave; idx++)
+		{
+		  sw->s_first[idx] = first;
+		  sw->s_last[idx] = last;
+		}
+	    }
 	  if (sw->vertical_subpasses > 1)
 	    {
 	      for (idx = 0; idx < sw->horizontal_weave; idx++)
-		stp_split(length, sw->bitwidth, sw->vertical_subpasses,
-			  sw->s[idx], sw->horizontal_weave, &(sw->s[idx]));
+		split_extent(sw, length, idx);
 	    }
 	  for (i = 0; i < h_passes; i++)
 	    {
-	      int first, last;
-	      setactive = (sw->pack)(v, sw->s[i], sw->bitwidth * xlength,
-				     sw->comp_buf, &comp_ptr, &first, &last);
+	      const unsigned char *packed = sw->comp_buf;
+	      size_t packed_length;
+	      if (sw->s_first[i] > sw->s_last[i] ||
+		  !stp_find_extent(sw->s[i] + sw->s_first[i],
+				   sw->s_last[i] - sw->s_first[i] + 1,
+				   &first, &last))
+		{
+		  packed = sw->blank_buf;
+		  packed_length = sw->blank_length;
+		  first = sw->blank_first;
+		  last = sw->blank_last;
+		  setactive = sw->blank_active;
+		}
+	      else if (sw->pack == stp_pack_tiff)
+		{
+		  first += sw->s_first[i];
+		  last += sw->s_first[i];
+		  setactive = stp_pack_tiff_extent(sw->s[i],
+						   sw->bitwidth * xlength,
+						   first, last, sw->comp_buf,
+						   &comp_ptr);
+		  packed_length = comp_ptr - sw->comp_buf;
+		}
+	      else
+		{
+		  setactive = (sw->pack)(v, sw->s[i], sw->bitwidth * xlength,
+					 sw->comp_buf, &comp_ptr,
+					 &first, &last);
+		  packed_length = comp_ptr - sw->comp_buf;
+		}
 	      if (first < linebounds[i]->start_pos[j])
 		linebounds[i]->start_pos[j] = first;
 	      if (last > linebounds[i]->end_pos[j])
 		linebounds[i]->end_pos[j] = last;
-	      add_to_row(v, sw, sw->lineno, sw->comp_buf,
-			 comp_ptr - sw->comp_buf, j, setactive, cpass + i);
+	      add_to_row(v, sw, sw->lineno, (unsigned char *) packed,
+			 packed_length, j, setactive, cpass + i);
 	    }
 	}
     }
@@ -37,6 +37,8 @@
 #endif
 #include <string.h>
 #include <stdlib.h>
+#include <strings.h>
+#include <ctype.h>
 
 #define FMIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -58,6 +60,31 @@ static const char* stpi_printer_long_namefunc(const void *item);
 
 static stp_list_t *printer_list = NULL;
 
+/*
+ * The list itself indexes printers by driver and long name.  Device IDs
+ * are looked up in hash tables built on the first lookup after the list
+ * changes.  Each maps one key (device ID, or normalized manufacturer
+ * and model from the device ID) to the first printer in list order with
+ * that key, which is the printer a scan of the list would find.
+ */
+typedef struct
+{
+  const char *key;
+  const stp_printer_t *printer;
+} printer_index_entry_t;
+
+typedef struct
+{
+  printer_index_entry_t *entries;
+  size_t size;			/* Number of slots; a power of two */
+} printer_index_t;
+
+static printer_index_t printer_index_by_device_id;
+static printer_index_t printer_index_by_mfg_mdl;
+static char **printer_index_mfg_mdl_keys = NULL;
+static size_t printer_index_mfg_mdl_count = 0;
+static int printer_index_valid = 0;
+
 struct stp_printer
 {
   const char *driver;
@@ -84,15 +111,19 @@ stpi_init_printvars_list(void)
     }
 }
 
+static void stpi_invalidate_printer_index(void);
+
 static int
 stpi_init_printer_list(void)
 {
+  stpi_invalidate_printer_index();
   if(printer_list)
     stp_list_destroy(printer_list);
   printer_list = stp_list_create();
   stp_list_set_freefunc(printer_list, stpi_printer_freefunc);
   stp_list_set_namefunc(printer_list, stpi_printer_namefunc);
   stp_list_set_long_namefunc(printer_list, stpi_printer_long_namefunc);
+  stpi_list_index_names(printer_list);
   /* stp_list_set_sortfunc(printer_list, stpi_printer_sortfunc); */
   return 0;
 }
@@ -215,16 +246,211 @@ stpi_get_printfuncs(const stp_printer_t *printer)
 }
 
 
-const stp_printer_t *
-stp_get_printer_by_long_name(const char *long_name)
+static unsigned long
+printer_index_hash(const char *key)
+{
+  unsigned long hash = 2166136261UL;
+  while (*key)
+    {
+      hash ^= (unsigned char) *key++;
+      hash *= 16777619UL;
+    }
+  return hash;
+}
+
+static void
+printer_index_clear(printer_index_t *index)
+{
+  STP_SAFE_FREE(index->entries);
+  index->size = 0;
+}
+
+static void
+printer_index_init(printer_index_t *index, size_t count)
+{
+  size_t size = 16;
+  while (size < count * 2)
+    size *= 2;
+  index->entries = stp_zalloc(sizeof(printer_index_entry_t) * size);
+  index->size = size;
+}
+
+static void
+printer_index_add(printer_index_t *index, const char *key,
+		  const stp_printer_t *printer)
+{
+  size_t mask = index->size - 1;
+  size_t slot;
+  if (!key || !key[0])
+    return;
+  slot = printer_index_hash(key) & mask;
+  while (index->entries[slot].key)
+    {
+      if (strcmp(index->entries[slot].key, key) == 0)
+	return;			/* Earlier entry wins */
+      slot = (slot + 1) & mask;
+    }
+  index->entries[slot].key = key;
+  index->entries[slot].printer = printer;
+}
+
+static const stp_printer_t *
+printer_index_find(const printer_index_t *index, const char *key)
+{
+  size_t mask = index->size - 1;
+  size_t slot;
+  if (!key || !index->size)
+    return NULL;
+  slot = printer_index_hash(key) & mask;
+  while (index->entries[slot].key)
+    {
+      if (strcmp(index->entries[slot].key, key) == 0)
+	return index->entries[slot].printer;
+      slot = (slot + 1) & mask;
+    }
+  return NULL;
+}
+
+/*
+ * Copy the value of an IEEE 1284 device ID field into buf, folding
+ * case and collapsing runs of whitespace, so that "MFG:EPSON;" and
+ * "MANUFACTURER: Epson ;" compare equal.
+ */
+static size_t
+device_id_field(const char *device_id, const char *key1, const char *key2,
+		char *buf, size_t bufsize)
+{
+  const char *ptr = device_id;
+  size_t len = 0;
+  while (*ptr)
+    {
+      const char *field = ptr;
+      const char *colon;
+      size_t keylen;
+      while (*ptr && *ptr != ';')
+	ptr++;
+      colon = memchr(field, ':', ptr - field);
+      if (colon)
+	{
+	  while (field < colon && isspace((unsigned char) *field))
+	    field++;
+	  keylen = colon - field;
+	  while (keylen > 0 && isspace((unsigned char) field[keylen - 1]))
+	    keylen--;
+	  if ((keylen == strlen(key1) && strncasecmp(field, key1, keylen) == 0) ||
+	      (keylen == strlen(key2) && strncasecmp(field, key2, keylen) == 0))
+	    {
+	      const char *val = colon + 1;
+	      int space = 0;
+	      for (; val < ptr && len + 1 < bufsize; val++)
+		{
+		  if (isspace((unsigned char) *val))
+		    space = len > 0;
+		  else
+		    {
+		      if (space && len + 2 < bufsize)
+			buf[len++] = ' ';
+		      space = 0;
+		      buf[len++] = tolower((unsigned char) *val);
+		    }
+		}
+	      buf[len] = '\0';
+	      return len;
+	    }
+	}
+      if (*ptr)
+	ptr++;
+    }
+  buf[0] = '\0';
+  return 0;
+}
+
+/*
+ * Normalized "manufacturer;model" key for a device ID, or NULL if it
+ * lacks either field.
+ */
+static char *
+device_id_mfg_mdl_key(const char *device_id)
+{
+  char mfg[256];
+  char mdl[256];
+  char *key;
+  if (!device_id ||
+      device_id_field(device_id, "MFG", "MANUFACTURER", mfg, sizeof(mfg)) == 0 ||
+      device_id_field(device_id, "MDL", "MODEL", mdl, sizeof(mdl)) == 0)
+    return NULL;
+  key = stp_malloc(strlen(mfg) + strlen(mdl) + 2);
+  sprintf(key, "%s;%s", mfg, mdl);
+  return key;
+}
+
+static void
+stpi_invalidate_printer_index(void)
+{
+  size_t i;
+  printer_index_clear(&printer_index_by_device_id);
+  printer_index_clear(&printer_index_by_mfg_mdl);
+  for (i = 0; i < printer_index_mfg_mdl_count; i++)
+    stp_free(printer_index_mfg_mdl_keys[i]);
+  STP_SAFE_FREE(printer_index_mfg_mdl_keys);
+  printer_index_mfg_mdl_count = 0;
+  printer_index_valid = 0;
+}
+
+static void
+stpi_build_printer_index(void)
+{
+  size_t count = stp_list_get_length(printer_list);
+  stp_list_item_t *printer_item = stp_list_get_start(printer_list);
+
+  stpi_invalidate_printer_index();
+  printer_index_init(&printer_index_by_device_id, count);
+  printer_index_init(&printer_index_by_mfg_mdl, count);
+  printer_index_mfg_mdl_keys = stp_zalloc(sizeof(char *) * (count + 1));
+
+  while (printer_item)
+    {
+      const stp_printer_t *printer =
+	(const stp_printer_t *) stp_list_item_get_data(printer_item);
+      char *key = device_id_mfg_mdl_key(printer->device_id);
+      printer_index_add(&printer_index_by_device_id,
+			printer->device_id, printer);
+      if (key)
+	{
+	  printer_index_mfg_mdl_keys[printer_index_mfg_mdl_count++] = key;
+	  printer_index_add(&printer_index_by_mfg_mdl, key, printer);
+	}
+      printer_item = stp_list_item_next(printer_item);
+    }
+  printer_index_valid = 1;
+  stp_deprintf(STP_DBG_PRINTERS, "stpi_build_printer_index: %lu printers\n",
+	       (unsigned long) count);
+}
+
+static void
+stpi_check_printer_list(void)
 {
-  stp_list_item_t *printer_item;
   if (printer_list == NULL)
     {
       stp_erprintf("No printer drivers found: "
 		   "are STP_DATA_PATH and STP_MODULE_PATH correct?\n");
       stpi_init_printer_list();
     }
+}
+
+static void
+stpi_check_printer_index(void)
+{
+  stpi_check_printer_list();
+  if (!printer_index_valid)
+    stpi_build_printer_index();
+}
+
+const stp_printer_t *
+stp_get_printer_by_long_name(const char *long_name)
+{
+  stp_list_item_t *printer_item;
+  stpi_check_printer_list();
   printer_item = stp_list_get_item_by_long_name(printer_list, long_name);
   if (!printer_item)
     return NULL;
@@ -235,12 +461,7 @@ const stp_printer_t *
 stp_get_printer_by_driver(const char *driver)
 {
   stp_list_item_t *printer_item;
-  if (printer_list == NULL)
-    {
-      stp_erprintf("No printer drivers found: "
-		   "are STP_DATA_PATH and STP_MODULE_PATH correct?\n");
-      stpi_init_printer_list();
-    }
+  stpi_check_printer_list();
   printer_item = stp_list_get_item_by_name(printer_list, driver);
   if (!printer_item)
     return NULL;
@@ -250,25 +471,28 @@ stp_get_printer_by_driver(const char *driver)
 const stp_printer_t *
 stp_get_printer_by_device_id(const char *device_id)
 {
-  stp_list_item_t *printer_item;
-  if (printer_list == NULL)
-    {
-      stp_erprintf("No printer drivers found: "
-		   "are STP_DATA_PATH and STP_MODULE_PATH correct?\n");
-      stpi_init_printer_list();
-    }
+  const stp_printer_t *printer;
+  char *key;
+  stpi_check_printer_index();
   if (! device_id || strcmp(device_id, "") == 0)
     return NULL;
 
-  printer_item = stp_list_get_start(printer_list);
-  while (printer_item)
+  printer = printer_index_find(&printer_index_by_device_id, device_id);
+  if (printer)
+    return printer;
+
+  /*
+   * Device IDs reported by printers usually carry more fields, or the
+   * same fields in a different order or case, than the ones in our
+   * data; fall back to matching on manufacturer and model.
+   */
+  key = device_id_mfg_mdl_key(device_id);
+  if (key)
     {
-      if (strcmp(((const stp_printer_t *) stp_list_item_get_data(printer_item))->device_id,
-		 device_id) == 0)
-	return ((const stp_printer_t *) stp_list_item_get_data(printer_item));
-      printer_item = stp_list_item_next(printer_item);
+      printer = printer_index_find(&printer_index_by_mfg_mdl, key);
+      stp_free(key);
     }
-  return NULL;
+  return printer;
 }
 
 int
@@ -1023,6 +1247,7 @@ stpi_family_register(stp_list_t *family)
 	 "stpi_family_register(): initialising printer_list...\n");
     }
 
+  stpi_invalidate_printer_index();
   if (family)
     {
       /* Check for duplicates after loading printers */
@@ -1053,6 +1278,7 @@ stpi_family_unregister(stp_list_t *family)
 	 "stpi_family_unregister(): initialising printer_list...\n");
     }
 
+  stpi_invalidate_printer_index();
   if (family)
     {
       printer_item = stp_list_get_start(family);
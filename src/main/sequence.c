@@ -380,7 +380,51 @@ stp_sequence_create_from_xmltree(stp_mxml_node_t *da)
       i = 0;
       while (child && i < point_count)
 	{
-	  if (child->type == STP_MXML_TEXT)
+	  if (child->type == STP_MXML_OPAQUE && child->value.opaque)
+	    {
+	      /*
+	       * The whole sequence as one string (see
+	       * stpi_xml_type_callback()); parse it in place.
+	       */
+	      const char *ptr = child->value.opaque;
+	      while (i < point_count)
+		{
+		  char *endptr;
+		  double tmpval;
+		  while (isspace((unsigned char) *ptr))
+		    ptr++;
+		  if (! *ptr)
+		    break;
+		  errno = 0;
+		  tmpval = stpi_xmlstrtod(ptr, &endptr);
+		  if (endptr == ptr)
+		    {
+		      stp_erprintf
+			("stp_sequence_create_from_xmltree: bad data %s\n",
+			 ptr);
+		      goto error;
+		    }
+		  if (! isfinite(tmpval)
+		      || ( tmpval == 0 && errno == ERANGE )
+		      || tmpval < low
+		      || tmpval > high)
+		    {
+		      stp_erprintf("stp_sequence_create_from_xmltree: "
+				   "read aborted: datum out of bounds: "
+				   "%g %d %s (require %g <= x <= %g), n = %d\n",
+				   tmpval, errno, ptr, low, high, i);
+		      goto error;
+		    }
+		  ret->data[i] = tmpval;
+		  i++;
+		  ptr = endptr;
+		  while (*ptr && ! isspace((unsigned char) *ptr))
+		    ptr++;
+		}
+	      ret->recompute_range = 1;
+	      invalidate_auxilliary_data(ret);
+	    }
+	  else if (child->type == STP_MXML_TEXT)
 	    {
 	      char *endptr;
 	      /*
@@ -68,6 +68,7 @@ stp_string_list_create(void)
   stp_list_set_namefunc(ret, namefunc);
   stp_list_set_copyfunc(ret, copyfunc);
   stp_list_set_long_namefunc(ret, long_namefunc);
+  stpi_list_index_names(ret);
   return (stp_string_list_t *) ret;
 }
 
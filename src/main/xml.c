@@ -255,6 +255,21 @@ stp_xml_init_defaults(void)
   return 0;
 }
 
+/*
+ * Type callback for loading Gutenprint XML.  The contents of a
+ * <sequence> are kept as a single opaque string, which
+ * stp_sequence_create_from_xmltree() parses directly, rather than as
+ * one text node per number.
+ */
+stp_mxml_type_t
+stpi_xml_type_callback(stp_mxml_node_t *node)
+{
+  if (node && node->type == STP_MXML_ELEMENT &&
+      strcmp(node->value.element.name, "sequence") == 0)
+    return STP_MXML_OPAQUE;
+  return STP_MXML_TEXT;
+}
+
 /*
  * Parse a single XML file.
  */
@@ -269,7 +284,7 @@ stp_xml_parse_file(const char *file) /* File to parse */
 
   stp_xml_init();
 
-  doc = stp_mxmlLoadFromFile(NULL, file, STP_MXML_NO_CALLBACK);
+  doc = stp_mxmlLoadFromFile(NULL, file, stpi_xml_type_callback);
 
   if ((cur = stp_xml_get_node(doc, "gutenprint", NULL)) == NULL)
     {
@@ -291,7 +306,7 @@ static stp_mxml_node_t *
 xml_try_parse_file_1(const char *pathname, const char *topnodename)
 {
   stp_mxml_node_t *root =
-    stp_mxmlLoadFromFile(NULL, pathname, STP_MXML_NO_CALLBACK);
+    stp_mxmlLoadFromFile(NULL, pathname, stpi_xml_type_callback);
   if (root)
     {
       stp_mxml_node_t *answer =
@@ -469,6 +484,92 @@ stp_xmlstrtoul(const char *textval)
   return val;
 }
 
+/*
+ * Powers of ten that are exactly representable as doubles.
+ */
+static const double xml_pow10[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Convert a decimal number into a double, with the same result and
+ * end pointer as strtod().  Plain decimal numbers whose digits fit in
+ * 53 bits and whose exponent is small are exact as a single multiply
+ * or divide of two exactly representable values (which are therefore
+ * correctly rounded); everything else (hex, inf/nan, long mantissas,
+ * large exponents) is handed to strtod().
+ */
+double
+stpi_xmlstrtod(const char *textval, char **endptr)
+{
+  const char *s = textval;
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  int negative = 0;
+  double val;
+
+  while (isspace((unsigned char) *s))
+    s++;
+  if (*s == '-' || *s == '+')
+    negative = (*s++ == '-');
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    return strtod(textval, endptr);
+  while (*s >= '0' && *s <= '9')
+    {
+      if (mantissa > (1ull << 53) / 10)
+	return strtod(textval, endptr);
+      mantissa = mantissa * 10 + (*s++ - '0');
+      digits++;
+    }
+  if (*s == '.')
+    {
+      s++;
+      while (*s >= '0' && *s <= '9')
+	{
+	  if (mantissa > (1ull << 53) / 10)
+	    return strtod(textval, endptr);
+	  mantissa = mantissa * 10 + (*s++ - '0');
+	  exponent--;
+	  digits++;
+	}
+    }
+  if (digits == 0)
+    return strtod(textval, endptr);
+  if (*s == 'e' || *s == 'E')
+    {
+      const char *e = s + 1;
+      int eneg = 0;
+      int eval = 0;
+      if (*e == '-' || *e == '+')
+	eneg = (*e++ == '-');
+      if (*e >= '0' && *e <= '9')
+	{
+	  while (*e >= '0' && *e <= '9')
+	    {
+	      if (eval > 1000)
+		return strtod(textval, endptr);
+	      eval = eval * 10 + (*e++ - '0');
+	    }
+	  exponent += eneg ? -eval : eval;
+	  s = e;
+	}
+    }
+  if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+    return strtod(textval, endptr);
+
+  val = (double) mantissa;
+  if (exponent < 0)
+    val /= xml_pow10[-exponent];
+  else
+    val *= xml_pow10[exponent];
+  if (endptr)
+    *endptr = (char *) s;
+  return negative ? -val : val;
+}
+
 /*
  * Convert a text string into a double.
  */
@@ -476,7 +577,7 @@ double
 stp_xmlstrtod(const char *textval)
 {
   double val; /* The value to return */
-  val = strtod(textval, (char **)NULL);
+  val = stpi_xmlstrtod(textval, (char **)NULL);
 
   return val;
 }
@@ -488,7 +589,7 @@ stp_dimension_t
 stp_xmlstrtodim(const char *textval)
 {
   double val; /* The value to return */
-  val = (stp_dimension_t) strtod(textval, (char **)NULL);
+  val = (stp_dimension_t) stpi_xmlstrtod(textval, (char **)NULL);
 
   return val;
 }
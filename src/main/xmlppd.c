@@ -49,120 +49,302 @@ order_compare(const void *a, const void *b)
 }
 
 
-static stp_mxml_node_t *
-find_element_named(stp_mxml_node_t *root, const char *name, const char *what)
+/*
+ * The groups, options, and choices of a PPD file are listed in document
+ * order when the file is read, and their names are hashed, so that
+ * looking one up by index or by name doesn't walk the tree.  Lists
+ * shorter than TABLE_HASH_MIN (as the choices of most options are) are
+ * searched rather than hashed.
+ */
+
+#define TABLE_HASH_MIN 8
+
+typedef struct
 {
-  stp_mxml_node_t *element;
-  if (root && name)
+  stp_mxml_node_t **nodes;	/* Elements in document order */
+  const char **names;		/* Their names */
+  int count;
+  int *slots;			/* Open addressing hash by name; index + 1 */
+  int size;			/* Slots in hash (power of 2) */
+} ppd_table_t;
+
+struct stpi_xmlppd
+{
+  char *filename;
+  stp_mxml_node_t *root;
+  ppd_table_t groups;
+  ppd_table_t options;
+  ppd_table_t *choices;		/* Choices of each option */
+  int *option_slots;		/* Open addressing hash by node; index + 1 */
+  int option_slots_size;	/* Slots in hash (power of 2) */
+};
+
+static unsigned
+name_hash(const char *name)
+{
+  unsigned hash = 2166136261U;
+  while (*name)
+    hash = (hash ^ (unsigned char) *name++) * 16777619U;
+  return hash;
+}
+
+static unsigned
+node_hash(const stp_mxml_node_t *node)
+{
+  size_t addr = (size_t) node;
+  return (unsigned) ((addr >> 4) ^ (addr >> 20)) * 2654435761U;
+}
+
+static int
+table_slot(const ppd_table_t *table, const char *name)
+{
+  int mask = table->size - 1;
+  int slot = name_hash(name) & mask;
+  while (table->slots[slot] &&
+	 strcmp(name, table->names[table->slots[slot] - 1]))
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+static void
+table_add(ppd_table_t *table, stp_mxml_node_t *node, int *alloc)
+{
+  if (table->count >= *alloc)
     {
-      for (element = stp_mxmlFindElement(root, root, what, NULL, NULL,
-					 STP_MXML_DESCEND);
-	   element;
-	   element = stp_mxmlFindElement(element, root, what, NULL, NULL,
-					 STP_MXML_DESCEND))
-	{
-	  if (!strcmp(stp_mxmlElementGetAttr(element, "name"), name))
-	    return element;
-	}
+      *alloc = *alloc ? *alloc * 2 : 16;
+      table->nodes = stp_realloc(table->nodes,
+				 *alloc * sizeof(stp_mxml_node_t *));
+      table->names = stp_realloc(table->names, *alloc * sizeof(const char *));
     }
-  return NULL;
+  table->nodes[table->count] = node;
+  table->names[table->count] = stp_mxmlElementGetAttr(node, "name");
+  table->count++;
+}
+
+/*
+ * Hash the names of a table once it is complete.  Where names repeat,
+ * the first is kept, as that is the one a walk of the tree would find.
+ */
+static void
+table_hash(ppd_table_t *table)
+{
+  int i;
+  if (table->count < TABLE_HASH_MIN)
+    return;
+  table->size = 2 * TABLE_HASH_MIN;
+  while (table->size < 2 * table->count)
+    table->size *= 2;
+  table->slots = stp_zalloc(table->size * sizeof(int));
+  for (i = 0; i < table->count; i++)
+    if (table->names[i])
+      {
+	int slot = table_slot(table, table->names[i]);
+	if (!table->slots[slot])
+	  table->slots[slot] = i + 1;
+      }
+}
+
+static void
+table_free(ppd_table_t *table)
+{
+  STP_SAFE_FREE(table->nodes);
+  STP_SAFE_FREE(table->names);
+  STP_SAFE_FREE(table->slots);
 }
 
 static stp_mxml_node_t *
-find_element_index(stp_mxml_node_t *root, int idx, const char *what)
+table_find_named(const ppd_table_t *table, const char *name)
 {
-  stp_mxml_node_t *element;
-  int count = 0;
-  if (root && idx >= 0)
+  if (!name)
+    return NULL;
+  if (table->slots)
     {
-      for (element = stp_mxmlFindElement(root, root, what, NULL, NULL,
-					 STP_MXML_DESCEND);
-	   element;
-	   element = stp_mxmlFindElement(element, root, what, NULL, NULL,
-					 STP_MXML_DESCEND))
-	{
-	  if (count++ == idx)
-	    return element;
-	}
+      int idx = table->slots[table_slot(table, name)];
+      return idx ? table->nodes[idx - 1] : NULL;
     }
+  else
+    {
+      int i;
+      for (i = 0; i < table->count; i++)
+	if (table->names[i] && !strcmp(table->names[i], name))
+	  return table->nodes[i];
+      return NULL;
+    }
+}
+
+static stp_mxml_node_t *
+table_find_index(const ppd_table_t *table, int idx)
+{
+  if (idx >= 0 && idx < table->count)
+    return table->nodes[idx];
   return NULL;
 }
 
-static size_t
-find_element_count(stp_mxml_node_t *root, const char *what)
+static int
+option_slot(const stpi_xmlppd_t *ppd, const stp_mxml_node_t *option)
+{
+  int mask = ppd->option_slots_size - 1;
+  int slot = node_hash(option) & mask;
+  while (ppd->option_slots[slot] &&
+	 ppd->options.nodes[ppd->option_slots[slot] - 1] != option)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+static const ppd_table_t *
+find_choices(const stpi_xmlppd_t *ppd, const stp_mxml_node_t *option)
 {
+  int idx;
+  if (!ppd || !option || !ppd->option_slots)
+    return NULL;
+  idx = ppd->option_slots[option_slot(ppd, option)];
+  return idx ? &(ppd->choices[idx - 1]) : NULL;
+}
+
+/*
+ * List the groups, options, and choices of a PPD tree.  The tree is
+ * walked in the same order stp_mxmlFindElement() would walk it.
+ */
+static stpi_xmlppd_t *
+index_ppd(stp_mxml_node_t *root, const char *filename)
+{
+  stpi_xmlppd_t *ppd = stp_zalloc(sizeof(stpi_xmlppd_t));
   stp_mxml_node_t *element;
-  size_t count = 0;
-  if (root)
+  int group_alloc = 0;
+  int option_alloc = 0;
+  int i;
+
+  ppd->filename = stp_strdup(filename);
+  ppd->root = root;
+  for (element = stp_mxmlWalkNext(root, root, STP_MXML_DESCEND);
+       element;
+       element = stp_mxmlWalkNext(element, root, STP_MXML_DESCEND))
+    {
+      if (element->type != STP_MXML_ELEMENT)
+	continue;
+      if (!strcmp(element->value.element.name, "group"))
+	table_add(&(ppd->groups), element, &group_alloc);
+      else if (!strcmp(element->value.element.name, "option"))
+	table_add(&(ppd->options), element, &option_alloc);
+    }
+  table_hash(&(ppd->groups));
+  table_hash(&(ppd->options));
+
+  ppd->choices = stp_zalloc((ppd->options.count + 1) * sizeof(ppd_table_t));
+  ppd->option_slots_size = 2 * TABLE_HASH_MIN;
+  while (ppd->option_slots_size < 2 * ppd->options.count)
+    ppd->option_slots_size *= 2;
+  ppd->option_slots = stp_zalloc(ppd->option_slots_size * sizeof(int));
+  for (i = 0; i < ppd->options.count; i++)
     {
-      for (element = stp_mxmlFindElement(root, root, what, NULL, NULL,
-					 STP_MXML_DESCEND);
+      stp_mxml_node_t *option = ppd->options.nodes[i];
+      int choice_alloc = 0;
+      for (element = stp_mxmlWalkNext(option, option, STP_MXML_DESCEND);
 	   element;
-	   element = stp_mxmlFindElement(element, root, what, NULL, NULL,
-					 STP_MXML_DESCEND))
-	count++;
+	   element = stp_mxmlWalkNext(element, option, STP_MXML_DESCEND))
+	if (element->type == STP_MXML_ELEMENT &&
+	    !strcmp(element->value.element.name, "choice"))
+	  table_add(&(ppd->choices[i]), element, &choice_alloc);
+      table_hash(&(ppd->choices[i]));
+      ppd->option_slots[option_slot(ppd, option)] = i + 1;
     }
-  return count;
+  return ppd;
+}
+
+void
+stpi_xmlppd_free(stpi_xmlppd_t *ppd)
+{
+  int i;
+  if (!ppd)
+    return;
+  table_free(&(ppd->groups));
+  for (i = 0; i < ppd->options.count; i++)
+    table_free(&(ppd->choices[i]));
+  table_free(&(ppd->options));
+  stp_free(ppd->choices);
+  stp_free(ppd->option_slots);
+  stp_mxmlDelete(ppd->root);
+  stp_free(ppd->filename);
+  stp_free(ppd);
+}
+
+stp_mxml_node_t *
+stpi_xmlppd_get_root(const stpi_xmlppd_t *ppd)
+{
+  return ppd ? ppd->root : NULL;
+}
+
+const char *
+stpi_xmlppd_get_filename(const stpi_xmlppd_t *ppd)
+{
+  return ppd ? ppd->filename : NULL;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_group_named(stp_mxml_node_t *root, const char *name)
+stpi_xmlppd_find_group_named(const stpi_xmlppd_t *ppd, const char *name)
 {
-  return find_element_named(root, name, "group");
+  return ppd ? table_find_named(&(ppd->groups), name) : NULL;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_group_index(stp_mxml_node_t *root, int idx)
+stpi_xmlppd_find_group_index(const stpi_xmlppd_t *ppd, int idx)
 {
-  return find_element_index(root, idx, "group");
+  return ppd ? table_find_index(&(ppd->groups), idx) : NULL;
 }
 
 int
-stpi_xmlppd_find_group_count(stp_mxml_node_t *root)
+stpi_xmlppd_find_group_count(const stpi_xmlppd_t *ppd)
 {
-  return find_element_count(root, "group");
+  return ppd ? ppd->groups.count : 0;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_option_named(stp_mxml_node_t *root, const char *name)
+stpi_xmlppd_find_option_named(const stpi_xmlppd_t *ppd, const char *name)
 {
-  return find_element_named(root, name, "option");
+  return ppd ? table_find_named(&(ppd->options), name) : NULL;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_option_index(stp_mxml_node_t *root, int idx)
+stpi_xmlppd_find_option_index(const stpi_xmlppd_t *ppd, int idx)
 {
-  return find_element_index(root, idx, "option");
+  return ppd ? table_find_index(&(ppd->options), idx) : NULL;
 }
 
 int
-stpi_xmlppd_find_option_count(stp_mxml_node_t *root)
+stpi_xmlppd_find_option_count(const stpi_xmlppd_t *ppd)
 {
-  return find_element_count(root, "option");
+  return ppd ? ppd->options.count : 0;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_choice_named(stp_mxml_node_t *option, const char *name)
+stpi_xmlppd_find_choice_named(const stpi_xmlppd_t *ppd,
+			      const stp_mxml_node_t *option, const char *name)
 {
-  return find_element_named(option, name, "choice");
+  const ppd_table_t *choices = find_choices(ppd, option);
+  return choices ? table_find_named(choices, name) : NULL;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_choice_index(stp_mxml_node_t *option, int idx)
+stpi_xmlppd_find_choice_index(const stpi_xmlppd_t *ppd,
+			      const stp_mxml_node_t *option, int idx)
 {
-  return find_element_index(option, idx, "choice");
+  const ppd_table_t *choices = find_choices(ppd, option);
+  return choices ? table_find_index(choices, idx) : NULL;
 }
 
 int
-stpi_xmlppd_find_choice_count(stp_mxml_node_t *option)
+stpi_xmlppd_find_choice_count(const stpi_xmlppd_t *ppd,
+			      const stp_mxml_node_t *option)
 {
-  return find_element_count(option, "choice");
+  const ppd_table_t *choices = find_choices(ppd, option);
+  return choices ? choices->count : 0;
 }
 
 stp_mxml_node_t *
-stpi_xmlppd_find_page_size(stp_mxml_node_t *root, const char *name)
+stpi_xmlppd_find_page_size(const stpi_xmlppd_t *ppd, const char *name)
 {
-  return stpi_xmlppd_find_choice_named(stpi_xmlppd_find_option_named(root, "PageSize"), name);
+  return stpi_xmlppd_find_choice_named
+    (ppd, stpi_xmlppd_find_option_named(ppd, "PageSize"), name);
 }
 
 static void
@@ -187,12 +369,13 @@ parse_values(const char **data, int limit, char *value)
 }
 
 /*
- * 'read_ppd_file()' - Read a PPD file into XML data.
+ * 'read_ppd_file()' - Read a PPD file into XML data, and index it.
  */
 
-stp_mxml_node_t *				/* O - PPD file as XML */
+stpi_xmlppd_t *				/* O - PPD file as XML */
 stpi_xmlppd_read_ppd_file(const char *filename)	/* I - PPD file */
 {
+  stpi_xmlppd_t *index;			/* Indexed PPD file */
   stp_mxml_node_t *ppd,			/* Root node of "ppd" group */
 		*group,			/* Current group */
 		*option,		/* Current option */
@@ -211,7 +394,7 @@ stpi_xmlppd_read_ppd_file(const char *filename)	/* I - PPD file */
 		*text,			/* Pointer to text */
 		*value;			/* Pointer to value */
   order_t	*order_array;		/* Precedence order of options */
-  int		i;
+  int		i, j;
   int		option_count;
   int		order_length;
   char		*order_list;
@@ -496,11 +679,13 @@ stpi_xmlppd_read_ppd_file(const char *filename)	/* I - PPD file */
       option = NULL;
       stp_option_data_name[0] = '\0';
     }
+  fclose(fp);
+  index = index_ppd(ppd, filename);
 
   for (i = 0; i < stp_string_list_count(ialist); i++)
     {
       stp_param_string_t *pstr = stp_string_list_param(ialist, i);
-      stp_mxml_node_t *psize = stpi_xmlppd_find_page_size(ppd, pstr->name);
+      stp_mxml_node_t *psize = stpi_xmlppd_find_page_size(index, pstr->name);
       if (psize)
 	{
 	  const char *data[4];
@@ -520,7 +705,7 @@ stpi_xmlppd_read_ppd_file(const char *filename)	/* I - PPD file */
   for (i = 0; i < stp_string_list_count(pdlist); i++)
     {
       stp_param_string_t *pstr = stp_string_list_param(pdlist, i);
-      stp_mxml_node_t *psize = stpi_xmlppd_find_page_size(ppd, pstr->name);
+      stp_mxml_node_t *psize = stpi_xmlppd_find_page_size(index, pstr->name);
       if (psize)
 	{
 	  const char *data[2];
@@ -535,16 +720,13 @@ stpi_xmlppd_read_ppd_file(const char *filename)	/* I - PPD file */
 	}
     }
   stp_string_list_destroy(pdlist);
-  option_count = stpi_xmlppd_find_option_count(ppd);
+  option_count = stpi_xmlppd_find_option_count(index);
   order_length = 1;		/* Terminating null */
   order_array = malloc(sizeof(order_t) * option_count);
   i = 0;
-  for (option = stp_mxmlFindElement(ppd, ppd, "option", NULL, NULL,
-				    STP_MXML_DESCEND);
-       option && i < option_count;
-       option = stp_mxmlFindElement(option, ppd, "option", NULL, NULL,
-				    STP_MXML_DESCEND))
+  for (j = 0; j < option_count; j++)
     {
+      option = stpi_xmlppd_find_option_index(index, j);
       if (stp_mxmlElementGetAttr(option, "order"))
 	{
 	  order_array[i].name = stp_mxmlElementGetAttr(option, "name");
@@ -567,7 +749,7 @@ stpi_xmlppd_read_ppd_file(const char *filename)	/* I - PPD file */
   stp_mxmlElementSetAttr(ppd, "optionorder", order_list);
   free(order_list);
   free(order_array);
-  return (ppd);
+  return (index);
 }
 
 /*
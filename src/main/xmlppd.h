@@ -19,26 +19,38 @@
 #ifndef GUTENPRINT_INTERNAL_XMLPPD_H
 #define GUTENPRINT_INTERNAL_XMLPPD_H
 
-extern stp_mxml_node_t *stpi_xmlppd_find_group_named(stp_mxml_node_t *root, const char *name);
+/*
+ * A PPD file read into XML data, with its groups, options, and choices
+ * indexed.  Nodes found in it remain valid until it is freed.
+ */
+typedef struct stpi_xmlppd stpi_xmlppd_t;
+
+extern stpi_xmlppd_t *stpi_xmlppd_read_ppd_file(const char *filename);
+
+extern void stpi_xmlppd_free(stpi_xmlppd_t *ppd);
+
+extern stp_mxml_node_t *stpi_xmlppd_get_root(const stpi_xmlppd_t *ppd);
+
+extern const char *stpi_xmlppd_get_filename(const stpi_xmlppd_t *ppd);
 
-extern stp_mxml_node_t *stpi_xmlppd_find_group_index(stp_mxml_node_t *root, int idx);
+extern stp_mxml_node_t *stpi_xmlppd_find_group_named(const stpi_xmlppd_t *ppd, const char *name);
 
-extern int stpi_xmlppd_find_group_count(stp_mxml_node_t *root);
+extern stp_mxml_node_t *stpi_xmlppd_find_group_index(const stpi_xmlppd_t *ppd, int idx);
 
-extern stp_mxml_node_t *stpi_xmlppd_find_option_named(stp_mxml_node_t *root, const char *name);
+extern int stpi_xmlppd_find_group_count(const stpi_xmlppd_t *ppd);
 
-extern stp_mxml_node_t *stpi_xmlppd_find_option_index(stp_mxml_node_t *root, int idx);
+extern stp_mxml_node_t *stpi_xmlppd_find_option_named(const stpi_xmlppd_t *ppd, const char *name);
 
-extern int stpi_xmlppd_find_option_count(stp_mxml_node_t *root);
+extern stp_mxml_node_t *stpi_xmlppd_find_option_index(const stpi_xmlppd_t *ppd, int idx);
 
-extern stp_mxml_node_t *stpi_xmlppd_find_choice_named(stp_mxml_node_t *option, const char *name);
+extern int stpi_xmlppd_find_option_count(const stpi_xmlppd_t *ppd);
 
-extern stp_mxml_node_t *stpi_xmlppd_find_choice_index(stp_mxml_node_t *option, int idx);
+extern stp_mxml_node_t *stpi_xmlppd_find_choice_named(const stpi_xmlppd_t *ppd, const stp_mxml_node_t *option, const char *name);
 
-extern int stpi_xmlppd_find_choice_count(stp_mxml_node_t *option);
+extern stp_mxml_node_t *stpi_xmlppd_find_choice_index(const stpi_xmlppd_t *ppd, const stp_mxml_node_t *option, int idx);
 
-extern stp_mxml_node_t *stpi_xmlppd_find_page_size(stp_mxml_node_t *root, const char *name);
+extern int stpi_xmlppd_find_choice_count(const stpi_xmlppd_t *ppd, const stp_mxml_node_t *option);
 
-extern stp_mxml_node_t *stpi_xmlppd_read_ppd_file(const char *filename);
+extern stp_mxml_node_t *stpi_xmlppd_find_page_size(const stpi_xmlppd_t *ppd, const char *name);
 
 #endif /* GUTENPRINT_INTERNAL_XMLPPD_H */
@@ -36,6 +36,8 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include "testpattern.h"
 #include <gutenprint/gutenprint-intl.h>
 #include <errno.h>
@@ -50,10 +52,22 @@ static void Image_init(stp_image_t *image);
 static stp_image_status_t Image_get_row(stp_image_t *image,
 					unsigned char *data,
 					size_t byte_limit, int row);
+static stp_image_status_t Image_get_rows(stp_image_t *image,
+					 unsigned char *data,
+					 size_t byte_limit, int row,
+					 int count);
+static stp_image_status_t Image_get_row_timed(stp_image_t *image,
+					      unsigned char *data,
+					      size_t byte_limit, int row);
+static stp_image_status_t Image_get_rows_timed(stp_image_t *image,
+					       unsigned char *data,
+					       size_t byte_limit, int row,
+					       int count);
 static int Image_height(stp_image_t *image);
 static void Image_reset(stp_image_t *image);
 static int Image_width(stp_image_t *image);
 static int Image_is_valid = 0;
+static int image_next_row = 0;	/* Next row of image input to be read */
 static stp_image_t theImage =
 {
   Image_init,
@@ -63,6 +77,9 @@ static stp_image_t theImage =
   Image_get_row,
   Image_get_appname,
   Image_conclude,
+  NULL,
+  0,
+  Image_get_rows,
   NULL
 };
 stp_vars_t *global_vars = NULL;
@@ -106,6 +123,18 @@ int failures = 0;
 int skipped = 0;
 size_t bytes_written = 0;
 
+/*
+ * With -b, one line describing each job and how long each stage of it
+ * took is appended to benchmark_log.  The stages are verification,
+ * setup (starting the job until the driver asks for the first row),
+ * input (generating or reading rows in the image callbacks) and
+ * rendering (everything else stp_print does).
+ */
+static FILE *benchmark_log = NULL;
+static struct timeval bench_first_row;
+static double bench_input_time;
+static int bench_rows;
+
 static testpattern_t *static_testpatterns;
 
 static size_t
@@ -269,6 +298,53 @@ initialize_global_parameters(void)
   end_job = 0;
 }
 
+static double
+compute_interval(const struct timeval *tv1, const struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static const char *
+benchmark_parameter(const stp_vars_t *v, const char *name)
+{
+  const char *val = stp_get_string_parameter(v, name);
+  return (val && val[0]) ? val : "-";
+}
+
+static void
+log_benchmark(const stp_vars_t *v, const char *status, int x, int y,
+	      const struct timeval *start, const struct timeval *verified,
+	      const struct timeval *printed, const struct timeval *done)
+{
+  const testpattern_t *t = &(static_testpatterns[0]);
+  struct rusage usage;
+  double setup = 0;
+  double render = 0;
+  if (!benchmark_log)
+    return;
+  if (bench_rows > 0)
+    {
+      setup = compute_interval(verified, &bench_first_row);
+      render = compute_interval(&bench_first_row, printed) - bench_input_time;
+    }
+  if (getrusage(RUSAGE_SELF, &usage))
+    usage.ru_maxrss = 0;
+  fprintf(benchmark_log,
+	  "%s\t%s\t%dx%d\t%s\t%s\t%s\t%s%d-%s\t%s\t%d\t%d\t%lu\t"
+	  "%.6f\t%.6f\t%.6f\t%.6f\t%.6f\t%ld\n",
+	  global_printer, benchmark_parameter(v, "Resolution"), x, y,
+	  benchmark_parameter(v, "DitherAlgorithm"),
+	  benchmark_parameter(v, "InkType"),
+	  benchmark_parameter(v, "PageSize"), global_image_type,
+	  global_bit_depth, t->type == E_IMAGE ? "image" : "pattern", status,
+	  t->type == E_IMAGE ? t->d.image.x : global_printer_width,
+	  bench_rows, (unsigned long) bytes_written,
+	  compute_interval(start, verified), setup, bench_input_time, render,
+	  compute_interval(start, done), (long) usage.ru_maxrss);
+  fflush(benchmark_log);
+}
+
 static int
 do_print(void)
 {
@@ -278,7 +354,9 @@ do_print(void)
   stp_dimension_t left, right, top, bottom;
   stp_resolution_t x, y;
   stp_dimension_t width, height;
+  struct timeval tv_start, tv_verified, tv_printed, tv_done;
   int retval;
+  int verified;
   stp_parameter_list_t params;
   int count;
   int i;
@@ -476,22 +554,32 @@ do_print(void)
   global_printer_width = width * x / 72;
   global_printer_height = height * y / 72;
 
-  global_band_height = global_printer_height / global_n_testpatterns;
+  /* An image is a single "pattern" that isn't counted */
+  if (global_n_testpatterns > 0)
+    global_band_height = global_printer_height / global_n_testpatterns;
   if (global_band_height == 0)
     global_band_height = 1;
   stp_set_left(v, left);
   stp_set_top(v, top);
 
   stp_merge_printvars(v, stp_printer_get_defaults(the_printer));
-  if (stp_verify(v))
+  bench_rows = 0;
+  bench_input_time = 0;
+  (void) gettimeofday(&tv_start, NULL);
+  verified = stp_verify(v);
+  (void) gettimeofday(&tv_verified, NULL);
+  if (verified)
     {
+      const char *bench_status = "ok";
       bytes_written = 0;
       if (start_job)
 	{
 	  stp_start_job(v, &theImage);
 	  start_job = 0;
 	}
-      if (stp_print(v, &theImage) != 1)
+      retval = stp_print(v, &theImage);
+      (void) gettimeofday(&tv_printed, NULL);
+      if (retval != 1)
 	{
 	  if (!global_quiet)
 	    fputs("FAILED", stderr);
@@ -499,6 +587,7 @@ do_print(void)
 	  status = 2;
 	  if (global_halt_on_error)
 	    return status;
+	  bench_status = "failed";
 	}
       else if (bytes_written == 0)
 	{
@@ -508,6 +597,7 @@ do_print(void)
 	  status = 2;
 	  if (global_halt_on_error)
 	    return status;
+	  bench_status = "failed";
 	}
       else
 	passes++;
@@ -516,6 +606,9 @@ do_print(void)
 	  stp_end_job(v, &theImage);
 	  end_job = 0;
 	}
+      (void) gettimeofday(&tv_done, NULL);
+      log_benchmark(v, bench_status, x, y, &tv_start, &tv_verified,
+		    &tv_printed, &tv_done);
     }
   else
     {
@@ -527,12 +620,16 @@ do_print(void)
 	  status = 2;
 	  if (global_halt_on_error)
 	    return status;
+	  log_benchmark(v, "failed", x, y, &tv_start, &tv_verified,
+			&tv_verified, &tv_verified);
 	}
       else
 	{
 	  if (!global_quiet)
 	    fputs("(skipped)", stderr);
 	  skipped++;
+	  log_benchmark(v, "skipped", x, y, &tv_start, &tv_verified,
+			&tv_verified, &tv_verified);
 	}
     }
   if (!global_quiet)
@@ -551,7 +648,7 @@ main(int argc, char **argv)
   int global_status = 0;
   while (1)
     {
-      c = getopt(argc, argv, "nqyH");
+      c = getopt(argc, argv, "nqyHb:");
       if (c == -1)
 	break;
       switch (c)
@@ -568,6 +665,22 @@ main(int argc, char **argv)
 	case 'H':
 	  global_halt_on_error = 1;
 	  break;
+	case 'b':
+	  benchmark_log = fopen(optarg, "a");
+	  if (!benchmark_log)
+	    {
+	      fprintf(stderr, "Cannot open %s: %s\n", optarg, strerror(errno));
+	      return 1;
+	    }
+	  if (fseek(benchmark_log, 0, SEEK_END) == 0 &&
+	      ftell(benchmark_log) == 0)
+	    fputs("# printer\tresolution\tdpi\tdither\tink_type\tpage_size\t"
+		  "input\tstatus\tcolumns\trows\tbytes\tverify_sec\t"
+		  "setup_sec\tinput_sec\trender_sec\ttotal_sec\t"
+		  "max_rss_kb\n", benchmark_log);
+	  theImage.get_row = Image_get_row_timed;
+	  theImage.get_rows = Image_get_rows_timed;
+	  break;
 	default:
 	  break;
 	}
@@ -584,6 +697,8 @@ main(int argc, char **argv)
 	global_status = 1;
     }
   close_output();
+  if (benchmark_log)
+    fclose(benchmark_log);
   if (passes + failures + skipped > 1)
     fprintf(stderr, "%d pass, %d fail, %d skipped\n", passes, failures, skipped);
   return global_status;
@@ -1129,6 +1244,32 @@ fill_pattern(testpattern_t *p, unsigned char *data, size_t width,
 }
 
 
+/*
+ * Image input comes from a stream, so it can be skipped forward to the
+ * row asked for but not rewound.  The rows skipped are read into data,
+ * which must hold at least one row.
+ */
+static stp_image_status_t
+seek_image_row(unsigned char *data, size_t row_bytes, int row)
+{
+  if (row < image_next_row)
+    {
+      fprintf(stderr, "Cannot reread image row %d after row %d!\n",
+	      row, image_next_row - 1);
+      return STP_IMAGE_STATUS_ABORT;
+    }
+  while (image_next_row < row)
+    {
+      if (fread(data, 1, row_bytes, yyin) != row_bytes)
+	{
+	  fputs("Read failed!\n", stderr);
+	  return STP_IMAGE_STATUS_ABORT;
+	}
+      image_next_row++;
+    }
+  return STP_IMAGE_STATUS_OK;
+}
+
 static stp_image_status_t
 Image_get_row(stp_image_t *image, unsigned char *data,
 	      size_t byte_limit, int row)
@@ -1142,13 +1283,18 @@ Image_get_row(stp_image_t *image, unsigned char *data,
   if (static_testpatterns[0].type == E_IMAGE)
     {
       testpattern_t *t = &(static_testpatterns[0]);
-      int total_read = fread(data, 1, t->d.image.x * depth * global_bit_depth / 8,
-			     yyin);
+      int total_read;
+      if (seek_image_row(data, t->d.image.x * depth * global_bit_depth / 8,
+			 row) != STP_IMAGE_STATUS_OK)
+	return STP_IMAGE_STATUS_ABORT;
+      total_read = fread(data, 1, t->d.image.x * depth * global_bit_depth / 8,
+			 yyin);
       if (total_read != t->d.image.x * depth * global_bit_depth / 8)
 	{
 	  fputs("Read failed!\n", stderr);
 	  return STP_IMAGE_STATUS_ABORT;
 	}
+      image_next_row = row + 1;
       if (!global_quiet)
 	fputc('.', stderr);
     }
@@ -1210,6 +1356,87 @@ Image_width(stp_image_t *image)
     return global_printer_width;
 }
 
+/*
+ * Image input is read (skipping forward to row, as by Image_get_row)
+ * in one block; test patterns are generated a row at a time.
+ */
+static stp_image_status_t
+Image_get_rows(stp_image_t *image, unsigned char *data,
+	       size_t byte_limit, int row, int count)
+{
+  int i;
+  if (Image_is_valid && static_testpatterns[0].type == E_IMAGE)
+    {
+      testpattern_t *t = &(static_testpatterns[0]);
+      size_t row_bytes = t->d.image.x * global_channel_depth *
+	global_bit_depth / 8;
+      if (row_bytes == byte_limit)
+	{
+	  size_t total_read;
+	  if (seek_image_row(data, row_bytes, row) != STP_IMAGE_STATUS_OK)
+	    return STP_IMAGE_STATUS_ABORT;
+	  total_read = fread(data, 1, row_bytes * count, yyin);
+	  if (total_read != row_bytes * count)
+	    {
+	      fputs("Read failed!\n", stderr);
+	      return STP_IMAGE_STATUS_ABORT;
+	    }
+	  image_next_row = row + count;
+	  if (!global_quiet)
+	    for (i = 0; i < count; i++)
+	      fputc('.', stderr);
+	  return STP_IMAGE_STATUS_OK;
+	}
+    }
+  for (i = 0; i < count; i++)
+    {
+      stp_image_status_t status =
+	Image_get_row(image, data + i * byte_limit, byte_limit, row + i);
+      if (status != STP_IMAGE_STATUS_OK)
+	return status;
+    }
+  return STP_IMAGE_STATUS_OK;
+}
+
+/*
+ * With -b, rows are fetched through these so that the time spent
+ * producing them is counted.
+ */
+static void
+count_input(const struct timeval *tv1, int count)
+{
+  struct timeval tv2;
+  (void) gettimeofday(&tv2, NULL);
+  if (bench_rows == 0)
+    bench_first_row = *tv1;
+  bench_input_time += compute_interval(tv1, &tv2);
+  bench_rows += count;
+}
+
+static stp_image_status_t
+Image_get_row_timed(stp_image_t *image, unsigned char *data,
+		    size_t byte_limit, int row)
+{
+  struct timeval tv;
+  stp_image_status_t status;
+  (void) gettimeofday(&tv, NULL);
+  status = Image_get_row(image, data, byte_limit, row);
+  count_input(&tv, 1);
+  return status;
+}
+
+static stp_image_status_t
+Image_get_rows_timed(stp_image_t *image, unsigned char *data,
+		     size_t byte_limit, int row, int count)
+{
+  struct timeval tv;
+  stp_image_status_t status;
+  (void) gettimeofday(&tv, NULL);
+  status = Image_get_rows(image, data, byte_limit, row, count);
+  count_input(&tv, count);
+  return status;
+}
+
 static int
 Image_height(stp_image_t *image)
 {
@@ -1229,7 +1456,7 @@ Image_init(stp_image_t *image)
       abort();
     }
   Image_is_valid = 1;
- /* dummy function */
+  image_next_row = 0;
 }
 
 static void
@@ -0,0 +1,474 @@
+/*
+ *   Test and benchmark for the bit interleaving primitives.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: bit-ops [-b] [-n iterations] [-l length]
+ *
+ * Without -b, stp_fold*, stp_split and stp_unpack are compared against
+ * straightforward bit at a time implementations on random input, and
+ * the *_extent variants, given only the nonzero part of a line, against
+ * the same operations on the whole line; the exit status is nonzero if
+ * any of them differ.  With -b, the throughput of each primitive is
+ * measured instead.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <gutenprint/gutenprint.h>
+#include <gutenprint/bit-ops.h>
+#include <gutenprint/weave.h>
+
+#define MAX_LENGTH 1024
+#define MAX_OUTS 16
+#define GUARD 64
+#define BUFSIZE (MAX_LENGTH * 16 + GUARD)
+
+static unsigned char inbuf[BUFSIZE];
+static unsigned char ref_out[MAX_OUTS][BUFSIZE];
+static unsigned char test_out[MAX_OUTS][BUFSIZE];
+static int failures = 0;
+
+static double
+compute_interval(struct timeval *tv1, struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static void
+fill_random(unsigned char *buf, size_t count, int density)
+{
+  size_t i;
+  for (i = 0; i < count; i++)
+    {
+      unsigned char c = random() & 0xff;
+      /* Mix in runs of zero and sparse bytes like real dithered output */
+      switch (density)
+	{
+	case 0:
+	  buf[i] = (random() % 4) ? 0 : c;
+	  break;
+	case 1:
+	  buf[i] = c & random() & random();
+	  break;
+	default:
+	  buf[i] = c;
+	}
+    }
+}
+
+static void
+reset_outputs(void)
+{
+  int i;
+  for (i = 0; i < MAX_OUTS; i++)
+    {
+      memset(ref_out[i], 0xa5, BUFSIZE);
+      memset(test_out[i], 0xa5, BUFSIZE);
+    }
+}
+
+static void
+compare_outputs(const char *what, int length, int bits, int n)
+{
+  int i;
+  for (i = 0; i < MAX_OUTS; i++)
+    if (memcmp(ref_out[i], test_out[i], BUFSIZE) != 0)
+      {
+	fprintf(stderr, "%s: length %d bits %d n %d: output %d differs\n",
+		what, length, bits, n, i);
+	failures++;
+	return;
+      }
+}
+
+static void
+set_bit(unsigned char *buf, int pos)
+{
+  buf[pos / 8] |= 128 >> (pos % 8);
+}
+
+static int
+get_bit(const unsigned char *buf, int pos)
+{
+  return (buf[pos / 8] >> (7 - (pos % 8))) & 1;
+}
+
+/*
+ * Folding interleaves the planes bit by bit, most significant bit and
+ * highest numbered plane first.
+ */
+static void
+ref_fold(const unsigned char *line, int length, int planes,
+	 unsigned char *out)
+{
+  int i, b, p;
+  if (length <= 0)
+    return;
+  memset(out, 0, length * planes);
+  for (i = 0; i < length; i++)
+    for (b = 7; b >= 0; b--)
+      for (p = planes - 1; p >= 0; p--)
+	if (line[p * length + i] & (1 << b))
+	  set_bit(out + i * planes, (7 - b) * planes + (planes - 1 - p));
+}
+
+/*
+ * Splitting deals the nonzero units of the input, least significant
+ * first, round robin to the rows.  The input may be the first row.
+ */
+static void
+ref_split(int length, int bits, int n, const unsigned char *inrow,
+	  int increment, unsigned char **outs)
+{
+  static unsigned char in[BUFSIZE];
+  int limit = length * bits;
+  int row = 0;
+  int i, k;
+  memcpy(in, inrow, limit);
+  for (i = 0; i < n; i++)
+    memset(outs[i * increment], 0, limit);
+  for (i = 0; i < limit; i++)
+    for (k = 0; k < 8; k += bits)
+      {
+	int unit = in[i] & (((1 << bits) - 1) << k);
+	if (unit)
+	  {
+	    outs[row * increment][i] |= unit;
+	    row = (row + 1) % n;
+	  }
+      }
+}
+
+/*
+ * Unpacking deals the units of the input, most significant first, round
+ * robin to the outputs.
+ */
+static void
+ref_unpack(int length, int bits, int n, const unsigned char *in,
+	   unsigned char **outs)
+{
+  int units, u, b, i;
+  if (length <= 0)
+    return;
+  if (n == 16 && bits == 2)
+    units = 16 * ((length + 1) / 2);
+  else if (n == 16)
+    units = 16 * length;
+  else
+    units = 8 * length;
+  for (i = 0; i < n; i++)
+    memset(outs[i], 0, ((units / n) * bits + 7) / 8);
+  for (u = 0; u < units; u++)
+    for (b = 0; b < bits; b++)
+      if (get_bit(in, u * bits + b))
+	set_bit(outs[u % n], (u / n) * bits + b);
+}
+
+static void
+check_fold(int length)
+{
+  reset_outputs();
+  ref_fold(inbuf, length, 2, ref_out[0]);
+  stp_fold(inbuf, length, test_out[0]);
+  ref_fold(inbuf, length, 3, ref_out[1]);
+  stp_fold_3bit(inbuf, length, test_out[1]);
+  ref_fold(inbuf, length, 4, ref_out[2]);
+  stp_fold_4bit(inbuf, length, test_out[2]);
+  ref_fold(inbuf, length, 8, ref_out[3]);
+  stp_fold_8bit(inbuf, length, test_out[3]);
+  compare_outputs("fold", length, 1, 0);
+}
+
+static void
+check_split(int length, int bits, int n, int increment, int in_place)
+{
+  unsigned char *ref_ptrs[MAX_OUTS];
+  unsigned char *test_ptrs[MAX_OUTS];
+  int i;
+  reset_outputs();
+  for (i = 0; i < MAX_OUTS; i++)
+    {
+      ref_ptrs[i] = ref_out[i];
+      test_ptrs[i] = test_out[i];
+    }
+  if (in_place)
+    {
+      memcpy(ref_out[0], inbuf, length * bits);
+      memcpy(test_out[0], inbuf, length * bits);
+      ref_split(length, bits, n, ref_out[0], increment, ref_ptrs);
+      stp_split(length, bits, n, test_out[0], increment, test_ptrs);
+    }
+  else
+    {
+      ref_split(length, bits, n, inbuf, increment, ref_ptrs);
+      stp_split(length, bits, n, inbuf, increment, test_ptrs);
+    }
+  compare_outputs("split", length, bits, n);
+}
+
+static void
+check_unpack(int length, int bits, int n)
+{
+  unsigned char *ref_ptrs[MAX_OUTS];
+  unsigned char *test_ptrs[MAX_OUTS];
+  int i;
+  reset_outputs();
+  for (i = 0; i < MAX_OUTS; i++)
+    {
+      ref_ptrs[i] = ref_out[i];
+      test_ptrs[i] = test_out[i];
+    }
+  ref_unpack(length, bits, n, inbuf, ref_ptrs);
+  stp_unpack(length, bits, n, inbuf, test_ptrs);
+  compare_outputs("unpack", length, bits, n);
+}
+
+/*
+ * Put random data in a random window of the input, with zeros on
+ * either side, so that the margins range from none to most of the line.
+ */
+static void
+fill_window(unsigned char *buf, int count, int density)
+{
+  int start = random() % (count + 1);
+  int end = start + random() % (count - start + 1);
+  memset(buf, 0, count);
+  fill_random(buf + start, end - start, density);
+}
+
+static void
+ref_find_extent(const unsigned char *line, int length, int *first, int *last)
+{
+  int i;
+  *first = length;
+  *last = 0;
+  for (i = 0; i < length; i++)
+    if (line[i])
+      {
+	if (*first == length)
+	  *first = i;
+	*last = i;
+      }
+}
+
+static void
+check_extents(int length, int bits, int n, int density)
+{
+  unsigned char *ref_ptrs[MAX_OUTS];
+  unsigned char *test_ptrs[MAX_OUTS];
+  unsigned char *ref_end, *test_end;
+  int first, last, ref_first, ref_last, found;
+  int i;
+
+  fill_window(inbuf, length * bits, density);
+  ref_find_extent(inbuf, length * bits, &ref_first, &ref_last);
+  found = stp_find_extent(inbuf, length * bits, &first, &last);
+  if (first != ref_first || last != ref_last ||
+      found != (ref_first < length * bits))
+    {
+      fprintf(stderr, "find_extent: length %d: %d %d %d, expected %d %d\n",
+	      length * bits, found, first, last, ref_first, ref_last);
+      failures++;
+    }
+
+  for (i = 0; i < MAX_OUTS; i++)
+    {
+      memset(ref_out[i], 0, BUFSIZE);
+      memset(test_out[i], 0, BUFSIZE);
+      ref_ptrs[i] = ref_out[i];
+      test_ptrs[i] = test_out[i];
+    }
+  if (found && bits == 2)
+    {
+      int first_hi, last_hi;
+      stp_find_extent(inbuf, length, &first, &last);
+      if (stp_find_extent(inbuf + length, length, &first_hi, &last_hi))
+	{
+	  if (first > last || first_hi < first)
+	    first = first_hi;
+	  if (last_hi > last)
+	    last = last_hi;
+	}
+      stp_fold(inbuf, length, ref_out[0]);
+      stp_fold_extent(inbuf, length, first, last, test_out[0]);
+      compare_outputs("fold_extent", length, bits, 0);
+    }
+  if (found)
+    {
+      int out_first, out_last;
+      for (i = 0; i < MAX_OUTS; i++)
+	{
+	  memset(ref_out[i], 0, BUFSIZE);
+	  memset(test_out[i], 0, BUFSIZE);
+	}
+      stp_unpack(length, bits, n, inbuf, ref_ptrs);
+      stp_unpack_extent(length, bits, n, inbuf, test_ptrs, ref_first,
+			ref_last, &out_first, &out_last);
+      compare_outputs("unpack_extent", length, bits, n);
+    }
+
+  stp_pack_tiff(NULL, inbuf, length * bits, ref_out[0], &ref_end,
+		NULL, NULL);
+  stp_pack_tiff_extent(inbuf, length * bits, ref_first, ref_last,
+		       test_out[0], &test_end);
+  if (ref_end - ref_out[0] != test_end - test_out[0] ||
+      memcmp(ref_out[0], test_out[0], ref_end - ref_out[0]) != 0)
+    {
+      fprintf(stderr, "pack_tiff_extent: length %d: window %d-%d differs\n",
+	      length * bits, ref_first, ref_last);
+      failures++;
+    }
+}
+
+static void
+run_tests(int iterations, int max_length)
+{
+  int iter;
+  for (iter = 0; iter < iterations; iter++)
+    {
+      int length = 1 + random() % max_length;
+      int bits, n, increment;
+      fill_random(inbuf, BUFSIZE, iter % 3);
+      check_fold(length);
+      for (bits = 1; bits <= 2; bits++)
+	{
+	  for (n = 1; n <= 8; n++)
+	    for (increment = 1; increment <= 2; increment++)
+	      if (n * increment <= MAX_OUTS)
+		{
+		  check_split(length, bits, n, increment, 0);
+		  check_split(length, bits, n, increment, 1);
+		}
+	  for (n = 2; n <= 16; n *= 2)
+	    {
+	      check_unpack(length, bits, n);
+	      check_extents(length, bits, n, iter % 3);
+	    }
+	}
+    }
+}
+
+#define TIME(label, bytes, stmt)					\
+do									\
+  {									\
+    struct timeval tv1, tv2;						\
+    double elapsed;							\
+    int iter_;								\
+    (void) gettimeofday(&tv1, NULL);					\
+    for (iter_ = 0; iter_ < iterations; iter_++)			\
+      stmt;								\
+    (void) gettimeofday(&tv2, NULL);					\
+    elapsed = compute_interval(&tv1, &tv2);				\
+    printf("%-16s %8.2f MB/sec\n", label,				\
+	   elapsed > 0 ?						\
+	   (double) (bytes) * iterations / elapsed / 1048576 : 0);	\
+  } while (0)
+
+static void
+run_benchmark(int iterations, int length)
+{
+  unsigned char *outs[MAX_OUTS];
+  char label[32];
+  int i, bits, n;
+  for (i = 0; i < MAX_OUTS; i++)
+    outs[i] = test_out[i];
+  fill_random(inbuf, BUFSIZE, 0);
+
+  TIME("fold", length * 2, stp_fold(inbuf, length, test_out[0]));
+  TIME("fold_3bit", length * 3, stp_fold_3bit(inbuf, length, test_out[0]));
+  TIME("fold_4bit", length * 4, stp_fold_4bit(inbuf, length, test_out[0]));
+  TIME("fold_8bit", length * 8, stp_fold_8bit(inbuf, length, test_out[0]));
+  for (bits = 1; bits <= 2; bits++)
+    for (n = 2; n <= 4; n++)
+      {
+	sprintf(label, "split_%d_%d", n, bits);
+	TIME(label, length * bits,
+	     stp_split(length, bits, n, inbuf, 1, outs));
+      }
+  for (bits = 1; bits <= 2; bits++)
+    for (n = 2; n <= 16; n *= 2)
+      {
+	sprintf(label, "unpack_%d_%d", n, bits);
+	TIME(label, length * bits, stp_unpack(length, bits, n, inbuf, outs));
+      }
+
+  /* A line with ink in only an eighth of its width */
+  memset(inbuf, 0, length);
+  fill_random(inbuf + length / 2, length / 8, 0);
+  inbuf[length / 2] = inbuf[length / 2 + length / 8 - 1] = 1;
+  TIME("pack_tiff", length,
+       stp_pack_tiff(NULL, inbuf, length, test_out[0], &outs[1],
+		     &i, &n));
+  TIME("pack_tiff_extent", length,
+       (stp_find_extent(inbuf, length, &i, &n),
+	stp_pack_tiff_extent(inbuf, length, i, n, test_out[0], &outs[1])));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int benchmark = 0;
+  int iterations = 0;
+  int length = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "bn:l:")) != -1)
+    {
+      switch (c)
+	{
+	case 'b':
+	  benchmark = 1;
+	  break;
+	case 'n':
+	  iterations = atoi(optarg);
+	  break;
+	case 'l':
+	  length = atoi(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-b] [-n iterations] [-l length]\n",
+		  argv[0]);
+	  return 1;
+	}
+    }
+  if (length <= 0 || length > MAX_LENGTH)
+    length = benchmark ? MAX_LENGTH : 100;
+  if (iterations <= 0)
+    iterations = benchmark ? 20000 : 200;
+
+  stp_init();
+  srandom(1);
+
+  if (benchmark)
+    run_benchmark(iterations, length);
+  else
+    {
+      run_tests(iterations, length);
+      if (failures)
+	fprintf(stderr, "%d failures\n", failures);
+      else
+	printf("All bit operations match\n");
+    }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+/*
+ *   Test and benchmark for stp_color_preview.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: color-preview [-b] [-n iterations] [-s size]
+ *
+ * Without -b, a synthetic image is previewed with a range of color
+ * settings, and each preview is compared with the output of the
+ * raw-data-8 driver (which the GTK UI uses for its thumbnail) with the
+ * same settings; the exit status is nonzero if any of them differ.
+ * With -b, the time taken to follow a brightness slider is measured
+ * both ways.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <gutenprint/gutenprint.h>
+#include <gutenprint/color.h>
+
+static int image_size = 128;
+static unsigned char *print_buffer;
+static size_t print_offset;
+
+static double
+compute_interval(struct timeval *tv1, struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static void
+Image_init(stp_image_t *image)
+{
+}
+
+static void
+Image_reset(stp_image_t *image)
+{
+}
+
+static int
+Image_width(stp_image_t *image)
+{
+  return image_size;
+}
+
+static int
+Image_height(stp_image_t *image)
+{
+  return image_size;
+}
+
+/*
+ * Red and green ramps across and down the image, with blue varying
+ * along the diagonal, so every channel sees most of its range.
+ */
+static stp_image_status_t
+Image_get_row(stp_image_t *image, unsigned char *data, size_t byte_limit,
+	      int row)
+{
+  int i;
+  for (i = 0; i < image_size; i++)
+    {
+      data[3 * i] = i * 255 / (image_size - 1);
+      data[3 * i + 1] = row * 255 / (image_size - 1);
+      data[3 * i + 2] = ((i + row) * 255 / (image_size - 1)) & 255;
+    }
+  return STP_IMAGE_STATUS_OK;
+}
+
+static const char *
+Image_get_appname(stp_image_t *image)
+{
+  return "color-preview";
+}
+
+static void
+Image_conclude(stp_image_t *image)
+{
+}
+
+static stp_image_t theImage =
+{
+  Image_init,
+  Image_reset,
+  Image_width,
+  Image_height,
+  Image_get_row,
+  Image_get_appname,
+  Image_conclude,
+  NULL
+};
+
+static void
+writefunc(void *file, const char *buf, size_t bytes)
+{
+  size_t limit = image_size * image_size * 3;
+  if (print_offset + bytes > limit)
+    bytes = limit - print_offset;
+  memcpy(print_buffer + print_offset, buf, bytes);
+  print_offset += bytes;
+}
+
+static void
+errfunc(void *file, const char *buf, size_t bytes)
+{
+  fwrite(buf, 1, bytes, stderr);
+}
+
+static stp_vars_t *
+create_vars(void)
+{
+  stp_vars_t *v = stp_vars_create();
+  stp_set_driver(v, "raw-data-8");
+  stp_set_printer_defaults(v, stp_get_printer(v));
+  stp_set_outfunc(v, writefunc);
+  stp_set_errfunc(v, errfunc);
+  stp_set_string_parameter(v, "InkType", "RGB");
+  stp_set_string_parameter(v, "InputImageType", "RGB");
+  stp_set_string_parameter(v, "PageSize", "Custom");
+  stp_set_float_parameter(v, "InkLimit", 0);
+  stp_set_page_width(v, image_size);
+  stp_set_page_height(v, image_size);
+  stp_set_top(v, 0);
+  stp_set_left(v, 0);
+  stp_set_width(v, image_size);
+  stp_set_height(v, image_size);
+  return v;
+}
+
+static int
+print_image(const stp_vars_t *v)
+{
+  print_offset = 0;
+  return stp_print(v, &theImage) == 1;
+}
+
+typedef struct
+{
+  const char *name;
+  double value;
+} setting_t;
+
+static const setting_t settings[] =
+{
+  { NULL, 0 },
+  { "Brightness", 0.5 },
+  { "Brightness", 1.6 },
+  { "Contrast", 1.8 },
+  { "Gamma", 1.4 },
+  { "Saturation", 0.3 },
+  { "Density", 0.6 },
+  { "Cyan", 1.5 },
+  { "Brightness", 0.8 },
+};
+
+static int
+run_tests(void)
+{
+  size_t size = image_size * image_size * 3;
+  unsigned char *preview = stp_malloc(size);
+  stp_vars_t *v = create_vars();
+  int failures = 0;
+  int i;
+
+  print_buffer = stp_malloc(size);
+  for (i = 0; i < sizeof(settings) / sizeof(setting_t); i++)
+    {
+      const char *name = settings[i].name ? settings[i].name : "Default";
+      if (settings[i].name)
+	stp_set_float_parameter(v, settings[i].name, settings[i].value);
+      memset(preview, 0, size);
+      memset(print_buffer, 0xff, size);
+      if (!stp_color_preview(v, &theImage, preview))
+	{
+	  fprintf(stderr, "%s: preview failed\n", name);
+	  failures++;
+	}
+      else if (!print_image(v))
+	{
+	  fprintf(stderr, "%s: print failed\n", name);
+	  failures++;
+	}
+      else if (print_offset != size || memcmp(preview, print_buffer, size))
+	{
+	  fprintf(stderr, "%s: preview differs from raw-data-8 output\n",
+		  name);
+	  failures++;
+	}
+    }
+  stp_vars_destroy(v);
+  stp_free(preview);
+  stp_free(print_buffer);
+  if (failures)
+    fprintf(stderr, "%d failures\n", failures);
+  else
+    printf("All previews match\n");
+  return failures;
+}
+
+static void
+run_benchmark(int iterations)
+{
+  unsigned char *preview = stp_malloc(image_size * image_size * 3);
+  stp_vars_t *v = create_vars();
+  struct timeval tv1, tv2;
+  int i;
+
+  print_buffer = stp_malloc(image_size * image_size * 3);
+  (void) gettimeofday(&tv1, NULL);
+  for (i = 0; i < iterations; i++)
+    {
+      stp_set_float_parameter(v, "Brightness", 0.5 + (i % 10) / 10.0);
+      print_image(v);
+    }
+  (void) gettimeofday(&tv2, NULL);
+  printf("stp_print          %8.3f ms/preview\n",
+	 compute_interval(&tv1, &tv2) * 1000 / iterations);
+
+  (void) gettimeofday(&tv1, NULL);
+  for (i = 0; i < iterations; i++)
+    {
+      stp_set_float_parameter(v, "Brightness", 0.5 + (i % 10) / 10.0);
+      stp_color_preview(v, &theImage, preview);
+    }
+  (void) gettimeofday(&tv2, NULL);
+  printf("stp_color_preview  %8.3f ms/preview\n",
+	 compute_interval(&tv1, &tv2) * 1000 / iterations);
+  stp_vars_destroy(v);
+  stp_free(preview);
+  stp_free(print_buffer);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int benchmark = 0;
+  int iterations = 100;
+  int c;
+
+  while ((c = getopt(argc, argv, "bn:s:")) != -1)
+    {
+      switch (c)
+	{
+	case 'b':
+	  benchmark = 1;
+	  break;
+	case 'n':
+	  iterations = atoi(optarg);
+	  break;
+	case 's':
+	  image_size = atoi(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-b] [-n iterations] [-s size]\n",
+		  argv[0]);
+	  return 1;
+	}
+    }
+  if (image_size < 2)
+    image_size = 128;
+  if (iterations <= 0)
+    iterations = 100;
+
+  stp_init();
+  if (benchmark)
+    {
+      run_benchmark(iterations);
+      return 0;
+    }
+  return run_tests() ? 1 : 0;
+}
@@ -623,6 +623,84 @@ piecewise_curve_checks(stp_curve_t *curve1, int resample_points, int expected)
     }
 }
 
+/*
+ * Resampling and composing the same curves again is answered from
+ * memory; the answers must be exactly what was computed the first
+ * time, and a curve differing in one point must not match.
+ */
+static int
+same_data(const stp_curve_t *curve1, const stp_curve_t *curve2)
+{
+  size_t count1, count2;
+  const double *data1 = stp_curve_get_data(curve1, &count1);
+  const double *data2 = stp_curve_get_data(curve2, &count2);
+  return data1 && data2 && count1 == count2 &&
+    memcmp(data1, data2, count1 * sizeof(double)) == 0;
+}
+
+static stp_curve_t *
+create_sat_curve(void)
+{
+  stp_curve_t *curve = stp_curve_create(STP_CURVE_WRAP_AROUND);
+  stp_curve_set_interpolation_type(curve, STP_CURVE_TYPE_SPLINE);
+  stp_curve_set_bounds(curve, 0.0, 4.0);
+  stp_curve_set_data(curve, 48, standard_sat_adjustment);
+  return curve;
+}
+
+static void
+remembered_result_checks(void)
+{
+  stp_curve_t *curve1 = create_sat_curve();
+  stp_curve_t *curve2 = create_sat_curve();
+  stp_curve_t *curve3 = create_sat_curve();
+  stp_curve_t *gamma1 = stp_curve_create(STP_CURVE_WRAP_NONE);
+  stp_curve_t *gamma2 = stp_curve_create(STP_CURVE_WRAP_NONE);
+  stp_curve_t *result1 = NULL;
+  stp_curve_t *result2 = NULL;
+
+  TEST("resample curve to 4096 points");
+  SIMPLE_TEST_CHECK(stp_curve_resample(curve1, 4096));
+  TEST("resample identical curve to 4096 points");
+  SIMPLE_TEST_CHECK(stp_curve_resample(curve2, 4096));
+  TEST("identical curves resample identically");
+  SIMPLE_TEST_CHECK(same_data(curve1, curve2));
+
+  TEST("resample changed curve to 4096 points");
+  stp_curve_set_point(curve3, 10, 1.5);
+  SIMPLE_TEST_CHECK(stp_curve_resample(curve3, 4096));
+  TEST("changed curve resamples differently");
+  SIMPLE_TEST_CHECK(!same_data(curve1, curve3));
+
+  TEST("resample curve to 4095 points");
+  stp_curve_destroy(curve2);
+  curve2 = create_sat_curve();
+  stp_curve_resample(curve2, 4095);
+  SIMPLE_TEST_CHECK(stp_curve_count_points(curve2) == 4095);
+
+  stp_curve_set_gamma(gamma1, 1.5);
+  stp_curve_set_gamma(gamma2, 0.8);
+  TEST("compose gamma curves");
+  SIMPLE_TEST_CHECK(stp_curve_compose(&result1, gamma1, gamma2,
+				      STP_CURVE_COMPOSE_ADD, 1024));
+  TEST("compose identical gamma curves");
+  SIMPLE_TEST_CHECK(stp_curve_compose(&result2, gamma1, gamma2,
+				      STP_CURVE_COMPOSE_ADD, 1024));
+  TEST("identical curves compose identically");
+  SIMPLE_TEST_CHECK(result1 && result2 && result1 != result2 &&
+		    same_data(result1, result2));
+
+  stp_curve_destroy(curve1);
+  stp_curve_destroy(curve2);
+  stp_curve_destroy(curve3);
+  stp_curve_destroy(gamma1);
+  stp_curve_destroy(gamma2);
+  if (result1)
+    stp_curve_destroy(result1);
+  if (result2)
+    stp_curve_destroy(result2);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1223,6 +1301,8 @@ main(int argc, char **argv)
   curve1 = stp_curve_create_from_string(small_piecewise_curve);
   SIMPLE_TEST_CHECK(curve1);
 
+  remembered_result_checks();
+
   stp_curve_destroy(curve1);
   curve1 = NULL;
   stp_curve_destroy(curve2);
@@ -0,0 +1,127 @@
+/*
+ *   Regression test for the paper size list indexes.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: paper-index
+ *
+ * Builds a named paper size list, looks papers up by name and by size,
+ * then removes and adds papers so that the length of the list is
+ * unchanged, and checks that the lookups see the new contents rather
+ * than a stale index.  The exit status is nonzero on any mismatch.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <gutenprint/gutenprint.h>
+#include "../src/main/gutenprint-internal.h"
+
+static int failures = 0;
+
+static void
+add_paper(stp_papersize_list_t *list, const char *name,
+	  stp_dimension_t width, stp_dimension_t height)
+{
+  stp_papersize_t *paper = stp_zalloc(sizeof(stp_papersize_t));
+  paper->name = stp_strdup(name);
+  paper->text = stp_strdup(name);
+  paper->width = width;
+  paper->height = height;
+  if (stpi_papersize_create(list, paper))
+    {
+      printf("FAIL: could not add %s\n", name);
+      failures++;
+    }
+}
+
+static void
+check(const char *what, const stp_papersize_t *paper, const char *expected)
+{
+  const char *got = paper ? paper->name : "(none)";
+  if (!expected)
+    expected = "(none)";
+  if (strcmp(got, expected))
+    {
+      printf("FAIL: %s: expected %s, got %s\n", what, expected, got);
+      failures++;
+    }
+}
+
+int
+main(void)
+{
+  stp_papersize_list_t *list;
+
+  stp_init();
+  list = stpi_new_papersize_list("paper-index-test");
+  if (!list)
+    {
+      printf("FAIL: could not create paper list\n");
+      return 1;
+    }
+
+  add_paper(list, "A", 100, 200);
+  add_paper(list, "B", 300, 400);
+  add_paper(list, "C", 500, 600);
+  check("name B", stpi_get_papersize_by_name(list, "B"), "B");
+  check("size 300x400", stpi_get_papersize_by_size(list, 400, 300), "B");
+  check("size 302x401", stpi_get_papersize_by_size(list, 401, 302), "B");
+
+  /* Replace B with a paper of the same size */
+  if (stpi_papersize_destroy(list, "B"))
+    {
+      printf("FAIL: could not remove B\n");
+      failures++;
+    }
+  add_paper(list, "D", 300, 400);
+  check("name B after removal", stpi_get_papersize_by_name(list, "B"), NULL);
+  check("name D", stpi_get_papersize_by_name(list, "D"), "D");
+  check("size 300x400 after replacement",
+	stpi_get_papersize_by_size(list, 400, 300), "D");
+  check("exact size 300x400 after replacement",
+	stpi_get_papersize_by_size_exact(list, 400, 300), "D");
+
+  /* Replace A with a paper of a different size */
+  stpi_papersize_destroy(list, "A");
+  add_paper(list, "E", 700, 800);
+  check("name A after removal", stpi_get_papersize_by_name(list, "A"), NULL);
+  check("size 100x200 after removal",
+	stpi_get_papersize_by_size(list, 200, 100), NULL);
+  check("size 700x800", stpi_get_papersize_by_size(list, 800, 700), "E");
+  check("name C", stpi_get_papersize_by_name(list, "C"), "C");
+  check("size 500x600", stpi_get_papersize_by_size(list, 600, 500), "C");
+
+  if (stpi_papersize_destroy(list, "A") == 0)
+    {
+      printf("FAIL: removed A twice\n");
+      failures++;
+    }
+  if (stpi_papersize_count(list) != 3)
+    {
+      printf("FAIL: expected 3 papers, found %d\n", stpi_papersize_count(list));
+      failures++;
+    }
+
+  if (failures)
+    printf("%d failures\n", failures);
+  else
+    printf("All tests passed\n");
+  return failures ? 1 : 0;
+}
@@ -29,6 +29,7 @@
 #include<stdlib.h>
 #include<ctype.h>
 #include<string.h>
+#include "transfer-stats.h"
 
 /*
  * Size of buffer used to read file
@@ -52,6 +53,7 @@ int max_data_len = 0;
 
 int read_pointer;
 int read_size;
+long read_offset = 0;			/* File offset of read_buffer */
 int eof;
 int combined_command = 0;
 int skip_output = 0;
@@ -302,6 +304,7 @@ void fill_buffer(void)
 {
 
     if ((read_pointer == -1) || (read_pointer >= read_size)) {
+	read_offset += read_size;
 	read_size = (int) fread(&read_buffer, sizeof(char), READ_SIZE, read_fd);
 
 #ifdef DEBUG
@@ -961,6 +964,28 @@ int depth_to_rows(int depth)
     return(0);	/* ?? */
 }
 
+/*
+ * plane_colour() - name the colour of a data row, for the transfer
+ * statistics.  The rows arrive in the order they are stored in
+ * received_rows.
+ */
+
+static const char *
+plane_colour(const output_t *output, int row)
+{
+    if ((row -= output->black_data_rows_per_row) < 0)
+	return("K");
+    if ((row -= output->cyan_data_rows_per_row) < 0)
+	return("C");
+    if ((row -= output->magenta_data_rows_per_row) < 0)
+	return("M");
+    if ((row -= output->yellow_data_rows_per_row) < 0)
+	return("Y");
+    if ((row -= output->lcyan_data_rows_per_row) < 0)
+	return("c");
+    return("m");
+}
+
 static void
 print_command(int index, int arg)
 {
@@ -989,6 +1014,10 @@ int main(int argc, char *argv[])
     long filepos = -1;
     int wrote_header = 0;
     int state_is_clean = 1;
+    transfer_stats_t *stats = NULL;	/* Transfer statistics, if wanted */
+    const char *stats_file = NULL;
+    double link_mbps = TRANSFER_STATS_DEFAULT_MBPS;
+    int per_pass_stats = 0;
 
 /*
  * Holders for the decoded lines
@@ -1024,6 +1053,37 @@ int main(int argc, char *argv[])
 
     received_rows = NULL;
 
+/*
+ * Transfer statistics options come before the file names
+ */
+
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+	if (argv[1][1] == 'P')
+	    per_pass_stats = 1;
+	else if ((argv[1][1] == 'T' || argv[1][1] == 'L') && argc > 2) {
+	    if (argv[1][1] == 'T')
+		stats_file = argv[2];
+	    else
+		link_mbps = atof(argv[2]);
+	    argc--;
+	    argv++;
+	}
+	else {
+	    fprintf(stderr, "Usage: pcl-unprint [-T file [-L mbps] [-P]] [in [out]]\n");
+	    exit (EXIT_FAILURE);
+	}
+	argc--;
+	argv++;
+    }
+
+    if (stats_file) {
+	stats = transfer_stats_create(stats_file, link_mbps, per_pass_stats);
+	if (stats == NULL) {
+	    fprintf(stderr, "ERROR: Error Opening statistics file.\n");
+	    exit (EXIT_FAILURE);
+	}
+    }
+
     if(argc == 1){
 	read_fd = stdin;
 	write_fd = stdout;
@@ -1068,6 +1128,8 @@ int main(int argc, char *argv[])
 	if (eof == 1) {
 	    if (! state_is_clean)
 		fprintf(stderr, "EOF while reading command.\n");
+	    if (stats)
+		transfer_stats_finish(stats, read_offset);
 	    (void) fclose(read_fd);
 	    (void) fclose(write_fd);
 	    exit(EXIT_SUCCESS);
@@ -1304,6 +1366,8 @@ int main(int argc, char *argv[])
 
 	    case PCL_END_RASTER :
 	    case PCL_END_COLOUR_RASTER :
+		if (stats)
+		    transfer_stats_page(stats, read_offset + read_pointer);
 		print_command(command_index, numeric_arg);
 
 		if (skip_output == 0) {
@@ -2016,6 +2080,10 @@ int main(int argc, char *argv[])
 			    current_data_row, received_rows,
 			    data_buffer, received_rows[current_data_row]);
 		    */
+		    if (stats)
+			transfer_stats_raster(stats, plane_colour(&output_data, current_data_row),
+			    (size_t) numeric_arg, (unsigned char *) received_rows[current_data_row],
+			    1, output_data.buffer_length * output_data.input_depth * output_data.pixels_depth);
 		    if (command == PCL_DATA_LAST) {
 			if (image_data.colour_type == PCL_MONO) {
 			    if (image_data.pixel_type == PCL_MONO) {
@@ -2028,6 +2096,8 @@ int main(int argc, char *argv[])
 			}
 			current_data_row = 0;
 			image_row_counter++;
+			if (stats)
+			    transfer_stats_pass(stats);
 		    }
 		    else
 			current_data_row++;
@@ -29,6 +29,7 @@
 #define DEBUG 0 /* 1 for debugging only: all output goes to stderr */
 
 #include "pixma_parse.h"
+#include "transfer-stats.h"
 
 /*TODO:
   1. change color loops to search for each named color rather than using a predefined order.
@@ -38,6 +39,9 @@
 /* redirection for debug output */
 FILE* fout;
 
+/* transfer statistics, if requested */
+static transfer_stats_t* stats = NULL;
+
 /* nextcmd(): find a command in a printjob
  * commands in the printjob start with either ESC[ or ESC(
  * ESC@ (go to neutral mode) and 0xc (form feed) are handled directly
@@ -104,6 +108,8 @@ static int nextcmd( FILE *infile,unsigned char* cmd,unsigned char *buf, unsigned
 			}
 		}else if(c1==0x0c){ /* Form Feed */
 			fprintf(fout,"-->Form Feed\n");
+			if(stats)
+				transfer_stats_page(stats,ftell(infile));
 		}else{
 			fprintf(fout,"UNKNOWN BYTE 0x%x @ %lu\n",c1,ftell(infile));
 		}
@@ -241,6 +247,7 @@ static int Raster(image_t* img,unsigned char* buffer,unsigned int len,unsigned c
 	int cur_line=0; /* line relative to block begin */
 	unsigned char* dst=malloc(len*256); /* the destination buffer */
 	unsigned char* dstr=dst;
+	char* line_start=buf; /* start of the current line's packed data */
 
 #if 0
 	/*int numbigvals;*/ /* number of values greater than number of decompression table max index value */
@@ -267,6 +274,13 @@ static int Raster(image_t* img,unsigned char* buffer,unsigned int len,unsigned c
 			c -=256;
 		if(c== -128){ /* end of line => decode and copy things here */
 		  /*printf("DEBUG end of line---decode and copy things here\n");*/
+			if(stats){
+				char name[2];
+				name[0]=color_name;
+				name[1]=0;
+				transfer_stats_raster(stats,name,buf-line_start,dstr,1,size);
+				line_start=buf;
+			}
 			/* create new list entry */
 			if(color && size){
 				if(!color->tail)
@@ -873,6 +887,8 @@ static int process(FILE* in, FILE* out,int verbose,unsigned int maxw,unsigned in
 				}
 				break;
 			case 'e': /* Raster skip */
+				if(stats)
+					transfer_stats_pass(stats);
 				if(verbose)
 					fprintf(fout,"ESC (e advance (len=%i): %i\n",cnt,buf[0]*256+buf[1]);
 				if(img->lines_per_block){
@@ -891,6 +907,10 @@ static int process(FILE* in, FILE* out,int verbose,unsigned int maxw,unsigned in
 	}
 
 	fprintf(fout,"-------- finished parsing   --------\n");
+	if(stats){
+		transfer_stats_finish(stats,ftell(in));
+		stats=NULL;
+	}
 	if(returnv < -2){ /* was < 0 :  work around to see what we get */
 		fprintf(fout,"error: parsing the printjob failed error %i\n",returnv);
 	} else {
@@ -938,6 +958,9 @@ static void display_usage(void){
 	printf(" -y height: cut the output ppm to the given height\n");
 	printf(" -s if XML prolog is present, define number of bytes (default 680) \n");
 	printf(" -e if XML epilog is present, define number of bytes (default 263) \n");
+	printf(" -T file: write transfer statistics to file (- for stderr)\n");
+	printf(" -L mbps: link speed for transfer time estimates (default %g)\n",TRANSFER_STATS_DEFAULT_MBPS);
+	printf(" -P: report transfer statistics for each pass\n");
 	printf(" -h: display this help\n");
 }
 
@@ -950,6 +973,9 @@ int main(int argc,char* argv[]){
 	unsigned int startxmllen, endxmllen;
 
 	char* filename_in=NULL,*filename_out=NULL;
+	char* stats_file=NULL;
+	double link_mbps=TRANSFER_STATS_DEFAULT_MBPS;
+	int per_pass_stats=0;
 	FILE *in,*out=NULL;
 	int i;
 
@@ -1003,6 +1029,24 @@ int main(int argc,char* argv[]){
 					display_usage();
 					return 1;
 				}
+			}else if(argv[i][1] == 'T'){
+				if(argc > i+1){
+					++i;
+					stats_file = argv[i];
+				}else{
+					display_usage();
+					return 1;
+				}
+			}else if(argv[i][1] == 'L'){
+				if(argc > i+1){
+					++i;
+					link_mbps = atof(argv[i]);
+				}else{
+					display_usage();
+					return 1;
+				}
+			}else if(argv[i][1] == 'P'){
+				per_pass_stats = 1;
 			}else {
 			  printf("unknown parameter %s\n",argv[i]);
 				return 1;
@@ -1034,6 +1078,14 @@ int main(int argc,char* argv[]){
 		return 1;
 	}
 
+	if(stats_file && !(stats=transfer_stats_create(stats_file,link_mbps,per_pass_stats))){
+	  printf("can't create the statistics file %s\n",stats_file);
+		fclose(in);
+		if(out)
+			fclose(out);
+		return 1;
+	}
+
 	/* process the printjob */
 	process(in,out,verbose,maxw,maxh,startxmllen,endxmllen);
 
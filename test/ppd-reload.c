@@ -0,0 +1,266 @@
+/*
+ *   Regression test for reading PPD files in the PostScript driver.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: ppd-reload
+ *
+ * Writes a small PPD file and describes every parameter and page size
+ * of the PostScript driver with it three times, each with a new vars
+ * object: once reading the file, once reusing what was read, and once
+ * reading it again under another name.  It is described once more after
+ * enough other files have been read to drop it from the driver's cache,
+ * and again after it has been changed.  The exit status is nonzero if
+ * the descriptions differ, the PPD file's options are missing, or the
+ * change is not seen.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <gutenprint/gutenprint.h>
+
+static const char ppd_data[] =
+  "*PPD-Adobe: \"4.3\"\n"
+  "*ModelName: \"Test Printer\"\n"
+  "*ShortNickName: \"Test Printer\"\n"
+  "*NickName: \"Test Printer PPD %s\"\n"
+  "*LanguageLevel: \"2\"\n"
+  "*ColorDevice: True\n"
+  "*OpenGroup: General/General\n"
+  "*OpenUI *PageSize/Media Size: PickOne\n"
+  "*OrderDependency: 10 AnySetup *PageSize\n"
+  "*DefaultPageSize: Letter\n"
+  "*PageSize Letter/US Letter: \"<</PageSize[612 792]>>setpagedevice\"\n"
+  "*PageSize A4/A4: \"<</PageSize[595 842]>>setpagedevice\"\n"
+  "*PageSize Small/Small: \"<</PageSize[144 216]>>setpagedevice\"\n"
+  "*CloseUI: *PageSize\n"
+  "*OpenUI *PageRegion: PickOne\n"
+  "*OrderDependency: 10 AnySetup *PageRegion\n"
+  "*DefaultPageRegion: Letter\n"
+  "*PageRegion Letter/US Letter: \"<</PageSize[612 792]>>setpagedevice\"\n"
+  "*PageRegion A4/A4: \"<</PageSize[595 842]>>setpagedevice\"\n"
+  "*PageRegion Small/Small: \"<</PageSize[144 216]>>setpagedevice\"\n"
+  "*CloseUI: *PageRegion\n"
+  "*DefaultImageableArea: Letter\n"
+  "*ImageableArea Letter/US Letter: \"18 36 594 756\"\n"
+  "*ImageableArea A4/A4: \"18 36 577 806\"\n"
+  "*ImageableArea Small/Small: \"9 9 135 207\"\n"
+  "*DefaultPaperDimension: Letter\n"
+  "*PaperDimension Letter/US Letter: \"612 792\"\n"
+  "*PaperDimension A4/A4: \"595 842\"\n"
+  "*PaperDimension Small/Small: \"144 216\"\n"
+  "*OpenUI *Duplex/Double-Sided Printing: PickOne\n"
+  "*OrderDependency: 20 AnySetup *Duplex\n"
+  "*DefaultDuplex: None\n"
+  "*Duplex None/Off: \"<</Duplex false>>setpagedevice\"\n"
+  "*Duplex DuplexNoTumble/Long Edge: \"<</Duplex true/Tumble false>>setpagedevice\"\n"
+  "*Duplex DuplexTumble/Short Edge: \"<</Duplex true/Tumble true>>setpagedevice\"\n"
+  "*CloseUI: *Duplex\n"
+  "*CloseGroup: General\n"
+  "*OpenGroup: Extra/Extra\n"
+  "*OpenUI *InputSlot/Media Source: PickOne\n"
+  "*OrderDependency: 30 AnySetup *InputSlot\n"
+  "*DefaultInputSlot: Upper\n"
+  "*InputSlot Upper/Upper Tray: \"<</MediaPosition 0>>setpagedevice\"\n"
+  "*InputSlot Lower/Lower Tray: \"<</MediaPosition 1>>setpagedevice\"\n"
+  "*InputSlot Manual/Manual Feed: \"<</ManualFeed true>>setpagedevice\"\n"
+  "*CloseUI: *InputSlot\n"
+  "*CloseGroup: Extra\n";
+
+#define OTHER_FILES 6
+
+static int failures = 0;
+
+static void
+append(char **buf, size_t *len, const char *fmt, ...)
+{
+  char line[1024];
+  size_t bytes;
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  bytes = strlen(line);
+  *buf = stp_realloc(*buf, *len + bytes + 1);
+  memcpy(*buf + *len, line, bytes + 1);
+  *len += bytes;
+}
+
+/*
+ * Describe every parameter, and the size and margins of every page
+ * size, of the PostScript driver with the named PPD file.
+ */
+static char *
+describe(const char *ppd_file)
+{
+  stp_vars_t *v = stp_vars_create();
+  stp_parameter_list_t params;
+  stp_parameter_t desc;
+  char *buf = NULL;
+  size_t len = 0;
+  int count, i, j;
+
+  stp_set_driver(v, "ps2");
+  stp_set_file_parameter(v, "PPDFile", ppd_file);
+  params = stp_get_parameter_list(v);
+  count = stp_parameter_list_count(params);
+  for (i = 0; i < count; i++)
+    {
+      const stp_parameter_t *p = stp_parameter_list_param(params, i);
+      append(&buf, &len, "%s (%s) type %d class %d level %d\n",
+	     p->name, p->text ? p->text : "", p->p_type, p->p_class,
+	     p->p_level);
+      stp_describe_parameter(v, p->name, &desc);
+      append(&buf, &len, "  active %d mandatory %d\n",
+	     desc.is_active, desc.is_mandatory);
+      if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.bounds.str)
+	{
+	  int choices = stp_string_list_count(desc.bounds.str);
+	  append(&buf, &len, "  default %s\n",
+		 desc.deflt.str ? desc.deflt.str : "(null)");
+	  for (j = 0; j < choices; j++)
+	    {
+	      const stp_param_string_t *choice =
+		stp_string_list_param(desc.bounds.str, j);
+	      append(&buf, &len, "  %s: %s\n", choice->name, choice->text);
+	    }
+	}
+      stp_parameter_description_destroy(&desc);
+    }
+  stp_parameter_list_destroy(params);
+
+  stp_describe_parameter(v, "PageSize", &desc);
+  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.bounds.str)
+    for (j = 0; j < stp_string_list_count(desc.bounds.str); j++)
+      {
+	const char *name = stp_string_list_param(desc.bounds.str, j)->name;
+	stp_dimension_t width, height, left, right, bottom, top;
+	stp_set_string_parameter(v, "PageSize", name);
+	stp_get_media_size(v, &width, &height);
+	stp_get_imageable_area(v, &left, &right, &bottom, &top);
+	append(&buf, &len, "page %s: %gx%g, %g %g %g %g\n",
+	       name, width, height, left, right, bottom, top);
+      }
+  stp_parameter_description_destroy(&desc);
+  stp_vars_destroy(v);
+  return buf;
+}
+
+static char *
+write_ppd(const char *tmpdir, const char *nickname)
+{
+  char *ppd_file;
+  FILE *fp;
+  int fd;
+  stp_asprintf(&ppd_file, "%s/ppd-reloadXXXXXX", tmpdir);
+  fd = mkstemp(ppd_file);
+  if (fd < 0 || !(fp = fdopen(fd, "w")))
+    {
+      perror("ppd-reload");
+      exit(1);
+    }
+  fprintf(fp, ppd_data, nickname);
+  fclose(fp);
+  return ppd_file;
+}
+
+static void
+check(const char *what, const char *expected, const char *got)
+{
+  if (strcmp(expected, got))
+    {
+      printf("FAIL: %s differs:\n--- expected\n%s--- got\n%s", what,
+	     expected, got);
+      failures++;
+    }
+}
+
+int
+main(void)
+{
+  const char *tmpdir = getenv("TMPDIR");
+  char *ppd_file, *other_name;
+  char *first, *again, *reread, *evicted, *changed;
+  FILE *fp;
+  int i;
+
+  stp_init();
+  if (!tmpdir || !tmpdir[0])
+    tmpdir = "/tmp";
+  ppd_file = write_ppd(tmpdir, "reload");
+  /* The same file, named differently so it is read again */
+  stp_asprintf(&other_name, "%s/./%s", tmpdir,
+	       ppd_file + strlen(tmpdir) + 1);
+
+  first = describe(ppd_file);
+  again = describe(ppd_file);
+  reread = describe(other_name);
+
+  for (i = 0; i < OTHER_FILES; i++)
+    {
+      char *other_file = write_ppd(tmpdir, "other");
+      stp_free(describe(other_file));
+      unlink(other_file);
+      stp_free(other_file);
+    }
+  evicted = describe(ppd_file);
+
+  /* A longer nickname, so that the file's size changes */
+  if (!(fp = fopen(ppd_file, "w")))
+    {
+      perror("ppd-reload");
+      return 1;
+    }
+  fprintf(fp, ppd_data, "changed on disk");
+  fclose(fp);
+  changed = describe(ppd_file);
+  unlink(ppd_file);
+
+  if (!strstr(first, "\nInputSlot (Media Source)") ||
+      !strstr(first, "  Manual: Manual Feed\n") ||
+      !strstr(first, "page Small: 144x216, 9 135 207 9\n"))
+    {
+      printf("FAIL: PPD file options missing:\n%s", first);
+      failures++;
+    }
+  check("Second description", first, again);
+  check("Description after reading the file again", first, reread);
+  check("Description after reading other files", first, evicted);
+  if (!strstr(changed, "Test Printer PPD changed on disk"))
+    {
+      printf("FAIL: Change to PPD file not seen:\n%s", changed);
+      failures++;
+    }
+
+  stp_free(first);
+  stp_free(again);
+  stp_free(reread);
+  stp_free(evicted);
+  stp_free(changed);
+  stp_free(ppd_file);
+  stp_free(other_name);
+  if (failures)
+    printf("%d failures\n", failures);
+  else
+    printf("All tests passed\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+/*
+ *   Test and benchmark for string list lookups.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: string-list [-b] [-n iterations]
+ *
+ * Without -b, lists with duplicate names, removals and copies are built
+ * at random, and stp_string_list_find and stp_string_list_is_present
+ * are compared with a search of the list in order; the exit status is
+ * nonzero if any of them differ.  With -b, every choice of every string
+ * list parameter of every printer is looked up the way the PPD
+ * generator does, and the cost of the lookups is compared with that of
+ * searching the lists.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <gutenprint/gutenprint.h>
+
+#define MAX_NAMES 400
+
+static int failures = 0;
+
+static double
+compute_interval(struct timeval *tv1, struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static const stp_param_string_t *
+search_list(const stp_string_list_t *list, const char *name)
+{
+  size_t count = stp_string_list_count(list);
+  size_t i;
+  for (i = 0; i < count; i++)
+    {
+      const stp_param_string_t *param = stp_string_list_param(list, i);
+      if (strcmp(param->name, name) == 0)
+	return param;
+    }
+  return NULL;
+}
+
+static void
+check_lookups(const stp_string_list_t *list, int names, const char *what)
+{
+  char name[32];
+  int i;
+  for (i = 0; i < names; i++)
+    {
+      const stp_param_string_t *expected;
+      sprintf(name, "Name%d", i);
+      expected = search_list(list, name);
+      if (stp_string_list_find(list, name) != expected ||
+	  stp_string_list_is_present(list, name) != (expected != NULL))
+	{
+	  fprintf(stderr, "%s: lookup of %s differs\n", what, name);
+	  failures++;
+	  return;
+	}
+    }
+}
+
+static void
+run_tests(int iterations)
+{
+  int iter;
+  for (iter = 0; iter < iterations; iter++)
+    {
+      stp_string_list_t *list = stp_string_list_create();
+      stp_string_list_t *copy;
+      int names = 1 + random() % MAX_NAMES;
+      int count = random() % (2 * names);
+      char name[32];
+      char text[32];
+      int i;
+
+      for (i = 0; i < count; i++)
+	{
+	  /* Names are reused, so a lookup has to find the first one */
+	  sprintf(name, "Name%ld", random() % names);
+	  sprintf(text, "Text%d", i);
+	  stp_string_list_add_string(list, name, text);
+	  if (random() % 8 == 0)
+	    check_lookups(list, names, "adding");
+	}
+      check_lookups(list, names, "added");
+      copy = stp_string_list_create_copy(list);
+      check_lookups(copy, names, "copy");
+
+      for (i = 0; i < names / 4; i++)
+	{
+	  sprintf(name, "Name%ld", random() % names);
+	  stp_string_list_remove_string(list, name);
+	}
+      check_lookups(list, names, "removed");
+      for (i = 0; i < names / 4; i++)
+	{
+	  sprintf(name, "Name%ld", random() % names);
+	  stp_string_list_add_string(list, name, "Readded");
+	}
+      check_lookups(list, names, "readded");
+      check_lookups(copy, names, "original copy");
+      stp_string_list_destroy(list);
+      stp_string_list_destroy(copy);
+    }
+}
+
+/*
+ * Look up every choice of a string list parameter, as the PPD generator
+ * and stp_verify do, both through the list and by searching it.  The
+ * names are copied out of the list first and looked up last to first,
+ * so that a list which remembers where it last looked gets no help.
+ */
+static void
+lookup_choices(const stp_string_list_t *list, int iterations,
+	       double *lookup_time, double *search_time, long *lookups)
+{
+  size_t count = stp_string_list_count(list);
+  char **names = malloc(count * sizeof(char *));
+  struct timeval tv1, tv2;
+  int iter;
+  size_t i;
+
+  for (i = 0; i < count; i++)
+    names[i] = strdup(stp_string_list_param(list, i)->name);
+
+  (void) gettimeofday(&tv1, NULL);
+  for (iter = 0; iter < iterations; iter++)
+    for (i = count; i > 0; i--)
+      if (!stp_string_list_is_present(list, names[i - 1]) ||
+	  !stp_string_list_find(list, names[i - 1]))
+	failures++;
+  (void) gettimeofday(&tv2, NULL);
+  *lookup_time += compute_interval(&tv1, &tv2);
+
+  (void) gettimeofday(&tv1, NULL);
+  for (iter = 0; iter < iterations; iter++)
+    for (i = count; i > 0; i--)
+      if (!search_list(list, names[i - 1]) ||
+	  !search_list(list, names[i - 1]))
+	failures++;
+  (void) gettimeofday(&tv2, NULL);
+  *search_time += compute_interval(&tv1, &tv2);
+  *lookups += 2 * count * iterations;
+
+  for (i = 0; i < count; i++)
+    free(names[i]);
+  free(names);
+}
+
+static void
+run_benchmark(int iterations)
+{
+  double lookup_time = 0;
+  double search_time = 0;
+  double describe_time = 0;
+  long lookups = 0;
+  size_t longest = 0;
+  int lists = 0;
+  int p;
+
+  for (p = 0; p < stp_printer_model_count(); p++)
+    {
+      const stp_printer_t *printer = stp_get_printer_by_index(p);
+      stp_vars_t *v = stp_vars_create_copy(stp_printer_get_defaults(printer));
+      stp_parameter_list_t params = stp_get_parameter_list(v);
+      size_t count = stp_parameter_list_count(params);
+      size_t i;
+      for (i = 0; i < count; i++)
+	{
+	  const stp_parameter_t *param = stp_parameter_list_param(params, i);
+	  stp_parameter_t desc;
+	  struct timeval tv1, tv2;
+	  if (param->p_type != STP_PARAMETER_TYPE_STRING_LIST)
+	    continue;
+	  (void) gettimeofday(&tv1, NULL);
+	  stp_describe_parameter(v, param->name, &desc);
+	  (void) gettimeofday(&tv2, NULL);
+	  describe_time += compute_interval(&tv1, &tv2);
+	  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST && desc.bounds.str)
+	    {
+	      size_t choices = stp_string_list_count(desc.bounds.str);
+	      if (choices > longest)
+		longest = choices;
+	      lists++;
+	      lookup_choices(desc.bounds.str, iterations,
+			     &lookup_time, &search_time, &lookups);
+	    }
+	  stp_parameter_description_destroy(&desc);
+	}
+      stp_parameter_list_destroy(params);
+      stp_vars_destroy(v);
+    }
+  printf("%d printers, %d lists (longest %lu), %ld lookups\n",
+	 stp_printer_model_count(), lists, (unsigned long) longest, lookups);
+  printf("describing parameters %10.3f ms\n", describe_time * 1000);
+  printf("lookups               %10.3f ms  %8.1f ns/lookup\n",
+	 lookup_time * 1000 / iterations,
+	 lookups ? lookup_time * 1e9 / lookups : 0);
+  printf("searching lists       %10.3f ms  %8.1f ns/lookup\n",
+	 search_time * 1000 / iterations,
+	 lookups ? search_time * 1e9 / lookups : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int benchmark = 0;
+  int iterations = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "bn:")) != -1)
+    {
+      switch (c)
+	{
+	case 'b':
+	  benchmark = 1;
+	  break;
+	case 'n':
+	  iterations = atoi(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-b] [-n iterations]\n", argv[0]);
+	  return 1;
+	}
+    }
+  if (iterations <= 0)
+    iterations = benchmark ? 10 : 200;
+
+  stp_init();
+  srandom(1);
+
+  if (benchmark)
+    run_benchmark(iterations);
+  else
+    {
+      run_tests(iterations);
+      if (failures)
+	fprintf(stderr, "%d failures\n", failures);
+      else
+	printf("All string list lookups match\n");
+    }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+/*
+ *   Transfer efficiency statistics for the unprint tools.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "transfer-stats.h"
+
+#define MAX_COLORS 40
+
+typedef struct
+{
+  char name[8];
+  unsigned long rasters;
+  unsigned long blank;
+  unsigned long long sent;
+  unsigned long long decoded;
+  unsigned long long whitespace;
+} color_stats_t;
+
+typedef struct
+{
+  int ncolors;
+  color_stats_t colors[MAX_COLORS];
+  unsigned long passes;
+  unsigned long blank_passes;
+  unsigned long long bytes;
+} page_stats_t;
+
+struct transfer_stats
+{
+  FILE *fp;
+  double link_mbps;
+  int per_pass;
+  int pages;
+  long last_offset;
+  page_stats_t page;
+  page_stats_t total;
+  /* Current pass */
+  unsigned long pass_rasters;
+  unsigned long pass_blank;
+  unsigned long long pass_sent;
+  unsigned long long pass_decoded;
+};
+
+transfer_stats_t *
+transfer_stats_create(const char *file, double link_mbps, int per_pass)
+{
+  transfer_stats_t *ts;
+  FILE *fp = strcmp(file, "-") ? fopen(file, "w") : stderr;
+  if (!fp)
+    return NULL;
+  ts = calloc(1, sizeof(transfer_stats_t));
+  ts->fp = fp;
+  ts->link_mbps = link_mbps > 0 ? link_mbps : TRANSFER_STATS_DEFAULT_MBPS;
+  ts->per_pass = per_pass;
+  return ts;
+}
+
+static color_stats_t *
+find_color(page_stats_t *ps, const char *name)
+{
+  int i;
+  for (i = 0; i < ps->ncolors; i++)
+    if (strcmp(ps->colors[i].name, name) == 0)
+      return &(ps->colors[i]);
+  if (ps->ncolors == MAX_COLORS)
+    return &(ps->colors[MAX_COLORS - 1]);
+  strncpy(ps->colors[i].name, name, sizeof(ps->colors[i].name) - 1);
+  ps->ncolors++;
+  return &(ps->colors[i]);
+}
+
+static void
+add_raster(page_stats_t *ps, const char *color, size_t sent, size_t decoded,
+	   size_t whitespace, int blank)
+{
+  color_stats_t *cs = find_color(ps, color);
+  cs->rasters++;
+  cs->blank += blank;
+  cs->sent += sent;
+  cs->decoded += decoded;
+  cs->whitespace += whitespace;
+}
+
+void
+transfer_stats_raster(transfer_stats_t *ts, const char *color,
+		      size_t sent_bytes, const unsigned char *data,
+		      int rows, size_t row_bytes)
+{
+  size_t whitespace = 0;
+  int blank = 1;
+  int row;
+
+  /*
+   * Whitespace is the zero bytes at either end of each row, which the
+   * driver could have skipped over with a horizontal move instead.
+   */
+  for (row = 0; row < rows; row++)
+    {
+      const unsigned char *p = data + row * row_bytes;
+      size_t left = 0;
+      size_t right = row_bytes;
+      while (left < row_bytes && p[left] == 0)
+	left++;
+      if (left < row_bytes)
+	{
+	  blank = 0;
+	  while (p[right - 1] == 0)
+	    right--;
+	}
+      whitespace += left + (row_bytes - right);
+    }
+
+  add_raster(&(ts->page), color, sent_bytes, rows * row_bytes,
+	     whitespace, blank);
+  ts->pass_rasters++;
+  ts->pass_blank += blank;
+  ts->pass_sent += sent_bytes;
+  ts->pass_decoded += rows * row_bytes;
+}
+
+void
+transfer_stats_pass(transfer_stats_t *ts)
+{
+  if (ts->pass_rasters == 0)
+    return;
+  ts->page.passes++;
+  if (ts->pass_blank == ts->pass_rasters)
+    ts->page.blank_passes++;
+  if (ts->per_pass)
+    fprintf(ts->fp, "  pass %lu: %lu rasters (%lu blank), %llu bytes sent, "
+	    "%llu decoded\n", ts->page.passes, ts->pass_rasters,
+	    ts->pass_blank, ts->pass_sent, ts->pass_decoded);
+  ts->pass_rasters = 0;
+  ts->pass_blank = 0;
+  ts->pass_sent = 0;
+  ts->pass_decoded = 0;
+}
+
+static double
+percent(unsigned long long part, unsigned long long whole)
+{
+  return whole ? 100.0 * part / whole : 0;
+}
+
+static void
+report(transfer_stats_t *ts, const page_stats_t *ps, const char *title)
+{
+  unsigned long long sent = 0, decoded = 0;
+  unsigned long rasters = 0, blank = 0;
+  int i;
+
+  for (i = 0; i < ps->ncolors; i++)
+    {
+      sent += ps->colors[i].sent;
+      decoded += ps->colors[i].decoded;
+      rasters += ps->colors[i].rasters;
+      blank += ps->colors[i].blank;
+    }
+  fprintf(ts->fp, "%s: %llu bytes, %.3f ms at %g Mbit/s\n", title,
+	  ps->bytes, ps->bytes * 8 / (ts->link_mbps * 1000), ts->link_mbps);
+  fprintf(ts->fp, "  raster %llu (%.1f%%), commands %llu (%.1f%%)\n",
+	  sent, percent(sent, ps->bytes), ps->bytes - sent,
+	  percent(ps->bytes - sent, ps->bytes));
+  fprintf(ts->fp, "  %lu passes (%lu blank), %lu rasters (%lu blank)\n",
+	  ps->passes, ps->blank_passes, rasters, blank);
+  fprintf(ts->fp, "  %-6s %8s %8s %12s %12s %7s %12s\n", "color", "rasters",
+	  "blank", "sent", "decoded", "ratio", "whitespace");
+  for (i = 0; i < ps->ncolors; i++)
+    {
+      const color_stats_t *cs = &(ps->colors[i]);
+      fprintf(ts->fp, "  %-6s %8lu %8lu %12llu %12llu %7.2f %12llu %5.1f%%\n",
+	      cs->name, cs->rasters, cs->blank, cs->sent, cs->decoded,
+	      cs->sent ? (double) cs->decoded / cs->sent : 0,
+	      cs->whitespace, percent(cs->whitespace, cs->decoded));
+    }
+}
+
+void
+transfer_stats_page(transfer_stats_t *ts, long offset)
+{
+  char title[32];
+  int i;
+
+  transfer_stats_pass(ts);
+  if (offset > ts->last_offset)
+    ts->page.bytes = offset - ts->last_offset;
+  ts->last_offset = offset;
+  ts->pages++;
+  sprintf(title, "Page %d", ts->pages);
+  report(ts, &(ts->page), title);
+
+  for (i = 0; i < ts->page.ncolors; i++)
+    {
+      const color_stats_t *cs = &(ts->page.colors[i]);
+      color_stats_t *tcs = find_color(&(ts->total), cs->name);
+      tcs->rasters += cs->rasters;
+      tcs->blank += cs->blank;
+      tcs->sent += cs->sent;
+      tcs->decoded += cs->decoded;
+      tcs->whitespace += cs->whitespace;
+    }
+  ts->total.passes += ts->page.passes;
+  ts->total.blank_passes += ts->page.blank_passes;
+  ts->total.bytes += ts->page.bytes;
+  memset(&(ts->page), 0, sizeof(page_stats_t));
+}
+
+void
+transfer_stats_finish(transfer_stats_t *ts, long offset)
+{
+  char title[32];
+  transfer_stats_pass(ts);
+  /* Anything after the last page that printed nothing is job overhead */
+  if (ts->page.passes)
+    transfer_stats_page(ts, offset);
+  else if (offset > ts->last_offset)
+    ts->total.bytes += offset - ts->last_offset;
+  sprintf(title, "Total (%d pages)", ts->pages);
+  report(ts, &(ts->total), title);
+  if (ts->fp != stderr)
+    fclose(ts->fp);
+  free(ts);
+}
@@ -0,0 +1,63 @@
+/*
+ *   Transfer efficiency statistics for the unprint tools.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The decoders (unprint, pcl-unprint, pixma_parse) report each raster
+ * transfer they decode, the points where the head moves to the next
+ * pass, and the end of each page, together with how far into the
+ * stream they have read.  Everything that isn't raster payload is
+ * counted as command overhead.
+ */
+
+#ifndef TRANSFER_STATS_H
+#define TRANSFER_STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Link speed assumed if none is given: USB full speed */
+#define TRANSFER_STATS_DEFAULT_MBPS 12.0
+
+typedef struct transfer_stats transfer_stats_t;
+
+/*
+ * Create a collector writing its report to the named file ("-" for
+ * stderr).  Transfer times are estimated at link_mbps megabits per
+ * second; if per_pass is set, a line is written for every pass.
+ * Returns NULL if the file can't be opened.
+ */
+extern transfer_stats_t *transfer_stats_create(const char *file,
+					       double link_mbps, int per_pass);
+
+/*
+ * Record one raster transfer: sent_bytes of payload that decoded into
+ * rows rows of row_bytes bytes each, stored contiguously in data.
+ */
+extern void transfer_stats_raster(transfer_stats_t *ts, const char *color,
+				  size_t sent_bytes, const unsigned char *data,
+				  int rows, size_t row_bytes);
+
+/* The head is about to move; anything transferred since is one pass */
+extern void transfer_stats_pass(transfer_stats_t *ts);
+
+/* End the current page; offset is the number of bytes read so far */
+extern void transfer_stats_page(transfer_stats_t *ts, long offset);
+
+/* Close any open page, write the totals, and free the collector */
+extern void transfer_stats_finish(transfer_stats_t *ts, long offset);
+
+#endif /* TRANSFER_STATS_H */
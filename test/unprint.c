@@ -29,6 +29,7 @@
 #include<limits.h>
 #endif
 #include<string.h>
+#include "transfer-stats.h"
 
 #ifdef __GNUC__
 #define inline __inline__
@@ -114,6 +115,7 @@ unsigned color_mask = 0xffffffff;
 
 pstate_t pstate;
 int unweave;
+transfer_stats_t *stats = NULL;
 
 line_type **page=NULL;
 
@@ -135,6 +137,13 @@ line_type **page=NULL;
    Orange   10       N/A     12
  */
 
+/* Sequential color names for the transfer statistics */
+static const char *color_names[] =
+{
+  "K", "M", "C", "Y", "m", "c", "k", "DY", "R", "B", "Gloss", "kk", "O",
+  "?", "?", "?", "K", "M", "C", "Y"
+};
+
 /* convert either Epson1 or Epson2 color encoding into a sequential encoding */
 static int
 seqcolor(int c)
@@ -771,6 +780,7 @@ parse_escp2_data(FILE *fp_r)
   int currentcolor = 0;
   int density = 0;
   int bandsize;
+  int data_start;
   switch (ch)
     {
     case 'i':
@@ -819,11 +829,16 @@ parse_escp2_data(FILE *fp_r)
       buf = stp_realloc(buf, bandsize);
       valid_bufsize = bandsize;
     }
+  data_start = global_counter;
   switch (c)
     {
     case 0:  /* uncompressed */
       bufsize = bandsize;
       getn(bufsize,"Error reading raster data!\n");
+      if (stats)
+	transfer_stats_raster(stats, color_names[currentcolor],
+			      global_counter - data_start, buf, m,
+			      (n * pstate.bpp + 7) / 8);
       update_page(buf, bufsize, m, n, currentcolor, density);
       break;
     case 1:  /* run length encoding */
@@ -852,7 +867,13 @@ parse_escp2_data(FILE *fp_r)
 	  eject = 1;
 	}
       else
-	update_page(buf, i, m, n, currentcolor, density);
+	{
+	  if (stats)
+	    transfer_stats_raster(stats, color_names[currentcolor],
+				  global_counter - data_start, buf, m,
+				  (n * pstate.bpp + 7) / 8);
+	  update_page(buf, i, m, n, currentcolor, density);
+	}
       break;
     case 2: /* TIFF compression */
       fprintf(stderr, "TIFF mode not yet supported!\n");
@@ -1013,6 +1034,8 @@ parse_escp2_extended(FILE *fp_r)
 		   sizeof(line_type *));
       break;
     case 'V': /* set absolute vertical position */
+      if (stats)
+	transfer_stats_pass(stats);
       i = 0;
       switch (bufsize)
 	{
@@ -1041,6 +1064,8 @@ parse_escp2_extended(FILE *fp_r)
 	}
       break;
     case 'v': /* set relative vertical position */
+      if (stats)
+	transfer_stats_pass(stats);
       i = 0;
       switch (bufsize)
 	{
@@ -1279,6 +1304,8 @@ parse_escp2(FILE *fp_r)
 	  pstate.xposition = 0;
 	  break;
 	case 0xc:		/* form feed */
+	  if (stats)
+	    transfer_stats_page(stats, global_counter);
 	  eject = 1;
 	  break;
 	case 0x0:
@@ -1400,6 +1427,8 @@ parse_canon(FILE *fp_r)
      continue;
    }
    if (ch==0xc) { /* form feed */
+     if (stats)
+       transfer_stats_page(stats,global_counter);
      l_eject=1;
      continue;
    }
@@ -1506,6 +1535,12 @@ parse_canon(FILE *fp_r)
        }
        pstate.current_color= currentcolor;
        m= rle_decode(buf+1,bufsize-1,sizeof(buf)-1);
+       if (stats) {
+	 char color_name[2];
+	 color_name[0]= *buf;
+	 color_name[1]= 0;
+	 transfer_stats_raster(stats,color_name,bufsize-1,buf+1,1,m > 0 ? m : 0);
+       }
        /* reverse_bit_order(buf+1,m); */
        pstate.yposition+= currentdelay;
        if (m) update_page(buf+1,m,1,(m*8)/pstate.bpp,currentcolor,
@@ -1543,6 +1578,8 @@ parse_canon(FILE *fp_r)
 				       sizeof(line_type *));
        break;
      case 'e': /* 0x65 - vertical head movement */
+       if (stats)
+	 transfer_stats_pass(stats);
        pstate.yposition+= (buf[1]+256*buf[0]);
 #ifdef DEBUG_CANON
        fprintf(stderr,"\n");
@@ -1595,6 +1632,9 @@ main(int argc,char *argv[])
   int force_extraskip = -1;
   int no_output = 0;
   int all_black = 0;
+  const char *stats_file = NULL;
+  double link_mbps = TRANSFER_STATS_DEFAULT_MBPS;
+  int per_pass_stats = 0;
 
   unweave = 0;
   pstate.nozzle_separation = 6;
@@ -1612,7 +1652,7 @@ main(int argc,char *argv[])
 		fp_r = stdin;
 	      break;
 	    case 'h':
-	      fprintf(stderr, "Usage: %s [-m mask] [-n nozzle_sep] [-s extra] [-b] [-q] [-Q] [-M] [-u] [in [out]]\n", argv[0]);
+	      fprintf(stderr, "Usage: %s [-m mask] [-n nozzle_sep] [-s extra] [-b] [-q] [-Q] [-M] [-u] [-T file [-L mbps] [-P]] [in [out]]\n", argv[0]);
 	      fprintf(stderr, "        -m mask       Color mask to unprint\n");
 	      fprintf(stderr, "        -n nozzle_sep Nozzle separation in vertical units for old printers\n");
 	      fprintf(stderr, "        -s extra      Extra feed requirement for old printers (typically 1)\n");
@@ -1621,6 +1661,9 @@ main(int argc,char *argv[])
 	      fprintf(stderr, "        -Q            Assume quadtone inks\n");
 	      fprintf(stderr, "        -M            Assume MIS quadtone inks\n");
 	      fprintf(stderr, "        -u            Unweave\n");
+	      fprintf(stderr, "        -T file       Write transfer statistics to file (- for stderr)\n");
+	      fprintf(stderr, "        -L mbps       Link speed for transfer time estimates\n");
+	      fprintf(stderr, "        -P            Report transfer statistics for each pass\n");
 	      return 1;
 	    case 'm':
 	      if (argv[arg][2])
@@ -1706,6 +1749,36 @@ main(int argc,char *argv[])
 	    case 'u':
 	      unweave = 1;
 	      break;
+	    case 'T':
+	      if (argv[arg][2])
+		stats_file = argv[arg] + 2;
+	      else if (argc <= arg + 1)
+		{
+		  fprintf(stderr, "Missing statistics file\n");
+		  exit(-1);
+		}
+	      else
+		stats_file = argv[++arg];
+	      break;
+	    case 'L':
+	      if (argv[arg][2])
+		s = argv[arg] + 2;
+	      else if (argc <= arg + 1)
+		{
+		  fprintf(stderr, "Missing link speed\n");
+		  exit(-1);
+		}
+	      else
+		s = argv[++arg];
+	      if (!sscanf(s, "%lf", &link_mbps) || link_mbps <= 0)
+		{
+		  fprintf(stderr, "Error parsing link speed\n");
+		  exit(-1);
+		}
+	      break;
+	    case 'P':
+	      per_pass_stats = 1;
+	      break;
 	    }
 	}
       else
@@ -1733,6 +1806,13 @@ main(int argc,char *argv[])
   if (!fp_w)
     fp_w = stdout;
 
+  if (stats_file &&
+      !(stats = transfer_stats_create(stats_file, link_mbps, per_pass_stats)))
+    {
+      perror("Error opening statistics file");
+      exit(-1);
+    }
+
   if (unweave) {
     pstate.nozzle_separation = 1;
   }
@@ -1758,6 +1838,8 @@ main(int argc,char *argv[])
       parse_escp2(fp_r);
     }
   fprintf(stderr,"Done reading.\n");
+  if (stats)
+    transfer_stats_finish(stats, global_counter);
   write_output(fp_w, no_output, all_black);
   fclose(fp_w);
   fprintf(stderr,"Image dump complete.\n");
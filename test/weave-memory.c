@@ -0,0 +1,374 @@
+/*
+ *   Stress test for the memory used by the soft weave.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: weave-memory [-b] [-l limit] [-r rss] [-w width] [-h height]
+ *
+ * A band of a page width inches wide (4 by default) and height inches
+ * high (0.5 by default) is woven at 2880x1440 dpi with eight two bit
+ * channels, the way a large format printer in soft weave mode would
+ * print it.  The page is woven with no limit on the pass buffers, with a
+ * limit of limit megabytes (1 by default), and with the same limit but
+ * a spill file that fills up after 64 KB, each in its own process.
+ * Every pass is checksummed as it is flushed; the exit status is
+ * nonzero if the passes differ, if nothing was spilled or the full
+ * spill file wasn't reported, if the pass buffers ever held much more
+ * than the limit, or if the limited run's peak resident set exceeded
+ * rss megabytes (24 by default).  The test is skipped where the library
+ * has no pread() and pwrite() to spill with.  With -b,
+ * the page is woven under a range of limits and the time, peak buffer
+ * memory, spilled data and peak resident set of each are reported; try
+ * -w 64 -h 1 for a page the size of a large format printer's.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <gutenprint/gutenprint.h>
+#include <gutenprint/weave.h>
+
+#define NCOLORS 8
+#define BITWIDTH 2
+#define XDPI 2880
+#define YDPI 1440
+#define JETS 180
+#define SEPARATION 4
+#define HORIZONTAL_PASSES 2
+#define SPILL_FILE_MAX 64		/* KB, when it's meant to fill up */
+
+typedef struct
+{
+  unsigned long long checksum;	/* Of every pass flushed */
+  int passes;			/* Passes flushed */
+  stp_weave_memory_t memory;	/* Weave accounting at the end */
+  size_t pass_size;		/* Most one pass's buffers take */
+  int errors;			/* Error messages from the weave */
+  double seconds;
+} run_result_t;
+
+static double width_inches = 4;
+static double height_inches = 0.5;
+static run_result_t result;
+
+static double
+compute_interval(struct timeval *tv1, struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static void
+errfunc(void *file, const char *buf, size_t bytes)
+{
+  if (bytes >= 6 && !strncmp(buf, "ERROR:", 6))
+    result.errors++;
+  fwrite(buf, 1, bytes, stderr);
+}
+
+static void
+checksum(const unsigned char *data, size_t bytes)
+{
+  unsigned long long sum = result.checksum;
+  size_t i;
+  for (i = 0; i < bytes; i++)
+    sum = (sum ^ data[i]) * 1099511628211ULL;
+  result.checksum = sum;
+}
+
+/*
+ * Checksum the pass as a driver would print it, and reset it.
+ */
+static void
+flush_pass(stp_vars_t *v, int passno, int vertical_subpass)
+{
+  stp_lineoff_t *lineoffs = stp_get_lineoffsets_by_pass(v, passno);
+  stp_lineactive_t *lineactive = stp_get_lineactive_by_pass(v, passno);
+  const stp_linebufs_t *bufs = stp_get_linebases_by_pass(v, passno);
+  stp_linecount_t *linecount = stp_get_linecount_by_pass(v, passno);
+  size_t pass_size = 0;
+  int j;
+
+  checksum((const unsigned char *) &passno, sizeof(passno));
+  for (j = 0; j < NCOLORS; j++)
+    {
+      if (lineactive->v[j] > 0)
+	{
+	  checksum((const unsigned char *) &(linecount->v[j]), sizeof(int));
+	  checksum(bufs->v[j], lineoffs->v[j]);
+	}
+      pass_size += lineoffs->v[j];
+      lineoffs->v[j] = 0;
+      linecount->v[j] = 0;
+    }
+  if (pass_size > result.pass_size)
+    result.pass_size = pass_size;
+  result.passes++;
+}
+
+/*
+ * Fill a row with noise across the middle half of the page and leave
+ * the margins blank, so the data doesn't compress away to nothing.
+ */
+static void
+fill_row(unsigned char *const cols[], int row, int length)
+{
+  static unsigned seed = 1;
+  int j, i;
+  for (j = 0; j < NCOLORS; j++)
+    {
+      memset(cols[j], 0, length);
+      if ((row + j) % 7 == 0)
+	continue;
+      for (i = length / 4; i < length * 3 / 4; i++)
+	{
+	  seed = seed * 1103515245 + 12345;
+	  cols[j][i] = (seed >> 16) & 0xff;
+	}
+    }
+}
+
+static void
+weave_page(int limit)
+{
+  int linewidth = width_inches * XDPI;
+  int rows = height_inches * YDPI;
+  int length = (linewidth * BITWIDTH + 7) / 8;
+  int head_offset[NCOLORS];
+  unsigned char *cols[NCOLORS];
+  stp_vars_t *v = stp_vars_create();
+  struct timeval tv1, tv2;
+  int i, j;
+
+  stp_set_errfunc(v, errfunc);
+  stp_set_int_parameter(v, "WeaveBufferLimit", limit);
+  memset(head_offset, 0, sizeof(head_offset));
+  for (j = 0; j < NCOLORS; j++)
+    cols[j] = stp_malloc(length);
+  memset(&result, 0, sizeof(result));
+
+  (void) gettimeofday(&tv1, NULL);
+  stp_initialize_weave(v, JETS, SEPARATION, HORIZONTAL_PASSES, 1, 1,
+		       NCOLORS, BITWIDTH, linewidth, rows, 0,
+		       rows + JETS * SEPARATION, head_offset,
+		       STP_WEAVE_ZIGZAG, flush_pass, stp_fill_tiff,
+		       stp_pack_tiff, stp_compute_tiff_linewidth);
+  for (i = 0; i < rows; i++)
+    {
+      fill_row(cols, i, length);
+      stp_write_weave(v, cols);
+    }
+  stp_flush_all(v);
+  (void) gettimeofday(&tv2, NULL);
+  result.seconds = compute_interval(&tv1, &tv2);
+  stp_get_weave_memory(v, &(result.memory));
+
+  for (j = 0; j < NCOLORS; j++)
+    stp_free(cols[j]);
+  stp_vars_destroy(v);
+}
+
+/*
+ * Weave the page in a child process, so that its peak resident set
+ * can be measured on its own.  If spill_max is nonzero, writes to the
+ * spill file past that many kilobytes fail.
+ */
+static int
+run_weave(int limit, int spill_max, run_result_t *res, long *maxrss)
+{
+  struct rusage usage;
+  int fds[2];
+  int status;
+  pid_t pid;
+
+  if (pipe(fds))
+    {
+      perror("weave-memory");
+      return 0;
+    }
+  pid = fork();
+  if (pid == 0)
+    {
+      close(fds[0]);
+      if (spill_max > 0)
+	{
+	  struct rlimit rl;
+	  rl.rlim_cur = rl.rlim_max = (rlim_t) spill_max << 10;
+	  signal(SIGXFSZ, SIG_IGN);
+	  setrlimit(RLIMIT_FSIZE, &rl);
+	}
+      weave_page(limit);
+      if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+	_exit(2);
+      _exit(0);
+    }
+  close(fds[1]);
+  status = read(fds[0], res, sizeof(run_result_t));
+  close(fds[0]);
+  if (pid < 0 || wait4(pid, NULL, 0, &usage) != pid ||
+      status != sizeof(run_result_t))
+    {
+      fprintf(stderr, "Weaving with a limit of %d MB failed\n", limit);
+      return 0;
+    }
+  *maxrss = usage.ru_maxrss;
+  return 1;
+}
+
+static void
+report(int limit, const run_result_t *res, long maxrss)
+{
+  printf("limit %4d MB: %6.3f sec, %d passes, buffers peak %7.1f MB "
+	 "(unbounded %7.1f MB), spilled %7.1f MB, max RSS %7.1f MB\n",
+	 limit, res->seconds, res->passes,
+	 res->memory.peak / 1048576.0, res->memory.unbounded / 1048576.0,
+	 res->memory.spilled / 1048576.0, maxrss / 1024.0);
+}
+
+static int
+run_tests(int limit, int rss)
+{
+  run_result_t unlimited, limited, full;
+  long unlimited_rss, limited_rss, full_rss;
+  int failures = 0;
+
+  if (!run_weave(0, 0, &unlimited, &unlimited_rss) ||
+      !run_weave(limit, 0, &limited, &limited_rss) ||
+      !run_weave(limit, SPILL_FILE_MAX, &full, &full_rss))
+    return 1;
+  report(0, &unlimited, unlimited_rss);
+  report(limit, &limited, limited_rss);
+  report(limit, &full, full_rss);
+
+  if (unlimited.passes != limited.passes ||
+      unlimited.checksum != limited.checksum)
+    {
+      fprintf(stderr, "Passes differ with a limit of %d MB\n", limit);
+      failures++;
+    }
+  if (limited.memory.spilled == 0)
+    {
+      fprintf(stderr, "Nothing spilled with a limit of %d MB\n", limit);
+      failures++;
+    }
+  /* A spill file that fills up leaves the rest of the page in memory */
+  if (unlimited.passes != full.passes ||
+      unlimited.checksum != full.checksum)
+    {
+      fprintf(stderr, "Passes differ when the spill file fills up\n");
+      failures++;
+    }
+  if (full.errors == 0)
+    {
+      fprintf(stderr, "Full spill file not reported\n");
+      failures++;
+    }
+  /* The pass being printed is read back in full, whatever the limit */
+  if (limited.memory.peak >
+      ((size_t) limit << 20) + 2 * limited.pass_size)
+    {
+      fprintf(stderr, "Pass buffers took %lu bytes, limit %d MB\n",
+	      (unsigned long) limited.memory.peak, limit);
+      failures++;
+    }
+  if (limited_rss > rss * 1024L)
+    {
+      fprintf(stderr, "Peak RSS %ld KB, limit %d MB\n", limited_rss, rss);
+      failures++;
+    }
+  if (failures)
+    fprintf(stderr, "%d failures\n", failures);
+  else
+    printf("All passes match\n");
+  return failures;
+}
+
+static void
+run_benchmark(void)
+{
+  static const int limits[] = { 0, 256, 64, 16, 4, 1 };
+  int i;
+  for (i = 0; i < sizeof(limits) / sizeof(int); i++)
+    {
+      run_result_t res;
+      long maxrss;
+      if (run_weave(limits[i], 0, &res, &maxrss))
+	report(limits[i], &res, maxrss);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int benchmark = 0;
+  int limit = 1;
+  int rss = 24;
+  int c;
+
+  while ((c = getopt(argc, argv, "bl:r:w:h:")) != -1)
+    {
+      switch (c)
+	{
+	case 'b':
+	  benchmark = 1;
+	  break;
+	case 'l':
+	  limit = atoi(optarg);
+	  break;
+	case 'r':
+	  rss = atoi(optarg);
+	  break;
+	case 'w':
+	  width_inches = atof(optarg);
+	  break;
+	case 'h':
+	  height_inches = atof(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-b] [-l limit] [-r rss] [-w width] "
+		  "[-h height]\n", argv[0]);
+	  return 1;
+	}
+    }
+  if (limit <= 0)
+    limit = 1;
+  if (width_inches <= 0)
+    width_inches = 4;
+  if (height_inches <= 0)
+    height_inches = 0.5;
+
+#if !defined(HAVE_PREAD) || !defined(HAVE_PWRITE)
+  /* The library can't spill pass buffers here, so there's nothing to test */
+  printf("Weave buffers are never spilled on this platform; skipped\n");
+  return 77;
+#endif
+  stp_init();
+  if (benchmark)
+    {
+      run_benchmark();
+      return 0;
+    }
+  return run_tests(limit, rss) ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+ *   Benchmark for loading Gutenprint XML data.
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: xml-load [-n iterations] file.xml...
+ *
+ * Each file is parsed the way the library parses its data files, and
+ * every <sequence> in it is converted into a stp_sequence_t.  Typical
+ * use is
+ *
+ *   xml-load -n 10 `find ../src/xml -name '*.xml'`
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <gutenprint/gutenprint.h>
+#include <gutenprint/xml.h>
+#include "../src/main/gutenprint-internal.h"
+
+static double
+compute_interval(struct timeval *tv1, struct timeval *tv2)
+{
+  return ((double) tv2->tv_sec + (double) tv2->tv_usec / 1000000.) -
+    ((double) tv1->tv_sec + (double) tv1->tv_usec / 1000000.);
+}
+
+static int
+load_file(const char *file, size_t *sequences, size_t *points)
+{
+  stp_mxml_node_t *doc = stp_mxmlLoadFromFile(NULL, file,
+					      stpi_xml_type_callback);
+  stp_mxml_node_t *node;
+
+  if (!doc)
+    return 1;
+  for (node = stp_mxmlFindElement(doc, doc, "sequence", NULL, NULL,
+				  STP_MXML_DESCEND);
+       node;
+       node = stp_mxmlFindElement(node, doc, "sequence", NULL, NULL,
+				  STP_MXML_DESCEND))
+    {
+      stp_sequence_t *seq = stp_sequence_create_from_xmltree(node);
+      if (seq)
+	{
+	  (*sequences)++;
+	  *points += stp_sequence_get_size(seq);
+	  stp_sequence_destroy(seq);
+	}
+    }
+  stp_mxmlDelete(doc);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct timeval tv1, tv2;
+  size_t bytes = 0, sequences = 0, points = 0;
+  int iterations = 1;
+  int failures = 0;
+  int files;
+  int i, j;
+  double elapsed;
+
+  while ((i = getopt(argc, argv, "n:")) != -1)
+    {
+      switch (i)
+	{
+	case 'n':
+	  iterations = atoi(optarg);
+	  break;
+	default:
+	  fprintf(stderr, "Usage: %s [-n iterations] file.xml...\n", argv[0]);
+	  return 1;
+	}
+    }
+  files = argc - optind;
+  if (files <= 0 || iterations <= 0)
+    {
+      fprintf(stderr, "Usage: %s [-n iterations] file.xml...\n", argv[0]);
+      return 1;
+    }
+
+  stp_init();
+
+  for (i = optind; i < argc; i++)
+    {
+      struct stat st;
+      if (stat(argv[i], &st) == 0)
+	bytes += st.st_size;
+    }
+
+  (void) gettimeofday(&tv1, NULL);
+  for (j = 0; j < iterations; j++)
+    for (i = optind; i < argc; i++)
+      if (load_file(argv[i], &sequences, &points))
+	{
+	  if (j == 0)
+	    fprintf(stderr, "%s: unable to load\n", argv[i]);
+	  failures++;
+	}
+  (void) gettimeofday(&tv2, NULL);
+
+  elapsed = compute_interval(&tv1, &tv2);
+  printf("%d files, %lu bytes, %lu sequences, %lu points per pass\n",
+	 files, (unsigned long) bytes,
+	 (unsigned long) (sequences / iterations),
+	 (unsigned long) (points / iterations));
+  printf("%d passes %.3f sec %.3f ms/pass %.2f MB/sec\n",
+	 iterations, elapsed, elapsed * 1000 / iterations,
+	 elapsed > 0 ? (double) bytes * iterations / elapsed / 1048576 : 0);
+  return failures ? 1 : 0;
+}